@@ -85,6 +85,8 @@ int Example::run()
   _window->setActive();
 
   initScene();
+  if (_renderer)
+    _renderer->preparePrograms(_scene);
 
   if (_cameraType == Flycam)
     _window->setMouseCursorVisible(false);
@@ -14,4 +14,33 @@
 # define GL3_PROTOTYPES
 # include <gl3.h>
 
+/*
+** Entry points newer than gl3.h, only called when the context exposes them
+** (see gle::Extensions)
+*/
+
+# ifndef GL_ARB_buffer_storage
+#  define GL_ARB_buffer_storage 1
+#  define GL_MAP_PERSISTENT_BIT			0x0040
+#  define GL_MAP_COHERENT_BIT			0x0080
+#  define GL_DYNAMIC_STORAGE_BIT		0x0100
+#  define GL_CLIENT_STORAGE_BIT			0x0200
+#  define GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT	0x00004000
+#  define GL_BUFFER_IMMUTABLE_STORAGE		0x821F
+#  define GL_BUFFER_STORAGE_FLAGS		0x8220
+#  ifdef __cplusplus
+extern "C" {
+#  endif
+GLAPI void APIENTRY glBufferStorage (GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags);
+#  ifdef __cplusplus
+}
+#  endif
+# endif
+
+# ifndef GL_KHR_parallel_shader_compile
+#  define GL_KHR_parallel_shader_compile 1
+#  define GL_MAX_SHADER_COMPILER_THREADS_KHR	0x91B0
+#  define GL_COMPLETION_STATUS_KHR		0x91B1
+# endif
+
 #endif /* _GLE_OPENGL_H_ */
@@ -9,6 +9,7 @@
 //
 
 #include <BoundingBox.hpp>
+#include <BoundsArray.hpp>
 #include <Geometries.hpp>
 
 gle::BoundingBox::BoundingBox() : _debugMaterial(NULL), _debugMesh(NULL)
@@ -185,25 +186,7 @@ const gle::Vector3<float>& gle::BoundingBox::getCenter()
 
 bool gle::BoundingBox::isInFrustum(const GLfloat frustum[6][4]) const
 {
-  for(int i = 0; i < 6; i++)
-    {
-      if (frustum[i][0] * _min.x + frustum[i][1] * _min.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _min.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _max.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _max.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _min.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _min.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _max.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _max.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-        continue;
-      return (false);
-    }
-  return (true);
+  GLuint planeMask = BoundsArray::AllPlanes;
+
+  return (BoundsArray::testBox(frustum, planeMask, _min, _max));
 }
@@ -166,27 +166,16 @@ const gle::Vector3<float>& gle::BoundingSphere::getCenter()
   return (_absoluteCenter);
 }
 
+GLfloat gle::BoundingSphere::getRadius()
+{
+  return (_absoluteRadius);
+}
+
 bool gle::BoundingSphere::isInFrustum(const GLfloat frustum[6][4]) const
 {
-  for(int i = 0; i < 6; i++)
-    {
-      if (frustum[i][0] * _min.x + frustum[i][1] * _min.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _min.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _max.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _max.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _min.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _min.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _max.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-        continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _max.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-        continue;
+  for (int i = 0; i < 6; i++)
+    if (frustum[i][0] * _absoluteCenter.x + frustum[i][1] * _absoluteCenter.y
+	+ frustum[i][2] * _absoluteCenter.z + frustum[i][3] < -_absoluteRadius)
       return (false);
-    }
   return (true);
 }
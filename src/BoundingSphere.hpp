@@ -64,6 +64,9 @@ namespace gle
     //! Get center of bounding sphere
     virtual const gle::Vector3<float>& getCenter();
 
+    //! Get the radius of the bounding sphere, after transformation
+    virtual GLfloat getRadius();
+
     //! Return wheter or not bounding sphere is in frustum
     /*!
       \param frustum Six planes of frustum
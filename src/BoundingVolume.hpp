@@ -64,6 +64,12 @@ namespace gle {
     //! Get center of bounding volume
     virtual const gle::Vector3<float>& getCenter() = 0;
 
+    //! Get the radius of the bounding volume if it is a sphere
+    /*!
+      A negative radius means the volume is culled with its box
+     */
+    virtual GLfloat getRadius() { return (-1); }
+
     //! Return wheter or not bounding volume is in frustum
     /*!
       \param frustum Six planes of frustum
@@ -0,0 +1,386 @@
+//
+// BoundsArray.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:58:15 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#ifdef __SSE__
+# include <xmmintrin.h>
+#endif
+#include <BoundsArray.hpp>
+
+gle::BoundsArray::BoundsArray() : _size(0)
+{
+  clear();
+}
+
+gle::BoundsArray::~BoundsArray()
+{
+}
+
+void gle::BoundsArray::clear()
+{
+  _centersX.assign(Width - 1, 0);
+  _centersY.assign(Width - 1, 0);
+  _centersZ.assign(Width - 1, 0);
+  _extentsX.assign(Width - 1, 0);
+  _extentsY.assign(Width - 1, 0);
+  _extentsZ.assign(Width - 1, 0);
+  _radiuses.assign(Width - 1, 0);
+  _sizes.assign(Width - 1, 0);
+  _drawDistances.assign(Width - 1, std::numeric_limits<GLfloat>::infinity());
+  _size = 0;
+}
+
+void gle::BoundsArray::reserve(GLuint size)
+{
+  _centersX.reserve(size + Width - 1);
+  _centersY.reserve(size + Width - 1);
+  _centersZ.reserve(size + Width - 1);
+  _extentsX.reserve(size + Width - 1);
+  _extentsY.reserve(size + Width - 1);
+  _extentsZ.reserve(size + Width - 1);
+  _radiuses.reserve(size + Width - 1);
+  _sizes.reserve(size + Width - 1);
+  _drawDistances.reserve(size + Width - 1);
+}
+
+GLuint gle::BoundsArray::size() const
+{
+  return (_size);
+}
+
+void gle::BoundsArray::resize(GLuint size)
+{
+  _centersX.resize(size + Width - 1);
+  _centersY.resize(size + Width - 1);
+  _centersZ.resize(size + Width - 1);
+  _extentsX.resize(size + Width - 1);
+  _extentsY.resize(size + Width - 1);
+  _extentsZ.resize(size + Width - 1);
+  _radiuses.resize(size + Width - 1);
+  _sizes.resize(size + Width - 1);
+  _drawDistances.resize(size + Width - 1);
+  // Clear the new bounds, and the padding
+  for (GLuint i = std::min(size, _size); i < size + Width - 1; ++i)
+    setEmpty(i);
+  _size = size;
+}
+
+GLuint gle::BoundsArray::addBox(const Vector3<GLfloat>& min,
+				const Vector3<GLfloat>& max)
+{
+  resize(_size + 1);
+  setBox(_size - 1, min, max);
+  return (_size - 1);
+}
+
+GLuint gle::BoundsArray::addSphere(const Vector3<GLfloat>& center,
+				   GLfloat radius)
+{
+  resize(_size + 1);
+  setSphere(_size - 1, center, radius);
+  return (_size - 1);
+}
+
+void gle::BoundsArray::setBox(GLuint index, const Vector3<GLfloat>& min,
+			      const Vector3<GLfloat>& max)
+{
+  _set(index, (min.x + max.x) / 2, (min.y + max.y) / 2, (min.z + max.z) / 2,
+       (max.x - min.x) / 2, (max.y - min.y) / 2, (max.z - min.z) / 2, 0);
+}
+
+void gle::BoundsArray::setSphere(GLuint index, const Vector3<GLfloat>& center,
+				 GLfloat radius)
+{
+  _set(index, center.x, center.y, center.z, 0, 0, 0, radius);
+}
+
+void gle::BoundsArray::setEmpty(GLuint index)
+{
+  // The infinite negative radius is behind any plane
+  _set(index, 0, 0, 0, 0, 0, 0, -std::numeric_limits<GLfloat>::infinity());
+  _drawDistances[index] = std::numeric_limits<GLfloat>::infinity();
+}
+
+void gle::BoundsArray::setDrawDistance(GLuint index, GLfloat distance)
+{
+  _drawDistances[index] = distance;
+}
+
+void gle::BoundsArray::_set(GLuint index, GLfloat x, GLfloat y, GLfloat z,
+			    GLfloat extentX, GLfloat extentY, GLfloat extentZ,
+			    GLfloat radius)
+{
+  _centersX[index] = x;
+  _centersY[index] = y;
+  _centersZ[index] = z;
+  _extentsX[index] = extentX;
+  _extentsY[index] = extentY;
+  _extentsZ[index] = extentZ;
+  _radiuses[index] = radius;
+  _sizes[index] = radius + sqrt(extentX * extentX + extentY * extentY
+				+ extentZ * extentZ);
+}
+
+#ifdef __SSE__
+
+int gle::BoundsArray::_cullDetail(const GLfloat* detail, GLuint index) const
+{
+  const GLfloat*	centers[3] = {&_centersX[index], &_centersY[index], &_centersZ[index]};
+  const GLfloat*	extents[3] = {&_extentsX[index], &_extentsY[index], &_extentsZ[index]};
+  __m128		signs = _mm_set1_ps(-0.0f);
+  __m128		zero = _mm_setzero_ps();
+  __m128		squares = zero;
+
+  // Distance from the point of view to the box, then to the sphere
+  for (GLuint axis = 0; axis < 3; ++axis)
+    {
+      __m128 offset = _mm_sub_ps(_mm_loadu_ps(centers[axis]), _mm_set1_ps(detail[axis]));
+      __m128 outside = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(signs, offset),
+					     _mm_loadu_ps(extents[axis])), zero);
+
+      squares = _mm_add_ps(squares, _mm_mul_ps(outside, outside));
+    }
+  __m128 distance = _mm_max_ps(_mm_sub_ps(_mm_sqrt_ps(squares),
+					  _mm_loadu_ps(&_radiuses[index])), zero);
+
+  // The empty bounds fail both tests
+  __m128 far = _mm_cmpnle_ps(distance, _mm_loadu_ps(&_drawDistances[index]));
+  __m128 small = _mm_cmpnge_ps(_mm_loadu_ps(&_sizes[index]),
+			       _mm_mul_ps(distance, _mm_set1_ps(detail[3])));
+
+  return (_mm_movemask_ps(_mm_or_ps(far, small)));
+}
+
+void gle::BoundsArray::cull(const GLfloat frustum[6][4], GLuint planeMask,
+			    const GLfloat* detail, GLuint first, GLuint last,
+			    std::vector<GLuint>& visible) const
+{
+  __m128	planes[6][7];
+  GLuint	nbPlanes = 0;
+  __m128	zero = _mm_setzero_ps();
+
+  for (GLuint i = 0; i < 6; ++i)
+    if (planeMask & (1 << i))
+      {
+	for (GLuint j = 0; j < 4; ++j)
+	  planes[nbPlanes][j] = _mm_set1_ps(frustum[i][j]);
+	for (GLuint j = 0; j < 3; ++j)
+	  planes[nbPlanes][4 + j] = _mm_set1_ps(fabs(frustum[i][j]));
+	++nbPlanes;
+      }
+  for (GLuint i = first; i < last; i += Width)
+    {
+      __m128	centerX = _mm_loadu_ps(&_centersX[i]);
+      __m128	centerY = _mm_loadu_ps(&_centersY[i]);
+      __m128	centerZ = _mm_loadu_ps(&_centersZ[i]);
+      __m128	extentX = _mm_loadu_ps(&_extentsX[i]);
+      __m128	extentY = _mm_loadu_ps(&_extentsY[i]);
+      __m128	extentZ = _mm_loadu_ps(&_extentsZ[i]);
+      __m128	radius = _mm_loadu_ps(&_radiuses[i]);
+      int	outside = 0;
+
+      for (GLuint p = 0; p < nbPlanes && outside != 0xF; ++p)
+	{
+	  // Distance of the center, and of the p-vertex from the center
+	  __m128 distance =
+	    _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], centerX),
+				  _mm_mul_ps(planes[p][1], centerY)),
+		       _mm_add_ps(_mm_mul_ps(planes[p][2], centerZ),
+				  planes[p][3]));
+	  __m128 reach =
+	    _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][4], extentX),
+				  _mm_mul_ps(planes[p][5], extentY)),
+		       _mm_add_ps(_mm_mul_ps(planes[p][6], extentZ), radius));
+
+	  outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach),
+						  zero));
+	}
+      if (detail && outside != 0xF)
+	outside |= _cullDetail(detail, i);
+      int inside = ~outside & 0xF;
+      if (last - i < Width)
+	inside &= (1 << (last - i)) - 1;
+      for (GLuint lane = 0; inside; ++lane, inside >>= 1)
+	if (inside & 1)
+	  visible.push_back(i + lane);
+    }
+}
+
+
+void gle::BoundsArray::cull(const GLfloat frustums[][6][4], const GLuint* planeMasks,
+			    GLuint viewMask, const GLfloat* detail, GLuint first, GLuint last,
+			    GLuint* masks, std::vector<GLuint>& visible) const
+{
+  __m128	zero = _mm_setzero_ps();
+  __m128	empty = _mm_set1_ps(-std::numeric_limits<GLfloat>::infinity());
+
+  for (GLuint i = first; i < last; i += Width)
+    {
+      __m128	centerX = _mm_loadu_ps(&_centersX[i]);
+      __m128	centerY = _mm_loadu_ps(&_centersY[i]);
+      __m128	centerZ = _mm_loadu_ps(&_centersZ[i]);
+      __m128	extentX = _mm_loadu_ps(&_extentsX[i]);
+      __m128	extentY = _mm_loadu_ps(&_extentsY[i]);
+      __m128	extentZ = _mm_loadu_ps(&_extentsZ[i]);
+      __m128	radius = _mm_loadu_ps(&_radiuses[i]);
+      GLuint	lanes = std::min(last - i, (GLuint)Width);
+
+      // The bounds are loaded once for all the views
+      for (GLuint view = 0; viewMask >> view; ++view)
+	{
+	  if (!(viewMask & (1u << view)))
+	    continue;
+
+	  int outside = 0;
+
+	  for (GLuint p = 0; p < 6 && outside != 0xF; ++p)
+	    if (planeMasks[view] & (1 << p))
+	      {
+		const GLfloat*	plane = frustums[view][p];
+		__m128		distance =
+		  _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), centerX),
+					_mm_mul_ps(_mm_set1_ps(plane[1]), centerY)),
+			     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[2]), centerZ),
+					_mm_set1_ps(plane[3])));
+		__m128		reach =
+		  _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(fabs(plane[0])), extentX),
+					_mm_mul_ps(_mm_set1_ps(fabs(plane[1])), extentY)),
+			     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(fabs(plane[2])), extentZ),
+					radius));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach),
+							zero));
+	      }
+	  // The empty bounds are outside the frustums without tested planes
+	  if (planeMasks[view] == 0)
+	    outside = _mm_movemask_ps(_mm_cmpeq_ps(radius, empty));
+	  if (view == 0 && detail && outside != 0xF)
+	    outside |= _cullDetail(detail, i);
+	  for (GLuint lane = 0; lane < lanes; ++lane)
+	    if (!(outside & (1 << lane)))
+	      {
+		if (!masks[i + lane])
+		  visible.push_back(i + lane);
+		masks[i + lane] |= 1u << view;
+	      }
+	}
+    }
+}
+
+#else
+
+int gle::BoundsArray::_cullDetail(const GLfloat* detail, GLuint index) const
+{
+  const GLfloat	centers[3] = {_centersX[index], _centersY[index], _centersZ[index]};
+  const GLfloat	extents[3] = {_extentsX[index], _extentsY[index], _extentsZ[index]};
+  GLfloat	squares = 0;
+
+  // Distance from the point of view to the box, then to the sphere
+  for (GLuint axis = 0; axis < 3; ++axis)
+    {
+      GLfloat outside = std::max(GLfloat(fabs(centers[axis] - detail[axis]))
+				 - extents[axis], 0.0f);
+
+      squares += outside * outside;
+    }
+  GLfloat distance = std::max(GLfloat(sqrt(squares)) - _radiuses[index], 0.0f);
+
+  // The empty bounds fail both tests
+  return (!(distance <= _drawDistances[index])
+	  || !(_sizes[index] >= distance * detail[3]));
+}
+
+void gle::BoundsArray::cull(const GLfloat frustum[6][4], GLuint planeMask,
+			    const GLfloat* detail, GLuint first, GLuint last,
+			    std::vector<GLuint>& visible) const
+{
+  for (GLuint i = first; i < last; ++i)
+    {
+      bool inside = true;
+
+      for (GLuint p = 0; p < 6 && inside; ++p)
+	if (planeMask & (1 << p))
+	  {
+	    GLfloat distance = frustum[p][0] * _centersX[i]
+	      + frustum[p][1] * _centersY[i]
+	      + frustum[p][2] * _centersZ[i] + frustum[p][3];
+	    GLfloat reach = fabs(frustum[p][0]) * _extentsX[i]
+	      + fabs(frustum[p][1]) * _extentsY[i]
+	      + fabs(frustum[p][2]) * _extentsZ[i] + _radiuses[i];
+
+	    inside = distance + reach >= 0;
+	  }
+      if (inside && detail)
+	inside = !_cullDetail(detail, i);
+      if (inside)
+	visible.push_back(i);
+    }
+}
+
+void gle::BoundsArray::cull(const GLfloat frustums[][6][4], const GLuint* planeMasks,
+			    GLuint viewMask, const GLfloat* detail, GLuint first, GLuint last,
+			    GLuint* masks, std::vector<GLuint>& visible) const
+{
+  for (GLuint view = 0; viewMask >> view; ++view)
+    if (viewMask & (1u << view))
+      for (GLuint i = first; i < last; ++i)
+	{
+	  bool inside = _radiuses[i] != -std::numeric_limits<GLfloat>::infinity();
+
+	  for (GLuint p = 0; p < 6 && inside; ++p)
+	    if (planeMasks[view] & (1 << p))
+	      {
+		const GLfloat*	plane = frustums[view][p];
+		GLfloat		distance = plane[0] * _centersX[i]
+		  + plane[1] * _centersY[i] + plane[2] * _centersZ[i] + plane[3];
+		GLfloat		reach = fabs(plane[0]) * _extentsX[i]
+		  + fabs(plane[1]) * _extentsY[i]
+		  + fabs(plane[2]) * _extentsZ[i] + _radiuses[i];
+
+		inside = distance + reach >= 0;
+	      }
+	  if (inside && view == 0 && detail)
+	    inside = !_cullDetail(detail, i);
+	  if (inside)
+	    {
+	      if (!masks[i])
+		visible.push_back(i);
+	      masks[i] |= 1u << view;
+	    }
+	}
+}
+
+#endif
+
+bool gle::BoundsArray::testBox(const GLfloat frustum[6][4], GLuint& planeMask,
+			       const Vector3<GLfloat>& min,
+			       const Vector3<GLfloat>& max)
+{
+  for (GLuint p = 0; p < 6; ++p)
+    if (planeMask & (1 << p))
+      {
+	GLfloat distance = frustum[p][0] * (min.x + max.x)
+	  + frustum[p][1] * (min.y + max.y)
+	  + frustum[p][2] * (min.z + max.z) + 2 * frustum[p][3];
+	GLfloat reach = fabs(frustum[p][0]) * (max.x - min.x)
+	  + fabs(frustum[p][1]) * (max.y - min.y)
+	  + fabs(frustum[p][2]) * (max.z - min.z);
+
+	// Twice the distances, from the center and half extents
+	if (distance + reach < 0)
+	  return (false);
+	// The n-vertex is inside too: so are the contents of the box
+	if (distance - reach > 0)
+	  planeMask &= ~(1 << p);
+      }
+  return (true);
+}
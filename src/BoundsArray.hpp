@@ -0,0 +1,189 @@
+//
+// BoundsArray.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:58:15 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_BOUNDS_ARRAY_HPP_
+# define _GLE_BOUNDS_ARRAY_HPP_
+
+# include <vector>
+# include <gle/opengl.h>
+# include <Vector3.hpp>
+
+namespace gle {
+
+  //! World bounds of a set of elements, tested against frustum planes
+  /*!
+    Each bound is an axis aligned box, stored as its center and half
+    extents, and an optional sphere radius. The components are stored as
+    structure of arrays, so the planes are tested on Width bounds at once
+    with SSE, or one by one when it is not available.
+
+    A box is outside a plane when its p-vertex (the corner the furthest
+    along the plane normal) is behind it: dot(n, center) + d +
+    dot(abs(n), extent) < 0. A sphere has a null extent and is outside
+    when dot(n, center) + d + radius < 0, which is the exact sphere test.
+
+    Planes follow the layout of Octree::getFrustumPlanes(): a point is
+    inside a plane when a * x + b * y + c * z + d > 0.
+
+    The queries can also cull the bounds too small or too far from a point
+    of view. Their distance is the distance from the point to their
+    nearest point, and their size the radius of the sphere around them.
+    A bound is culled when its distance is above its draw distance, or
+    when its size is below its distance times a ratio: the size of the
+    smallest bound drawn at a distance of 1.
+   */
+
+  class BoundsArray {
+  public:
+
+    //! Number of bounds tested by a single instruction
+    static const GLuint Width = 4;
+
+    //! Mask of all the planes of a frustum
+    static const GLuint AllPlanes = (1 << 6) - 1;
+
+    //! Create an empty array
+    BoundsArray();
+
+    //! Destroy the array
+    ~BoundsArray();
+
+    //! Remove all the bounds
+    void clear();
+
+    //! Reserve memory for a number of bounds
+    void reserve(GLuint size);
+
+    //! Returns the number of bounds
+    GLuint size() const;
+
+    //! Set the number of bounds
+    /*!
+      New bounds are empty
+     */
+    void resize(GLuint size);
+
+    //! Add a box
+    /*!
+      \param min Lowest corner of the box
+      \param max Highest corner of the box
+      \return Index of the bound
+     */
+    GLuint addBox(const Vector3<GLfloat>& min, const Vector3<GLfloat>& max);
+
+    //! Add a sphere
+    /*!
+      \param center World center of the sphere
+      \param radius World radius of the sphere
+      \return Index of the bound
+     */
+    GLuint addSphere(const Vector3<GLfloat>& center, GLfloat radius);
+
+    //! Set a bound to a box
+    /*!
+      \param index Index of the bound
+      \param min Lowest corner of the box
+      \param max Highest corner of the box
+     */
+    void setBox(GLuint index, const Vector3<GLfloat>& min,
+		const Vector3<GLfloat>& max);
+
+    //! Set a bound to a sphere
+    /*!
+      \param index Index of the bound
+      \param center World center of the sphere
+      \param radius World radius of the sphere
+     */
+    void setSphere(GLuint index, const Vector3<GLfloat>& center,
+		   GLfloat radius);
+
+    //! Set a bound to an empty bound, outside all the planes
+    /*!
+      \param index Index of the bound
+     */
+    void setEmpty(GLuint index);
+
+    //! Set the distance above which a bound is culled
+    /*!
+      \param index Index of the bound
+      \param distance Draw distance, infinite by default
+     */
+    void setDrawDistance(GLuint index, GLfloat distance);
+
+    //! Test a range of bounds against frustum planes
+    /*!
+      \param frustum Six planes of frustum
+      \param planeMask Planes to test, one bit per plane of frustum
+      \param detail Point of view and size ratio: x, y, z and ratio, to
+      cull the small and distant bounds, or NULL
+      \param first Index of the first bound to test
+      \param last Index after the last bound to test
+      \param visible Indexes of the bounds inside all the tested planes
+      are added at its end
+     */
+    void cull(const GLfloat frustum[6][4], GLuint planeMask,
+	      const GLfloat* detail, GLuint first, GLuint last,
+	      std::vector<GLuint>& visible) const;
+
+    //! Test a range of bounds against several frustums
+    /*!
+      The bounds are loaded once and tested against all the frustums.
+      \param frustums Six planes of each frustum
+      \param planeMasks Planes to test in each frustum
+      \param viewMask Frustums to test, one bit per frustum
+      \param detail Point of view and size ratio culling the small and
+      distant bounds of the first frustum, or NULL
+      \param first Index of the first bound to test
+      \param last Index after the last bound to test
+      \param masks Frustums containing each bound, indexed by bound: the
+      bit of each frustum containing a bound is set
+      \param visible Indexes of the bounds whose mask was null before the
+      test, and is not after, are added at its end
+     */
+    void cull(const GLfloat frustums[][6][4], const GLuint* planeMasks,
+	      GLuint viewMask, const GLfloat* detail, GLuint first, GLuint last,
+	      GLuint* masks, std::vector<GLuint>& visible) const;
+
+    //! Test a box against frustum planes
+    /*!
+      \param frustum Six planes of frustum
+      \param planeMask Planes to test, updated to the planes the box is
+      only partially inside
+      \return false if the box is outside one of the planes
+     */
+    static bool testBox(const GLfloat frustum[6][4], GLuint& planeMask,
+			const Vector3<GLfloat>& min,
+			const Vector3<GLfloat>& max);
+
+  private:
+    // Mask of the bounds from index too small or too far: Width bounds
+    // with SSE, a single one otherwise
+    int		_cullDetail(const GLfloat* detail, GLuint index) const;
+    void	_set(GLuint index, GLfloat x, GLfloat y, GLfloat z,
+		     GLfloat extentX, GLfloat extentY, GLfloat extentZ,
+		     GLfloat radius);
+
+    // Bounds, stored as structure of arrays, with Width - 1 more elements
+    // so the last bounds can always be loaded Width at a time, with the
+    // radius of the sphere around each bound
+    std::vector<GLfloat>	_centersX;
+    std::vector<GLfloat>	_centersY;
+    std::vector<GLfloat>	_centersZ;
+    std::vector<GLfloat>	_extentsX;
+    std::vector<GLfloat>	_extentsY;
+    std::vector<GLfloat>	_extentsZ;
+    std::vector<GLfloat>	_radiuses;
+    std::vector<GLfloat>	_sizes;
+    std::vector<GLfloat>	_drawDistances;
+    GLuint			_size;
+  };
+}
+
+#endif /* _GLE_BOUNDS_ARRAY_HPP_ */
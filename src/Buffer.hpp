@@ -11,8 +11,12 @@
 #ifndef _GLE_BUFFER_HPP_
 # define _GLE_BUFFER_HPP_
 
+# include <cstring>
 # include <gle/opengl.h>
 # include <Exception.hpp>
+# include <Debug.hpp>
+# include <Extensions.hpp>
+# include <StateCache.hpp>
 
 #include <iostream>
 
@@ -24,6 +28,11 @@ namespace gle {
     an OpenGL Buffer.
     It also allows to map a buffer in memory or update part or all of its
     data once created.
+
+    Buffers updated every frame should use the DynamicDraw or StreamDraw
+    usages. When GL_ARB_buffer_storage is available, setPersistent() keeps
+    the buffer mapped for its whole life: writes are then done directly in
+    the mapped memory, synchronized with the gpu by lock() and wait().
   */
 
   template <typename T>
@@ -51,9 +60,15 @@ namespace gle {
     */
 
     enum Usage {
-      StaticDraw = GL_STATIC_DRAW
+      StaticDraw = GL_STATIC_DRAW,
       /*!< Usage for a buffer modified by the application and used by OpenGL
 	for drawing */
+      DynamicDraw = GL_DYNAMIC_DRAW,
+      /*!< Usage for a buffer modified repeatedly by the application and used
+	many times by OpenGL for drawing */
+      StreamDraw = GL_STREAM_DRAW
+      /*!< Usage for a buffer modified by the application before each use by
+	OpenGL for drawing */
     };
 
     //! Mapping access types
@@ -71,6 +86,26 @@ namespace gle {
       /*!< Map the buffer for reading and writing */
     };
 
+    //! Mapping options
+    /*!
+      Additional flags for the mapping of a part of a buffer.
+      They can be combined with the OR operator.
+    */
+
+    enum MapFlags {
+      NoFlags = 0,
+      /*!< Default synchronized mapping */
+      InvalidateRange = GL_MAP_INVALIDATE_RANGE_BIT,
+      /*!< The previous content of the mapped range is discarded */
+      InvalidateBuffer = GL_MAP_INVALIDATE_BUFFER_BIT,
+      /*!< The previous content of the whole buffer is discarded */
+      Unsynchronized = GL_MAP_UNSYNCHRONIZED_BIT,
+      /*!< Do not wait for the gpu to finish using the buffer.
+	The application must ensure the mapped range is not in use */
+      FlushExplicit = GL_MAP_FLUSH_EXPLICIT_BIT
+      /*!< Modified ranges must be indicated with flush() */
+    };
+
     //! Create a buffer
     /*!
       Size, data and usage are can be ommited.
@@ -85,18 +120,14 @@ namespace gle {
 
     Buffer(Type type, Usage usage=StaticDraw,
 	   GLsizeiptr size=0, const T* data=NULL) :
-      _type(type), _usage(usage), _size(size), _id(0)
+      _type(type), _usage(usage), _size(size), _id(0),
+      _storageSize(0), _persistent(false), _persistentData(NULL), _fence(0)
     {
       glGenBuffers(1, &_id);
       if (size > 0)
 	{
 	  bind();
-	  glBufferData(_type, _size * sizeof(T), data, _usage);
-	  GLenum error = glGetError();
-	  if (error == GL_OUT_OF_MEMORY)
-	    throw new gle::Exception::OutOfMemory("Cannot create buffer");
-	  else if (error != GL_NO_ERROR)
-	    throw new gle::Exception::OpenGLError();
+	  _createStorage(data);
 	}
     }
 
@@ -107,20 +138,20 @@ namespace gle {
     */
 
     Buffer(Buffer const & other) :
-      _type(other._type), _usage(other._usage), _size(0), _id(0)
+      _type(other._type), _usage(other._usage), _size(0), _id(0),
+      _storageSize(0), _persistent(other._persistent), _persistentData(NULL),
+      _fence(0)
     {
       glGenBuffers(1, &_id);
       if (other._size > 0)
 	{
 	  _size = other._size;
-	  glBindBuffer(GL_COPY_WRITE_BUFFER, _id);
-	  glBufferData(GL_COPY_WRITE_BUFFER, other._size * sizeof(T),
-		       NULL, _usage);
-	  glBindBuffer(GL_COPY_READ_BUFFER, other._id);
+	  _createStorage(NULL);
+	  gle::StateCache::getInstance().bindBuffer(GL_COPY_READ_BUFFER, other._id);
 	  bind();
 	  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
 			      0, 0, other._size * sizeof(T));
-	  GLenum error = glGetError();
+	  GLenum error = GLE_GET_ERROR();
 	  if (error == GL_OUT_OF_MEMORY)
 	    throw new gle::Exception::OutOfMemory("Cannot copy buffer");
 	  else if (error == GL_INVALID_VALUE)
@@ -141,19 +172,19 @@ namespace gle {
     */
 
     Buffer(Buffer const & other, GLsizeiptr newSize) :
-      _type(other._type), _usage(other._usage), _size(newSize), _id(0)
+      _type(other._type), _usage(other._usage), _size(newSize), _id(0),
+      _storageSize(0), _persistent(other._persistent), _persistentData(NULL),
+      _fence(0)
     {
       glGenBuffers(1, &_id);
       if (_size < other._size)
 	_size = other._size;
-      glBindBuffer(GL_COPY_WRITE_BUFFER, _id);
-      glBufferData(GL_COPY_WRITE_BUFFER, _size * sizeof(T),
-		   NULL, _usage);
-      glBindBuffer(GL_COPY_READ_BUFFER, other._id);
+      _createStorage(NULL);
+      gle::StateCache::getInstance().bindBuffer(GL_COPY_READ_BUFFER, other._id);
       bind();
       glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
 			  0, 0, other._size * sizeof(T));
-      GLenum error = glGetError();
+      GLenum error = GLE_GET_ERROR();
       if (error == GL_OUT_OF_MEMORY)
 	throw new gle::Exception::OutOfMemory("Cannot copy buffer");
       else if (error == GL_INVALID_VALUE)
@@ -167,7 +198,10 @@ namespace gle {
     //! Destruct a buffer
     ~Buffer()
     {
+      if (_fence)
+	glDeleteSync(_fence);
       glDeleteBuffers(1, &_id);
+      gle::StateCache::getInstance().forgetBuffer(_id);
     }
 
     //! Bind a buffer
@@ -178,7 +212,7 @@ namespace gle {
 
     void bind() const
     {
-      glBindBuffer(_type, _id);
+      gle::StateCache::getInstance().bindBuffer(_type, _id);
     }
 
     //! Bind a buffer to a binding point
@@ -189,7 +223,7 @@ namespace gle {
 
     void bindBase(GLuint binding) const
     {
-      glBindBufferBase(_type, binding, _id);
+      gle::StateCache::getInstance().bindBufferBase(_type, binding, _id);
     }
 
     //! Resize a buffer
@@ -209,6 +243,83 @@ namespace gle {
       setData(data);
     }
 
+    //! Make the buffer persistently mapped
+    /*!
+      A persistent buffer stays mapped in memory, map() and setData() then
+      write directly in the mapped memory, without any call to OpenGL.
+      The application must call lock() after the commands using the buffer
+      are sent, so the next writes wait for the gpu to finish with it.
+      The data of the buffer are kept.
+      \param persistent Wether the buffer must be persistent or not
+      \return False if persistent mapping is not supported
+      by the context (GL_ARB_buffer_storage)
+    */
+
+    bool setPersistent(bool persistent=true)
+    {
+      if (persistent && !gle::Extensions::hasBufferStorage())
+	return (false);
+      if (persistent == _persistent)
+	return (true);
+      _persistent = persistent;
+      _reallocate(NULL, _size);
+      return (true);
+    }
+
+    //! Return wether the buffer is persistently mapped
+
+    bool isPersistent() const
+    {
+      return (_persistent);
+    }
+
+    //! Invalidate the buffer data
+    /*!
+      The previous content of the buffer becomes undefined.
+      For a classic buffer, a new storage is allocated (orphaning) so the
+      application can write new data without waiting for the gpu to finish
+      with the previous ones.
+      For a persistent buffer, this waits for the last lock() to be reached.
+    */
+
+    void invalidate()
+    {
+      if (_persistent)
+	{
+	  wait();
+	  return ;
+	}
+      _createStorage(NULL);
+    }
+
+    //! Place a fence after the commands currently using the buffer
+    /*!
+      The next wait() (and writes to a persistent buffer) will block
+      until the gpu has executed these commands.
+    */
+
+    void lock()
+    {
+      if (_fence)
+	glDeleteSync(_fence);
+      _fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    //! Wait for the gpu to reach the last fence placed by lock()
+
+    void wait()
+    {
+      if (!_fence)
+	return ;
+      GLenum status = GL_TIMEOUT_EXPIRED;
+      while (status == GL_TIMEOUT_EXPIRED)
+	status = glClientWaitSync(_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+      glDeleteSync(_fence);
+      _fence = 0;
+      if (status == GL_WAIT_FAILED)
+	throw new gle::Exception::OpenGLError("Cannot wait for buffer fence");
+    }
+
     //! Set the buffer data
     /*!
       Update the buffer data with values pointed by 'data'
@@ -220,19 +331,23 @@ namespace gle {
     void setData(const T* data)
     {
       bind();
-      GLenum error = glGetError();
+      GLenum error = GLE_GET_ERROR();
       if (error != GL_NO_ERROR)
 	{
 	  throw new gle::Exception::OpenGLError("setData: bind()");
 	}
-      glBufferData(_type, _size * sizeof(T), data, _usage);
-      error = glGetError();
-      if (error == GL_OUT_OF_MEMORY)
-	throw new gle::Exception::OutOfMemory("Cannot set buffer data");
-      else if (error != GL_NO_ERROR)
+      if (_persistent && _persistentData && _storageSize == _size)
 	{
-	  throw new gle::Exception::OpenGLError("setData: glBufferData()");
+	  if (data)
+	    {
+	      wait();
+	      memcpy(_persistentData, data, _size * sizeof(T));
+	    }
 	}
+      else if (_persistent)
+	_reallocate(data, 0);
+      else
+	_createStorage(data);
     }
 
     //! Set a part of the buffer data
@@ -248,9 +363,15 @@ namespace gle {
 
     void setData(const T* data, GLintptr offset, GLsizeiptr size)
     {
+      if (_persistentData)
+	{
+	  wait();
+	  memcpy(_persistentData + offset, data, size * sizeof(T));
+	  return ;
+	}
       bind();
       glBufferSubData(_type, offset * sizeof(T), size * sizeof(T), data);
-      GLenum error = glGetError();
+      GLenum error = GLE_GET_ERROR();
       if (error == GL_INVALID_VALUE)
 	throw new gle::Exception::InvalidValue("Invalid offset or size");
       else if (error == GL_INVALID_OPERATION)
@@ -270,9 +391,14 @@ namespace gle {
 
     T* map(MapAccess access=ReadWrite)
     {
+      if (_persistentData)
+	{
+	  wait();
+	  return (_persistentData);
+	}
       bind();
       T* ptr = (T*)glMapBuffer(_type, access);
-      GLenum error = glGetError();
+      GLenum error = GLE_GET_ERROR();
       if (error == GL_OUT_OF_MEMORY)
 	throw new gle::Exception::OutOfMemory("Cannot map buffer");
       else if (error == GL_INVALID_OPERATION)
@@ -291,23 +417,31 @@ namespace gle {
       \param offset The offset of the start of the part to be mapped
       \param length Length of the part to be mapped
       \param access Specifies the type of access required for this mapping
+      \param flags Combination of MapFlags
       \return A pointer to the mapped space
       \sa unmap
     */
 
-    T* map(GLintptr offset, GLsizeiptr length, MapAccess access=ReadWrite)
+    T* map(GLintptr offset, GLsizeiptr length, MapAccess access=ReadWrite,
+	   GLbitfield flags=NoFlags)
     {
+      if (_persistentData)
+	{
+	  if (!(flags & Unsynchronized))
+	    wait();
+	  return (_persistentData + offset);
+	}
       bind();
-      GLbitfield accessBits = 0;
+      GLbitfield accessBits = flags;
       if (access == ReadOnly)
-	accessBits = GL_MAP_READ_BIT;
+	accessBits |= GL_MAP_READ_BIT;
       else if (access == WriteOnly)
-	accessBits = GL_MAP_WRITE_BIT;
+	accessBits |= GL_MAP_WRITE_BIT;
       else if (access == ReadWrite)
-	accessBits = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
+	accessBits |= GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
       T* ptr = (T*)glMapBufferRange(_type, offset * sizeof(T),
 				    length * sizeof(T), accessBits);
-      GLenum error = glGetError();
+      GLenum error = GLE_GET_ERROR();
       if (error == GL_INVALID_VALUE)
 	throw new gle::Exception::InvalidValue("Invalid offset or length");
       else if (error == GL_OUT_OF_MEMORY)
@@ -333,9 +467,11 @@ namespace gle {
 
     bool unmap()
     {
+      if (_persistentData)
+	return (true);
       bind();
       GLboolean ret = glUnmapBuffer(_type);
-      GLenum error = glGetError();
+      GLenum error = GLE_GET_ERROR();
       if (error == GL_INVALID_OPERATION)
 	throw new gle::Exception::InvalidOperation("Buffer not mapped");
       else if (error != GL_NO_ERROR)
@@ -352,9 +488,11 @@ namespace gle {
     
     void flush(GLintptr offset, GLsizeiptr length)
     {
+      if (_persistentData)
+	return ;
       bind();
       glFlushMappedBuffer(_type, offset, length);
-      GLenum error = glGetError();
+      GLenum error = GLE_GET_ERROR();
       if (error == GL_INVALID_VALUE)
 	throw new gle::Exception::InvalidValue("Flush invalid");
       else if (error == GL_INVALID_OPERATION)
@@ -388,11 +526,71 @@ namespace gle {
     }
     
   private:
+    static const GLbitfield PersistentMapBits =
+      GL_MAP_READ_BIT | GL_MAP_WRITE_BIT
+      | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    void _createStorage(const T* data)
+    {
+      gle::StateCache::getInstance().bindBuffer(GL_COPY_WRITE_BUFFER, _id);
+      if (_persistent)
+	{
+	  if (_size > 0)
+	    {
+	      glBufferStorage(GL_COPY_WRITE_BUFFER, _size * sizeof(T), data,
+			      PersistentMapBits | GL_DYNAMIC_STORAGE_BIT);
+	      _persistentData = (T*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0,
+						     _size * sizeof(T),
+						     PersistentMapBits);
+	    }
+	}
+      else
+	glBufferData(GL_COPY_WRITE_BUFFER, _size * sizeof(T), data, _usage);
+      _storageSize = _size;
+      GLenum error = GLE_GET_ERROR();
+      if (error == GL_OUT_OF_MEMORY)
+	throw new gle::Exception::OutOfMemory("Cannot allocate buffer storage");
+      else if (error != GL_NO_ERROR)
+	throw new gle::Exception::OpenGLError("Cannot allocate buffer storage");
+    }
+
+    // Storage of persistent buffers is immutable,
+    // so it's reallocated in a new buffer object
+
+    void _reallocate(const T* data, GLsizeiptr copySize)
+    {
+      GLuint oldId = _id;
+      GLsizeiptr oldSize = _storageSize;
+
+      wait();
+      _persistentData = NULL;
+      glGenBuffers(1, &_id);
+      _createStorage(data);
+      if (copySize > oldSize)
+	copySize = oldSize;
+      if (copySize > _size)
+	copySize = _size;
+      if (copySize > 0)
+	{
+	  gle::StateCache::getInstance().bindBuffer(GL_COPY_READ_BUFFER, oldId);
+	  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+			      0, 0, copySize * sizeof(T));
+	}
+      glDeleteBuffers(1, &oldId);
+      gle::StateCache::getInstance().forgetBuffer(oldId);
+      bind();
+    }
+
     Type	_type;
     Usage	_usage;
     GLsizeiptr	_size;
 
     GLuint	_id;
+
+    GLsizeiptr	_storageSize;
+    bool	_persistent;
+    T*		_persistentData;
+    GLsync	_fence;
   };
 
   //! OpenGL of floats
@@ -400,6 +598,9 @@ namespace gle {
   
   //! OpenGL of unsigned int
   typedef Buffer<GLuint> Bufferui;
+
+  //! OpenGL of unsigned short
+  typedef Buffer<GLushort> Bufferus;
 };
 
 #endif /* _GLE_BUFFER_HPP_ */
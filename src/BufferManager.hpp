@@ -165,12 +165,17 @@ namespace gle {
       }
 
       //! Map the chunk memory
+      /*!
+	\param access Specifies the type of access required for this mapping
+	\param flags Combination of Buffer::MapFlags
+       */
 
-      T* map(typename gle::Buffer<T>::MapAccess access=gle::Buffer<T>::ReadWrite)
+      T* map(typename gle::Buffer<T>::MapAccess access=gle::Buffer<T>::ReadWrite,
+	     GLbitfield flags=gle::Buffer<T>::NoFlags)
       {
 	gle::Buffer<T>* buffer = UnderClass::getInstance().getStorageBuffer();
 
-	return (buffer->map(_offset, _size, access));
+	return (buffer->map(_offset, _size, access, flags));
       }
 
       //! Unmap the chunk memory
@@ -230,6 +235,17 @@ namespace gle {
 	_buffer->bind();
     }
 
+    //! Return the OpenGL name of the internal storage buffer
+    /*!
+      The storage buffer is replaced when the BufferManager grows,
+      so this name changes at each new allocation on the gpu.
+     */
+
+    GLuint getBufferId() const
+    {
+      return (_buffer ? _buffer->getId() : 0);
+    }
+
     //! Delete all the chunks of the BufferManager
     
     void drain()
@@ -281,8 +297,8 @@ namespace gle {
 	  return (store(data, size));
 	}
       Chunk* newChunk = store(NULL, size);
-      glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer->getId());
-      glBindBuffer(GL_COPY_READ_BUFFER, _buffer->getId());
+      gle::StateCache::getInstance().bindBuffer(GL_COPY_WRITE_BUFFER, _buffer->getId());
+      gle::StateCache::getInstance().bindBuffer(GL_COPY_READ_BUFFER, _buffer->getId());
       glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
 			  chunk->getOffset() * sizeof(T), newChunk->getOffset() * sizeof(T),
 			  chunk->getSize() * sizeof(T));
@@ -303,8 +319,8 @@ namespace gle {
       if (!chunk)
       	return (NULL);
       Chunk* newChunk = store(NULL, chunk->getSize());
-      glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer->getId());
-      glBindBuffer(GL_COPY_READ_BUFFER, _buffer->getId());
+      gle::StateCache::getInstance().bindBuffer(GL_COPY_WRITE_BUFFER, _buffer->getId());
+      gle::StateCache::getInstance().bindBuffer(GL_COPY_READ_BUFFER, _buffer->getId());
       glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
 			  chunk->getOffset() * sizeof(T), newChunk->getOffset() * sizeof(T),
 			  chunk->getSize() * sizeof(T));
@@ -0,0 +1,61 @@
+//
+// Debug.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 07:57:30 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <iostream>
+#include <Debug.hpp>
+#include <Extensions.hpp>
+#include <StateCache.hpp>
+
+gle::Debug::Level	gle::Debug::_level = static_cast<gle::Debug::Level>(GLE_DEBUG_LEVEL);
+bool			gle::Debug::_outputInstalled = false;
+const char*		gle::Debug::_file = "";
+int			gle::Debug::_line = 0;
+
+void gle::Debug::setLevel(Level level)
+{
+  if (level > GLE_DEBUG_LEVEL)
+    level = static_cast<Level>(GLE_DEBUG_LEVEL);
+  _level = level;
+  if (!gle::Extensions::isSupported("GL_ARB_debug_output")
+      && !gle::Extensions::isSupported("GL_KHR_debug"))
+    return ;
+  if (_level >= Output && !_outputInstalled)
+    {
+      glDebugMessageCallbackARB(&gle::Debug::_debugOutput, NULL);
+      glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE,
+			       0, NULL, GL_TRUE);
+      // Messages are sent during the faulty call
+      gle::StateCache::getInstance().enable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+      _outputInstalled = true;
+    }
+  else if (_level < Output && _outputInstalled)
+    {
+      glDebugMessageCallbackARB(NULL, NULL);
+      gle::StateCache::getInstance().disable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+      _outputInstalled = false;
+    }
+}
+
+void APIENTRY gle::Debug::_debugOutput(GLenum source, GLenum type, GLuint id,
+				       GLenum severity, GLsizei length,
+				       const GLchar* message, GLvoid* userParam)
+{
+  (void)source;
+  (void)length;
+  (void)userParam;
+  const char* severityName = "low";
+  if (severity == GL_DEBUG_SEVERITY_HIGH_ARB)
+    severityName = "high";
+  else if (severity == GL_DEBUG_SEVERITY_MEDIUM_ARB)
+    severityName = "medium";
+  std::cerr << "OpenGL " << (type == GL_DEBUG_TYPE_ERROR_ARB ? "error" : "message")
+	    << " " << id << " (" << severityName << "): " << message
+	    << " [after " << _file << ":" << _line << "]" << std::endl;
+}
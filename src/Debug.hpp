@@ -0,0 +1,132 @@
+//
+// Debug.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 07:57:30 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_DEBUG_HPP_
+# define _GLE_DEBUG_HPP_
+
+# include <gle/opengl.h>
+# include <Exception.hpp>
+
+//! Compile-time debug level of the engine
+/*!
+  0: OpenGL errors are never checked\n
+  1: OpenGL errors are checked and throw exceptions\n
+  2: Same as 1, and the OpenGL debug output can be enabled\n
+  Defaults to 0 when NDEBUG is defined, 1 otherwise.
+ */
+
+# ifndef GLE_DEBUG_LEVEL
+#  ifdef NDEBUG
+#   define GLE_DEBUG_LEVEL 0
+#  else
+#   define GLE_DEBUG_LEVEL 1
+#  endif
+# endif
+
+//! Poll the OpenGL error if checks are enabled, GL_NO_ERROR otherwise
+
+# define GLE_GET_ERROR() gle::Debug::getError(__FILE__, __LINE__)
+
+//! Throw an exception for the pending OpenGL error if checks are enabled
+
+# define GLE_CHECK_OPENGL_ERROR(message)				\
+  do {									\
+    if (gle::Debug::isEnabled())					\
+      gle::Exception::CheckOpenGLError(message, __FILE__, __LINE__);	\
+  } while (0)
+
+namespace gle {
+
+  //! Control of the OpenGL error checks
+  /*!
+    The debug level can be lowered at runtime, but cannot exceed
+    the compile-time GLE_DEBUG_LEVEL.
+    When checks are disabled, the engine never calls glGetError.
+   */
+
+  class Debug {
+  public:
+
+    //! Runtime debug levels
+
+    enum Level {
+      None = 0,
+      /*!< No OpenGL error check */
+      Errors = 1,
+      /*!< OpenGL errors are checked and throw exceptions */
+      Output = 2
+      /*!< Same as Errors, and messages from the OpenGL debug output
+	(ARB_debug_output / KHR_debug) are printed on standard error */
+    };
+
+    //! Set the runtime debug level
+    /*!
+      With the Output level, an OpenGL context created with the debug
+      flag must be active.
+      The level is clamped to GLE_DEBUG_LEVEL.
+     */
+
+    static void setLevel(Level level);
+
+    //! Returns the runtime debug level
+
+    static Level getLevel()
+    {
+      return (_level);
+    }
+
+    //! Returns wether OpenGL errors are checked
+
+    static bool isEnabled()
+    {
+      return (GLE_DEBUG_LEVEL > 0 && _level > None);
+    }
+
+    //! Poll the OpenGL error, remembering where the check happened
+    /*!
+      Use the GLE_GET_ERROR() macro instead.
+     */
+
+    static GLenum getError(const char* file, int line)
+    {
+      if (!isEnabled())
+	return (GL_NO_ERROR);
+      _file = file;
+      _line = line;
+      return (glGetError());
+    }
+
+    //! Returns the file of the last error check
+
+    static const char* getLastCheckFile()
+    {
+      return (_file);
+    }
+
+    //! Returns the line of the last error check
+
+    static int getLastCheckLine()
+    {
+      return (_line);
+    }
+
+  private:
+    static void APIENTRY _debugOutput(GLenum source, GLenum type, GLuint id,
+				      GLenum severity, GLsizei length,
+				      const GLchar* message, GLvoid* userParam);
+
+    static Level	_level;
+    static bool		_outputInstalled;
+    static const char*	_file;
+    static int		_line;
+  };
+}
+
+#endif /* _GLE_DEBUG_HPP_ */
@@ -8,20 +8,38 @@
 // Last update Tue Jun 26 11:20:42 2012 gael jochaud-du-plessix
 //
 
+#include <cmath>
+#include <algorithm>
 #include <DirectionalLight.hpp>
 
 gle::DirectionalLight::DirectionalLight(Vector3<GLfloat> const& direction,
 					Color<GLfloat> const& color)
-  : gle::Light(gle::Light::DIRECTIONAL), _direction(direction)
+  : gle::Light(gle::Light::DIRECTIONAL), _direction(direction),
+    _cascadesDistance(500), _cascadesSplitWeight(0.75), _castersDistance(1000)
 {
   _color[0] = color.r;
   _color[1] = color.g;
   _color[2] = color.b;
+  for (GLuint i = 0; i < NbCascades; ++i)
+    {
+      _cascadesCameras[i] = NULL;
+      _cascadesFrameBuffers[i] = NULL;
+      _cascadesSplits[i] = 0;
+      _cascadesBiases[i] = 0;
+    }
+  for (GLuint i = 0; i < NbCascades * 16; ++i)
+    _cascadesMatrices[i] = 0;
 }
 
 gle::DirectionalLight::~DirectionalLight()
 {
-
+  for (GLuint i = 0; i < NbCascades; ++i)
+    {
+      if (_cascadesCameras[i])
+	delete _cascadesCameras[i];
+      if (_cascadesFrameBuffers[i])
+	delete _cascadesFrameBuffers[i];
+    }
 }
 
 void gle::DirectionalLight::setDirection(Vector3<GLfloat> const& direction)
@@ -45,3 +63,217 @@ GLfloat* gle::DirectionalLight::getColor()
 {
   return (_color);
 }
+
+void gle::DirectionalLight::getUniforms(GLfloat* uniforms)
+{
+  gle::Light::getUniforms(uniforms);
+  uniforms[4] = _direction.x;
+  uniforms[5] = _direction.y;
+  uniforms[6] = _direction.z;
+  for (int i = 0; i < 3; ++i)
+    {
+      uniforms[8 + i] = _color[i];
+      uniforms[12 + i] = _color[i];
+    }
+  if (projectShadow())
+    uniforms[15] = 1;
+}
+
+void gle::DirectionalLight::setCascadesDistance(GLfloat distance)
+{
+  _cascadesDistance = distance;
+}
+
+GLfloat gle::DirectionalLight::getCascadesDistance() const
+{
+  return (_cascadesDistance);
+}
+
+void gle::DirectionalLight::setCascadesSplitWeight(GLfloat weight)
+{
+  _cascadesSplitWeight = std::min(std::max(weight, 0.0f), 1.0f);
+}
+
+void gle::DirectionalLight::setCastersDistance(GLfloat distance)
+{
+  _castersDistance = distance;
+}
+
+void gle::DirectionalLight::updateCascades(const Matrix4<GLfloat>& view,
+					   const Matrix4<GLfloat>& projection)
+{
+  const Matrix4<GLfloat>&	p = projection;
+  bool				perspective = (p[11] != 0);
+  GLfloat			near, far;
+  GLfloat			splits[NbCascades + 1];
+  GLfloat			resolution = _shadowMapSize.width;
+
+  // Retreive the clipping planes from the projection matrix
+  if (perspective)
+    {
+      near = p[14] / (p[10] - 1);
+      far = p[14] / (p[10] + 1);
+    }
+  else
+    {
+      near = (p[14] + 1) / p[10];
+      far = (p[14] - 1) / p[10];
+    }
+  near = std::max(near, 0.0001f);
+  far = std::max(std::min(far, _cascadesDistance), near * 1.001f);
+
+  // Blend of logarithmic and regular splits
+  for (GLuint i = 0; i <= NbCascades; ++i)
+    {
+      GLfloat ratio = (GLfloat)i / NbCascades;
+
+      splits[i] = _cascadesSplitWeight * near * pow(far / near, ratio)
+	+ (1 - _cascadesSplitWeight) * (near + (far - near) * ratio);
+    }
+
+  // Axis of the light view, the same as the cascades cameras
+  Vector3<GLfloat> direction = _direction;
+  direction.normalize();
+  if (direction.x * direction.x + direction.z * direction.z < 0.000001)
+    {
+      direction.x += 0.001;
+      direction.normalize();
+    }
+  Vector3<GLfloat> xAxis = Vector3<GLfloat>(0, 1, 0) ^ direction;
+  xAxis.normalize();
+  Vector3<GLfloat> yAxis = direction ^ xAxis;
+
+  gle::Matrix4f
+    shadowMapBiasMatrix(
+			0.5, 0.0, 0.0, 0.5,
+			0.0, 0.5, 0.0, 0.5,
+			0.0, 0.0, 0.5, 0.5,
+			0.0, 0.0, 0.0, 1.0
+			);
+
+  getShadowMap();
+  for (GLuint cascade = 0; cascade < NbCascades; ++cascade)
+    {
+      Vector3<GLfloat>	corners[8];
+      Vector3<GLfloat>	center(0, 0, 0);
+      GLfloat		radius = 0;
+
+      for (int corner = 0; corner < 8; ++corner)
+	{
+	  GLfloat depth = splits[cascade + (corner & 4 ? 1 : 0)];
+	  GLfloat sx = (corner & 1) ? 1 : -1;
+	  GLfloat sy = (corner & 2) ? 1 : -1;
+	  Vector3<GLfloat> v;
+
+	  if (perspective)
+	    v = Vector3<GLfloat>(depth * (sx + p[8]) / p[0],
+				 depth * (sy + p[9]) / p[5], -depth);
+	  else
+	    v = Vector3<GLfloat>((sx - p[12]) / p[0], (sy - p[13]) / p[5], -depth);
+	  // The view matrix is rigid: its inverse is its transposed rotation
+	  v -= Vector3<GLfloat>(view[12], view[13], view[14]);
+	  corners[corner] = Vector3<GLfloat>(view[0] * v.x + view[1] * v.y + view[2] * v.z,
+					     view[4] * v.x + view[5] * v.y + view[6] * v.z,
+					     view[8] * v.x + view[9] * v.y + view[10] * v.z);
+	  center += corners[corner];
+	}
+      center *= 0.125f;
+      for (int corner = 0; corner < 8; ++corner)
+	{
+	  Vector3<GLfloat> d = corners[corner] - center;
+	  radius = std::max(radius, (GLfloat)sqrt(d * d));
+	}
+      // The size of the cascade does not change with the orientation of the camera
+      radius = ceil(radius * 16) / 16;
+
+      // Move the cascade by whole texels only
+      GLfloat texelSize = 2 * radius / resolution;
+      GLfloat x = floor((center * xAxis) / texelSize) * texelSize;
+      GLfloat y = floor((center * yAxis) / texelSize) * texelSize;
+      GLfloat z = center * direction;
+      center = xAxis * x + yAxis * y + direction * z;
+
+      gle::OrthographicCamera* camera =
+	static_cast<gle::OrthographicCamera*>(getCascadeCamera(cascade));
+      GLfloat depthRange = _castersDistance + 2 * radius;
+
+      camera->setPosition(center + direction * (_castersDistance + radius));
+      camera->setTarget(center);
+      camera->setClippingPlanes(0, depthRange, -radius, radius, -radius, radius);
+
+      gle::Matrix4f matrix = shadowMapBiasMatrix * camera->getProjectionMatrix()
+	* camera->getTransformationMatrix();
+      const GLfloat* matrixf = (const GLfloat*)matrix;
+      for (int i = 0; i < 16; ++i)
+	_cascadesMatrices[cascade * 16 + i] = matrixf[i];
+      _cascadesSplits[cascade] = splits[cascade + 1];
+      _cascadesBiases[cascade] = 2 * texelSize / depthRange;
+    }
+}
+
+gle::Texture*	gle::DirectionalLight::getShadowMap()
+{
+  if (!_projectShadow)
+    return (NULL);
+  if (!_shadowMap)
+    {
+      _shadowMap = new gle::Texture(_shadowMapSize.width, _shadowMapSize.height,
+				    NbCascades, gle::Texture::Texture2DArray,
+				    gle::Texture::Depth);
+      _shadowMap->setUseMipmap(false);
+      _shadowMap->setFilterType(gle::Texture::Nearest);
+      // The cascades use whole layers, they are not in the shadow atlas
+      _shadowMapTile = _shadowMapSize;
+    }
+  return (_shadowMap);
+}
+
+gle::FrameBuffer*	gle::DirectionalLight::getShadowMapFrameBuffer()
+{
+  return (getCascadeFrameBuffer(0));
+}
+
+gle::Camera*	gle::DirectionalLight::getShadowMapCamera()
+{
+  return (getCascadeCamera(0));
+}
+
+gle::FrameBuffer*	gle::DirectionalLight::getCascadeFrameBuffer(GLuint cascade)
+{
+  if (!_projectShadow || cascade >= NbCascades)
+    return (NULL);
+  if (!_cascadesFrameBuffers[cascade])
+    {
+      _cascadesFrameBuffers[cascade] = new gle::FrameBuffer();
+      _cascadesFrameBuffers[cascade]->attach(*getShadowMap(),
+					     gle::FrameBuffer::AttachmentDepth,
+					     cascade);
+    }
+  return (_cascadesFrameBuffers[cascade]);
+}
+
+gle::Camera*	gle::DirectionalLight::getCascadeCamera(GLuint cascade)
+{
+  if (cascade >= NbCascades)
+    return (NULL);
+  if (!_cascadesCameras[cascade])
+    _cascadesCameras[cascade] =
+      new gle::OrthographicCamera(Vector3<GLfloat>(0, 0, 0) + _direction,
+				  Vector3<GLfloat>(0, 0, 0));
+  return (_cascadesCameras[cascade]);
+}
+
+const GLfloat*	gle::DirectionalLight::getCascadesMatrices() const
+{
+  return (_cascadesMatrices);
+}
+
+const GLfloat*	gle::DirectionalLight::getCascadesSplits() const
+{
+  return (_cascadesSplits);
+}
+
+const GLfloat*	gle::DirectionalLight::getCascadesBiases() const
+{
+  return (_cascadesBiases);
+}
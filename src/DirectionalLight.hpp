@@ -15,17 +15,27 @@
 # include <Light.hpp>
 # include <Vector3.hpp>
 # include <Color.hpp>
+# include <Matrix4.hpp>
+# include <OrthographicCamera.hpp>
 
 namespace gle {
 
   //! Directional light class
   /*!
-    This class enables to create a directional light, with a direction, and a color
+    This class enables to create a directional light, with a direction, and a color.
+
+    When it projects shadows, the view frustum of the camera is split in
+    NbCascades depth ranges, each covered by an orthographic shadow map
+    stored in a layer of a single depth texture array (cascaded shadow maps).
   */
   
   class DirectionalLight : public Light {
   public:
 
+    //! Number of shadow map cascades
+
+    static const GLuint NbCascades = 4;
+
     //! Construct a directional light
     /*!
       \param direction Light direction
@@ -60,9 +70,102 @@ namespace gle {
 
     GLfloat* getColor();
 
+    //! Write the parameters of the light in the lights uniform block layout
+    /*!
+      The cascades are not part of the lights uniform block,
+      only the shadow flag is set when the light projects shadows.
+     */
+
+    void getUniforms(GLfloat* uniforms);
+
+    //! Set the distance from the camera covered by the cascades
+    /*!
+      It is limited by the far plane of the camera. Beyond it,
+      the light does not project any shadow.
+     */
+
+    void setCascadesDistance(GLfloat distance);
+
+    //! Get the distance from the camera covered by the cascades
+
+    GLfloat getCascadesDistance() const;
+
+    //! Set the distribution of the cascades splits
+    /*!
+      \param weight 0 for splits at regular intervals, 1 for logarithmic
+      splits, or a blend of both between them
+     */
+
+    void setCascadesSplitWeight(GLfloat weight);
+
+    //! Set the distance towards the light where the shadow casters are searched
+    /*!
+      Meshes between a cascade and the light, up to this distance,
+      project their shadow in the cascade.
+     */
+
+    void setCastersDistance(GLfloat distance);
+
+    //! Fit the cascades to the view frustum of a camera
+    /*!
+      The center of each cascade is snapped to the texels of its shadow map,
+      and its size only depends on its depth range, so the shadows do not
+      shimmer when the camera moves or rotates.
+      \param view View matrix of the camera
+      \param projection Projection matrix of the camera
+     */
+
+    void updateCascades(const Matrix4<GLfloat>& view,
+			const Matrix4<GLfloat>& projection);
+
+    //! Return the texture array containing the depth of the cascades
+
+    gle::Texture*	getShadowMap();
+
+    //! Return the framebuffer of the first cascade
+
+    gle::FrameBuffer*	getShadowMapFrameBuffer();
+
+    //! Return the camera of the first cascade
+
+    gle::Camera*	getShadowMapCamera();
+
+    //! Return the framebuffer rendering in the layer of a cascade
+
+    gle::FrameBuffer*	getCascadeFrameBuffer(GLuint cascade);
+
+    //! Return the orthographic camera of a cascade
+
+    gle::Camera*	getCascadeCamera(GLuint cascade);
+
+    //! Return the shadow map matrices of the cascades
+    /*!
+      NbCascades matrices, transforming world coordinates
+      to texture coordinates and depth in the shadow map
+     */
+
+    const GLfloat*	getCascadesMatrices() const;
+
+    //! Return the view depth where each cascade ends
+
+    const GLfloat*	getCascadesSplits() const;
+
+    //! Return the depth bias of each cascade, about two texels
+
+    const GLfloat*	getCascadesBiases() const;
+
   private:
     Vector3<GLfloat> _direction;
     GLfloat _color[3];
+
+    GLfloat		_cascadesDistance;
+    GLfloat		_cascadesSplitWeight;
+    GLfloat		_castersDistance;
+    gle::OrthographicCamera*	_cascadesCameras[NbCascades];
+    gle::FrameBuffer*		_cascadesFrameBuffers[NbCascades];
+    GLfloat		_cascadesMatrices[NbCascades * 16];
+    GLfloat		_cascadesSplits[NbCascades];
+    GLfloat		_cascadesBiases[NbCascades];
   };
 }
 
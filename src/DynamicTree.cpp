@@ -0,0 +1,615 @@
+//
+// DynamicTree.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 09:31:04 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <DynamicTree.hpp>
+#include <BoundsArray.hpp>
+
+// Number of last moves added to a fat box in the direction of the move
+#define GLE_DYNAMIC_TREE_PREDICTION 2
+
+// Subtrees of this height or less are culled by one task
+#define GLE_DYNAMIC_TREE_CULL_TASK_HEIGHT 8
+
+namespace {
+  // Half of the surface area of a box, the cost of testing it
+  GLfloat surfaceArea(const gle::Vector3<GLfloat>& min,
+		      const gle::Vector3<GLfloat>& max)
+  {
+    gle::Vector3<GLfloat> size = max - min;
+
+    return (size.x * size.y + size.y * size.z + size.z * size.x);
+  }
+
+  // Half of the surface area of the union of two boxes
+  GLfloat surfaceArea(const gle::DynamicTree::Node& node,
+		      const gle::DynamicTree::Node& other)
+  {
+    return (surfaceArea(gle::Vector3<GLfloat>(std::min(node.min.x, other.min.x),
+					      std::min(node.min.y, other.min.y),
+					      std::min(node.min.z, other.min.z)),
+			gle::Vector3<GLfloat>(std::max(node.max.x, other.max.x),
+					      std::max(node.max.y, other.max.y),
+					      std::max(node.max.z, other.max.z))));
+  }
+
+  // Set the box of a node to the union of two boxes, with the largest
+  // size and draw distance of its children
+  void mergeBounds(gle::DynamicTree::Node& node,
+		   const gle::DynamicTree::Node& first,
+		   const gle::DynamicTree::Node& second)
+  {
+    node.size = std::max(first.size, second.size);
+    node.drawDistance = std::max(first.drawDistance, second.drawDistance);
+    node.min = gle::Vector3<GLfloat>(std::min(first.min.x, second.min.x),
+				     std::min(first.min.y, second.min.y),
+				     std::min(first.min.z, second.min.z));
+    node.max = gle::Vector3<GLfloat>(std::max(first.max.x, second.max.x),
+				     std::max(first.max.y, second.max.y),
+				     std::max(first.max.z, second.max.z));
+  }
+
+  bool containsBounds(const gle::DynamicTree::Node& node,
+		      const gle::Vector3<GLfloat>& min,
+		      const gle::Vector3<GLfloat>& max)
+  {
+    return (min.x >= node.min.x && min.y >= node.min.y && min.z >= node.min.z
+	    && max.x <= node.max.x && max.y <= node.max.y && max.z <= node.max.z);
+  }
+}
+
+gle::DynamicTree::DynamicTree() :
+  _margin(0.1), _root(NoIndex), _stamp(0),
+  _pool(1),
+  _frustums(NULL), _nbViews(0), _detail(NULL), _nbCullTasks(0)
+{
+}
+
+gle::DynamicTree::~DynamicTree()
+{
+}
+
+void gle::DynamicTree::setMargin(GLfloat margin)
+{
+  _margin = std::max(margin, 0.0f);
+}
+
+GLfloat gle::DynamicTree::getMargin() const
+{
+  return (_margin);
+}
+
+void gle::DynamicTree::setNumberOfThreads(unsigned int nbThreads)
+{
+  _pool.setNumberOfThreads(std::min(nbThreads,
+				    (unsigned int)Octree::maximumNumberOfThreads));
+}
+
+void gle::DynamicTree::clear()
+{
+  _root = NoIndex;
+  _nodes.clear();
+  _freeNodes.clear();
+  _elementsLeaves.clear();
+  _stamps.clear();
+}
+
+void gle::DynamicTree::updateTree(std::list<Element*> &elements)
+{
+  std::vector<Element*> removed;
+
+  if (++_stamp == 0)
+    {
+      std::fill(_stamps.begin(), _stamps.end(), 0);
+      _stamp = 1;
+    }
+  for (Element* element : elements)
+    {
+      bool moved;
+
+      _stamps[_update(element, moved)] = _stamp;
+    }
+  for (GLuint node = 0; node < _nodes.size(); ++node)
+    if (_nodes[node].element && _stamps[node] != _stamp)
+      removed.push_back(_nodes[node].element);
+  for (Element* element : removed)
+    remove(element);
+}
+
+bool gle::DynamicTree::insert(Element* element)
+{
+  if (contains(element))
+    return (false);
+
+  GLuint leaf = _allocateNode();
+
+  _nodes[leaf].element = element;
+  _setFatBounds(leaf, false);
+  _insertLeaf(leaf);
+  _elementsLeaves[element] = leaf;
+  return (true);
+}
+
+bool gle::DynamicTree::remove(Element* element)
+{
+  auto it = _elementsLeaves.find(element);
+
+  if (it == _elementsLeaves.end())
+    return (false);
+  _removeLeaf(it->second);
+  _releaseNode(it->second);
+  _elementsLeaves.erase(it);
+  return (true);
+}
+
+bool gle::DynamicTree::update(Element* element)
+{
+  bool moved;
+
+  _update(element, moved);
+  return (moved);
+}
+
+bool gle::DynamicTree::contains(Element* element) const
+{
+  return (_elementsLeaves.find(element) != _elementsLeaves.end());
+}
+
+GLuint gle::DynamicTree::getNbElements() const
+{
+  return (_elementsLeaves.size());
+}
+
+GLuint gle::DynamicTree::getRoot() const
+{
+  return (_root);
+}
+
+const std::vector<gle::DynamicTree::Node>& gle::DynamicTree::getNodes() const
+{
+  return (_nodes);
+}
+
+const std::vector<gle::DynamicTree::Element*>&
+gle::DynamicTree::getVisibleElements(const gle::Matrix4<GLfloat>& projection,
+				     const gle::Matrix4<GLfloat>& modelview)
+{
+  GLfloat frustum[6][4];
+
+  Octree::getFrustumPlanes(projection, modelview, frustum);
+  return (getVisibleElements(frustum));
+}
+
+const std::vector<gle::DynamicTree::Element*>&
+gle::DynamicTree::getVisibleElements(const GLfloat frustum[6][4], const GLfloat* detail)
+{
+  // The tasks of the large trees share the traversal of several views
+  if (_isSplit())
+    {
+      GLfloat frustums[1][6][4];
+
+      std::copy(&frustum[0][0], &frustum[0][0] + 6 * 4, &frustums[0][0][0]);
+      return (getVisibleElements(frustums, 1, detail));
+    }
+  _visibleElements.clear();
+  _detail = detail;
+  if (_root == NoIndex)
+    return (_visibleElements);
+  _stack.clear();
+  _stack.push_back(std::make_pair(_root, (GLuint)BoundsArray::AllPlanes));
+  while (!_stack.empty())
+    {
+      const Node&	node = _nodes[_stack.back().first];
+      GLuint		planeMask = _stack.back().second;
+
+      _stack.pop_back();
+      // The planes containing a node are not tested on its children
+      if (!BoundsArray::testBox(frustum, planeMask, node.min, node.max)
+	  || (detail && _cullDetail(node)))
+	continue;
+      if (node.element)
+	{
+	  if (planeMask == 0 || node.element->isInFrustum(frustum))
+	    _visibleElements.push_back(node.element);
+	}
+      else
+	{
+	  _stack.push_back(std::make_pair(node.children[1], planeMask));
+	  _stack.push_back(std::make_pair(node.children[0], planeMask));
+	}
+    }
+  _visibleMasks.assign(_visibleElements.size(), 1);
+  return (_visibleElements);
+}
+
+const std::vector<gle::DynamicTree::Element*>&
+gle::DynamicTree::getVisibleElements(const GLfloat frustums[][6][4], GLuint nbViews,
+				     const GLfloat* detail)
+{
+  GLuint planeMasks[Octree::maximumNumberOfViews];
+
+  _visibleElements.clear();
+  _visibleMasks.clear();
+  _frustums = frustums;
+  _detail = detail;
+  _nbViews = std::min(nbViews, (GLuint)Octree::maximumNumberOfViews);
+  std::fill(planeMasks, planeMasks + _nbViews, (GLuint)BoundsArray::AllPlanes);
+  _nbCullTasks = 0;
+  if (_root == NoIndex || _nbViews == 0)
+    return (_visibleElements);
+  if (!_isSplit())
+    {
+      _cullNode(_root, _nbViews < 32 ? (1u << _nbViews) - 1 : ~0u, planeMasks,
+		_visibleElements, _visibleMasks);
+      return (_visibleElements);
+    }
+
+  // Each task culls its subtree in its own arrays, which are then copied
+  // in the order of the serial traversal
+  _splitCull(_root, _nbViews < 32 ? (1u << _nbViews) - 1 : ~0u, planeMasks);
+  _pool.run([this](GLuint index) {
+      CullTask& task = _cullTasks[index];
+
+      task.elements.clear();
+      task.masks.clear();
+      _cullNode(task.node, task.viewMask, task.planeMasks, task.elements, task.masks);
+    }, _nbCullTasks);
+
+  GLuint size = 0;
+
+  for (GLuint task = 0; task < _nbCullTasks; ++task)
+    {
+      _cullTasks[task].offset = size;
+      size += _cullTasks[task].elements.size();
+    }
+  _visibleElements.resize(size);
+  _visibleMasks.resize(size);
+  _pool.run([this](GLuint index) {
+      const CullTask& task = _cullTasks[index];
+
+      std::copy(task.elements.begin(), task.elements.end(),
+		_visibleElements.begin() + task.offset);
+      std::copy(task.masks.begin(), task.masks.end(),
+		_visibleMasks.begin() + task.offset);
+    }, _nbCullTasks);
+  return (_visibleElements);
+}
+
+const std::vector<GLuint>& gle::DynamicTree::getVisibleMasks() const
+{
+  return (_visibleMasks);
+}
+
+bool gle::DynamicTree::_isSplit() const
+{
+  return (_pool.getNumberOfThreads() > 1 && _root != NoIndex
+	  && _nodes[_root].height > GLE_DYNAMIC_TREE_CULL_TASK_HEIGHT);
+}
+
+void gle::DynamicTree::_splitCull(GLuint index, GLuint viewMask,
+				  const GLuint* parentMasks)
+{
+  const Node&	node = _nodes[index];
+  GLuint	planeMasks[Octree::maximumNumberOfViews];
+
+  if (node.height <= GLE_DYNAMIC_TREE_CULL_TASK_HEIGHT)
+    {
+      // The tasks are kept with their arrays between two queries
+      if (_nbCullTasks == _cullTasks.size())
+	_cullTasks.resize(_nbCullTasks + 1);
+
+      CullTask& task = _cullTasks[_nbCullTasks++];
+
+      task.node = index;
+      task.viewMask = viewMask;
+      std::copy(parentMasks, parentMasks + _nbViews, task.planeMasks);
+      return;
+    }
+  for (GLuint view = 0; view < _nbViews; ++view)
+    if (viewMask & (1u << view))
+      {
+	planeMasks[view] = parentMasks[view];
+	if (!BoundsArray::testBox(_frustums[view], planeMasks[view], node.min, node.max)
+	    || (view == 0 && _detail && _cullDetail(node)))
+	  viewMask &= ~(1u << view);
+      }
+  if (viewMask == 0)
+    return;
+  _splitCull(node.children[0], viewMask, planeMasks);
+  _splitCull(node.children[1], viewMask, planeMasks);
+}
+
+void gle::DynamicTree::_cullNode(GLuint index, GLuint viewMask,
+				 const GLuint* parentMasks,
+				 std::vector<Element*>& elements,
+				 std::vector<GLuint>& masks) const
+{
+  const Node&	node = _nodes[index];
+  GLuint	planeMasks[Octree::maximumNumberOfViews];
+
+  for (GLuint view = 0; view < _nbViews; ++view)
+    if (viewMask & (1u << view))
+      {
+	planeMasks[view] = parentMasks[view];
+	if (!BoundsArray::testBox(_frustums[view], planeMasks[view], node.min, node.max)
+	    || (view == 0 && _detail && _cullDetail(node))
+	    || (node.element && planeMasks[view] != 0
+		&& !node.element->isInFrustum(_frustums[view])))
+	  viewMask &= ~(1u << view);
+      }
+  if (viewMask == 0)
+    return;
+  if (node.element)
+    {
+      elements.push_back(node.element);
+      masks.push_back(viewMask);
+      return;
+    }
+  _cullNode(node.children[0], viewMask, planeMasks, elements, masks);
+  _cullNode(node.children[1], viewMask, planeMasks, elements, masks);
+}
+
+bool gle::DynamicTree::_cullDetail(const Node& node) const
+{
+  // Distance from the point of view to the nearest point of the box
+  Vector3<GLfloat> outside(std::max(std::max(node.min.x - _detail[0],
+					     _detail[0] - node.max.x), 0.0f),
+			   std::max(std::max(node.min.y - _detail[1],
+					     _detail[1] - node.max.y), 0.0f),
+			   std::max(std::max(node.min.z - _detail[2],
+					     _detail[2] - node.max.z), 0.0f));
+  GLfloat distance = sqrt(outside * outside);
+
+  return (!(distance <= node.drawDistance) || !(node.size >= distance * _detail[3]));
+}
+
+GLuint gle::DynamicTree::_update(Element* element, bool& moved)
+{
+  auto it = _elementsLeaves.find(element);
+
+  if (it == _elementsLeaves.end())
+    {
+      moved = true;
+      insert(element);
+      return (_elementsLeaves[element]);
+    }
+
+  GLuint leaf = it->second;
+
+  moved = !containsBounds(_nodes[leaf], element->getMinPoint(),
+			  element->getMaxPoint());
+  if (moved)
+    {
+      _removeLeaf(leaf);
+      _setFatBounds(leaf, true);
+      _insertLeaf(leaf);
+    }
+  // The ancestors keep the largest size and draw distance of their leaves
+  else if (_setDetail(leaf) && _nodes[leaf].parent != NoIndex)
+    _refit(_nodes[leaf].parent);
+  return (leaf);
+}
+
+GLuint gle::DynamicTree::_allocateNode()
+{
+  GLuint index;
+
+  if (!_freeNodes.empty())
+    {
+      index = _freeNodes.back();
+      _freeNodes.pop_back();
+    }
+  else
+    {
+      index = _nodes.size();
+      _nodes.resize(index + 1);
+      _stamps.resize(index + 1, 0);
+    }
+
+  Node& node = _nodes[index];
+
+  node.element = NULL;
+  node.parent = NoIndex;
+  node.children[0] = NoIndex;
+  node.children[1] = NoIndex;
+  node.height = 0;
+  node.size = 0;
+  node.drawDistance = 0;
+  return (index);
+}
+
+void gle::DynamicTree::_releaseNode(GLuint node)
+{
+  _nodes[node].element = NULL;
+  _nodes[node].parent = NoIndex;
+  _nodes[node].children[0] = NoIndex;
+  _nodes[node].children[1] = NoIndex;
+  _freeNodes.push_back(node);
+}
+
+void gle::DynamicTree::_setFatBounds(GLuint leaf, bool predict)
+{
+  Node&			node = _nodes[leaf];
+  Vector3<GLfloat>	min = node.element->getMinPoint();
+  Vector3<GLfloat>	max = node.element->getMaxPoint();
+  Vector3<GLfloat>	margin = max - min;
+  Vector3<GLfloat>	move(0, 0, 0);
+
+  margin *= _margin;
+  // The box is extended by the last move, which likely happens again
+  if (predict)
+    {
+      move = (min + max) - (node.min + node.max);
+      move *= 0.5 * GLE_DYNAMIC_TREE_PREDICTION;
+    }
+  node.min = Vector3<GLfloat>(min.x - margin.x + std::min(move.x, 0.0f),
+			      min.y - margin.y + std::min(move.y, 0.0f),
+			      min.z - margin.z + std::min(move.z, 0.0f));
+  node.max = Vector3<GLfloat>(max.x + margin.x + std::max(move.x, 0.0f),
+			      max.y + margin.y + std::max(move.y, 0.0f),
+			      max.z + margin.z + std::max(move.z, 0.0f));
+  _setDetail(leaf);
+}
+
+bool gle::DynamicTree::_setDetail(GLuint leaf)
+{
+  Node&			node = _nodes[leaf];
+  Vector3<GLfloat>	diagonal = node.element->getMaxPoint() - node.element->getMinPoint();
+  GLfloat		size = node.element->getRadius();
+  GLfloat		drawDistance = node.element->getDrawDistance();
+
+  if (size < 0)
+    size = sqrt(diagonal * diagonal) / 2;
+  if (size == node.size && drawDistance == node.drawDistance)
+    return (false);
+  node.size = size;
+  node.drawDistance = drawDistance;
+  return (true);
+}
+
+void gle::DynamicTree::_insertLeaf(GLuint leaf)
+{
+  if (_root == NoIndex)
+    {
+      _root = leaf;
+      _nodes[leaf].parent = NoIndex;
+      return ;
+    }
+
+  // Go down to the sibling giving the smallest area to the new parent and
+  // its ancestors, while going further down costs less
+  GLuint index = _root;
+  while (!_nodes[index].element)
+    {
+      const Node&	node = _nodes[index];
+      GLfloat		area = surfaceArea(node.min, node.max);
+      GLfloat		mergedArea = surfaceArea(node, _nodes[leaf]);
+      GLfloat		cost = 2 * mergedArea;
+      GLfloat		inheritedCost = 2 * (mergedArea - area);
+      GLfloat		childrenCosts[2];
+
+      for (GLuint i = 0; i < 2; ++i)
+	{
+	  const Node& child = _nodes[node.children[i]];
+
+	  childrenCosts[i] = surfaceArea(child, _nodes[leaf]) + inheritedCost;
+	  if (!child.element)
+	    childrenCosts[i] -= surfaceArea(child.min, child.max);
+	}
+      if (cost < childrenCosts[0] && cost < childrenCosts[1])
+	break;
+      index = node.children[childrenCosts[0] < childrenCosts[1] ? 0 : 1];
+    }
+
+  GLuint sibling = index;
+  GLuint previousParent = _nodes[sibling].parent;
+  GLuint parent = _allocateNode();
+
+  _nodes[parent].parent = previousParent;
+  _nodes[parent].children[0] = sibling;
+  _nodes[parent].children[1] = leaf;
+  if (previousParent == NoIndex)
+    _root = parent;
+  else if (_nodes[previousParent].children[0] == sibling)
+    _nodes[previousParent].children[0] = parent;
+  else
+    _nodes[previousParent].children[1] = parent;
+  _nodes[sibling].parent = parent;
+  _nodes[leaf].parent = parent;
+  _refit(parent);
+}
+
+void gle::DynamicTree::_removeLeaf(GLuint leaf)
+{
+  if (leaf == _root)
+    {
+      _root = NoIndex;
+      return ;
+    }
+
+  GLuint parent = _nodes[leaf].parent;
+  GLuint grandParent = _nodes[parent].parent;
+  GLuint sibling = _nodes[parent].children[_nodes[parent].children[0] == leaf ? 1 : 0];
+
+  // The sibling takes the place of the parent
+  _nodes[sibling].parent = grandParent;
+  if (grandParent == NoIndex)
+    _root = sibling;
+  else if (_nodes[grandParent].children[0] == parent)
+    _nodes[grandParent].children[0] = sibling;
+  else
+    _nodes[grandParent].children[1] = sibling;
+  _releaseNode(parent);
+  _nodes[leaf].parent = NoIndex;
+  if (grandParent != NoIndex)
+    _refit(grandParent);
+}
+
+void gle::DynamicTree::_refit(GLuint node)
+{
+  for (; node != NoIndex; node = _nodes[node].parent)
+    {
+      node = _balance(node);
+
+      Node&		current = _nodes[node];
+      const Node&	first = _nodes[current.children[0]];
+      const Node&	second = _nodes[current.children[1]];
+
+      current.height = 1 + std::max(first.height, second.height);
+      mergeBounds(current, first, second);
+    }
+}
+
+GLuint gle::DynamicTree::_balance(GLuint index)
+{
+  Node& node = _nodes[index];
+
+  if (node.element || node.height < 2)
+    return (index);
+
+  // The highest child is rotated up, and gives its lowest child to node
+  GLuint side = _nodes[node.children[1]].height > _nodes[node.children[0]].height + 1
+    ? 1 : 0;
+  GLuint other = 1 - side;
+  GLuint upIndex = node.children[side];
+  Node&	 up = _nodes[upIndex];
+
+  if (up.height <= _nodes[node.children[other]].height + 1)
+    return (index);
+
+  GLuint highIndex = up.children[0];
+  GLuint lowIndex = up.children[1];
+
+  if (_nodes[highIndex].height < _nodes[lowIndex].height)
+    std::swap(highIndex, lowIndex);
+
+  up.parent = node.parent;
+  if (up.parent == NoIndex)
+    _root = upIndex;
+  else if (_nodes[up.parent].children[0] == index)
+    _nodes[up.parent].children[0] = upIndex;
+  else
+    _nodes[up.parent].children[1] = upIndex;
+  up.children[0] = index;
+  up.children[1] = highIndex;
+  node.parent = upIndex;
+  node.children[side] = lowIndex;
+  _nodes[highIndex].parent = upIndex;
+  _nodes[lowIndex].parent = index;
+
+  node.height = 1 + std::max(_nodes[node.children[0]].height,
+			     _nodes[node.children[1]].height);
+  mergeBounds(node, _nodes[node.children[0]], _nodes[node.children[1]]);
+  up.height = 1 + std::max(node.height, _nodes[highIndex].height);
+  mergeBounds(up, node, _nodes[highIndex]);
+  return (upIndex);
+}
@@ -0,0 +1,251 @@
+//
+// DynamicTree.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 09:31:04 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_DYNAMIC_TREE_HPP_
+# define _GLE_DYNAMIC_TREE_HPP_
+
+# include <vector>
+# include <list>
+# include <unordered_map>
+# include <gle/opengl.h>
+# include <Vector3.hpp>
+# include <Matrix4.hpp>
+# include <Octree.hpp>
+# include <WorkerPool.hpp>
+
+namespace gle {
+
+  //! Bounding volume tree of moving elements
+  /*!
+    A binary tree of axis aligned boxes, in the style of the dynamic
+    bounding volume tree of Bullet (btDbvt). Each leaf holds an element
+    with a fat box: its bounds grown by getMargin() times its size, and
+    extended in the direction it last moved. update() does nothing while
+    the element stays in its fat box. Otherwise its leaf is removed and
+    inserted again, next to the sibling which least increases the area of
+    the tree.
+
+    The ancestors of an inserted or removed leaf are refitted to their
+    children on the way up, and rotated when one of their children is
+    much higher than the other, so the tree stays balanced whatever the
+    order of the moves.
+
+    The tree is queried with the same frustum planes as Octree.
+   */
+
+  class DynamicTree {
+  public:
+
+    //! Elements of the tree, culled like the elements of Octree
+    typedef Octree::Element Element;
+
+    //! Index of a node that does not exist
+    static const GLuint NoIndex = (GLuint)-1;
+
+    //! Node of the tree
+    struct Node {
+      //! Lowest corner of the box of the node
+      /*!
+	The fat box of the element of a leaf, or the union of the boxes
+	of the children
+       */
+      Vector3<GLfloat>	min;
+
+      //! Highest corner of the box of the node
+      Vector3<GLfloat>	max;
+
+      //! Element of a leaf, or NULL
+      Element*		element;
+
+      //! Index of the parent node, or NoIndex for the root
+      GLuint		parent;
+
+      //! Indexes of the two children, or NoIndex for a leaf
+      GLuint		children[2];
+
+      //! Height of the node, 0 for a leaf
+      GLuint		height;
+
+      //! Largest size of the elements of the node
+      /*!
+	The radius of the sphere of an element, or half the diagonal of
+	its box
+       */
+      GLfloat		size;
+
+      //! Largest draw distance of the elements of the node
+      GLfloat		drawDistance;
+    };
+
+    //! Create an empty tree
+    DynamicTree();
+
+    //! Destroy the tree
+    ~DynamicTree();
+
+    //! Set how much the box of an element is grown in its leaf
+    /*!
+      \param margin Part of the size of the element added on each side
+      of its box, 0.1 by default
+     */
+    void setMargin(GLfloat margin);
+
+    //! Returns how much the box of an element is grown in its leaf
+    GLfloat getMargin() const;
+
+    //! Set the number of threads querying the tree
+    /*!
+      The large trees are split in subtrees, each culled by a task in its
+      own arrays. The results are copied in the order of a single thread
+      traversal, so they do not depend on the number of threads.
+      The tree uses a single thread by default.
+     */
+    void setNumberOfThreads(unsigned int nbThreads);
+
+    //! Remove all the elements
+    void clear();
+
+    //! Update the tree to contain a list of elements
+    /*!
+      The elements missing from the tree are inserted, the elements
+      missing from the list are removed, and the others are updated.
+      \param elements Elements of the tree
+     */
+    void updateTree(std::list<Element*> &elements);
+
+    //! Add an element to the tree
+    /*!
+      \return false if the element is already in the tree
+     */
+    bool insert(Element* element);
+
+    //! Remove an element from the tree
+    /*!
+      \return false if the element is not in the tree
+     */
+    bool remove(Element* element);
+
+    //! Update the bounds of an element of the tree
+    /*!
+      The element is inserted if it is not in the tree.
+      \return true if the leaf of the element was moved
+     */
+    bool update(Element* element);
+
+    //! Returns whether an element is in the tree
+    bool contains(Element* element) const;
+
+    //! Returns the number of elements of the tree
+    GLuint getNbElements() const;
+
+    //! Returns the index of the root node, or NoIndex
+    GLuint getRoot() const;
+
+    //! Returns the nodes of the tree
+    /*!
+      The nodes released by removals are not linked to the root.
+     */
+    const std::vector<Node>& getNodes() const;
+
+    //! Return all the elements in given projection and modelview matrix
+    /*!
+      \param projection Projection matrix of frustum
+      \param modelview Modelview matrix of frustum
+    */
+    const std::vector<Element*>& getVisibleElements(const gle::Matrix4<GLfloat>& projection,
+						    const gle::Matrix4<GLfloat>& modelview);
+
+    //! Return all the elements inside six frustum planes
+    /*!
+      The fat boxes of the nodes are tested first, then the elements
+      with Element::isInFrustum() in the nodes crossing a plane.
+
+      The detail culls the nodes whose elements are all too small or too
+      far from the point of view, as BoundsArray does, their distance
+      being the distance to the fat box of the node.
+      \param frustum Six planes of frustum, see Octree::getFrustumPlanes()
+      \param detail Point of view x, y, z and size ratio, or NULL
+    */
+    const std::vector<Element*>& getVisibleElements(const GLfloat frustum[6][4],
+						    const GLfloat* detail = NULL);
+
+    //! Return all the elements inside one of several frustums
+    /*!
+      The tree is traversed once, each node being tested against the
+      frustums containing part of its parent. getVisibleMasks() returns
+      the frustums containing each element.
+      \param frustums Six planes of each frustum
+      \param nbViews Number of frustums, at most
+      Octree::maximumNumberOfViews
+      \param detail Point of view and size ratio culling the small and
+      distant elements of the first frustum only, or NULL
+    */
+    const std::vector<Element*>& getVisibleElements(const GLfloat frustums[][6][4],
+						    GLuint nbViews,
+						    const GLfloat* detail = NULL);
+
+    //! Returns the frustums containing each element of the last query
+    /*!
+      The bit i of a mask is set when the element is inside the frustum
+      i, in the order of the elements returned by getVisibleElements().
+     */
+    const std::vector<GLuint>& getVisibleMasks() const;
+
+  private:
+    GLuint	_allocateNode();
+    void	_releaseNode(GLuint node);
+    void	_setFatBounds(GLuint leaf, bool predict);
+    bool	_setDetail(GLuint leaf);
+    void	_insertLeaf(GLuint leaf);
+    void	_removeLeaf(GLuint leaf);
+    void	_refit(GLuint node);
+    GLuint	_balance(GLuint node);
+    GLuint	_update(Element* element, bool& moved);
+    bool	_isSplit() const;
+    void	_splitCull(GLuint index, GLuint viewMask, const GLuint* parentMasks);
+    void	_cullNode(GLuint index, GLuint viewMask, const GLuint* parentMasks,
+			  std::vector<Element*>& elements,
+			  std::vector<GLuint>& masks) const;
+    bool	_cullDetail(const Node& node) const;
+
+    GLfloat				_margin;
+    GLuint				_root;
+    std::vector<Node>			_nodes;
+    std::vector<GLuint>			_freeNodes;
+    std::unordered_map<Element*, GLuint>	_elementsLeaves;
+
+    // Stamp of the last updateTree() listing the element of each leaf
+    std::vector<GLuint>			_stamps;
+    GLuint				_stamp;
+
+    WorkerPool				_pool;
+    std::vector<std::pair<GLuint, GLuint> >	_stack;
+    const GLfloat			(*_frustums)[6][4];
+    GLuint				_nbViews;
+    const GLfloat*			_detail;
+    std::vector<Element*>		_visibleElements;
+    std::vector<GLuint>			_visibleMasks;
+
+    // Subtree culled by a worker, with its visible elements
+    struct CullTask {
+      GLuint			node;
+      GLuint			viewMask;
+      GLuint			planeMasks[Octree::maximumNumberOfViews];
+      GLuint			offset;
+      std::vector<Element*>	elements;
+      std::vector<GLuint>	masks;
+    };
+
+    std::vector<CullTask>		_cullTasks;
+    GLuint				_nbCullTasks;
+  };
+}
+
+#endif /* _GLE_DYNAMIC_TREE_HPP_ */
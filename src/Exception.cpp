@@ -8,16 +8,25 @@
 // Last update Thu May 31 18:05:31 2012 gael jochaud-du-plessix
 //
 
+#include <sstream>
 #include "Exception.hpp"
 #include <gle/opengl.h>
 
-void gle::Exception::CheckOpenGLError(const std::string& message)
+void gle::Exception::CheckOpenGLError(const std::string& checkMessage,
+				      const char* file, int line)
 {
   GLuint    error = glGetError();
 
   if (error == GL_NO_ERROR)
     return ;
-  else if (error == GL_INVALID_ENUM)
+  std::string message = checkMessage;
+  if (file)
+    {
+      std::ostringstream location;
+      location << (message.empty() ? "" : " ") << "(" << file << ":" << line << ")";
+      message += location.str();
+    }
+  if (error == GL_INVALID_ENUM)
     {
       if (!message.empty())
 	throw new InvalidEnum(message);
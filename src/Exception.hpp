@@ -139,8 +139,14 @@ namespace gle {
     };
 
     //! Check for OpenGL error and throw an exception if necessary
-
-    void CheckOpenGLError(const std::string& message="");
+    /*!
+      When file is set, the location of the check is appended to the message.
+      Use the GLE_CHECK_OPENGL_ERROR macro of Debug.hpp, which skips the
+      check when the debug level disables it.
+     */
+
+    void CheckOpenGLError(const std::string& message="",
+			  const char* file=NULL, int line=0);
   };
   
 };
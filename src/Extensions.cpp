@@ -0,0 +1,67 @@
+//
+// Extensions.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 07:48:21 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <Extensions.hpp>
+
+bool			gle::Extensions::_retreived = false;
+GLint			gle::Extensions::_majorVersion = 0;
+GLint			gle::Extensions::_minorVersion = 0;
+GLint			gle::Extensions::_maxUniformBlockSize = 0;
+std::set<std::string>	gle::Extensions::_extensions;
+
+void gle::Extensions::_retreive()
+{
+  GLint nbExtensions = 0;
+
+  glGetIntegerv(GL_MAJOR_VERSION, &_majorVersion);
+  glGetIntegerv(GL_MINOR_VERSION, &_minorVersion);
+  glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &_maxUniformBlockSize);
+  glGetIntegerv(GL_NUM_EXTENSIONS, &nbExtensions);
+  for (GLint i = 0; i < nbExtensions; ++i)
+    {
+      const GLubyte* name = glGetStringi(GL_EXTENSIONS, i);
+      if (name)
+	_extensions.insert((const char*)name);
+    }
+  _retreived = true;
+}
+
+bool gle::Extensions::isSupported(std::string const & name)
+{
+  if (!_retreived)
+    _retreive();
+  return (_extensions.find(name) != _extensions.end());
+}
+
+bool gle::Extensions::hasVersion(GLint major, GLint minor)
+{
+  if (!_retreived)
+    _retreive();
+  return (_majorVersion > major
+	  || (_majorVersion == major && _minorVersion >= minor));
+}
+
+bool gle::Extensions::hasBufferStorage()
+{
+  return (hasVersion(4, 4) || isSupported("GL_ARB_buffer_storage"));
+}
+
+bool gle::Extensions::hasParallelShaderCompile()
+{
+  return (isSupported("GL_KHR_parallel_shader_compile")
+	  || isSupported("GL_ARB_parallel_shader_compile"));
+}
+
+GLint gle::Extensions::getMaxUniformBlockSize()
+{
+  if (!_retreived)
+    _retreive();
+  return (_maxUniformBlockSize);
+}
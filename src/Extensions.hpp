@@ -0,0 +1,72 @@
+//
+// Extensions.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 07:48:21 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_EXTENSIONS_HPP_
+# define _GLE_EXTENSIONS_HPP_
+
+# include <set>
+# include <string>
+# include <gle/opengl.h>
+
+namespace gle {
+
+  //! Query the OpenGL features available in the current context
+  /*!
+    The list of extensions and the context version are retreived the first
+    time one of the functions is called, so an OpenGL context must be active.
+   */
+
+  class Extensions {
+  public:
+
+    //! Return wether an extension is supported by the current context
+    /*!
+      \param name Name of the extension (ex: "GL_ARB_buffer_storage")
+     */
+
+    static bool isSupported(std::string const & name);
+
+    //! Return wether the context version is at least major.minor
+
+    static bool hasVersion(GLint major, GLint minor);
+
+    //! Return wether persistent mapping of buffers is available
+    /*!
+      Needs OpenGL 4.4 or GL_ARB_buffer_storage
+     */
+
+    static bool hasBufferStorage();
+
+    //! Return wether the completion of shaders and programs can be polled
+    /*!
+      Needs GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile
+     */
+
+    static bool hasParallelShaderCompile();
+
+    //! Return the maximum size of a uniform block, in bytes
+    /*!
+      GL_MAX_UNIFORM_BLOCK_SIZE is only queried once
+     */
+
+    static GLint getMaxUniformBlockSize();
+
+  private:
+    static void _retreive();
+
+    static bool			_retreived;
+    static GLint		_majorVersion;
+    static GLint		_minorVersion;
+    static GLint		_maxUniformBlockSize;
+    static std::set<std::string>	_extensions;
+  };
+};
+
+#endif /* _GLE_EXTENSIONS_HPP_ */
@@ -10,6 +10,8 @@
 
 #include "FrameBuffer.hpp"
 #include "Exception.hpp"
+#include "Debug.hpp"
+#include "StateCache.hpp"
 
 gle::FrameBuffer& gle::FrameBuffer::getDefaultFrameBuffer()
 {
@@ -29,7 +31,10 @@ gle::FrameBuffer::FrameBuffer(GLint id) :
 gle::FrameBuffer::~FrameBuffer()
 {
   if (_id != 0)
-    glDeleteFramebuffers(1, &_id);
+    {
+      glDeleteFramebuffers(1, &_id);
+      gle::StateCache::getInstance().forgetFramebuffer(_id);
+    }
 }
 
 void gle::FrameBuffer::update()
@@ -38,7 +43,7 @@ void gle::FrameBuffer::update()
 
 void gle::FrameBuffer::bind() const
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, _id);
+  gle::StateCache::getInstance().bindFramebuffer(GL_FRAMEBUFFER, _id);
 }
 
 void gle::FrameBuffer::attach(gle::Texture const& texture, Attachment attachment)
@@ -49,7 +54,17 @@ void gle::FrameBuffer::attach(gle::Texture const& texture, Attachment attachment
 			   GL_TEXTURE_2D,
 			   texture.getId(),
 			   0);
-  gle::Exception::CheckOpenGLError("Attach texture");
+  else if (texture.getType() == gle::Texture::Texture2DArray)
+    glFramebufferTexture(GL_FRAMEBUFFER, attachment, texture.getId(), 0);
+  GLE_CHECK_OPENGL_ERROR("Attach texture");
+}
+
+void gle::FrameBuffer::attach(gle::Texture const& texture, Attachment attachment,
+			      GLint layer)
+{
+  bind();
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment, texture.getId(), 0, layer);
+  GLE_CHECK_OPENGL_ERROR("Attach texture layer");
 }
 
 void gle::FrameBuffer::detach(gle::Texture const& texture, Attachment attachment)
@@ -60,7 +75,9 @@ void gle::FrameBuffer::detach(gle::Texture const& texture, Attachment attachment
 			   GL_TEXTURE_2D,
 			   0,
 			   0);
-  gle::Exception::CheckOpenGLError("Detach texture");
+  else if (texture.getType() == gle::Texture::Texture2DArray)
+    glFramebufferTexture(GL_FRAMEBUFFER, attachment, 0, 0);
+  GLE_CHECK_OPENGL_ERROR("Detach texture");
 }
 
 void gle::FrameBuffer::attach(gle::RenderBuffer const& renderBuffer, Attachment attachment)
@@ -69,7 +86,7 @@ void gle::FrameBuffer::attach(gle::RenderBuffer const& renderBuffer, Attachment
   glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment,
 			    GL_RENDERBUFFER,
 			    renderBuffer.getId());
-  gle::Exception::CheckOpenGLError("Attach render buffer");
+  GLE_CHECK_OPENGL_ERROR("Attach render buffer");
 }
 
 void gle::FrameBuffer::detach(gle::RenderBuffer const& renderBuffer, Attachment attachment)
@@ -79,7 +96,7 @@ void gle::FrameBuffer::detach(gle::RenderBuffer const& renderBuffer, Attachment
   glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment,
 			    GL_RENDERBUFFER,
 			    0);
-  gle::Exception::CheckOpenGLError("Detach render buffer");
+  GLE_CHECK_OPENGL_ERROR("Detach render buffer");
 }
 
 GLenum	gle::FrameBuffer::getStatus() const
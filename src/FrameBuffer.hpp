@@ -78,12 +78,23 @@ namespace gle {
 
     //! Attach a texture to the framebuffer
     /*!
+      All the layers of a texture array are attached: the framebuffer is
+      layered, and the geometry shader selects the layer of each primitive.
       \param texture The texture to be attached
       \param attachment The attachment point
      */
 
     void attach(gle::Texture const& texture, Attachment attachment);
 
+    //! Attach a layer of a texture array to the framebuffer
+    /*!
+      \param texture The texture whose layer is attached
+      \param attachment The attachment point
+      \param layer Index of the layer to attach
+     */
+
+    void attach(gle::Texture const& texture, Attachment attachment, GLint layer);
+
     //! Detach a texture from the framebuffer
     /*!
       \param texture The texture to be detached
@@ -16,24 +16,54 @@
 namespace gle {
 
   //! Buffer manager for storage of mesh indexes
+  /*!
+    Indexes of all the meshes are stored in one element array buffer
+    per index type.
+    Mesh indexes are relative to the first vertex of the mesh, so meshes
+    with less than 65536 vertexes can use 16 bits indexes, stored in
+    the IndexBufferManagerus. The other ones use the IndexBufferManagerui.
+   */
 
-  class IndexBufferManager : public BufferManager<IndexBufferManager, GLfloat>
+  template <typename T>
+  class IndexBufferManager : public BufferManager<IndexBufferManager<T>, T>
   {
-    friend class Singleton<IndexBufferManager>;
+    friend class Singleton<IndexBufferManager<T>>;
 
   private:
     IndexBufferManager()
-      : BufferManager()
+      : BufferManager<IndexBufferManager<T>, T>()
     {
-      setStorageBuffer(new Bufferui(Bufferui::ElementArray,
-				    Bufferui::StaticDraw));
+      this->setStorageBuffer(new Buffer<T>(Buffer<T>::ElementArray,
+					   Buffer<T>::StaticDraw));
     }
     ~IndexBufferManager()
     {
     }
 
   public:
+
+    //! OpenGL type of the indexes stored in the buffer manager
+
+    static GLenum getIndexType();
   };
+
+  template <>
+  inline GLenum IndexBufferManager<GLuint>::getIndexType()
+  {
+    return (GL_UNSIGNED_INT);
+  }
+
+  template <>
+  inline GLenum IndexBufferManager<GLushort>::getIndexType()
+  {
+    return (GL_UNSIGNED_SHORT);
+  }
+
+  //! Buffer manager for 32 bits indexes
+  typedef IndexBufferManager<GLuint> IndexBufferManagerui;
+
+  //! Buffer manager for 16 bits indexes
+  typedef IndexBufferManager<GLushort> IndexBufferManagerus;
 }
 
 # endif
@@ -13,8 +13,11 @@
 gle::Light::Light(Type type) :
   Scene::Node(Scene::Node::Light), _lightType(type),
   _shadowMapSize(0, 0, 1024, 1024),
-  _shadowMap(), _shadowMapFrameBuffer(), _shadowMapCamera()
+  _shadowMap(), _shadowMapFrameBuffer(), _shadowMapCamera(),
+  _shadowMapTile(0, 0, 0, 0), _shadowAtlasSize(0), _staticShadowCasters()
 {
+  _staticShadowCasters.valid = false;
+  _staticShadowCasters.staticMeshesVersion = 0;
 }
 
 gle::Light::~Light()
@@ -36,34 +39,63 @@ void gle::Light::update()
 {
 }
 
+void gle::Light::getUniforms(GLfloat* uniforms)
+{
+  for (GLsizeiptr i = 0; i < UniformSize; ++i)
+    uniforms[i] = 0;
+}
+
 gle::Texture*	gle::Light::getShadowMap()
 {
-  if (!_projectShadow)
-    return (NULL);
-  if (!_shadowMap)
-    {
-      _shadowMap = new gle::Texture(_shadowMapSize.width, _shadowMapSize.height,
-				    gle::Texture::Texture2D, gle::Texture::Depth);
-      _shadowMap->setUseMipmap(false);
-      _shadowMap->setFilterType(gle::Texture::Nearest);      
-      //_shadowMap->setWrapMode(gle::Texture::Clamp);
-    }
   return (_shadowMap);
 }
 
 gle::FrameBuffer*	gle::Light::getShadowMapFrameBuffer()
 {
-  if (!_projectShadow)
-    return (NULL);
-  if (!_shadowMapFrameBuffer)
-    {
-      _shadowMapFrameBuffer = new gle::FrameBuffer();
-      _shadowMapFrameBuffer->attach(*getShadowMap(), gle::FrameBuffer::AttachmentDepth);
-    }
   return (_shadowMapFrameBuffer);
 }
 
+void	gle::Light::setShadowMapSize(GLuint size)
+{
+  _shadowMapSize.width = size;
+  _shadowMapSize.height = size;
+}
+
+GLuint	gle::Light::getShadowMapSize() const
+{
+  return (_shadowMapSize.width);
+}
+
+void	gle::Light::setShadowMapTile(const gle::Rectui& tile, GLuint atlasSize)
+{
+  if (tile.x != _shadowMapTile.x || tile.y != _shadowMapTile.y
+      || tile.width != _shadowMapTile.width || atlasSize != _shadowAtlasSize)
+    invalidateStaticShadowMap();
+  _shadowMapTile = tile;
+  _shadowAtlasSize = atlasSize;
+}
+
+const gle::Rectui&	gle::Light::getShadowMapTile() const
+{
+  return (_shadowMapTile);
+}
+
+bool	gle::Light::hasShadowMapTile() const
+{
+  return (_shadowMapTile.width > 0 && _shadowMapTile.height > 0);
+}
+
 gle::Camera* gle::Light::getShadowMapCamera()
 {
   return (_shadowMapCamera);
 }
+
+gle::Light::StaticShadowCasters&	gle::Light::getStaticShadowCasters()
+{
+  return (_staticShadowCasters);
+}
+
+void	gle::Light::invalidateStaticShadowMap()
+{
+  _staticShadowCasters.valid = false;
+}
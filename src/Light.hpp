@@ -15,6 +15,8 @@
 # include <Texture.hpp>
 # include <FrameBuffer.hpp>
 # include <Camera.hpp>
+# include <list>
+# include <vector>
 
 namespace gle {
 
@@ -34,6 +36,19 @@ namespace gle {
       SPOT = 2
     };
 
+    //! Number of floats used by a light in the lights uniform block
+    /*!
+      std140 layout of a light in the shaders:\n
+      0: absolute position\n
+      4: direction, cosinus of the spot cut off in w\n
+      8: color, cosinus of the spot inner cut off in w\n
+      12: specular color, 1 in w if the light has a shadow map\n
+      16: attenuation\n
+      20: shadow map matrix, to the coordinates of its tile in the shadow atlas
+     */
+
+    static const GLsizeiptr UniformSize = 36;
+
     //! Constructor with type
     /*
       \param type Type of light
@@ -53,18 +68,88 @@ namespace gle {
 
     virtual void update();
 
-    //! Return the shadow map texture if shadows are enabled
+    //! Write the parameters of the light in the lights uniform block layout
+    /*!
+      \param uniforms Array of UniformSize floats
+      \sa UniformSize
+     */
+
+    virtual void getUniforms(GLfloat* uniforms);
+
+    //! Return the shadow map texture owned by the light, if any
+    /*!
+      Spot lights render in a tile of the shadow atlas of the scene
+      instead, and have no texture of their own.
+     */
 
     virtual gle::Texture*	getShadowMap();
 
-    //! Return the framebuffer used to render the shadow map if shadows are enabled
+    //! Return the framebuffer of the shadow map owned by the light, if any
 
     virtual gle::FrameBuffer*	getShadowMapFrameBuffer();
 
+    //! Set the resolution of the shadow map when the light covers the screen
+    /*!
+      Tiles of lights covering a smaller part of the screen are smaller.
+     */
+
+    void	setShadowMapSize(GLuint size);
+
+    //! Return the resolution of the shadow map when the light covers the screen
+
+    GLuint	getShadowMapSize() const;
+
+    //! Set the area of the shadow atlas where the shadow map is rendered
+    /*!
+      A tile with a null size disables the shadows of the light.
+      The static shadow casters are rendered again when the tile changes.
+      \param tile Position and size of the tile in texels
+      \param atlasSize Size of the shadow atlas
+     */
+
+    void	setShadowMapTile(const gle::Rectui& tile, GLuint atlasSize);
+
+    //! Return the area of the shadow framebuffer where the shadow map is rendered
+
+    const gle::Rectui&	getShadowMapTile() const;
+
+    //! Return wether the light has a tile to render its shadow map
+
+    bool	hasShadowMapTile() const;
+
     //! Return the camera used to generate the shadow map
 
     virtual gle::Camera*	getShadowMapCamera();    
 
+    //! Static shadow casters rendered in the static shadow map
+    /*!
+      The depth of the static meshes is kept in the static shadow atlas,
+      and only rendered again when the light, its tile, or one of the
+      static meshes casting a shadow in its frustum, changes.
+      Each frame, the dynamic meshes are rendered on a copy of it.
+     */
+
+    struct StaticShadowCasters {
+      //! Wether the static shadow atlas contains the depth of the casters
+      bool				valid;
+      //! Projection * view matrix of the light when rendered
+      Matrix4<GLfloat>			matrix;
+      //! Version of the static meshes of the scene when rendered
+      GLuint				staticMeshesVersion;
+      //! Static meshes rendered in the static shadow atlas
+      std::list<gle::Mesh*>		meshes;
+      //! Transformation matrices of the meshes when rendered
+      std::vector<Matrix4<GLfloat> >	meshesMatrices;
+    };
+
+    //! Return the static shadow casters of the static shadow atlas
+
+    StaticShadowCasters&	getStaticShadowCasters();
+
+    //! Force the static shadow casters to be rendered again
+
+    void	invalidateStaticShadowMap();
+
   protected:
     //! Type of light
     Type		_lightType;
@@ -80,6 +165,15 @@ namespace gle {
 
     //! Shadow map camera
     gle::Camera*	_shadowMapCamera;
+
+    //! Area of the shadow framebuffer where the shadow map is rendered
+    gle::Rectui		_shadowMapTile;
+
+    //! Size of the shadow atlas containing the tile
+    GLuint		_shadowAtlasSize;
+
+    //! Static shadow casters
+    StaticShadowCasters	_staticShadowCasters;
   };
 }
 
@@ -0,0 +1,318 @@
+//
+// LightClusters.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:17:07 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <LightClusters.hpp>
+
+// Below this number of lights per thread, the threads cost more than the binning
+#define GLE_LIGHT_CLUSTERS_LIGHTS_PER_THREAD 32
+
+gle::LightClusters::LightClusters(GLsizeiptr maxIndexes) :
+  _maxIndexes(0), _pool(1),
+  _view(), _projection(), _depthParameters(), _counts(NbClusters, 0),
+  _data(), _nbIndexes(0)
+{
+  setMaxIndexes(maxIndexes);
+}
+
+gle::LightClusters::~LightClusters()
+{
+}
+
+void gle::LightClusters::setMaxIndexes(GLsizeiptr maxIndexes)
+{
+  // Offsets are stored on 16 bits
+  maxIndexes = std::min(maxIndexes, (GLsizeiptr)0xFFFF);
+  _maxIndexes = std::max(maxIndexes - maxIndexes % 8, (GLsizeiptr)0);
+  _indexes.assign(_maxIndexes, 0);
+  _data.assign(NbClusters + _maxIndexes / 2, 0);
+  _nbIndexes = 0;
+}
+
+GLsizeiptr gle::LightClusters::getMaxIndexes() const
+{
+  return (_maxIndexes);
+}
+
+void gle::LightClusters::setNumberOfThreads(unsigned int nbThreads)
+{
+  _pool.setNumberOfThreads(std::min(nbThreads,
+				    (unsigned int)maximumNumberOfThreads));
+}
+
+void gle::LightClusters::clear()
+{
+  _positionsX.clear();
+  _positionsY.clear();
+  _positionsZ.clear();
+  _ranges.clear();
+  _lightIndexes.clear();
+}
+
+void gle::LightClusters::addLight(const Vector3<GLfloat>& position,
+				  GLfloat range, GLuint index)
+{
+  _positionsX.push_back(position.x);
+  _positionsY.push_back(position.y);
+  _positionsZ.push_back(position.z);
+  _ranges.push_back(range);
+  _lightIndexes.push_back(index);
+}
+
+GLsizeiptr gle::LightClusters::getNbLights() const
+{
+  return (_ranges.size());
+}
+
+void gle::LightClusters::build(const Matrix4<GLfloat>& view,
+			       const Matrix4<GLfloat>& projection)
+{
+  GLuint	nbLights = _ranges.size();
+  GLfloat	near, far;
+
+  _view = view;
+  _projection = projection;
+  // Retreive the clipping planes from the projection matrix
+  if (projection[11] != 0)
+    {
+      near = projection[14] / (projection[10] - 1);
+      far = projection[14] / (projection[10] + 1);
+    }
+  else
+    {
+      near = (projection[14] + 1) / projection[10];
+      far = (projection[14] - 1) / projection[10];
+    }
+  near = std::max(near, 0.0001f);
+  far = std::max(far, near * 1.001f);
+  _depthParameters = Vector3<GLfloat>(near, far, GridZ / log(far / near));
+
+  for (int i = 0; i < 6; ++i)
+    _bounds[i].resize(nbLights);
+  _run(&LightClusters::_computeBounds, nbLights);
+
+  // Each thread works on its own depth slices, so they never share a cluster
+  _counts.assign(NbClusters, 0);
+  _run(&LightClusters::_countLights, GridZ);
+  _nbIndexes = 0;
+  for (GLuint cluster = 0; cluster < NbClusters; ++cluster)
+    {
+      GLuint size = std::min((GLsizeiptr)_counts[cluster],
+			     _maxIndexes - _nbIndexes);
+
+      _counts[cluster] = size;
+      _data[cluster] = _nbIndexes | (size << 16);
+      _nbIndexes += size;
+    }
+  _run(&LightClusters::_fillClusters, GridZ);
+  for (GLsizeiptr i = 0; i < _nbIndexes; i += 2)
+    _data[NbClusters + i / 2] = _indexes[i] | (_indexes[i + 1] << 16);
+}
+
+GLuint gle::LightClusters::getClusterIndex(GLuint x, GLuint y, GLuint z) const
+{
+  return ((z * GridY + y) * GridX + x);
+}
+
+GLuint gle::LightClusters::getClusterOffset(GLuint cluster) const
+{
+  return (_data[cluster] & 0xFFFF);
+}
+
+GLuint gle::LightClusters::getClusterSize(GLuint cluster) const
+{
+  return (_data[cluster] >> 16);
+}
+
+GLuint gle::LightClusters::getIndex(GLsizeiptr index) const
+{
+  return (_indexes[index]);
+}
+
+GLsizeiptr gle::LightClusters::getNbIndexes() const
+{
+  return (_nbIndexes);
+}
+
+const std::vector<GLuint>& gle::LightClusters::getData() const
+{
+  return (_data);
+}
+
+GLsizeiptr gle::LightClusters::getDataSize() const
+{
+  return (NbClusters + (_nbIndexes + 7) / 8 * 4);
+}
+
+const gle::Vector3<GLfloat>& gle::LightClusters::getDepthParameters() const
+{
+  return (_depthParameters);
+}
+
+GLfloat gle::LightClusters::getLightRange(GLfloat constant, GLfloat linear,
+					  GLfloat quadratic, GLfloat threshold)
+{
+  GLfloat limit = 1.0 / threshold - constant;
+
+  if (quadratic > 0)
+    return ((-linear + sqrt(linear * linear + 4 * quadratic * limit))
+	    / (2 * quadratic));
+  else if (linear > 0)
+    return (std::max(limit / linear, 0.0f));
+  return (-1);
+}
+
+void gle::LightClusters::_computeBounds(GLuint firstLight, GLuint lastLight)
+{
+  const Matrix4<GLfloat>&	v = _view;
+  const Matrix4<GLfloat>&	p = _projection;
+  GLfloat			near = _depthParameters.x;
+  GLfloat			far = _depthParameters.y;
+
+  for (GLuint i = firstLight; i < lastLight; ++i)
+    {
+      GLfloat r = _ranges[i];
+      GLfloat x = v[0] * _positionsX[i] + v[4] * _positionsY[i]
+	+ v[8] * _positionsZ[i] + v[12];
+      GLfloat y = v[1] * _positionsX[i] + v[5] * _positionsY[i]
+	+ v[9] * _positionsZ[i] + v[13];
+      GLfloat z = v[2] * _positionsX[i] + v[6] * _positionsY[i]
+	+ v[10] * _positionsZ[i] + v[14];
+
+      _bounds[0][i] = 0;
+      _bounds[1][i] = GridX - 1;
+      _bounds[2][i] = 0;
+      _bounds[3][i] = GridY - 1;
+      _bounds[4][i] = 0;
+      _bounds[5][i] = GridZ - 1;
+      if (r < 0)
+	continue ;
+      if (-z + r < near || -z - r > far)
+	{
+	  _bounds[4][i] = 1;
+	  _bounds[5][i] = 0;
+	  continue ;
+	}
+      _bounds[4][i] = _getSlice(-z - r);
+      _bounds[5][i] = _getSlice(-z + r);
+      // A sphere crossing the near plane can cover the whole screen
+      if (-z - r <= near)
+	continue ;
+
+      // Screen bounds of the projection of the box around the sphere
+      GLfloat minX = 1, maxX = -1, minY = 1, maxY = -1;
+      for (int corner = 0; corner < 8; ++corner)
+	{
+	  GLfloat cx = x + (corner & 1 ? r : -r);
+	  GLfloat cy = y + (corner & 2 ? r : -r);
+	  GLfloat cz = z + (corner & 4 ? r : -r);
+	  GLfloat w = p[3] * cx + p[7] * cy + p[11] * cz + p[15];
+	  GLfloat px = (p[0] * cx + p[4] * cy + p[8] * cz + p[12]) / w;
+	  GLfloat py = (p[1] * cx + p[5] * cy + p[9] * cz + p[13]) / w;
+
+	  minX = std::min(minX, px);
+	  maxX = std::max(maxX, px);
+	  minY = std::min(minY, py);
+	  maxY = std::max(maxY, py);
+	}
+      if (maxX < -1 || minX > 1 || maxY < -1 || minY > 1)
+	{
+	  _bounds[4][i] = 1;
+	  _bounds[5][i] = 0;
+	  continue ;
+	}
+      _bounds[0][i] = _getTile(minX, GridX);
+      _bounds[1][i] = _getTile(maxX, GridX);
+      _bounds[2][i] = _getTile(minY, GridY);
+      _bounds[3][i] = _getTile(maxY, GridY);
+    }
+}
+
+void gle::LightClusters::_countLights(GLuint firstSlice, GLuint lastSlice)
+{
+  GLuint nbLights = _ranges.size();
+
+  for (GLuint i = 0; i < nbLights; ++i)
+    {
+      GLuint minZ = std::max(_bounds[4][i], firstSlice);
+      GLuint maxZ = std::min(_bounds[5][i] + 1, lastSlice);
+
+      for (GLuint z = minZ; z < maxZ; ++z)
+	for (GLuint y = _bounds[2][i]; y <= _bounds[3][i]; ++y)
+	  for (GLuint x = _bounds[0][i]; x <= _bounds[1][i]; ++x)
+	    ++_counts[getClusterIndex(x, y, z)];
+    }
+}
+
+void gle::LightClusters::_fillClusters(GLuint firstSlice, GLuint lastSlice)
+{
+  GLuint		nbLights = _ranges.size();
+  GLuint		firstCluster = getClusterIndex(0, 0, firstSlice);
+  std::vector<GLuint>	sizes(getClusterIndex(0, 0, lastSlice) - firstCluster, 0);
+
+  // Lights are added in order, so the result does not depend on the threads
+  for (GLuint i = 0; i < nbLights; ++i)
+    {
+      GLuint minZ = std::max(_bounds[4][i], firstSlice);
+      GLuint maxZ = std::min(_bounds[5][i] + 1, lastSlice);
+
+      for (GLuint z = minZ; z < maxZ; ++z)
+	for (GLuint y = _bounds[2][i]; y <= _bounds[3][i]; ++y)
+	  for (GLuint x = _bounds[0][i]; x <= _bounds[1][i]; ++x)
+	    {
+	      GLuint cluster = getClusterIndex(x, y, z);
+	      GLuint& size = sizes[cluster - firstCluster];
+
+	      if (size < _counts[cluster])
+		_indexes[(_data[cluster] & 0xFFFF) + size++] = _lightIndexes[i];
+	    }
+    }
+}
+
+GLuint gle::LightClusters::_getSlice(GLfloat depth) const
+{
+  if (depth <= _depthParameters.x)
+    return (0);
+  return (std::min((GLuint)(log(depth / _depthParameters.x)
+			    * _depthParameters.z), GridZ - 1));
+}
+
+GLuint gle::LightClusters::_getTile(GLfloat position, GLuint gridSize) const
+{
+  GLfloat tile = (position + 1) * 0.5f * gridSize;
+
+  if (tile <= 0)
+    return (0);
+  return (std::min((GLuint)tile, gridSize - 1));
+}
+
+void gle::LightClusters::_run(void (LightClusters::*task)(GLuint, GLuint),
+			      GLuint nbItems)
+{
+  GLuint nbTasks = std::min((GLuint)_ranges.size()
+			    / GLE_LIGHT_CLUSTERS_LIGHTS_PER_THREAD,
+			    _pool.getNumberOfThreads());
+
+  nbTasks = std::min(nbTasks, nbItems);
+  if (nbTasks <= 1)
+    {
+      (this->*task)(0, nbItems);
+      return ;
+    }
+
+  GLuint itemsByTask = (nbItems + nbTasks - 1) / nbTasks;
+
+  _pool.run([&](GLuint index) {
+      (this->*task)(std::min(index * itemsByTask, nbItems),
+		    std::min((index + 1) * itemsByTask, nbItems));
+    }, nbTasks);
+}
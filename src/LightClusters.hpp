@@ -0,0 +1,204 @@
+//
+// LightClusters.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:17:07 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_LIGHT_CLUSTERS_HPP_
+# define _GLE_LIGHT_CLUSTERS_HPP_
+
+# include <vector>
+# include <gle/opengl.h>
+# include <Vector3.hpp>
+# include <Matrix4.hpp>
+# include <WorkerPool.hpp>
+
+namespace gle {
+
+  //! Assignment of the point and spot lights to view space clusters
+  /*!
+    The view frustum is divided in a grid of GridX * GridY * GridZ clusters:
+    tiles of the screen in x and y, and slices distributed exponentially
+    between the near and far planes in z.
+    Each light is bounded by a sphere (its position and range) and added
+    to the list of all the clusters the sphere overlaps, so the fragment
+    shader only iterates the lights of its own cluster.
+
+    The binning only works on the CPU: the result can be checked with
+    getClusterOffset(), getClusterSize() and getIndexes() without any
+    OpenGL context.
+
+    The data follows the std140 layout of the gle_lightClustersBlock
+    uniform block: one uint per cluster (offset of its lights in the low
+    16 bits, number of lights in the high 16 bits), then the list of the
+    light indexes, two 16 bits indexes per uint.
+    Clusters are filled from the nearest slice, and lights that do not fit
+    in the index list are dropped from the clusters that overflow it.
+   */
+
+  class LightClusters {
+  public:
+
+    //! Number of clusters on the x axis of the screen
+    static const GLuint GridX = 16;
+
+    //! Number of clusters on the y axis of the screen
+    static const GLuint GridY = 8;
+
+    //! Number of depth slices
+    static const GLuint GridZ = 24;
+
+    //! Total number of clusters
+    static const GLuint NbClusters = GridX * GridY * GridZ;
+
+    //! Maximum number of threads used for the binning
+    static const unsigned int maximumNumberOfThreads = 8;
+
+    //! Create an empty set of clusters
+    /*!
+      \param maxIndexes Maximum number of light indexes in all the clusters
+     */
+
+    LightClusters(GLsizeiptr maxIndexes = 0);
+
+    //! Destroy the clusters
+
+    ~LightClusters();
+
+    //! Set the maximum number of light indexes in all the clusters
+    /*!
+      It is rounded down to a multiple of 8, to fill std140 uvec4
+     */
+
+    void setMaxIndexes(GLsizeiptr maxIndexes);
+
+    //! Returns the maximum number of light indexes
+
+    GLsizeiptr getMaxIndexes() const;
+
+    //! Set the number of threads used by build()
+    /*!
+      The binning uses a single thread by default. The threads of the
+      pool are only used when there are enough lights to share, and are
+      kept alive between two builds.
+      The result does not depend on the number of threads.
+     */
+
+    void setNumberOfThreads(unsigned int nbThreads);
+
+    //! Remove all the lights
+
+    void clear();
+
+    //! Add a light to bin
+    /*!
+      \param position World position of the light
+      \param range Distance after which the light has no effect,
+      or a negative value for an infinite range
+      \param index Index of the light stored in the clusters
+     */
+
+    void addLight(const Vector3<GLfloat>& position, GLfloat range,
+		  GLuint index);
+
+    //! Returns the number of lights added since the last clear()
+
+    GLsizeiptr getNbLights() const;
+
+    //! Assign the lights to the clusters of a camera
+    /*!
+      \param view View matrix of the camera
+      \param projection Projection matrix of the camera
+     */
+
+    void build(const Matrix4<GLfloat>& view,
+	       const Matrix4<GLfloat>& projection);
+
+    //! Returns the index of a cluster from its coordinates in the grid
+
+    GLuint getClusterIndex(GLuint x, GLuint y, GLuint z) const;
+
+    //! Returns the offset of the lights of a cluster in the index list
+
+    GLuint getClusterOffset(GLuint cluster) const;
+
+    //! Returns the number of lights in a cluster
+
+    GLuint getClusterSize(GLuint cluster) const;
+
+    //! Returns a light index of the list of all the clusters
+    /*!
+      The lights of a cluster are at the indexes
+      [getClusterOffset(cluster), getClusterOffset(cluster) + getClusterSize(cluster)[
+     */
+
+    GLuint getIndex(GLsizeiptr index) const;
+
+    //! Returns the number of used light indexes
+
+    GLsizeiptr getNbIndexes() const;
+
+    //! Returns the clusters data, in the layout of gle_lightClustersBlock
+
+    const std::vector<GLuint>& getData() const;
+
+    //! Returns the number of uints of getData() used by the last build()
+
+    GLsizeiptr getDataSize() const;
+
+    //! Returns the parameters of the depth slices for the shader
+    /*!
+      x: near plane distance, y: far plane distance,
+      z: scale so that slice = log(depth / near) * z
+     */
+
+    const Vector3<GLfloat>& getDepthParameters() const;
+
+    //! Returns the range of a light from its attenuation
+    /*!
+      The range is the distance where the attenuation
+      1 / (constant + linear * d + quadratic * d * d) goes below threshold.
+      It is negative (infinite) when the light is not attenuated.
+     */
+
+    static GLfloat getLightRange(GLfloat constant, GLfloat linear,
+				 GLfloat quadratic, GLfloat threshold);
+
+  private:
+    void	_computeBounds(GLuint firstLight, GLuint lastLight);
+    void	_countLights(GLuint firstSlice, GLuint lastSlice);
+    void	_fillClusters(GLuint firstSlice, GLuint lastSlice);
+    GLuint	_getSlice(GLfloat depth) const;
+    GLuint	_getTile(GLfloat position, GLuint gridSize) const;
+    void	_run(void (LightClusters::*task)(GLuint, GLuint),
+		     GLuint nbItems);
+
+    GLsizeiptr		_maxIndexes;
+    WorkerPool		_pool;
+
+    // Lights, stored as structure of arrays
+    std::vector<GLfloat>	_positionsX;
+    std::vector<GLfloat>	_positionsY;
+    std::vector<GLfloat>	_positionsZ;
+    std::vector<GLfloat>	_ranges;
+    std::vector<GLuint>		_lightIndexes;
+
+    // Clusters overlapped by each light: min and max on the 3 axis
+    std::vector<GLuint>		_bounds[6];
+
+    Matrix4<GLfloat>	_view;
+    Matrix4<GLfloat>	_projection;
+    Vector3<GLfloat>	_depthParameters;
+
+    std::vector<GLuint>	_counts;
+    std::vector<GLushort>	_indexes;
+    std::vector<GLuint>	_data;
+    GLsizeiptr		_nbIndexes;
+  };
+}
+
+#endif /* _GLE_LIGHT_CLUSTERS_HPP_ */
@@ -11,6 +11,7 @@
 #include <sstream>
 #include <Material.hpp>
 #include <Scene.hpp>
+#include <Mesh.hpp>
 #include <ShaderSource.hpp>
 
 gle::Material::Material(std::string const & name) :
@@ -22,12 +23,13 @@ gle::Material::Material(std::string const & name) :
   _colorMapEnabled(false), _colorMap(NULL),
   _normalMapEnabled(false), _normalMap(NULL),
   _envMapEnabled(false), _envMap(NULL),
+  _maxDrawDistance(std::numeric_limits<GLfloat>::infinity()),
   _uniforms(NULL), _uniformsBuffer(NULL),
   _needUniformsUpdate(true), _needUniformsBufferUpdate(true)
 {
   _uniforms = new GLfloat[UniformSize];
   _uniformsBuffer = new gle::Buffer<GLfloat>(gle::Buffer<GLfloat>::UniformArray,
-					     gle::Buffer<GLfloat>::StaticDraw);
+					     gle::Buffer<GLfloat>::DynamicDraw);
   _uniformsBuffer->resize(UniformSize);
 }
 
@@ -221,6 +223,19 @@ gle::EnvironmentMap* gle::Material::getEnvMap() const
   return (_envMap);
 }
 
+void gle::Material::setMaxDrawDistance(GLfloat distance)
+{
+  if (distance == _maxDrawDistance)
+    return ;
+  _maxDrawDistance = distance;
+  gle::Mesh::updateDrawDistancesVersion();
+}
+
+GLfloat gle::Material::getMaxDrawDistance() const
+{
+  return (_maxDrawDistance);
+}
+
 gle::Buffer<GLfloat>* gle::Material::getUniformsBuffer() const
 {
   if (_needUniformsUpdate || _needUniformsBufferUpdate)
@@ -12,6 +12,7 @@
 # define _GLE_MATERIAL_HPP_
 
 # include <string>
+# include <limits>
 # include <Program.hpp>
 # include <Texture.hpp>
 # include <Color.hpp>
@@ -205,6 +206,16 @@ namespace gle {
     //! Return environment map
     gle::EnvironmentMap* getEnvMap() const;
 
+    //! Set the largest distance from which the meshes of the material are drawn
+    /*!
+      \param distance Draw distance, infinite by default
+      \sa Mesh::setMaxDrawDistance()
+     */
+    void setMaxDrawDistance(GLfloat distance);
+
+    //! Return the largest distance from which the meshes are drawn
+    GLfloat getMaxDrawDistance() const;
+
     //! Returns the uniform buffer containing all datas for the material
     /*!
       Build the buffer if necessary
@@ -249,6 +260,8 @@ namespace gle {
     bool			_envMapEnabled;
     gle::EnvironmentMap*	_envMap;
 
+    GLfloat		_maxDrawDistance;
+
     GLfloat*		_uniforms;
     Buffer<GLfloat>*	_uniformsBuffer;
     mutable bool	_needUniformsUpdate;
@@ -104,6 +104,23 @@ namespace gle {
       return (_matrix[n]);
     }
 
+    //! Return true if all the elements of the matrices are equal
+
+    bool operator==(Matrix4 const & other) const
+    {
+      for (int i = 0; i < 16; ++i)
+	if (_matrix[i] != other._matrix[i])
+	  return (false);
+      return (true);
+    }
+
+    //! Return true if at least one element of the matrices differs
+
+    bool operator!=(Matrix4 const & other) const
+    {
+      return (!(*this == other));
+    }
+
     //! Add a matrix to the current
     /*!
       \param other Matrix to add.
@@ -12,6 +12,10 @@
 #include <BoundingBox.hpp>
 #include <Renderer.hpp>
 #include <Skeleton.hpp>
+#include <algorithm>
+#include <limits>
+
+GLuint gle::Mesh::_drawDistancesVersion = 0;
 
 std::list<gle::Scene::MeshGroup> gle::Mesh::factorizeForDrawing(std::list<gle::Mesh*> meshes,
 								bool ignoreBufferId,
@@ -66,21 +70,22 @@ gle::Mesh::Mesh(Material* material, bool isDynamic)
     _rasterizationMode(Fill),
     _pointSize(1.0),
     _material(material),
-    _indexes(NULL),
+    _indexType(GL_UNSIGNED_SHORT),
+    _shortIndexes(NULL),
+    _intIndexes(NULL),
     _attributes(NULL),
     _nbIndexes(0),
     _nbVertexes(0),
     _boundingVolume(NULL),
+    _maxDrawDistance(std::numeric_limits<GLfloat>::infinity()),
     _uniformBufferId(-1),
     _materialBufferId(-1),
-    _absoluteIndexes(false),
     _needUniformsUpdate(true),
     _uniforms(NULL), _skeleton(NULL), _skeletonId(-1),
+    _uniformIndex(0), _nbLights(-1), _lights(),
     _needSetIdentifiers(true)
 {
   _isDynamic = isDynamic;
-  _indexes = new gle::Buffer<GLuint>(gle::Buffer<GLuint>::ElementArray,
-				     gle::Buffer<GLuint>::StaticDraw);
 }
 
 gle::Mesh::Mesh(gle::Mesh const & other)
@@ -89,16 +94,21 @@ gle::Mesh::Mesh(gle::Mesh const & other)
     _rasterizationMode(other._rasterizationMode),
     _pointSize(other._pointSize),
     _material(other._material),
-    _indexes(NULL),
+    _indexType(other._indexType),
+    _shortIndexes(NULL),
+    _intIndexes(NULL),
     _attributes(NULL),
     _nbIndexes(other._nbIndexes),
     _nbVertexes(other._nbVertexes),
     _boundingVolume(NULL),
+    _occluderVertexes(other._occluderVertexes),
+    _occluderIndexes(other._occluderIndexes),
+    _maxDrawDistance(other._maxDrawDistance),
     _uniformBufferId(-1),
     _materialBufferId(-1),
-    _absoluteIndexes(other._absoluteIndexes),
     _needUniformsUpdate(true),
     _uniforms(NULL), _skeleton(other._skeleton), _skeletonId(other._skeletonId),
+    _uniformIndex(0), _nbLights(-1), _lights(),
     _needSetIdentifiers(true)
 {
   if (other._boundingVolume)
@@ -108,25 +118,20 @@ gle::Mesh::Mesh(gle::Mesh const & other)
   static int max = 0, nb = 0;
   max += _nbVertexes;
   nb++;
-  if (other._indexes)
-    _indexes =  new gle::Buffer<GLuint>(*other._indexes);
+  if (other._shortIndexes)
+    _shortIndexes = gle::IndexBufferManagerus::getInstance().duplicate(other._shortIndexes);
+  if (other._intIndexes)
+    _intIndexes = gle::IndexBufferManagerui::getInstance().duplicate(other._intIndexes);
   if (other._attributes)
     _attributes = gle::MeshBufferManager::getInstance().duplicate(other._attributes);
-  if (other._indexes && other._attributes && !_isDynamic)
-    {
-      GLuint* indexes = _indexes->map();
-      GLuint oldOffset = other._attributes->getOffset() / VertexAttributesSize;
-      GLuint newOffset = _attributes->getOffset() / VertexAttributesSize;
-      for (GLuint i = 0; i < _indexes->getSize(); ++i)
-  	indexes[i] = indexes[i] - oldOffset + newOffset;
-      _indexes->unmap();
-    }
 }
 
 gle::Mesh::~Mesh()
 {
-  if (_indexes)
-    delete _indexes;
+  if (_shortIndexes)
+    _shortIndexes->release();
+  if (_intIndexes)
+    _intIndexes->release();
   if (_attributes)
     _attributes->release();
   if (_boundingVolume)
@@ -270,10 +275,32 @@ void gle::Mesh::setBones(const GLfloat* bones, GLsizeiptr size)
 
 void gle::Mesh::setIndexes(const GLuint* indexes, GLsizeiptr size)
 {
+  GLuint maxIndex = 0;
+
+  if (_shortIndexes)
+    _shortIndexes->release();
+  if (_intIndexes)
+    _intIndexes->release();
+  _shortIndexes = NULL;
+  _intIndexes = NULL;
   _nbIndexes = size;
-  _indexes->resize(size, indexes);
-  if (!_isDynamic)
-    makeAbsoluteIndexes();
+  for (GLsizeiptr i = 0; i < size; ++i)
+    if (indexes[i] > maxIndex)
+      maxIndex = indexes[i];
+  if (maxIndex > 0xFFFF)
+    {
+      _indexType = GL_UNSIGNED_INT;
+      _intIndexes = IndexBufferManagerui::getInstance().store(indexes, size);
+    }
+  else if (size > 0)
+    {
+      GLushort* shortIndexes = new GLushort[size];
+      for (GLsizeiptr i = 0; i < size; ++i)
+	shortIndexes[i] = indexes[i];
+      _indexType = GL_UNSIGNED_SHORT;
+      _shortIndexes = IndexBufferManagerus::getInstance().store(shortIndexes, size);
+      delete [] shortIndexes;
+    }
   _needSetIdentifiers = true;
 }
 
@@ -369,15 +396,12 @@ void gle::Mesh::setBones(gle::Array<GLfloat> const &bones)
 
 void gle::Mesh::setIndexes(gle::Array<GLuint> const &indexes)
 {
-  _nbIndexes = indexes.size();
-  _indexes->resize(indexes.size(), (GLuint const *)indexes);
-  if (!_isDynamic)
-    makeAbsoluteIndexes();
-  _needSetIdentifiers = true;
+  setIndexes((GLuint const *)indexes, indexes.size());
 }
 
 void gle::Mesh::setIdentifiers(GLuint meshId, GLuint materialId)
 {
+  _uniformIndex = meshId;
   if (_nbVertexes < 1)
     return ;
   if (!_attributes)
@@ -424,9 +448,31 @@ gle::Material* gle::Mesh::getMaterial() const
   return (_material);
 }
 
-gle::Buffer<GLuint> * gle::Mesh::getIndexesBuffer() const
+GLenum gle::Mesh::getIndexType() const
 {
-  return (_indexes);
+  return (_indexType);
+}
+
+const GLvoid* gle::Mesh::getIndexesOffset() const
+{
+  if (_indexType == GL_UNSIGNED_INT)
+    return ((GLvoid*)(_intIndexes ? _intIndexes->getOffset() * sizeof(GLuint) : 0));
+  return ((GLvoid*)(_shortIndexes ? _shortIndexes->getOffset() * sizeof(GLushort) : 0));
+}
+
+GLint gle::Mesh::getBaseVertex() const
+{
+  if (!_attributes)
+    return (0);
+  return (_attributes->getOffset() / VertexAttributesSize);
+}
+
+void gle::Mesh::bindIndexes() const
+{
+  if (_indexType == GL_UNSIGNED_INT)
+    IndexBufferManagerui::getInstance().bind();
+  else
+    IndexBufferManagerus::getInstance().bind();
 }
 
 gle::MeshBufferManager::Chunk* gle::Mesh::getAttributes()
@@ -462,6 +508,28 @@ gle::BoundingVolume* gle::Mesh::getBoundingVolume() const
   return (_boundingVolume);
 }
 
+void gle::Mesh::setOccluder(const GLfloat* vertexes, GLsizeiptr size,
+			    const GLuint* indexes, GLsizeiptr nbIndexes)
+{
+  _occluderVertexes.assign(vertexes, vertexes + size);
+  _occluderIndexes.assign(indexes, indexes + nbIndexes);
+}
+
+bool gle::Mesh::isOccluder() const
+{
+  return (!_occluderIndexes.empty());
+}
+
+const std::vector<GLfloat>& gle::Mesh::getOccluderVertexes() const
+{
+  return (_occluderVertexes);
+}
+
+const std::vector<GLuint>& gle::Mesh::getOccluderIndexes() const
+{
+  return (_occluderIndexes);
+}
+
 const gle::Vector3<GLfloat>& gle::Mesh::getMaxPoint()
 {
   if (_needUpdateMatrix)
@@ -498,6 +566,48 @@ const gle::Vector3<GLfloat>& gle::Mesh::getCenter()
   return (_position);
 }
 
+GLfloat gle::Mesh::getRadius()
+{
+  if (_needUpdateMatrix)
+    {
+      this->updateMatrix();
+      _needUpdateMatrix = false;
+    }
+  if (_boundingVolume)
+    return (_boundingVolume->getRadius());
+  return (-1);
+}
+
+void gle::Mesh::setMaxDrawDistance(GLfloat distance)
+{
+  if (distance == _maxDrawDistance)
+    return ;
+  _maxDrawDistance = distance;
+  updateDrawDistancesVersion();
+}
+
+GLfloat gle::Mesh::getMaxDrawDistance() const
+{
+  return (_maxDrawDistance);
+}
+
+GLfloat gle::Mesh::getDrawDistance()
+{
+  if (_material)
+    return (std::min(_maxDrawDistance, _material->getMaxDrawDistance()));
+  return (_maxDrawDistance);
+}
+
+GLuint gle::Mesh::getDrawDistancesVersion()
+{
+  return (_drawDistancesVersion);
+}
+
+void gle::Mesh::updateDrawDistancesVersion()
+{
+  ++_drawDistancesVersion;
+}
+
 bool gle::Mesh::isInFrustum(const GLfloat frustum[6][4]) const
 {
   if (_boundingVolume)
@@ -521,32 +631,13 @@ void gle::Mesh::setDynamic(bool dynamic, bool deep)
   if (dynamic && !_isDynamic)
     {
       _type = gle::Scene::Node::DynamicMesh;
-      makeAbsoluteIndexes(false);
       setIdentifiers(0, 0);
     }
   else if (!dynamic && _isDynamic)
-    {
-      _type = gle::Scene::Node::StaticMesh;
-      makeAbsoluteIndexes(true);
-    }
+    _type = gle::Scene::Node::StaticMesh;
   gle::Scene::Node::setDynamic(dynamic, deep);
 }
 
-void gle::Mesh::makeAbsoluteIndexes(bool absolute)
-{
-  if (!_attributes || !_indexes || _absoluteIndexes == absolute)
-    return ;
-  _absoluteIndexes = absolute;
-  GLuint* indexes = _indexes->map();
-  GLuint offset = _attributes->getOffset() / VertexAttributesSize;
-  for (GLuint i = 0; i < _indexes->getSize(); ++i)
-    if (absolute)
-      indexes[i] += offset;
-    else
-      indexes[i] -= offset;
-  _indexes->unmap();
-}
-
 bool gle::Mesh::canBeRenderedWith(const gle::Scene::MeshGroup& group, bool ignoreBufferId, bool ignoreMaterial) const
 {
   return ((_rasterizationMode == group.rasterizationMode)
@@ -578,6 +669,28 @@ GLint gle::Mesh::getMaterialBufferId() const
   return (_materialBufferId);
 }
 
+GLuint gle::Mesh::getUniformIndex() const
+{
+  return (_uniformIndex);
+}
+
+bool gle::Mesh::setLights(const GLuint* lights, GLint nbLights)
+{
+  nbLights = std::min(nbLights, (GLint)MaxLights);
+  if (nbLights == _nbLights && std::equal(lights, lights + std::max(nbLights, 0), _lights))
+    return (false);
+  _nbLights = nbLights;
+  for (GLint i = 0; i < nbLights; ++i)
+    _lights[i] = lights[i];
+  _needUniformsUpdate = true;
+  return (true);
+}
+
+GLint gle::Mesh::getNbLights() const
+{
+  return (_nbLights);
+}
+
 std::vector<gle::Scene::Node*>& gle::Mesh::getDebugNodes(int mode)
 {
   _debugNodes.clear();
@@ -611,6 +724,9 @@ const GLfloat* gle::Mesh::getUniforms()
 	}
       else
 	_uniforms[16] = -1;
+      _uniforms[UniformLightsOffset] = _nbLights;
+      for (GLint i = 0; i < _nbLights; ++i)
+	_uniforms[20 + i] = _lights[i];
       _needUniformsUpdate = false;
     }
   return (_uniforms);
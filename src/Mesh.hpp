@@ -23,6 +23,7 @@
 # include <Quaternion.hpp>
 # include <Array.hpp>
 # include <MeshBufferManager.hpp>
+# include <IndexBufferManager.hpp>
 # include <BoundingVolume.hpp>
 # include <Octree.hpp>
 # include <Scene.hpp>
@@ -149,8 +150,18 @@ namespace gle {
        + VertexAttributeMeshIdentifiers)
       ;
 
+    //! Maximum number of point and spot lights selected for one mesh
+    static const GLsizeiptr MaxLights = 8;
+
+    //! Offset of the selected lights in the mesh uniform datas
+    /*!
+      The number of lights is followed by padding then the indexes
+      of the lights, as an array of std140 vec4
+     */
+    static const GLsizeiptr UniformLightsOffset = 17;
+
     //! Size of the datas used by one mesh in the uniform buffer
-    static const GLsizeiptr UniformSize = 20;
+    static const GLsizeiptr UniformSize = 20 + MaxLights;
 
     //! Factorize a list of meshes using canBeRenderedWith comparator
 
@@ -219,6 +230,10 @@ namespace gle {
     void setBones(const GLfloat* bones, GLsizeiptr size);
 
     //! Set the mesh indexes
+    /*!
+      Indexes are relative to the first vertex of the mesh.
+      They are stored on 16 bits if every index fits in, on 32 bits otherwise.
+     */
 
     void setIndexes(const GLuint* indexes, GLsizeiptr size);
 
@@ -270,10 +285,25 @@ namespace gle {
 
     Buffer<GLfloat> * getTextureCoordsBuffer();
 
-    //! Get the indexes buffer
+    //! Get the OpenGL type of the mesh indexes
+    /*!
+      Returns GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+     */
+
+    GLenum getIndexType() const;
+
+    //! Get the offset in bytes of the mesh indexes in their element array buffer
+
+    const GLvoid* getIndexesOffset() const;
+
+    //! Get the index of the first vertex of the mesh in the mesh buffer manager
+
+    GLint getBaseVertex() const;
+
+    //! Bind the element array buffer containing the mesh indexes
+
+    void bindIndexes() const;
 
-    Buffer<GLuint> * getIndexesBuffer() const;
-    
     //! Get the number of indexes in the mesh
 
     GLsizeiptr getNbIndexes() const;
@@ -294,6 +324,33 @@ namespace gle {
 
     BoundingVolume* getBoundingVolume() const;
 
+    //! Set the triangles hiding the meshes behind the mesh
+    /*!
+      The occluder is rasterized in the occlusion buffer of the scene (see
+      Scene::enableOcclusionCulling()). It should have few triangles, and
+      must be inside the mesh, or the meshes it wrongly hides are culled.
+      \param vertexes Positions of the vertexes in the mesh space, three
+      floats each
+      \param size Number of floats in vertexes
+      \param indexes Indexes of the vertexes of the triangles
+      \param nbIndexes Number of indexes, three per triangle
+     */
+
+    void setOccluder(const GLfloat* vertexes, GLsizeiptr size,
+		     const GLuint* indexes, GLsizeiptr nbIndexes);
+
+    //! Returns whether the mesh has an occluder
+
+    bool isOccluder() const;
+
+    //! Returns the positions of the vertexes of the occluder
+
+    const std::vector<GLfloat>& getOccluderVertexes() const;
+
+    //! Returns the indexes of the triangles of the occluder
+
+    const std::vector<GLuint>& getOccluderIndexes() const;
+
     //! Get the coords of the highest values of the mesh vertices
 
     virtual const Vector3<GLfloat>& getMaxPoint();
@@ -306,6 +363,41 @@ namespace gle {
 
     virtual const Vector3<GLfloat>& getCenter();
 
+    //! Get the radius of the bounding sphere of the mesh
+    /*!
+      It is negative if the mesh has no bounding sphere
+     */
+
+    virtual GLfloat getRadius();
+
+    //! Set the largest distance from which the mesh is drawn
+    /*!
+      The scene culls the mesh when the nearest point of its bounds is
+      farther from the camera, see Scene::setScreenSizeCulling().
+      \param distance Draw distance, infinite by default
+     */
+
+    void setMaxDrawDistance(GLfloat distance);
+
+    //! Returns the largest distance from which the mesh is drawn
+
+    GLfloat getMaxDrawDistance() const;
+
+    //! Get the draw distance of the mesh, limited by its material
+
+    virtual GLfloat getDrawDistance();
+
+    //! Returns a number changed with the draw distance of any mesh or material
+    /*!
+      The scenes then update the draw distances stored in their octree.
+     */
+
+    static GLuint getDrawDistancesVersion();
+
+    //! Change the number returned by getDrawDistancesVersion()
+
+    static void updateDrawDistancesVersion();
+
     //! Return wether the mesh is in a frutum or not
 
     virtual bool isInFrustum(const GLfloat frustum[6][4]) const;
@@ -325,10 +417,6 @@ namespace gle {
 
     virtual void setDynamic(bool dynamic, bool deep=true);
 
-    //! Update the mesh indexes so they are relative or not to the mesh attributes position in the buffer manager
-
-    void makeAbsoluteIndexes(bool absolute=true);
-
     //! Indicated whether the mesh can be rendered with an other mesh or not
     /*!
       Two meshes can be rendered together if they have the same rasterization mode,
@@ -359,6 +447,26 @@ namespace gle {
 
     GLint getMaterialBufferId() const;
 
+    //! Returns the index of the mesh in its uniform buffer
+
+    GLuint getUniformIndex() const;
+
+    //! Set the point and spot lights used to render the mesh
+    /*!
+      Only used for static meshes, when the scene selects lights per mesh
+      (see Scene::MeshLights).
+      Returns true if the lights are different from the previous ones.
+      \param lights Indexes of the lights in the lights uniform buffer
+      \param nbLights Number of lights, at most MaxLights,
+      or -1 to use the lights of the clusters
+     */
+
+    bool setLights(const GLuint* lights, GLint nbLights);
+
+    //! Returns the number of lights selected for the mesh, or -1
+
+    GLint getNbLights() const;
+
     //! Returns the nodes for rendering debug informations about the mesh
 
     virtual std::vector<Scene::Node*>& getDebugNodes(int mode);
@@ -388,24 +496,32 @@ namespace gle {
     GLfloat		_pointSize;
 
     Material*			_material;
-    Buffer<GLuint>*		_indexes;
+    GLenum			_indexType;
+    IndexBufferManagerus::Chunk*	_shortIndexes;
+    IndexBufferManagerui::Chunk*	_intIndexes;
     MeshBufferManager::Chunk*	_attributes;
 
     GLsizeiptr		_nbIndexes;
     GLsizeiptr		_nbVertexes;
     BoundingVolume*	_boundingVolume;
+    std::vector<GLfloat>	_occluderVertexes;
+    std::vector<GLuint>	_occluderIndexes;
+    GLfloat		_maxDrawDistance;
+    static GLuint	_drawDistancesVersion;
 
     GLint		_uniformBufferId;
     GLint		_materialBufferId;
 
-    bool		_absoluteIndexes;
-
     bool		_needUniformsUpdate;
     GLfloat*		_uniforms;
 
     gle::Skeleton*	_skeleton;
     GLint		_skeletonId;
 
+    GLuint		_uniformIndex;
+    GLint		_nbLights;
+    GLuint		_lights[MaxLights];
+
     bool		_needSetIdentifiers;
   };
 }
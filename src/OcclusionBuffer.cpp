@@ -0,0 +1,328 @@
+//
+// OcclusionBuffer.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 09:53:22 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#ifdef __SSE__
+# include <xmmintrin.h>
+#endif
+#include <OcclusionBuffer.hpp>
+#include <Octree.hpp>
+
+namespace {
+  // Clip coordinates of a point: x, y, z, w
+  void project(const gle::Matrix4<GLfloat>& m, GLfloat x, GLfloat y, GLfloat z,
+	       GLfloat* clip)
+  {
+    for (GLuint i = 0; i < 4; ++i)
+      clip[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+  }
+
+  // Points behind the near plane cannot be projected
+  bool isBehindNear(const GLfloat* clip)
+  {
+    return (clip[3] <= 0 || clip[2] < -clip[3]);
+  }
+}
+
+gle::OcclusionBuffer::OcclusionBuffer(GLuint width, GLuint height) :
+  _width(0), _height(0),
+  _pool(1)
+{
+  setSize(width, height);
+}
+
+gle::OcclusionBuffer::~OcclusionBuffer()
+{
+}
+
+void gle::OcclusionBuffer::setSize(GLuint width, GLuint height)
+{
+  _width = std::max((width + TileWidth - 1) / TileWidth, 1u) * TileWidth;
+  _height = std::max((height + TileHeight - 1) / TileHeight, 1u) * TileHeight;
+  _depths.assign(_width * _height, std::numeric_limits<GLfloat>::infinity());
+  _tilesDepths.assign((_width / TileWidth) * (_height / TileHeight),
+		      std::numeric_limits<GLfloat>::infinity());
+  _triangles.clear();
+}
+
+GLuint gle::OcclusionBuffer::getWidth() const
+{
+  return (_width);
+}
+
+GLuint gle::OcclusionBuffer::getHeight() const
+{
+  return (_height);
+}
+
+void gle::OcclusionBuffer::setNumberOfThreads(unsigned int nbThreads)
+{
+  _pool.setNumberOfThreads(std::min(nbThreads,
+				    (unsigned int)Octree::maximumNumberOfThreads));
+}
+
+void gle::OcclusionBuffer::clear(const Matrix4<GLfloat>& projection,
+				 const Matrix4<GLfloat>& modelview)
+{
+  _matrix = projection * modelview;
+  _triangles.clear();
+  std::fill(_depths.begin(), _depths.end(), std::numeric_limits<GLfloat>::infinity());
+  std::fill(_tilesDepths.begin(), _tilesDepths.end(),
+	    std::numeric_limits<GLfloat>::infinity());
+}
+
+void gle::OcclusionBuffer::addOccluder(const Matrix4<GLfloat>& transformation,
+				       const GLfloat* vertexes, GLuint nbVertexes,
+				       const GLuint* indexes, GLuint nbIndexes)
+{
+  Matrix4<GLfloat> matrix = _matrix * transformation;
+
+  if (nbVertexes == 0)
+    return;
+  _vertexes.resize(nbVertexes * 4);
+  for (GLuint i = 0; i < nbVertexes; ++i)
+    project(matrix, vertexes[i * 3], vertexes[i * 3 + 1], vertexes[i * 3 + 2],
+	    &_vertexes[i * 4]);
+  for (GLuint i = 0; i + 2 < nbIndexes; i += 3)
+    {
+      Triangle	triangle;
+      bool	projected = true;
+
+      for (GLuint j = 0; j < 3 && projected; ++j)
+	{
+	  const GLfloat* clip = &_vertexes[std::min(indexes[i + j], nbVertexes - 1) * 4];
+
+	  // Clipping would only add pixels: the triangle is not rasterized
+	  if (indexes[i + j] >= nbVertexes || isBehindNear(clip))
+	    projected = false;
+	  else
+	    {
+	      triangle.x[j] = (clip[0] / clip[3] * 0.5 + 0.5) * _width;
+	      triangle.y[j] = (clip[1] / clip[3] * 0.5 + 0.5) * _height;
+	      triangle.z[j] = clip[2] / clip[3];
+	    }
+	}
+      if (!projected)
+	continue;
+
+      // The rows whose centers are in the box of the triangle
+      GLfloat minY = std::min(std::min(triangle.y[0], triangle.y[1]), triangle.y[2]);
+      GLfloat maxY = std::max(std::max(triangle.y[0], triangle.y[1]), triangle.y[2]);
+      GLfloat minX = std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2]);
+      GLfloat maxX = std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2]);
+
+      triangle.minY = std::max((GLint)ceil(minY - 0.5), 0);
+      triangle.maxY = std::min((GLint)floor(maxY - 0.5), (GLint)_height - 1);
+      if (triangle.minY <= triangle.maxY && maxX >= 0 && minX <= _width)
+	_triangles.push_back(triangle);
+    }
+}
+
+void gle::OcclusionBuffer::rasterize()
+{
+  _pool.run(std::bind(&gle::OcclusionBuffer::_rasterizeBand, this,
+		      std::placeholders::_1), _height / TileHeight);
+}
+
+GLuint gle::OcclusionBuffer::getNbTriangles() const
+{
+  return (_triangles.size());
+}
+
+void gle::OcclusionBuffer::_rasterizeBand(GLuint band)
+{
+  GLint first = band * TileHeight;
+  GLint last = first + TileHeight - 1;
+
+  for (const Triangle& triangle : _triangles)
+    if (triangle.minY <= last && triangle.maxY >= first)
+      _rasterizeTriangle(triangle, std::max(triangle.minY, first),
+			 std::min(triangle.maxY, last));
+
+  // Farthest depth of each tile of the band
+  for (GLuint tile = 0; tile < _width / TileWidth; ++tile)
+    {
+      GLfloat depth = -std::numeric_limits<GLfloat>::infinity();
+
+      for (GLint y = first; y <= last; ++y)
+	for (GLuint x = tile * TileWidth; x < (tile + 1) * TileWidth; ++x)
+	  depth = std::max(depth, _depths[y * _width + x]);
+      _tilesDepths[band * (_width / TileWidth) + tile] = depth;
+    }
+}
+
+void gle::OcclusionBuffer::_rasterizeTriangle(const Triangle& triangle,
+					      GLint minY, GLint maxY)
+{
+  GLfloat	a[3];
+  GLfloat	b[3];
+  GLfloat	c[3];
+
+  // Edge functions a * x + b * y + c, opposite to each vertex
+  for (GLuint i = 0; i < 3; ++i)
+    {
+      GLuint	j = (i + 1) % 3;
+      GLuint	k = (i + 2) % 3;
+
+      a[i] = triangle.y[j] - triangle.y[k];
+      b[i] = triangle.x[k] - triangle.x[j];
+      c[i] = -(a[i] * triangle.x[j] + b[i] * triangle.y[j]);
+    }
+
+  GLfloat area = a[0] * triangle.x[0] + b[0] * triangle.y[0] + c[0];
+
+  if (area == 0)
+    return;
+  // Both faces are rasterized: the functions are positive inside
+  if (area < 0)
+    for (GLuint i = 0; i < 3; ++i)
+      {
+	a[i] = -a[i];
+	b[i] = -b[i];
+	c[i] = -c[i];
+      }
+  area = fabs(area);
+
+  // Plane of the depths, raised to its farthest value on a pixel
+  GLfloat zA = (a[0] * triangle.z[0] + a[1] * triangle.z[1] + a[2] * triangle.z[2]) / area;
+  GLfloat zB = (b[0] * triangle.z[0] + b[1] * triangle.z[1] + b[2] * triangle.z[2]) / area;
+  GLfloat zC = (c[0] * triangle.z[0] + c[1] * triangle.z[1] + c[2] * triangle.z[2]) / area
+    + (fabs(zA) + fabs(zB)) / 2;
+  GLfloat maxZ = std::max(std::max(triangle.z[0], triangle.z[1]), triangle.z[2]);
+
+  GLfloat minX = std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2]);
+  GLfloat maxX = std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2]);
+  GLint	  firstX = std::max((GLint)ceil(minX - 0.5), 0);
+  GLint	  lastX = std::min((GLint)floor(maxX - 0.5), (GLint)_width - 1);
+
+  if (firstX > lastX)
+    return;
+  // The pixels out of the box of the triangle are outside an edge, so the
+  // rows start on a multiple of four
+  firstX &= ~3;
+
+#ifdef __SSE__
+  __m128	zero = _mm_setzero_ps();
+  __m128	offsets = _mm_set_ps(3.5, 2.5, 1.5, 0.5);
+  __m128	farthest = _mm_set1_ps(maxZ);
+
+  for (GLint y = minY; y <= maxY; ++y)
+    {
+      GLfloat	centerY = y + 0.5;
+      GLfloat*	row = &_depths[y * _width];
+      __m128	rowC[3];
+      __m128	rowZ = _mm_set1_ps(zB * centerY + zC);
+
+      for (GLuint i = 0; i < 3; ++i)
+	rowC[i] = _mm_set1_ps(b[i] * centerY + c[i]);
+      for (GLint x = firstX; x <= lastX; x += 4)
+	{
+	  __m128 centerX = _mm_add_ps(_mm_set1_ps(x), offsets);
+	  __m128 inside =
+	    _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), centerX),
+							   rowC[0]), zero),
+				  _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), centerX),
+							   rowC[1]), zero)),
+		       _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), centerX),
+						rowC[2]), zero));
+
+	  if (_mm_movemask_ps(inside) == 0)
+	    continue;
+
+	  __m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), centerX), rowZ),
+				    farthest);
+	  __m128 previous = _mm_loadu_ps(row + x);
+
+	  depth = _mm_min_ps(previous, depth);
+	  _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, depth),
+					   _mm_andnot_ps(inside, previous)));
+	}
+    }
+#else
+  for (GLint y = minY; y <= maxY; ++y)
+    {
+      GLfloat	centerY = y + 0.5;
+      GLfloat*	row = &_depths[y * _width];
+
+      for (GLint x = firstX; x <= lastX; ++x)
+	{
+	  GLfloat centerX = x + 0.5;
+
+	  if (a[0] * centerX + b[0] * centerY + c[0] >= 0
+	      && a[1] * centerX + b[1] * centerY + c[1] >= 0
+	      && a[2] * centerX + b[2] * centerY + c[2] >= 0)
+	    row[x] = std::min(row[x], std::min(zA * centerX + zB * centerY + zC, maxZ));
+	}
+    }
+#endif
+}
+
+bool gle::OcclusionBuffer::isVisible(const Vector3<GLfloat>& min,
+				     const Vector3<GLfloat>& max) const
+{
+  GLfloat minX = std::numeric_limits<GLfloat>::infinity();
+  GLfloat minY = minX;
+  GLfloat minZ = minX;
+  GLfloat maxX = -minX;
+  GLfloat maxY = -minX;
+
+  for (GLuint corner = 0; corner < 8; ++corner)
+    {
+      GLfloat clip[4];
+
+      project(_matrix, corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y,
+	      corner & 4 ? max.z : min.z, clip);
+      if (isBehindNear(clip))
+	return (true);
+
+      GLfloat x = (clip[0] / clip[3] * 0.5 + 0.5) * _width;
+      GLfloat y = (clip[1] / clip[3] * 0.5 + 0.5) * _height;
+
+      minX = std::min(minX, x);
+      maxX = std::max(maxX, x);
+      minY = std::min(minY, y);
+      maxY = std::max(maxY, y);
+      minZ = std::min(minZ, clip[2] / clip[3]);
+    }
+
+  // All the pixels touched by the box
+  GLint firstX = std::max((GLint)floor(minX), 0);
+  GLint lastX = std::min((GLint)floor(maxX), (GLint)_width - 1);
+  GLint firstY = std::max((GLint)floor(minY), 0);
+  GLint lastY = std::min((GLint)floor(maxY), (GLint)_height - 1);
+  GLuint nbTiles = _width / TileWidth;
+
+  if (firstX > lastX || firstY > lastY)
+    return (false);
+  for (GLint tileY = firstY / TileHeight; tileY <= lastY / (GLint)TileHeight; ++tileY)
+    for (GLint tileX = firstX / TileWidth; tileX <= lastX / (GLint)TileWidth; ++tileX)
+      {
+	// The whole tile is in front of the box
+	if (_tilesDepths[tileY * nbTiles + tileX] < minZ)
+	  continue;
+
+	GLint lastTileY = std::min(lastY, (GLint)((tileY + 1) * TileHeight - 1));
+	GLint lastTileX = std::min(lastX, (GLint)((tileX + 1) * TileWidth - 1));
+
+	for (GLint y = std::max(firstY, (GLint)(tileY * TileHeight)); y <= lastTileY; ++y)
+	  for (GLint x = std::max(firstX, (GLint)(tileX * TileWidth)); x <= lastTileX; ++x)
+	    if (_depths[y * _width + x] >= minZ)
+	      return (true);
+      }
+  return (false);
+}
+
+const std::vector<GLfloat>& gle::OcclusionBuffer::getDepths() const
+{
+  return (_depths);
+}
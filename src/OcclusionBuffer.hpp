@@ -0,0 +1,142 @@
+//
+// OcclusionBuffer.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 09:53:22 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_OCCLUSION_BUFFER_HPP_
+# define _GLE_OCCLUSION_BUFFER_HPP_
+
+# include <vector>
+# include <gle/opengl.h>
+# include <Vector3.hpp>
+# include <Matrix4.hpp>
+# include <WorkerPool.hpp>
+
+namespace gle {
+
+  //! Low resolution depth buffer rasterized on the CPU, to cull hidden meshes
+  /*!
+    The triangles of the occluders are rasterized with SSE, four pixels at
+    a time, in the style of masked software occlusion culling: the screen
+    is split in bands of TileHeight rows, each rasterized by a task of the
+    worker pool, so no two tasks write the same pixels.
+
+    Each pixel keeps the nearest depth (z / w) of the occluders covering
+    its center, raised to the farthest depth of their plane on the pixel,
+    and each tile of TileWidth x TileHeight pixels the farthest depth of
+    its pixels. A box is hidden when its nearest depth is behind the depth
+    of all the pixels it covers: most boxes are decided on the tiles only.
+
+    The occluders must be inside the meshes they stand for, or the meshes
+    they partly hide may be culled. Triangles crossing the near plane are
+    not rasterized, and boxes crossing it are always visible.
+   */
+
+  class OcclusionBuffer {
+  public:
+
+    //! Width of a tile, in pixels
+    static const GLuint TileWidth = 8;
+
+    //! Height of a tile, and of a band rasterized by a task, in pixels
+    static const GLuint TileHeight = 8;
+
+    //! Create a buffer
+    /*!
+      \param width Width of the buffer, rounded up to TileWidth
+      \param height Height of the buffer, rounded up to TileHeight
+     */
+    OcclusionBuffer(GLuint width = 256, GLuint height = 128);
+
+    //! Destroy the buffer
+    ~OcclusionBuffer();
+
+    //! Set the size of the buffer
+    /*!
+      \param width Width of the buffer, rounded up to TileWidth
+      \param height Height of the buffer, rounded up to TileHeight
+     */
+    void setSize(GLuint width, GLuint height);
+
+    //! Returns the width of the buffer
+    GLuint getWidth() const;
+
+    //! Returns the height of the buffer
+    GLuint getHeight() const;
+
+    //! Set the number of threads rasterizing the occluders (1 by default)
+    void setNumberOfThreads(unsigned int nbThreads);
+
+    //! Clear the buffer, and set the camera of the next occluders
+    /*!
+      \param projection Projection matrix of the camera
+      \param modelview Modelview matrix of the camera
+     */
+    void clear(const Matrix4<GLfloat>& projection,
+	       const Matrix4<GLfloat>& modelview);
+
+    //! Add the triangles of an occluder
+    /*!
+      The triangles are projected, and rasterized by the next rasterize().
+      \param transformation Transformation matrix of the occluder
+      \param vertexes Positions of the vertexes, three floats each
+      \param nbVertexes Number of vertexes
+      \param indexes Indexes of the vertexes of the triangles
+      \param nbIndexes Number of indexes, three per triangle
+     */
+    void addOccluder(const Matrix4<GLfloat>& transformation,
+		     const GLfloat* vertexes, GLuint nbVertexes,
+		     const GLuint* indexes, GLuint nbIndexes);
+
+    //! Rasterize the occluders added since clear()
+    void rasterize();
+
+    //! Returns the number of triangles added since clear()
+    GLuint getNbTriangles() const;
+
+    //! Returns whether a box may be visible
+    /*!
+      \param min Lowest world corner of the box
+      \param max Highest world corner of the box
+      \return false if the box is behind the occluders on all its pixels
+     */
+    bool isVisible(const Vector3<GLfloat>& min, const Vector3<GLfloat>& max) const;
+
+    //! Returns the depths of the pixels, row after row from the bottom
+    /*!
+      The pixels no occluder covers are infinitely far.
+     */
+    const std::vector<GLfloat>& getDepths() const;
+
+  private:
+    // Triangle in pixel coordinates, with its depths and its rows
+    struct Triangle {
+      GLfloat	x[3];
+      GLfloat	y[3];
+      GLfloat	z[3];
+      GLint	minY;
+      GLint	maxY;
+    };
+
+    void	_rasterizeBand(GLuint band);
+    void	_rasterizeTriangle(const Triangle& triangle, GLint minY, GLint maxY);
+
+    GLuint			_width;
+    GLuint			_height;
+    Matrix4<GLfloat>		_matrix;
+    std::vector<Triangle>	_triangles;
+    std::vector<GLfloat>	_depths;
+    std::vector<GLfloat>	_tilesDepths;
+    WorkerPool			_pool;
+
+    // Projected vertexes of the current occluder: x, y, z, w
+    std::vector<GLfloat>	_vertexes;
+  };
+}
+
+#endif /* _GLE_OCCLUSION_BUFFER_HPP_ */
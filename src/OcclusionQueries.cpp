@@ -0,0 +1,262 @@
+//
+// OcclusionQueries.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 09:59:45 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <cmath>
+#include <algorithm>
+#include <OcclusionQueries.hpp>
+#include <BoundsArray.hpp>
+#include <Mesh.hpp>
+
+gle::OcclusionQueries::OcclusionQueries() :
+  _visibleInterval(4), _frame(0), _nodes(), _leaves(), _frustum(NULL),
+  _queries(), _pendingQueries(), _freeIds()
+{
+}
+
+gle::OcclusionQueries::~OcclusionQueries()
+{
+  clear();
+  if (!_freeIds.empty())
+    glDeleteQueries(_freeIds.size(), &_freeIds[0]);
+}
+
+void gle::OcclusionQueries::setVisibleInterval(GLuint frames)
+{
+  _visibleInterval = std::max(frames, 1u);
+}
+
+GLuint gle::OcclusionQueries::getVisibleInterval() const
+{
+  return (_visibleInterval);
+}
+
+void gle::OcclusionQueries::clear()
+{
+  // The results of the pending queries are never read: their objects
+  // can be reused once the GPU is done with them
+  for (const Query& query : _pendingQueries)
+    _freeIds.push_back(query.id);
+  for (const Query& query : _queries)
+    _freeIds.push_back(query.id);
+  _pendingQueries.clear();
+  _queries.clear();
+  _nodes.clear();
+}
+
+void gle::OcclusionQueries::cull(const gle::Octree& tree, const GLfloat frustum[6][4],
+				 const std::list<gle::Mesh*>& meshes,
+				 std::list<gle::Mesh*>& visible)
+{
+  const std::vector<gle::Octree::Node>& nodes = tree.getNodes();
+  Node		newNode = {0, true, false, 0, 0, 0, 0, 0};
+
+  // The indexes of the nodes released by the updates of the tree are
+  // reused: the results of the queries on the released nodes, all
+  // prepared before this frame, are ignored
+  _nodes.resize(nodes.size(), newNode);
+  for (GLuint node = 0; node < nodes.size(); ++node)
+    if (_nodes[node].generation != nodes[node].generation)
+      {
+	_nodes[node] = newNode;
+	_nodes[node].generation = nodes[node].generation;
+	_nodes[node].enterFrame = _frame + 1;
+      }
+  _readResults();
+  ++_frame;
+  _frustum = frustum;
+
+  // The meshes of a leaf follow each other in the order of the tree
+  _leaves.clear();
+  visible.clear();
+  GLuint	leaf = gle::Octree::NoIndex;
+  bool		leafVisible = true;
+  for (gle::Mesh* mesh : meshes)
+    {
+      GLuint meshLeaf = tree.getLeaf(mesh);
+
+      if (meshLeaf == gle::Octree::NoIndex)
+	{
+	  visible.push_back(mesh);
+	  continue ;
+	}
+      if (meshLeaf != leaf)
+	{
+	  leaf = meshLeaf;
+	  if (_nodes[leaf].frame != _frame)
+	    {
+	      // A leaf entering the frustum is drawn until it is queried:
+	      // its visibility from an older frame is not trusted
+	      if (_nodes[leaf].frame + 1 != _frame)
+		{
+		  _nodes[leaf].visible = true;
+		  _nodes[leaf].enterFrame = _frame;
+		}
+	      _nodes[leaf].frame = _frame;
+	      _leaves.push_back(leaf);
+	    }
+	  leafVisible = _nodes[leaf].visible;
+	}
+      if (leafVisible)
+	visible.push_back(mesh);
+    }
+
+  // The ancestors of the visible leaves are visible: the hidden leaves
+  // are grouped below them
+  for (GLuint leaf : _leaves)
+    if (_nodes[leaf].visible)
+      for (GLuint node = leaf;
+	   node != gle::Octree::NoIndex && _nodes[node].visibleFrame != _frame;
+	   node = nodes[node].parent)
+	_nodes[node].visibleFrame = _frame;
+
+  _queries.clear();
+  for (GLuint leaf : _leaves)
+    {
+      Node&	state = _nodes[leaf];
+
+      if (state.pending)
+	continue ;
+      if (state.visible)
+	{
+	  if ((_frame + leaf) % _visibleInterval == 0)
+	    _addQuery(tree, leaf, leaf);
+	  continue ;
+	}
+      GLuint			node = leaf;
+      gle::Vector3<GLfloat>	min;
+      gle::Vector3<GLfloat>	max;
+
+      while (nodes[node].parent != gle::Octree::NoIndex
+	     && _nodes[nodes[node].parent].visibleFrame != _frame
+	     && _getBox(tree, nodes[node].parent, min, max))
+	node = nodes[node].parent;
+      _addQuery(tree, node, leaf);
+    }
+}
+
+const std::vector<gle::OcclusionQueries::Query>& gle::OcclusionQueries::getQueries() const
+{
+  return (_queries);
+}
+
+void gle::OcclusionQueries::setQueriesIssued(bool issued)
+{
+  for (Query& query : _queries)
+    {
+      if (!issued)
+	{
+	  _freeIds.push_back(query.id);
+	  continue ;
+	}
+      for (GLuint leaf : query.leaves)
+	_nodes[leaf].pending = true;
+      _pendingQueries.push_back(Query());
+      std::swap(_pendingQueries.back(), query);
+    }
+  _queries.clear();
+}
+
+GLuint gle::OcclusionQueries::getNbPendingQueries() const
+{
+  return (_pendingQueries.size());
+}
+
+void gle::OcclusionQueries::_readResults()
+{
+  GLuint	nbPending = 0;
+
+  for (GLuint i = 0; i < _pendingQueries.size(); ++i)
+    {
+      Query&	query = _pendingQueries[i];
+      GLuint	available = GL_FALSE;
+      GLuint	samples = 0;
+
+      glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+	{
+	  if (i != nbPending)
+	    std::swap(_pendingQueries[nbPending], query);
+	  ++nbPending;
+	  continue ;
+	}
+      glGetQueryObjectuiv(query.id, GL_QUERY_RESULT, &samples);
+      // The leaves which left the frustum since the query keep their
+      // visibility
+      for (GLuint leaf : query.leaves)
+	if (query.frame >= _nodes[leaf].enterFrame)
+	  {
+	    _nodes[leaf].visible = samples != 0;
+	    _nodes[leaf].pending = false;
+	  }
+      _freeIds.push_back(query.id);
+    }
+  _pendingQueries.resize(nbPending);
+}
+
+void gle::OcclusionQueries::_addQuery(const gle::Octree& tree, GLuint node, GLuint leaf)
+{
+  Node&	state = _nodes[node];
+
+  // The hidden leaves grouped under the same ancestor share its query
+  if (state.queryFrame == _frame)
+    {
+      _queries[state.query].leaves.push_back(leaf);
+      return ;
+    }
+
+  gle::Vector3<GLfloat>	min;
+  gle::Vector3<GLfloat>	max;
+
+  if (!_getBox(tree, node, min, max))
+    {
+      _nodes[leaf].visible = true;
+      return ;
+    }
+  state.queryFrame = _frame;
+  state.query = _queries.size();
+  _queries.push_back(Query());
+  _queries.back().id = _getQueryId();
+  _queries.back().frame = _frame;
+  _queries.back().min = min;
+  _queries.back().max = max;
+  _queries.back().leaves.push_back(leaf);
+}
+
+bool gle::OcclusionQueries::_getBox(const gle::Octree& tree, GLuint node,
+				    gle::Vector3<GLfloat>& min,
+				    gle::Vector3<GLfloat>& max) const
+{
+  // The box is grown so the faces of the meshes on its sides do not hide
+  // it, and the boxes the near plane clips are not queried
+  const gle::Octree::Node&	treeNode = tree.getNodes()[node];
+  gle::Vector3<GLfloat>		size = treeNode.max - treeNode.min;
+  GLfloat			margin = sqrt(size * size) * 0.01f + 0.001f;
+  GLuint			planeMask = 1 << 5;
+
+  min = treeNode.min;
+  min -= margin;
+  max = treeNode.max;
+  max += margin;
+  return (gle::BoundsArray::testBox(_frustum, planeMask, min, max) && !planeMask);
+}
+
+GLuint gle::OcclusionQueries::_getQueryId()
+{
+  GLuint	id;
+
+  if (_freeIds.empty())
+    {
+      glGenQueries(1, &id);
+      return (id);
+    }
+  id = _freeIds.back();
+  _freeIds.pop_back();
+  return (id);
+}
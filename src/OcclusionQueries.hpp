@@ -0,0 +1,145 @@
+//
+// OcclusionQueries.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 09:59:45 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_OCCLUSION_QUERIES_HPP_
+# define _GLE_OCCLUSION_QUERIES_HPP_
+
+# include <vector>
+# include <list>
+# include <gle/opengl.h>
+# include <Vector3.hpp>
+# include <Octree.hpp>
+
+namespace gle {
+
+  class Mesh;
+
+  //! Hardware occlusion queries on the leaves of an octree
+  /*!
+    The visibility of the leaves is kept from frame to frame, in the style
+    of coherent hierarchical culling (CHC): the meshes of the leaves found
+    hidden are not rendered, and the boxes of the leaves are drawn in
+    occlusion queries after the scene, against its depth buffer.
+
+    The results are read a frame later, and only once they are available,
+    so the CPU never waits for the GPU: a leaf keeps its visibility until
+    the result of its query arrives. A leaf becoming visible is thus
+    rendered one frame late. A leaf entering the frustum is visible until
+    its first query, whatever it was when it left.
+
+    The visible leaves are queried again every getVisibleInterval()
+    frames, each at its own frame. The hidden leaves are queried every
+    frame, grouped in the box of their highest ancestor containing no
+    visible leaf in the frustum, so large hidden regions take a single
+    query.
+
+    The boxes crossing the near plane are always visible, and never
+    queried. The state of a node is reset when the tree allocates its
+    index again (see Octree::Node::generation), and the results of the
+    queries on the released node are ignored.
+   */
+
+  class OcclusionQueries {
+  public:
+
+    //! Query of the box of a node
+    struct Query {
+      //! Query object
+      GLuint			id;
+
+      //! Lowest corner of the box, slightly grown around the node
+      Vector3<GLfloat>		min;
+
+      //! Highest corner of the box
+      Vector3<GLfloat>		max;
+
+      //! Leaves in the frustum whose visibility the query decides
+      std::vector<GLuint>	leaves;
+
+      //! Frame of the cull() preparing the query
+      GLuint			frame;
+    };
+
+    //! Create the queries
+    OcclusionQueries();
+
+    //! Destroy the queries and their query objects
+    ~OcclusionQueries();
+
+    //! Set the number of frames between two queries of a visible leaf
+    /*!
+      \param frames Number of frames, 4 by default
+     */
+    void setVisibleInterval(GLuint frames);
+
+    //! Returns the number of frames between two queries of a visible leaf
+    GLuint getVisibleInterval() const;
+
+    //! Forget the visibility of the leaves, when the tree is generated again
+    void clear();
+
+    //! Remove the meshes of the hidden leaves, and prepare the new queries
+    /*!
+      The results of the previous queries available are read first.
+      \param tree Tree containing the static meshes
+      \param frustum Planes of the frustum of the camera
+      \param meshes Meshes in the frustum, in the order of the tree
+      \param visible Filled with the meshes of the visible leaves, and
+      the meshes not in the tree
+     */
+    void cull(const Octree& tree, const GLfloat frustum[6][4],
+	      const std::list<Mesh*>& meshes, std::list<Mesh*>& visible);
+
+    //! Returns the queries to issue after the scene is rendered
+    const std::vector<Query>& getQueries() const;
+
+    //! Tell whether the queries of getQueries() were issued
+    /*!
+      Their results are read by the next cull() when they were, and they
+      are dropped otherwise.
+     */
+    void setQueriesIssued(bool issued);
+
+    //! Returns the number of queries whose results are not read yet
+    GLuint getNbPendingQueries() const;
+
+  private:
+    // Visibility of a node, and frames of its last uses: frame is the
+    // last frame its leaf was in the frustum, and enterFrame the frame it
+    // entered it. generation is the one of the node of the tree
+    struct Node {
+      GLuint	generation;
+      bool	visible;
+      bool	pending;
+      GLuint	frame;
+      GLuint	enterFrame;
+      GLuint	visibleFrame;
+      GLuint	queryFrame;
+      GLuint	query;
+    };
+
+    void	_readResults();
+    void	_addQuery(const Octree& tree, GLuint node, GLuint leaf);
+    bool	_getBox(const Octree& tree, GLuint node,
+			Vector3<GLfloat>& min, Vector3<GLfloat>& max) const;
+    GLuint	_getQueryId();
+
+    GLuint			_visibleInterval;
+    GLuint			_frame;
+    std::vector<Node>		_nodes;
+    std::vector<GLuint>		_leaves;
+    const GLfloat		(*_frustum)[4];
+    std::vector<Query>		_queries;
+    std::vector<Query>		_pendingQueries;
+    std::vector<GLuint>		_freeIds;
+  };
+}
+
+#endif /* _GLE_OCCLUSION_QUERIES_HPP_ */
@@ -8,396 +8,1165 @@
 // Last update Thu Jul 12 00:05:13 2012 loick michard
 //
 
+#include <cmath>
+#include <algorithm>
+#include <limits>
 #include <Octree.hpp>
 #include <Mesh.hpp>
 #include <Scene.hpp>
 #include <Geometries.hpp>
 
-gle::Octree::Node::Node(const Vector3<GLfloat>& min,
-			const Vector3<GLfloat>& max,
-			const std::list<Element*> &elements,
-			const std::list<Element*> &partialsElements) :
-  _elements(elements), _partialsElements(partialsElements),
-  _debugMaterial(NULL), _debugMesh(NULL), _leaf(true)
+// Below this number of elements, a subtree is tested without its nodes
+#define GLE_OCTREE_SMALL_SUBTREE 32
+
+// Nodes with this number of elements or less are merged in a leaf
+#define GLE_OCTREE_MERGE_SIZE (gle::Octree::maximumLeafSize / 2)
+
+// Number of elements of each task building the tree
+#define GLE_OCTREE_ELEMENTS_PER_TASK 4096
+
+// Subtrees with this number of elements or less are culled by one task
+#define GLE_OCTREE_ELEMENTS_PER_CULL_TASK 2048
+
+// Bits of the Morton codes sorted by each pass of the radix sort
+#define GLE_OCTREE_RADIX_BITS 10
+
+namespace {
+  // Insert two zero bits between each of the 10 low bits of a value
+  GLuint spreadBits(GLuint value)
+  {
+    value &= 0x3FF;
+    value = (value | (value << 16)) & 0x030000FF;
+    value = (value | (value << 8)) & 0x0300F00F;
+    value = (value | (value << 4)) & 0x030C30C3;
+    value = (value | (value << 2)) & 0x09249249;
+    return (value);
+  }
+
+  // Quantize a coordinate on the grid of the Morton codes
+  GLuint quantize(GLfloat value, GLfloat origin, GLfloat scale)
+  {
+    GLfloat position = (value - origin) * scale;
+
+    if (position <= 0)
+      return (0);
+    return (std::min((GLuint)position, (GLuint)(1 << gle::Octree::maximumDepth) - 1));
+  }
+
+  // Returns every third bit of a value, from the lowest one
+  GLuint compactBits(GLuint value)
+  {
+    value &= 0x09249249;
+    value = (value | (value >> 2)) & 0x030C30C3;
+    value = (value | (value >> 4)) & 0x0300F00F;
+    value = (value | (value >> 8)) & 0x030000FF;
+    value = (value | (value >> 16)) & 0x3FF;
+    return (value);
+  }
+
+  // Empty bounds, which become any bounds they are extended with
+  void clearBounds(gle::Vector3<GLfloat>& min, gle::Vector3<GLfloat>& max)
+  {
+    GLfloat infinity = std::numeric_limits<GLfloat>::infinity();
+
+    min = gle::Vector3<GLfloat>(infinity, infinity, infinity);
+    max = gle::Vector3<GLfloat>(-infinity, -infinity, -infinity);
+  }
+
+  bool equalPoints(const gle::Vector3<GLfloat>& point,
+		   const gle::Vector3<GLfloat>& other)
+  {
+    return (point.x == other.x && point.y == other.y && point.z == other.z);
+  }
+
+  bool containsBounds(const gle::Vector3<GLfloat>& min, const gle::Vector3<GLfloat>& max,
+		      const gle::Vector3<GLfloat>& otherMin,
+		      const gle::Vector3<GLfloat>& otherMax)
+  {
+    return (otherMin.x >= min.x && otherMin.y >= min.y && otherMin.z >= min.z
+	    && otherMax.x <= max.x && otherMax.y <= max.y && otherMax.z <= max.z);
+  }
+
+  void extendBounds(gle::Vector3<GLfloat>& min, gle::Vector3<GLfloat>& max,
+		    const gle::Vector3<GLfloat>& otherMin,
+		    const gle::Vector3<GLfloat>& otherMax)
+  {
+    min.x = std::min(min.x, otherMin.x);
+    min.y = std::min(min.y, otherMin.y);
+    min.z = std::min(min.z, otherMin.z);
+    max.x = std::max(max.x, otherMax.x);
+    max.y = std::max(max.y, otherMax.y);
+    max.z = std::max(max.z, otherMax.z);
+  }
+}
+
+gle::Octree::Octree() :
+  _pool(1),
+  _nbViews(0), _queryDetail(NULL), _debugMaterial(NULL), _looseness(0.5),
+  _nbAllocatedNodes(0), _stamp(0),
+  _version(0), _queryVersion(0), _queryNbViews(0), _nbCullTasks(0)
 {
-  for (int i = 0; i < 8; ++i)
-    _children[i] = NULL;
-  _min = min;
-  _max = max;
 }
 
-gle::Octree::Node::~Node()
+gle::Octree::~Octree()
 {
-  delete _debugMesh;
+  _clearDebugNodes();
   delete _debugMaterial;
 }
 
-gle::Mesh* gle::Octree::Node::getDebugMesh()
+void gle::Octree::setNumberOfThreads(unsigned int nbThreads)
 {
-  if (!_debugMaterial)
+  _pool.setNumberOfThreads(std::min(nbThreads, (unsigned int)maximumNumberOfThreads));
+}
+
+void gle::Octree::setLooseness(GLfloat looseness)
+{
+  _looseness = std::max(looseness, 0.0f);
+}
+
+GLfloat gle::Octree::getLooseness() const
+{
+  return (_looseness);
+}
+
+void gle::Octree::generateTree(std::list<Element*> &elements)
+{
+  GLuint	nbElements = elements.size();
+  GLuint	nbTasks = (nbElements + GLE_OCTREE_ELEMENTS_PER_TASK - 1)
+    / GLE_OCTREE_ELEMENTS_PER_TASK;
+  Vector3<GLfloat> min, max;
+  GLuint	i = 0;
+
+  _clearDebugNodes();
+  ++_version;
+  _nodes.clear();
+  _freeNodes.clear();
+  _elements.clear();
+  _slots.clear();
+  _bounds.clear();
+  _bucketsNodes.clear();
+  _bucketsNext.clear();
+  _freeBuckets.clear();
+  _elementsSlots.clear();
+  _stamps.clear();
+  _unsortedElements.assign(elements.begin(), elements.end());
+  _mins.resize(nbElements);
+  _maxs.resize(nbElements);
+  _centers.resize(nbElements);
+  _radiuses.resize(nbElements);
+  _drawDistances.resize(nbElements);
+  // The elements may update their matrix, so they are only read here
+  for (Element* element : _unsortedElements)
     {
-      _debugMaterial = new Material();
-      _debugMaterial->setAmbientColor(gle::Color<GLfloat>(0, 1.0, 0));
+      _mins[i] = element->getMinPoint();
+      _maxs[i] = element->getMaxPoint();
+      _centers[i] = element->getCenter();
+      _radiuses[i] = element->getRadius();
+      _drawDistances[i] = element->getDrawDistance();
+      if (i == 0)
+	min = max = _centers[i];
+      extendBounds(min, max, _centers[i], _centers[i]);
+      ++i;
     }
-  if (!_debugMesh)
+  if (nbElements == 0)
+    return ;
+
+  // The grid of the codes covers the centers of the elements
+  _codesOrigin = min;
+  _codesScale.x = max.x > min.x ? (1 << maximumDepth) / (max.x - min.x) : 0;
+  _codesScale.y = max.y > min.y ? (1 << maximumDepth) / (max.y - min.y) : 0;
+  _codesScale.z = max.z > min.z ? (1 << maximumDepth) / (max.z - min.z) : 0;
+  _codes.resize(nbElements);
+  _indexes.resize(nbElements);
+  _pool.run(std::bind(&gle::Octree::_computeCodes, this, std::placeholders::_1),
+	    nbTasks);
+  _sortCodes(nbTasks);
+
+  _sortedSlots.resize(nbElements);
+  _buildNode(0, nbElements, 0, NoIndex, 0);
+  _elements.resize(_bucketsNodes.size() * BucketSize, NULL);
+  _slots.resize(_bucketsNodes.size() * BucketSize);
+  _stamps.resize(_bucketsNodes.size() * BucketSize, 0);
+  _bounds.resize(_bucketsNodes.size() * BucketSize);
+  _pool.run(std::bind(&gle::Octree::_storeElements, this, std::placeholders::_1),
+	    nbTasks);
+  _elementsSlots.reserve(nbElements);
+  for (i = 0; i < nbElements; ++i)
+    _elementsSlots[_unsortedElements[_indexes[i]]] = _sortedSlots[i];
+}
+
+GLuint gle::Octree::_getCode(const Vector3<GLfloat>& center) const
+{
+  return ((spreadBits(quantize(center.x, _codesOrigin.x, _codesScale.x)) << 2)
+	  | (spreadBits(quantize(center.y, _codesOrigin.y, _codesScale.y)) << 1)
+	  | spreadBits(quantize(center.z, _codesOrigin.z, _codesScale.z)));
+}
+
+void gle::Octree::_computeCodes(GLuint task)
+{
+  GLuint first = task * GLE_OCTREE_ELEMENTS_PER_TASK;
+  GLuint last = std::min(first + GLE_OCTREE_ELEMENTS_PER_TASK, (GLuint)_codes.size());
+
+  for (GLuint i = first; i < last; ++i)
     {
-      _debugMesh = gle::Geometries::Cuboid(_debugMaterial,
-					   (_max.x - _min.x > 0) ? _max.x - _min.x : _min.x - _max.x,
-					   (_max.y - _min.y > 0) ? _max.y - _min.y : _min.y - _max.y,
-					   (_max.z - _min.z > 0) ? _max.z - _min.z : _min.z - _max.z, true);
-      Vector3<GLfloat> _center = (_max + _min);
-      _center /= 2.0;
-      _debugMesh->setPosition(_center);
-      _debugMesh->setRasterizationMode(gle::Mesh::Line);
+      _codes[i] = _getCode(_centers[i]);
+      _indexes[i] = i;
     }
-  return (_debugMesh);
 }
 
-gle::Octree::Octree() : _root(NULL)
+void gle::Octree::_sortCodes(GLuint nbTasks)
 {
-  for (unsigned int i = 0; i < maximumNumberOfThreads; ++i)
-    _threadPool[i] = NULL;
+  const GLuint	nbBuckets = 1 << GLE_OCTREE_RADIX_BITS;
+  GLuint	nbElements = _codes.size();
+
+  _sortedCodes.resize(nbElements);
+  _sortedIndexes.resize(nbElements);
+  _histograms.resize(nbTasks * nbBuckets);
+  for (GLuint shift = 0; shift < 3 * maximumDepth; shift += GLE_OCTREE_RADIX_BITS)
+    {
+      // Count the digits of each task
+      _pool.run([&](GLuint task) {
+	  GLuint* histogram = &_histograms[task * nbBuckets];
+	  GLuint first = task * GLE_OCTREE_ELEMENTS_PER_TASK;
+	  GLuint last = std::min(first + GLE_OCTREE_ELEMENTS_PER_TASK, nbElements);
+
+	  std::fill(histogram, histogram + nbBuckets, 0);
+	  for (GLuint i = first; i < last; ++i)
+	    ++histogram[(_codes[i] >> shift) & (nbBuckets - 1)];
+	}, nbTasks);
+
+      // A task writes each digit after the same digit of the previous tasks,
+      // so the sort is stable
+      GLuint offset = 0;
+      for (GLuint digit = 0; digit < nbBuckets; ++digit)
+	for (GLuint task = 0; task < nbTasks; ++task)
+	  {
+	    GLuint count = _histograms[task * nbBuckets + digit];
+
+	    _histograms[task * nbBuckets + digit] = offset;
+	    offset += count;
+	  }
+
+      _pool.run([&](GLuint task) {
+	  GLuint* histogram = &_histograms[task * nbBuckets];
+	  GLuint first = task * GLE_OCTREE_ELEMENTS_PER_TASK;
+	  GLuint last = std::min(first + GLE_OCTREE_ELEMENTS_PER_TASK, nbElements);
+
+	  for (GLuint i = first; i < last; ++i)
+	    {
+	      GLuint position = histogram[(_codes[i] >> shift) & (nbBuckets - 1)]++;
+
+	      _sortedCodes[position] = _codes[i];
+	      _sortedIndexes[position] = _indexes[i];
+	    }
+	}, nbTasks);
+      _codes.swap(_sortedCodes);
+      _indexes.swap(_sortedIndexes);
+    }
 }
 
-gle::Octree::~Octree()
+void gle::Octree::_storeElements(GLuint task)
 {
+  GLuint first = task * GLE_OCTREE_ELEMENTS_PER_TASK;
+  GLuint last = std::min(first + GLE_OCTREE_ELEMENTS_PER_TASK, (GLuint)_codes.size());
+
+  for (GLuint i = first; i < last; ++i)
+    {
+      GLuint	index = _indexes[i];
+      GLuint	slot = _sortedSlots[i];
+      Slot&	data = _slots[slot];
 
+      _elements[slot] = _unsortedElements[index];
+      data.min = _mins[index];
+      data.max = _maxs[index];
+      data.center = _centers[index];
+      data.radius = _radiuses[index];
+      data.drawDistance = _drawDistances[index];
+      data.code = _codes[i];
+      if (data.radius < 0)
+	_bounds.setBox(slot, data.min, data.max);
+      else
+	_bounds.setSphere(slot, data.center, data.radius);
+      _bounds.setDrawDistance(slot, data.drawDistance);
+    }
 }
 
-void gle::Octree::threadNodeGeneration()
+GLuint gle::Octree::_buildNode(GLuint first, GLuint last, GLuint depth,
+			       GLuint parent, GLuint code)
 {
-  int	depth = -1;
-  Node*	node = NULL;
+  GLuint index = _allocateNode(parent, depth, code);
 
-  while (1)
+  _nodes[index].nbElements = last - first;
+  _nodes[index].firstBucket = _bucketsNodes.size();
+  if (last - first <= maximumLeafSize || depth == maximumDepth)
     {
-      _tasksQueueAccess.lock();
+      GLuint bucket = NoIndex;
 
-      depth = 0;
-      node = NULL;
-      if (_tasksQueue.size() > 0)
+      for (GLuint i = first; i < last; ++i)
 	{
-	  _threadIsComputing += 1;
-	  node = _tasksQueue.front().first;
-	  depth = _tasksQueue.front().second;
-	  _tasksQueue.pop();
-	  if (_tasksQueue.size() > 0)
-	    _listEmptyAccess.unlock();
-	  _tasksQueueAccess.unlock();
-	}
-      else
-	{
-	  _tasksQueueAccess.unlock();
-	  if (_hasFinished)
+	  // The slots of the buckets are allocated once all the nodes are built
+	  if ((i - first) % BucketSize == 0)
 	    {
-	      _listEmptyAccess.unlock();
-	      return;
+	      GLuint next = _bucketsNodes.size();
+
+	      _bucketsNodes.push_back(index);
+	      _bucketsNext.push_back((GLuint)NoIndex);
+	      if (bucket == NoIndex)
+		_nodes[index].bucket = next;
+	      else
+		_bucketsNext[bucket] = next;
+	      bucket = next;
 	    }
-	  _listEmptyAccess.lock();
-	  depth = -1;
+	  _sortedSlots[i] = bucket * BucketSize + (i - first) % BucketSize;
+	  extendBounds(_nodes[index].min, _nodes[index].max,
+		       _mins[_indexes[i]], _maxs[_indexes[i]]);
 	}
+      _nodes[index].lastBucket = _bucketsNodes.size();
+      return (index);
+    }
 
-      if (depth >= 0 && depth < maximumDepth)
-	{
-	  node->splitNode();
-	  int	nbChild = 0;
+  // The codes of a child share their first 3 * (depth + 1) bits
+  GLuint shift = 3 * (maximumDepth - depth - 1);
+  GLuint previous = NoIndex;
 
-	  _tasksQueueAccess.lock();
-	  for (int i = 0; i < 8; ++i)
-	    {
-	      if (node->_children[i])
-		{	
-		  ++nbChild;
-		  _tasksQueue.push({node->_children[i], depth + 1});
-		  _listEmptyAccess.unlock();
-		}
-	    }
-	  _tasksQueueAccess.unlock();
-	  if (nbChild == 0)
-	    {
-	      if (_threadIsComputing == 1)
-		{
-		  if (_listEmptyAccess.try_lock())
-		    _listEmptyAccess.unlock();
-		  else
-		    {
-		      _generateDone.unlock();
-		      _hasFinished = true;
-		      _listEmptyAccess.unlock();
-		      return;
-		    }
-		}
-	    }
-	}
-      if (depth >= 0)
-	_threadIsComputing -= 1;
+  for (GLuint begin = first; begin < last;)
+    {
+      GLuint end = std::lower_bound(_codes.begin() + begin, _codes.begin() + last,
+				    ((_codes[begin] >> shift) + 1) << shift)
+	- _codes.begin();
+      GLuint child = _buildNode(begin, end, depth + 1, index, _codes[begin] >> shift);
+
+      if (previous == NoIndex)
+	_nodes[index].firstChild = child;
+      else
+	_nodes[previous].nextSibling = child;
+      extendBounds(_nodes[index].min, _nodes[index].max,
+		   _nodes[child].min, _nodes[child].max);
+      previous = child;
+      begin = end;
     }
+  _nodes[index].lastBucket = _bucketsNodes.size();
+  return (index);
 }
 
-void gle::Octree::generateTree(std::list<Element*> &elements)
+void gle::Octree::updateTree(std::list<Element*> &elements)
 {
-  Vector3<GLfloat>	_min;
-  Vector3<GLfloat>	_max;
-  unsigned int		i = 0;
-
-  for (Element* &element : elements)
-    {
-      const gle::Vector3<GLfloat>& min = element->getMinPoint();
-      const gle::Vector3<GLfloat>& max = element->getMaxPoint();
-      if (i == 0 || min.x < _min.x)
-	_min.x = min.x;
-      if (i == 0 || min.y < _min.y)
-	_min.y = min.y;
-      if (i == 0 || min.z < _min.z)
-	_min.z = min.z;
-      if (i == 0 || max.x > _max.x)
-	_max.x = max.x;
-      if (i == 0 || max.y > _max.y)
-        _max.y = max.y;
-      if (i == 0 || max.z > _max.z)
-        _max.z = max.z;
-      ++i;
+  std::vector<Element*> removed;
+
+  if (_nodes.empty())
+    {
+      generateTree(elements);
+      return ;
+    }
+  if (++_stamp == 0)
+    {
+      std::fill(_stamps.begin(), _stamps.end(), 0);
+      _stamp = 1;
+    }
+  for (Element* element : elements)
+    _stamps[_update(element)] = _stamp;
+  // Removing elements may move others, so they are found first
+  for (GLuint slot = 0; slot < _elements.size(); ++slot)
+    if (_elements[slot] && _stamps[slot] != _stamp)
+      removed.push_back(_elements[slot]);
+  for (Element* element : removed)
+    remove(element);
+}
+
+bool gle::Octree::insert(Element* element)
+{
+  if (contains(element))
+    return (false);
+  _clearDebugNodes();
+  ++_version;
+  // Without generateTree(), all the elements have the same code
+  if (_nodes.empty())
+    {
+      _codesOrigin = element->getCenter();
+      _codesScale = Vector3<GLfloat>(0, 0, 0);
+      _allocateNode(NoIndex, 0, 0);
     }
-  _root = new Node(_min, _max, elements, {});
-  _tasksQueue.push({_root, 0});
-  _threadIsComputing = 0;
-  _tasksQueueAccess.unlock();
-  _listEmptyAccess.unlock();
-  _generateDone.lock();
-  _hasFinished = false;
+  _insert(0, element, _getSlot(element));
+  return (true);
+}
+
+void gle::Octree::update(Element* element)
+{
+  _update(element);
+}
 
-  for (i = 0; i < maximumNumberOfThreads; ++i)
-    _threadPool[i] = new std::thread(&gle::Octree::threadNodeGeneration, this);
+bool gle::Octree::remove(Element* element)
+{
+  auto it = _elementsSlots.find(element);
 
-  _generateDone.lock();
-  _generateDone.unlock();
+  if (it == _elementsSlots.end())
+    return (false);
+  _clearDebugNodes();
+  ++_version;
 
-  for (i = 0; i < maximumNumberOfThreads; ++i)
+  GLuint slot = it->second;
+  GLuint bucket = slot / BucketSize;
+  GLuint node = _bucketsNodes[bucket];
+  GLuint first = bucket * BucketSize;
+
+  _elementsSlots.erase(it);
+  _clearSlot(slot);
+  for (GLuint parent = node; parent != NoIndex; parent = _nodes[parent].parent)
+    --_nodes[parent].nbElements;
+
+  // Release the bucket if it is empty
+  if (std::find_if(_elements.begin() + first, _elements.begin() + first + BucketSize,
+		   [](Element* other) { return (other != NULL); })
+      == _elements.begin() + first + BucketSize)
     {
-      _threadPool[i]->join();
-      _threadPool[i] = NULL;
+      GLuint* link = &_nodes[node].bucket;
+
+      while (*link != bucket)
+	link = &_bucketsNext[*link];
+      *link = _bucketsNext[bucket];
+      _freeBuckets.push_back(bucket);
+      _clearBucketsRange(node);
     }
+
+  // Release the nodes left empty, but the root
+  while (node != 0 && _nodes[node].nbElements == 0)
+    {
+      GLuint parent = _nodes[node].parent;
+      GLuint* link = &_nodes[parent].firstChild;
+
+      while (*link != node)
+	link = &_nodes[*link].nextSibling;
+      *link = _nodes[node].nextSibling;
+      _releaseNode(node);
+      node = parent;
+    }
+
+  // The highest node with few enough elements becomes a leaf
+  GLuint merged = NoIndex;
+  for (; node != NoIndex; node = _nodes[node].parent)
+    if (_nodes[node].firstChild != NoIndex
+	&& _nodes[node].nbElements <= GLE_OCTREE_MERGE_SIZE)
+      merged = node;
+  if (merged != NoIndex)
+    _merge(merged);
+  return (true);
 }
 
-void gle::Octree::Node::splitNode()
+GLuint gle::Octree::_update(Element* element)
 {
-  struct subdivision {
-    gle::Vector3<GLfloat> min;
-    gle::Vector3<GLfloat> max;
-    std::list<gle::Octree::Element*> elements;
-    std::list<gle::Octree::Element*> partialsElements;
-  };
+  auto it = _elementsSlots.find(element);
 
-  if (_elements.size() <= 8)
-    return ;
+  if (it == _elementsSlots.end())
+    {
+      insert(element);
+      return (_elementsSlots[element]);
+    }
+
+  GLuint	slot = it->second;
+  GLuint	node = _bucketsNodes[slot / BucketSize];
+  Slot		data = _getSlot(element);
+  const Slot&	previous = _slots[slot];
 
-  subdivision subdivisions[8] = 
+  if (equalPoints(data.min, previous.min) && equalPoints(data.max, previous.max)
+      && equalPoints(data.center, previous.center) && data.radius == previous.radius
+      && data.drawDistance == previous.drawDistance)
+    return (slot);
+  _clearDebugNodes();
+  ++_version;
+  // Small moves keep the element in its leaf, with the code of the leaf
+  if (_isInLooseCell(node, data.center))
     {
-      {
-	{(_min.x + _max.x) / 2, (_min.y + _max.y) / 2, (_min.z + _max.z) / 2},
-	{_max.x, _max.y, _max.z},
-	{}, {}
-      },
-      {
-        {(_min.x + _max.x) / 2, _min.y, (_min.z + _max.z) / 2},
-	{_max.x, (_min.y + _max.y) / 2, _max.z},
-        {}, {}
-      },
-      {
-        {(_min.x + _max.x) / 2, (_min.y + _max.y) / 2, _min.z},
-	{_max.x, _max.y, (_min.z + _max.z) / 2},
-        {}, {}
-      },
-      {
-        {(_min.x + _max.x) / 2, _min.y, _min.z},
-        {_max.x, (_min.y + _max.y) / 2, (_min.z + _max.z) / 2},
-        {}, {}
-      },
-      {
-	{_min.x, (_min.y + _max.y) / 2, (_min.z + _max.z) / 2},
-	{(_max.x + _min.x) / 2, _max.y, _max.z},
-	{}, {}
-      },
-      {
-        {_min.x, _min.y, (_min.z + _max.z) / 2},
-	{(_max.x + _min.x) / 2, (_min.y + _max.y) / 2, _max.z},
-        {}, {}
-      },
-      {
-        {_min.x, (_min.y + _max.y) / 2, _min.z},
-	{(_max.x + _min.x) / 2, _max.y, (_min.z + _max.z) / 2},
-        {}, {}
-      },
-      {
-        {_min.x, _min.y, _min.z},
-        {(_max.x + _min.x) / 2, (_min.y + _max.y) / 2, (_min.z + _max.z) / 2},
-        {}, {}
-      }
-    };
+      data.code = previous.code;
+      _setSlot(slot, element, data);
+      _extendBounds(node, data);
+      return (slot);
+    }
+
+  GLuint stamp = _stamps[slot];
+
+  remove(element);
+  slot = _insert(0, element, _getSlot(element));
+  _stamps[slot] = stamp;
+  return (slot);
+}
+
+bool gle::Octree::contains(Element* element) const
+{
+  return (_elementsSlots.find(element) != _elementsSlots.end());
+}
+
+GLuint gle::Octree::getNbElements() const
+{
+  return (_elementsSlots.size());
+}
+
+GLuint gle::Octree::getLeaf(Element* element) const
+{
+  auto it = _elementsSlots.find(element);
+
+  if (it == _elementsSlots.end())
+    return (NoIndex);
+  return (_bucketsNodes[it->second / BucketSize]);
+}
+
+const std::vector<gle::Octree::Node>& gle::Octree::getNodes() const
+{
+  return (_nodes);
+}
+
+const std::vector<gle::Octree::Element*>& gle::Octree::getElements() const
+{
+  return (_elements);
+}
+
+GLuint gle::Octree::getNextBucket(GLuint bucket) const
+{
+  return (_bucketsNext[bucket]);
+}
+
+gle::Octree::Slot gle::Octree::_getSlot(Element* element) const
+{
+  Slot data;
+
+  data.min = element->getMinPoint();
+  data.max = element->getMaxPoint();
+  data.center = element->getCenter();
+  data.radius = element->getRadius();
+  data.drawDistance = element->getDrawDistance();
+  data.code = _getCode(data.center);
+  return (data);
+}
+
+GLuint gle::Octree::_allocateNode(GLuint parent, GLuint depth, GLuint code)
+{
+  Node	node;
+  GLuint index;
+
+  clearBounds(node.min, node.max);
+  node.code = code;
+  node.depth = depth;
+  node.nbElements = 0;
+  node.parent = parent;
+  node.firstChild = NoIndex;
+  node.nextSibling = NoIndex;
+  node.bucket = NoIndex;
+  node.firstBucket = NoIndex;
+  node.lastBucket = NoIndex;
+  node.generation = _nbAllocatedNodes++;
+  if (!_freeNodes.empty())
+    {
+      index = _freeNodes.back();
+      _freeNodes.pop_back();
+      _nodes[index] = node;
+    }
+  else
+    {
+      index = _nodes.size();
+      _nodes.push_back(node);
+    }
+  return (index);
+}
+
+GLuint gle::Octree::_allocateBucket(GLuint node)
+{
+  GLuint bucket;
+
+  if (!_freeBuckets.empty())
+    {
+      bucket = _freeBuckets.back();
+      _freeBuckets.pop_back();
+    }
+  else
+    {
+      // The slots of a new bucket are empty
+      bucket = _bucketsNodes.size();
+      _bucketsNodes.resize(bucket + 1);
+      _bucketsNext.resize(bucket + 1);
+      _elements.resize(_elements.size() + BucketSize, NULL);
+      _slots.resize(_slots.size() + BucketSize);
+      _stamps.resize(_stamps.size() + BucketSize, 0);
+      _bounds.resize(_bounds.size() + BucketSize);
+    }
+  _bucketsNodes[bucket] = node;
+  _bucketsNext[bucket] = NoIndex;
+  _clearBucketsRange(node);
+  return (bucket);
+}
+
+void gle::Octree::_setSlot(GLuint slot, Element* element, const Slot& data)
+{
+  _elements[slot] = element;
+  _slots[slot] = data;
+  if (data.radius < 0)
+    _bounds.setBox(slot, data.min, data.max);
+  else
+    _bounds.setSphere(slot, data.center, data.radius);
+  _bounds.setDrawDistance(slot, data.drawDistance);
+  _elementsSlots[element] = slot;
+}
+
+void gle::Octree::_clearSlot(GLuint slot)
+{
+  _elements[slot] = NULL;
+  _bounds.setEmpty(slot);
+}
+
+void gle::Octree::_extendBounds(GLuint node, const Slot& data)
+{
+  for (; node != NoIndex; node = _nodes[node].parent)
+    {
+      if (containsBounds(_nodes[node].min, _nodes[node].max, data.min, data.max))
+	return ;
+      extendBounds(_nodes[node].min, _nodes[node].max, data.min, data.max);
+    }
+}
+
+GLuint gle::Octree::_getChild(GLuint node, GLuint code)
+{
+  GLuint depth = _nodes[node].depth + 1;
+  GLuint prefix = code >> (3 * (maximumDepth - depth));
+  GLuint previous = NoIndex;
+  GLuint child = _nodes[node].firstChild;
 
-  for (int i = 0; i < 8; ++i)
+  // The children are sorted by code
+  while (child != NoIndex && _nodes[child].code < prefix)
     {
-      for (Element* &element : _elements)
+      previous = child;
+      child = _nodes[child].nextSibling;
+    }
+  if (child != NoIndex && _nodes[child].code == prefix)
+    return (child);
+
+  GLuint created = _allocateNode(node, depth, prefix);
+
+  _nodes[created].nextSibling = child;
+  if (previous == NoIndex)
+    _nodes[node].firstChild = created;
+  else
+    _nodes[previous].nextSibling = created;
+  return (created);
+}
+
+GLuint gle::Octree::_insert(GLuint node, Element* element, const Slot& data)
+{
+  while (1)
+    {
+      if (_nodes[node].firstChild == NoIndex)
 	{
-	  const gle::Vector3<GLfloat>& min = element->getMinPoint();
-	  const gle::Vector3<GLfloat>& max = element->getMaxPoint();
-	  const gle::Vector3<GLfloat>& center = element->getCenter();
-          if (center.x <= subdivisions[i].max.x && center.x >= subdivisions[i].min.x &&
-              center.y <= subdivisions[i].max.y && center.y >= subdivisions[i].min.y &&
-              center.z <= subdivisions[i].max.z && center.z >= subdivisions[i].min.z)
-            subdivisions[i].elements.push_back(element);
-	  else if (min.x <= subdivisions[i].max.x && max.x >= subdivisions[i].min.x &&
-		   min.y <= subdivisions[i].max.y && max.y >= subdivisions[i].min.y &&
-		   min.z <= subdivisions[i].max.z && max.z >= subdivisions[i].min.z)
-	    subdivisions[i].partialsElements.push_back(element);
+	  if (_nodes[node].nbElements < maximumLeafSize
+	      || _nodes[node].depth == maximumDepth)
+	    break;
+	  // The element goes down in a child of the full leaf
+	  _split(node);
 	}
+      ++_nodes[node].nbElements;
+      extendBounds(_nodes[node].min, _nodes[node].max, data.min, data.max);
+      node = _getChild(node, data.code);
     }
-  for (int i = 0; i < 8; ++i)
+  ++_nodes[node].nbElements;
+  extendBounds(_nodes[node].min, _nodes[node].max, data.min, data.max);
+
+  GLuint last = NoIndex;
+  for (GLuint bucket = _nodes[node].bucket; bucket != NoIndex;
+       last = bucket, bucket = _bucketsNext[bucket])
+    for (GLuint slot = bucket * BucketSize; slot < (bucket + 1) * BucketSize; ++slot)
+      if (!_elements[slot])
+	{
+	  _setSlot(slot, element, data);
+	  return (slot);
+	}
+
+  GLuint bucket = _allocateBucket(node);
+
+  if (last == NoIndex)
+    _nodes[node].bucket = bucket;
+  else
+    _bucketsNext[last] = bucket;
+  _setSlot(bucket * BucketSize, element, data);
+  return (bucket * BucketSize);
+}
+
+void gle::Octree::_split(GLuint node)
+{
+  std::vector<GLuint>	slots;
+  std::vector<Element*>	elements;
+  std::vector<Slot>	datas;
+  std::vector<GLuint>	stamps;
+
+  _collectSlots(node, slots);
+  for (GLuint slot : slots)
     {
-      if (subdivisions[i].elements.size() > 0)
-	_children[i] = new gle::Octree::Node(subdivisions[i].min, subdivisions[i].max, subdivisions[i].elements,
-					     subdivisions[i].partialsElements);
+      elements.push_back(_elements[slot]);
+      datas.push_back(_slots[slot]);
+      stamps.push_back(_stamps[slot]);
+      _clearSlot(slot);
     }
+  for (GLuint bucket = _nodes[node].bucket; bucket != NoIndex;
+       bucket = _bucketsNext[bucket])
+    _freeBuckets.push_back(bucket);
+  _nodes[node].bucket = NoIndex;
+  _clearBucketsRange(node);
+  for (GLuint i = 0; i < elements.size(); ++i)
+    _stamps[_insert(_getChild(node, datas[i].code), elements[i], datas[i])] = stamps[i];
 }
 
-void gle::Octree::_addDebugNode(gle::Octree::Node* node)
+void gle::Octree::_merge(GLuint node)
 {
-  if (node)
+  std::vector<GLuint>	slots;
+  std::vector<Element*>	elements;
+  std::vector<Slot>	datas;
+  std::vector<GLuint>	stamps;
+
+  _collectSlots(node, slots);
+  for (GLuint slot : slots)
+    {
+      elements.push_back(_elements[slot]);
+      datas.push_back(_slots[slot]);
+      stamps.push_back(_stamps[slot]);
+    }
+  for (GLuint child = _nodes[node].firstChild; child != NoIndex;)
     {
-      _debugNodes.push_back(node->getDebugMesh());
-      for (int i = 0; i < 8; ++i)
-	_addDebugNode(node->_children[i]);
+      GLuint next = _nodes[child].nextSibling;
+
+      _releaseNode(child);
+      child = next;
     }
+  _nodes[node].firstChild = NoIndex;
+  _nodes[node].nbElements = 0;
+  _clearBucketsRange(node);
+  clearBounds(_nodes[node].min, _nodes[node].max);
+  for (GLuint i = 0; i < elements.size(); ++i)
+    _stamps[_insert(node, elements[i], datas[i])] = stamps[i];
 }
 
-std::vector<gle::Mesh*>& gle::Octree::getDebugNodes()
+void gle::Octree::_collectSlots(GLuint node, std::vector<GLuint>& slots)
+{
+  for (GLuint bucket = _nodes[node].bucket; bucket != NoIndex;
+       bucket = _bucketsNext[bucket])
+    for (GLuint slot = bucket * BucketSize; slot < (bucket + 1) * BucketSize; ++slot)
+      if (_elements[slot])
+	slots.push_back(slot);
+  for (GLuint child = _nodes[node].firstChild; child != NoIndex;
+       child = _nodes[child].nextSibling)
+    _collectSlots(child, slots);
+}
+
+void gle::Octree::_releaseNode(GLuint node)
+{
+  for (GLuint child = _nodes[node].firstChild; child != NoIndex;)
+    {
+      GLuint next = _nodes[child].nextSibling;
+
+      _releaseNode(child);
+      child = next;
+    }
+  for (GLuint bucket = _nodes[node].bucket; bucket != NoIndex;
+       bucket = _bucketsNext[bucket])
+    {
+      for (GLuint slot = bucket * BucketSize; slot < (bucket + 1) * BucketSize; ++slot)
+	_clearSlot(slot);
+      _freeBuckets.push_back(bucket);
+    }
+  _nodes[node].parent = NoIndex;
+  _nodes[node].firstChild = NoIndex;
+  _nodes[node].nextSibling = NoIndex;
+  _nodes[node].bucket = NoIndex;
+  _nodes[node].nbElements = 0;
+  _freeNodes.push_back(node);
+}
+
+void gle::Octree::_clearBucketsRange(GLuint node)
+{
+  for (; node != NoIndex; node = _nodes[node].parent)
+    _nodes[node].firstBucket = _nodes[node].lastBucket = NoIndex;
+}
+
+bool gle::Octree::_isInLooseCell(GLuint node, const Vector3<GLfloat>& center) const
 {
+  GLfloat	size = 1 << (maximumDepth - _nodes[node].depth);
+  GLfloat	gridSize = 1 << maximumDepth;
+  GLuint	code = _nodes[node].code;
+  GLuint	cell[3] = {compactBits(code >> 2), compactBits(code >> 1), compactBits(code)};
+  GLfloat	position[3] = {(center.x - _codesOrigin.x) * _codesScale.x,
+			       (center.y - _codesOrigin.y) * _codesScale.y,
+			       (center.z - _codesOrigin.z) * _codesScale.z};
+
+  for (int i = 0; i < 3; ++i)
+    {
+      GLfloat min = cell[i] * size;
+      GLfloat max = min + size;
+
+      // The cells of the borders also hold the positions outside the grid
+      if (min > 0 && position[i] < min - _looseness * size)
+	return (false);
+      if (max < gridSize && position[i] >= max + _looseness * size)
+	return (false);
+    }
+  return (true);
+}
+
+void gle::Octree::_clearDebugNodes()
+{
+  for (Mesh* mesh : _debugNodes)
+    delete mesh;
   _debugNodes.clear();
-  _addDebugNode(_root);
+}
+
+std::vector<gle::Mesh*>& gle::Octree::getDebugNodes()
+{
+  if (!_debugMaterial)
+    {
+      _debugMaterial = new Material();
+      _debugMaterial->setAmbientColor(gle::Color<GLfloat>(0, 1.0, 0));
+    }
+  if (_debugNodes.empty())
+    for (const Node& node : _nodes)
+      {
+	if (node.nbElements == 0)
+	  continue;
+	Mesh* mesh = gle::Geometries::Cuboid(_debugMaterial,
+					     node.max.x - node.min.x,
+					     node.max.y - node.min.y,
+					     node.max.z - node.min.z, true);
+	Vector3<GLfloat> center = node.max + node.min;
+
+	center /= 2.0;
+	mesh->setPosition(center);
+	mesh->setRasterizationMode(gle::Mesh::Line);
+	_debugNodes.push_back(mesh);
+      }
   return (_debugNodes);
 }
 
 std::list<gle::Octree::Element*> &gle::Octree::getElementsInFrustum(const gle::Matrix4<GLfloat>& projection,
 								    const gle::Matrix4<GLfloat>& modelview)
 {
-  _elementsInFrustum.clear();
-  gle::Matrix4<GLfloat> clip = projection * modelview;
-  GLfloat t;
-  
-  _frustum[0][0] = clip[3] - clip[0];
-  _frustum[0][1] = clip[7] - clip[4];
-  _frustum[0][2] = clip[11] - clip[8];
-  _frustum[0][3] = clip[15] - clip[12];
-  t = sqrt(_frustum[0][0] * _frustum[0][0] + _frustum[0][1] * _frustum[0][1] + _frustum[0][2] * _frustum[0][2]);
-  _frustum[0][0] /= t;
-  _frustum[0][1] /= t;
-  _frustum[0][2] /= t;
-  _frustum[0][3] /= t;
-  _frustum[1][0] = clip[3] + clip[0];
-  _frustum[1][1] = clip[7] + clip[4];
-  _frustum[1][2] = clip[11] + clip[8];
-  _frustum[1][3] = clip[15] + clip[12];
-  t = sqrt( _frustum[1][0] * _frustum[1][0] + _frustum[1][1] * _frustum[1][1] + _frustum[1][2] * _frustum[1][2] );
-  _frustum[1][0] /= t;
-  _frustum[1][1] /= t;
-  _frustum[1][2] /= t;
-  _frustum[1][3] /= t;
-  _frustum[2][0] = clip[3] + clip[1];
-  _frustum[2][1] = clip[7] + clip[5];
-  _frustum[2][2] = clip[11] + clip[9];
-  _frustum[2][3] = clip[15] + clip[13];
-  t = sqrt( _frustum[2][0] * _frustum[2][0] + _frustum[2][1] * _frustum[2][1] + _frustum[2][2] * _frustum[2][2] );
-  _frustum[2][0] /= t;
-  _frustum[2][1] /= t;
-  _frustum[2][2] /= t;
-  _frustum[2][3] /= t;
-  _frustum[3][0] = clip[3] - clip[1];
-  _frustum[3][1] = clip[7] - clip[5];
-  _frustum[3][2] = clip[11] - clip[9];
-  _frustum[3][3] = clip[15] - clip[13];
-  t = sqrt( _frustum[3][0] * _frustum[3][0] + _frustum[3][1] * _frustum[3][1] + _frustum[3][2] * _frustum[3][2] );
-  _frustum[3][0] /= t;
-  _frustum[3][1] /= t;
-  _frustum[3][2] /= t;
-  _frustum[3][3] /= t;
-  _frustum[4][0] = clip[3] - clip[2];
-  _frustum[4][1] = clip[7] - clip[6];
-  _frustum[4][2] = clip[11] - clip[10];
-  _frustum[4][3] = clip[15] - clip[14];
-  t = sqrt( _frustum[4][0] * _frustum[4][0] + _frustum[4][1] * _frustum[4][1] + _frustum[4][2] * _frustum[4][2] );
-  _frustum[4][0] /= t;
-  _frustum[4][1] /= t;
-  _frustum[4][2] /= t;
-  _frustum[4][3] /= t;
-  _frustum[5][0] = clip[3] + clip[2];
-  _frustum[5][1] = clip[7] + clip[6];
-  _frustum[5][2] = clip[11] + clip[10];
-  _frustum[5][3] = clip[15] + clip[14];
-  t = sqrt( _frustum[5][0] * _frustum[5][0] + _frustum[5][1] * _frustum[5][1] + _frustum[5][2] * _frustum[5][2] );
-  _frustum[5][0] /= t;
-  _frustum[5][1] /= t;
-  _frustum[5][2] /= t;
-  _frustum[5][3] /= t;
-  _alreadyDone.clear();
-  _root->addToFrustum(_frustum, _elementsInFrustum, &_alreadyDone);
+  const std::vector<Element*>& elements = getVisibleElements(projection, modelview);
+
+  _elementsInFrustum.assign(elements.begin(), elements.end());
   return (_elementsInFrustum);
 }
 
-void gle::Octree::Node::addToFrustum(const GLfloat frustum[6][4],
-				     std::list<Element*>& elementsInFrustum,
-				     std::map<Element*, bool>* alreadyDone)
-{
-  for(int i = 0; i < 6; i++)
-    {
-      if (frustum[i][0] * _min.x + frustum[i][1] * _min.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-	continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _min.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-	continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _max.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-	continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _max.y + frustum[i][2] * _min.z + frustum[i][3] > 0)
-	continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _min.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-	continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _min.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-	continue;
-      if (frustum[i][0] * _min.x + frustum[i][1] * _max.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-	continue;
-      if (frustum[i][0] * _max.x + frustum[i][1] * _max.y + frustum[i][2] * _max.z + frustum[i][3] > 0)
-	continue;
+const std::vector<gle::Octree::Element*>& gle::Octree::getVisibleElements(const gle::Matrix4<GLfloat>& projection,
+									  const gle::Matrix4<GLfloat>& modelview)
+{
+  GLfloat frustum[6][4];
+
+  getFrustumPlanes(projection, modelview, frustum);
+  return (getVisibleElements(frustum));
+}
+
+const std::vector<gle::Octree::Element*>& gle::Octree::getVisibleElements(const GLfloat frustum[6][4],
+									  const GLfloat* detail)
+{
+  if (_isQueryCached(&frustum[0][0], 1, detail))
+    return (_visibleElements);
+  std::copy(&frustum[0][0], &frustum[0][0] + 6 * 4, &_frustums[0][0][0]);
+  _setDetail(detail);
+  _cull(1);
+  return (_visibleElements);
+}
+
+const std::vector<gle::Octree::Element*>& gle::Octree::getVisibleElements(const GLfloat frustums[][6][4],
+									  GLuint nbViews,
+									  const GLfloat* detail)
+{
+  nbViews = std::min(nbViews, (GLuint)maximumNumberOfViews);
+  if (_isQueryCached(&frustums[0][0][0], nbViews, detail))
+    return (_visibleElements);
+  std::copy(&frustums[0][0][0], &frustums[0][0][0] + nbViews * 6 * 4,
+	    &_frustums[0][0][0]);
+  _setDetail(detail);
+  _slotsMasks.resize(_elements.size(), 0);
+  _cull(nbViews);
+  return (_visibleElements);
+}
+
+const std::vector<GLuint>& gle::Octree::getVisibleMasks() const
+{
+  return (_visibleMasks);
+}
+
+GLuint gle::Octree::getVersion() const
+{
+  return (_version);
+}
+
+bool gle::Octree::_isQueryCached(const GLfloat* frustums, GLuint nbViews,
+				 const GLfloat* detail) const
+{
+  // Nothing moved in the tree, and the frustums and the detail are those
+  // of the last query
+  return (_queryVersion == _version && _queryNbViews == nbViews && nbViews > 0
+	  && std::equal(frustums, frustums + nbViews * 6 * 4, &_frustums[0][0][0])
+	  && (detail == NULL) == (_queryDetail == NULL)
+	  && (detail == NULL || std::equal(detail, detail + 4, _detail)));
+}
+
+void gle::Octree::_setDetail(const GLfloat* detail)
+{
+  _queryDetail = NULL;
+  if (detail == NULL)
+    return;
+  std::copy(detail, detail + 4, _detail);
+  _queryDetail = _detail;
+}
+
+void gle::Octree::getFrustumPlanes(const gle::Matrix4<GLfloat>& projection,
+				   const gle::Matrix4<GLfloat>& modelview,
+				   GLfloat frustum[6][4])
+{
+  // Each plane is the last row of the clip matrix plus or minus another row
+  static const int	rows[6] = {0, 0, 1, 1, 2, 2};
+  static const GLfloat	signs[6] = {-1, 1, 1, -1, -1, 1};
+  gle::Matrix4<GLfloat>	clip = projection * modelview;
+
+  for (int i = 0; i < 6; ++i)
+    {
+      for (int j = 0; j < 4; ++j)
+	frustum[i][j] = clip[j * 4 + 3] + signs[i] * clip[j * 4 + rows[i]];
+      GLfloat t = sqrt(frustum[i][0] * frustum[i][0] + frustum[i][1] * frustum[i][1]
+		       + frustum[i][2] * frustum[i][2]);
+      for (int j = 0; j < 4; ++j)
+	frustum[i][j] /= t;
+    }
+}
+
+void gle::Octree::_cull(GLuint nbViews)
+{
+  GLuint planeMasks[maximumNumberOfViews];
+  GLuint viewMask = nbViews < 32 ? (1u << nbViews) - 1 : ~0u;
+
+  _nbViews = nbViews;
+  _queryNbViews = nbViews;
+  _queryVersion = _version;
+  std::fill(planeMasks, planeMasks + nbViews, (GLuint)BoundsArray::AllPlanes);
+  _visibleIndexes.clear();
+  _nbCullTasks = 0;
+  // Large trees are split in tasks when there are several threads
+  if (!_nodes.empty() && nbViews > 0)
+    {
+      if (_pool.getNumberOfThreads() > 1
+	  && _nodes[0].nbElements > GLE_OCTREE_ELEMENTS_PER_CULL_TASK)
+	_splitCull(0, viewMask, planeMasks);
+      else
+	_cullNode(0, viewMask, planeMasks, _visibleIndexes);
+    }
+  if (_nbCullTasks == 0)
+    {
+      _gatherSlots(_visibleIndexes, _visibleElements, _visibleMasks);
+      return;
+    }
+
+  // Each task culls its subtree in its own arrays, which are then copied
+  // in the order of the serial traversal
+  _pool.run(std::bind(&gle::Octree::_runCullTask, this, std::placeholders::_1),
+	    _nbCullTasks);
+
+  GLuint size = 0;
+
+  for (GLuint task = 0; task < _nbCullTasks; ++task)
+    {
+      _cullTasks[task].offset = size;
+      size += _cullTasks[task].elements.size();
+    }
+  _visibleElements.resize(size);
+  _visibleMasks.resize(size);
+  _pool.run([this](GLuint task) {
+      const CullTask& cullTask = _cullTasks[task];
+
+      std::copy(cullTask.elements.begin(), cullTask.elements.end(),
+		_visibleElements.begin() + cullTask.offset);
+      std::copy(cullTask.masks.begin(), cullTask.masks.end(),
+		_visibleMasks.begin() + cullTask.offset);
+    }, _nbCullTasks);
+}
+
+void gle::Octree::_splitCull(GLuint index, GLuint viewMask, const GLuint* parentMasks)
+{
+  const Node&	node = _nodes[index];
+  GLuint	planeMasks[maximumNumberOfViews];
+  GLuint	insideMask = 0;
+
+  if (node.nbElements <= GLE_OCTREE_ELEMENTS_PER_CULL_TASK)
+    {
+      _addCullTask(index, viewMask, parentMasks, true);
+      return;
+    }
+  for (GLuint view = 0; view < _nbViews; ++view)
+    if (viewMask & (1u << view))
+      {
+	planeMasks[view] = parentMasks[view];
+	if (!BoundsArray::testBox(_frustums[view], planeMasks[view], node.min, node.max))
+	  viewMask &= ~(1u << view);
+	else if (planeMasks[view] == 0)
+	  insideMask |= 1u << view;
+      }
+  if (viewMask == 0)
+    return;
+  // The subtrees fully inside the frustums are only copied
+  if (insideMask == viewMask)
+    {
+      _addCullTask(index, viewMask, planeMasks, true);
+      return;
+    }
+  if (node.bucket != NoIndex)
+    _addCullTask(index, viewMask, planeMasks, false);
+  for (GLuint child = node.firstChild; child != NoIndex;
+       child = _nodes[child].nextSibling)
+    _splitCull(child, viewMask, planeMasks);
+}
+
+void gle::Octree::_addCullTask(GLuint index, GLuint viewMask, const GLuint* planeMasks,
+			       bool subtree)
+{
+  // The tasks are kept with their arrays between two queries
+  if (_nbCullTasks == _cullTasks.size())
+    _cullTasks.resize(_nbCullTasks + 1);
+
+  CullTask& task = _cullTasks[_nbCullTasks++];
+
+  task.node = index;
+  task.viewMask = viewMask;
+  task.subtree = subtree;
+  for (GLuint view = 0; view < _nbViews; ++view)
+    if (viewMask & (1u << view))
+      task.planeMasks[view] = planeMasks[view];
+}
+
+void gle::Octree::_runCullTask(GLuint index)
+{
+  CullTask&	task = _cullTasks[index];
+  GLuint	first = 0;
+  GLuint	last = 0;
+
+  task.indexes.clear();
+  if (task.subtree)
+    _cullNode(task.node, task.viewMask, task.planeMasks, task.indexes);
+  else
+    {
+      _cullBuckets(task.node, task.viewMask, task.planeMasks, false,
+		   first, last, task.indexes);
+      _cullSlots(task.viewMask, task.planeMasks, first, last, task.indexes);
+    }
+  _gatherSlots(task.indexes, task.elements, task.masks);
+}
+
+void gle::Octree::_gatherSlots(const std::vector<GLuint>& slots,
+			       std::vector<Element*>& elements,
+			       std::vector<GLuint>& masks)
+{
+  elements.clear();
+  masks.clear();
+  if (_nbViews == 1)
+    {
+      for (GLuint slot : slots)
+	if (_elements[slot])
+	  elements.push_back(_elements[slot]);
+      masks.assign(elements.size(), 1);
       return;
     }
-  if (_leaf)
+  // The masks are cleared for the next query
+  for (GLuint slot : slots)
     {
-      for (gle::Octree::Element* &element : _elements)
+      if (_elements[slot])
 	{
-	  if (element->isInFrustum(frustum) && (*alreadyDone)[element] == false)
-	    {
-	      (*alreadyDone)[element] = true;
-	      elementsInFrustum.push_back(element);
-	    }
+	  elements.push_back(_elements[slot]);
+	  masks.push_back(_slotsMasks[slot]);
 	}
-      for (gle::Octree::Element* &element : _partialsElements)
-        {
-          if (element->isInFrustum(frustum) && (*alreadyDone)[element] == false)
-            {
-	      (*alreadyDone)[element] = true;
-	      elementsInFrustum.push_back(element);
-	    }
+      _slotsMasks[slot] = 0;
+    }
+}
+
+void gle::Octree::_cullNode(GLuint index, GLuint viewMask, const GLuint* parentMasks,
+			    std::vector<GLuint>& visible)
+{
+  const Node&	node = _nodes[index];
+  GLuint	planeMasks[maximumNumberOfViews];
+  GLuint	insideMask = 0;
+
+  // Each view only tests the planes still crossed by the parent
+  for (GLuint view = 0; view < _nbViews; ++view)
+    if (viewMask & (1u << view))
+      {
+	planeMasks[view] = parentMasks[view];
+	if (!BoundsArray::testBox(_frustums[view], planeMasks[view], node.min, node.max))
+	  viewMask &= ~(1u << view);
+	else if (planeMasks[view] == 0)
+	  insideMask |= 1u << view;
+      }
+  if (viewMask == 0)
+    return;
+
+  GLuint first = 0;
+  GLuint last = 0;
+  // Small subtrees, or subtrees fully inside the frustums, are added
+  // without testing their nodes
+  bool	 subtree = insideMask == viewMask || node.nbElements <= GLE_OCTREE_SMALL_SUBTREE;
+
+  _cullBuckets(index, viewMask, planeMasks, subtree, first, last, visible);
+  _cullSlots(viewMask, planeMasks, first, last, visible);
+  if (!subtree)
+    for (GLuint child = node.firstChild; child != NoIndex;
+	 child = _nodes[child].nextSibling)
+      _cullNode(child, viewMask, planeMasks, visible);
+}
+
+void gle::Octree::_cullBuckets(GLuint index, GLuint viewMask, const GLuint* planeMasks,
+			       bool subtree, GLuint& first, GLuint& last,
+			       std::vector<GLuint>& visible)
+{
+  const Node& node = _nodes[index];
+
+  // Consecutive buckets, as built by generateTree(), are tested at once
+  if (subtree && node.firstBucket != NoIndex)
+    {
+      if (node.firstBucket * BucketSize != last)
+	{
+	  _cullSlots(viewMask, planeMasks, first, last, visible);
+	  first = node.firstBucket * BucketSize;
 	}
+      last = node.lastBucket * BucketSize;
+      return;
     }
-  else
+  for (GLuint bucket = _nodes[index].bucket; bucket != NoIndex;
+       bucket = _bucketsNext[bucket])
     {
-      for (int i = 0; i < 8; ++i)
-	if (_children[i])
-	  _children[i]->addToFrustum(frustum, elementsInFrustum, alreadyDone);
-      for (gle::Octree::Element* &element : _partialsElements)
-        {
-          if (element->isInFrustum(frustum) && (*alreadyDone)[element] == false)
-            {
-              (*alreadyDone)[element] = true;
-	      elementsInFrustum.push_back(element);
-	    }
+      if (bucket * BucketSize != last)
+	{
+	  _cullSlots(viewMask, planeMasks, first, last, visible);
+	  first = bucket * BucketSize;
 	}
+      last = (bucket + 1) * BucketSize;
+    }
+  if (subtree)
+    for (GLuint child = _nodes[index].firstChild; child != NoIndex;
+	 child = _nodes[child].nextSibling)
+      _cullBuckets(child, viewMask, planeMasks, true, first, last, visible);
+}
+
+void gle::Octree::_cullSlots(GLuint viewMask, const GLuint* planeMasks,
+			     GLuint first, GLuint last, std::vector<GLuint>& visible)
+{
+  if (first == last)
+    return;
+  // A single view finds each slot once: the empty ones are skipped with
+  // the results
+  if (_nbViews == 1)
+    {
+      if (planeMasks[0] != 0 || _queryDetail)
+	{
+	  _bounds.cull(_frustums[0], planeMasks[0], _queryDetail, first, last, visible);
+	  return;
+	}
+
+      GLuint size = visible.size();
+
+      visible.resize(size + last - first);
+      for (GLuint slot = first; slot < last; ++slot)
+	visible[size++] = slot;
+      return;
     }
+  _bounds.cull(_frustums, planeMasks, viewMask, _queryDetail, first, last,
+	       &_slotsMasks[0], visible);
 }
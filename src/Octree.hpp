@@ -10,16 +10,15 @@
 #ifndef _OCTREE_HPP_
 # define _OCTREE_HPP_
 
-# include <utility>
-# include <queue>
 # include <vector>
 # include <list>
-# include <thread>
-# include <mutex>
-# include <atomic>
-# include <map>
+# include <limits>
+# include <unordered_map>
 # include <gle/opengl.h>
 # include <Vector3.hpp>
+# include <Matrix4.hpp>
+# include <BoundsArray.hpp>
+# include <WorkerPool.hpp>
 
 
 namespace gle {
@@ -28,14 +27,49 @@ namespace gle {
   class Mesh;
 
   //! Handler of %Octree
+  /*!
+    The tree is built as a linear octree: the centers of the elements are
+    quantized on a 1024 grid of the scene, and sorted along the Z-order
+    curve of their Morton codes. The nodes are then split on the prefixes
+    of the codes, and stored in a single array linked by indexes.
+
+    The Morton codes and the radix sort are computed by a worker pool in
+    fixed size tasks, so the tree does not depend on the number of
+    threads. It is built and queried without any OpenGL context: only
+    getDebugNodes() creates meshes.
+
+    The elements of a leaf are stored in buckets of BucketSize slots of
+    getElements(). Elements can then be inserted, removed and moved
+    without building the tree again: a full leaf is split in 8, a node
+    with few enough elements is merged back in a leaf. An element stays
+    in its leaf while its center stays in the loose cell of the leaf:
+    the cell of its Morton code grown on each side by getLooseness()
+    times its size. Only the bounds of the nodes are extended.
+
+    The grid is set by generateTree(): elements inserted outside of it
+    are stored in the cells of its borders, and the tree should be
+    generated again when the scene is very different.
+   */
   class Octree {
   public:
 
     //! Number maximum of threads
     static const unsigned int maximumNumberOfThreads = 8;
 
-    //! Maximum tree depth
-    static const int maximumDepth = 15;
+    //! Maximum tree depth, the number of bits of the codes on each axis
+    static const GLuint maximumDepth = 10;
+
+    //! Nodes with more elements are split, above the maximum depth
+    static const GLuint maximumLeafSize = 8;
+
+    //! Number of element slots of a bucket
+    static const GLuint BucketSize = BoundsArray::Width;
+
+    //! Number maximum of frustums of a single query
+    static const GLuint maximumNumberOfViews = 32;
+
+    //! Index of a node or bucket that does not exist
+    static const GLuint NoIndex = (GLuint)-1;
     
     //! Octree element interface
     class Element
@@ -54,6 +88,23 @@ namespace gle {
       //! Get center of octree element
       virtual const Vector3<GLfloat>& getCenter() = 0;
 
+      //! Get the radius of the sphere bounding the element
+      /*!
+	A negative radius means the element is culled with its box:
+	getMinPoint() and getMaxPoint()
+       */
+      virtual GLfloat getRadius() { return (-1); }
+
+      //! Get the largest distance from which the element is drawn
+      /*!
+	Only used by the queries given a point of view: the element is
+	culled when the nearest point of its bounds is farther
+       */
+      virtual GLfloat getDrawDistance()
+      {
+	return (std::numeric_limits<GLfloat>::infinity());
+      }
+
       //! Return wheter or not octree element is in frustum
       /*!
 	\param frustum Six planes of frustum
@@ -61,63 +112,64 @@ namespace gle {
       virtual bool isInFrustum(const GLfloat frustum[6][4]) const = 0;
     };
     
-    //! Represent an octree node
-    class Node {
-    public:
-      
-      //! Create an octree node
+    //! Node of the octree
+    /*!
+      The root is the first node. A node is a leaf when it has no child,
+      and the nodes released by merges are not linked to the root.
+     */
+    struct Node {
+      //! Lowest corner of the bounds of all the elements of the node
       /*!
-	\param min lowest extreme value in the 3 axis
-	\param max highest extreme value in the 3 axis
-	\param elements Elements totally in frustum
-	\param partialsElements Elements partially in frustum
+	The bounds are extended when elements are added or moved, but not
+	reduced when they are removed.
        */
-      Node(const Vector3<GLfloat>& min,
-	   const Vector3<GLfloat>& max,
-	   const std::list<Element*> &elements,
-	   const std::list<Element*> &partialsElements);
+      Vector3<GLfloat>	min;
 
-      //! Destroy an octree node
-      ~Node();
+      //! Highest corner of the bounds of all the elements of the node
+      Vector3<GLfloat>	max;
 
-      //! Return the node debug mesh
-      /*!
-	This is used only if renderer debug mode is activated and set to Renderer::Octree
-      */
-      Mesh* getDebugMesh();
+      //! Morton code of the cell of the node, its 3 * depth last bits
+      GLuint		code;
+
+      //! Depth of the node, 0 for the root
+      GLuint		depth;
+
+      //! Number of elements of the node and its children
+      GLuint		nbElements;
+
+      //! Index of the parent node, or NoIndex for the root
+      GLuint		parent;
+
+      //! Index of the first child node, or NoIndex for a leaf
+      GLuint		firstChild;
 
-      //! Split node
+      //! Index of the next child of the parent node, or NoIndex
+      GLuint		nextSibling;
+
+      //! First bucket of the elements of a leaf, or NoIndex
       /*!
-	It split node in 8 children.
-	All node elements are divide in each child.
+	The elements of the bucket are the slots
+	[bucket * BucketSize, (bucket + 1) * BucketSize[ of getElements()
        */
-      void splitNode();
+      GLuint		bucket;
 
-      //! Add element to child frustum
+      //! Buckets of the node and its children, when they are consecutive
       /*!
-	\param frustum Six planes of frustum
-	\param elementsInFrustum Elements to check
-	\param alreadyDone Elements already add
+	generateTree() stores the buckets of each subtree in the range
+	[firstBucket, lastBucket[. The range is set to NoIndex once
+	buckets are added to or removed from the subtree.
        */
-      void addToFrustum(const GLfloat frustum[6][4], 
-			std::list<Element*>& elementsInFrustum,
-			std::map<Element*, bool>* alreadyDone);
-
-      //! Octree node children
-      Node*		_children[8];
+      GLuint		firstBucket;
 
-    protected:
-      //! Elements totally in frustum
-      std::list<Element*> _elements;
+      //! Bucket after the last bucket of the subtree, or NoIndex
+      GLuint		lastBucket;
 
-      //! Elements partially in frustum
-      std::list<Element*> _partialsElements;
-    private:
-      Material*		_debugMaterial;
-      Mesh*		_debugMesh;
-      Vector3<GLfloat>	_min;
-      Vector3<GLfloat>	_max;
-      bool		_leaf;
+      //! Number of nodes allocated by the tree before this one
+      /*!
+	A node reusing the index of a released node has another
+	generation, so the data kept by node index can be reset.
+       */
+      GLuint		generation;
     };
 
     //! Create an octree
@@ -126,12 +178,91 @@ namespace gle {
     //! Destroy octree
     ~Octree();
 
+    //! Set the number of threads building and querying the tree
+    /*!
+      The tree does not depend on the number of threads. Queries split
+      the large trees in subtrees, each culled by a task in its own
+      arrays: the results are copied in the order of a single thread
+      traversal, so they do not depend on the number of threads either.
+      The tree uses a single thread by default.
+     */
+    void setNumberOfThreads(unsigned int nbThreads);
+
+    //! Set how far the center of an element moves before it changes of leaf
+    /*!
+      \param looseness Part of the size of the cell of a leaf added on
+      each side of it, 0.5 by default
+     */
+    void setLooseness(GLfloat looseness);
+
+    //! Returns how far the center of an element moves in its leaf
+    GLfloat getLooseness() const;
+
     //! Generate the octree structure
     /*!
+      The bounds of the elements are stored when the tree is generated,
+      update() must be called when they move.
       \param elements Elements to add in octree
      */
     void generateTree(std::list<Element*> &elements);
 
+    //! Update the tree to contain a list of elements
+    /*!
+      The elements missing from the tree are inserted, the elements
+      missing from the list are removed, and the others are updated.
+      The tree is generated from scratch when it is empty.
+      \param elements Elements of the octree
+     */
+    void updateTree(std::list<Element*> &elements);
+
+    //! Add an element to the tree
+    /*!
+      \return false if the element is already in the tree
+     */
+    bool insert(Element* element);
+
+    //! Remove an element from the tree
+    /*!
+      \return false if the element is not in the tree
+     */
+    bool remove(Element* element);
+
+    //! Update the bounds of an element of the tree
+    /*!
+      The element only changes of leaf when its center leaves the loose
+      cell of its leaf. It is inserted if it is not in the tree.
+     */
+    void update(Element* element);
+
+    //! Returns whether an element is in the tree
+    bool contains(Element* element) const;
+
+    //! Returns the number of elements of the tree
+    GLuint getNbElements() const;
+
+    //! Returns the index of the leaf containing an element, or NoIndex
+    GLuint getLeaf(Element* element) const;
+
+    //! Returns the version of the elements of the tree
+    /*!
+      The version changes each time an element is added, removed or
+      moved, so equal versions mean the same visible elements in the
+      same frustums.
+     */
+    GLuint getVersion() const;
+
+    //! Returns the nodes of the tree
+    const std::vector<Node>& getNodes() const;
+
+    //! Returns the slots of the elements of the tree
+    /*!
+      The empty slots of the buckets are NULL
+     */
+    const std::vector<Element*>& getElements() const;
+
+    //! Returns the bucket following a bucket of a leaf, or NoIndex
+    GLuint getNextBucket(GLuint bucket) const;
+
     //! Get octree debug nodes
     /*!
       This is used only if renderer debug mode is activated and set to Renderer::Octree
@@ -146,25 +277,194 @@ namespace gle {
     std::list<Element*> &getElementsInFrustum(const gle::Matrix4<GLfloat>& projection,
 					      const gle::Matrix4<GLfloat>& modelview);
 
+    //! Return all the elements in given projection and modelview matrix
+    /*!
+      The elements are returned in the order of the nodes of the tree.
+      \param projection Projection matrix of frustum
+      \param modelview Modelview matrix of frustum
+    */
+    const std::vector<Element*>& getVisibleElements(const gle::Matrix4<GLfloat>& projection,
+						    const gle::Matrix4<GLfloat>& modelview);
+
+    //! Return all the elements inside six frustum planes
+    /*!
+      The tree is not traversed when the frustum, the detail and the
+      version are those of the last query: its results are returned again.
+      \param frustum Six planes of frustum, see getFrustumPlanes()
+      \param detail Point of view x, y, z and size ratio culling the
+      small and distant elements, see BoundsArray, or NULL
+    */
+    const std::vector<Element*>& getVisibleElements(const GLfloat frustum[6][4],
+						    const GLfloat* detail = NULL);
+
+    //! Return all the elements inside one of several frustums
+    /*!
+      The tree is traversed once for all the frustums: each node is only
+      tested against the frustums containing part of its parent, and the
+      subtrees fully inside all of them are added without testing their
+      nodes. getVisibleMasks() returns the frustums containing each
+      element.
+      \param frustums Six planes of each frustum, see getFrustumPlanes()
+      \param nbViews Number of frustums, at most maximumNumberOfViews
+      \param detail Point of view and size ratio culling the small and
+      distant elements of the first frustum only, or NULL
+    */
+    const std::vector<Element*>& getVisibleElements(const GLfloat frustums[][6][4],
+						    GLuint nbViews,
+						    const GLfloat* detail = NULL);
+
+    //! Returns the frustums containing each element of the last query
+    /*!
+      The bit i of a mask is set when the element is inside the frustum
+      i: the masks are in the order of the elements returned by
+      getVisibleElements().
+     */
+    const std::vector<GLuint>& getVisibleMasks() const;
+
+    //! Compute the planes of a frustum
+    /*!
+      The planes are normalized, and a point is inside a plane when
+      a * x + b * y + c * z + d > 0. They are in the order
+      right, left, bottom, top, far, near.
+      \param projection Projection matrix of frustum
+      \param modelview Modelview matrix of frustum
+      \param frustum Filled with the six planes of frustum
+    */
+    static void getFrustumPlanes(const gle::Matrix4<GLfloat>& projection,
+				 const gle::Matrix4<GLfloat>& modelview,
+				 GLfloat frustum[6][4]);
+
     private:
-    void threadNodeGeneration();
+    // Bounds of the element of a slot
+    struct Slot {
+      Vector3<GLfloat>	min;
+      Vector3<GLfloat>	max;
+      Vector3<GLfloat>	center;
+      GLfloat		radius;
+      GLfloat		drawDistance;
+      GLuint		code;
+    };
+
+    void			_computeCodes(GLuint task);
+    void			_sortCodes(GLuint nbTasks);
+    void			_storeElements(GLuint task);
+    GLuint			_buildNode(GLuint first, GLuint last, GLuint depth,
+					   GLuint parent, GLuint code);
+    GLuint			_getCode(const Vector3<GLfloat>& center) const;
+    Slot			_getSlot(Element* element) const;
+    GLuint			_allocateNode(GLuint parent, GLuint depth, GLuint code);
+    GLuint			_allocateBucket(GLuint node);
+    void			_setSlot(GLuint slot, Element* element, const Slot& data);
+    void			_clearSlot(GLuint slot);
+    void			_extendBounds(GLuint node, const Slot& data);
+    GLuint			_getChild(GLuint node, GLuint code);
+    GLuint			_insert(GLuint node, Element* element, const Slot& data);
+    GLuint			_update(Element* element);
+    void			_split(GLuint node);
+    void			_merge(GLuint node);
+    void			_collectSlots(GLuint node, std::vector<GLuint>& slots);
+    void			_releaseNode(GLuint node);
+    void			_clearBucketsRange(GLuint node);
+    bool			_isInLooseCell(GLuint node, const Vector3<GLfloat>& center) const;
+    void			_cull(GLuint nbViews);
+    void			_splitCull(GLuint index, GLuint viewMask,
+					   const GLuint* parentMasks);
+    void			_addCullTask(GLuint index, GLuint viewMask,
+					     const GLuint* planeMasks, bool subtree);
+    void			_runCullTask(GLuint index);
+    void			_gatherSlots(const std::vector<GLuint>& slots,
+					     std::vector<Element*>& elements,
+					     std::vector<GLuint>& masks);
+    void			_cullNode(GLuint index, GLuint viewMask,
+					  const GLuint* parentMasks,
+					  std::vector<GLuint>& visible);
+    void			_cullBuckets(GLuint index, GLuint viewMask,
+					     const GLuint* planeMasks, bool subtree,
+					     GLuint& first, GLuint& last,
+					     std::vector<GLuint>& visible);
+    void			_cullSlots(GLuint viewMask, const GLuint* planeMasks,
+					   GLuint first, GLuint last,
+					   std::vector<GLuint>& visible);
+    void			_clearDebugNodes();
+    bool			_isQueryCached(const GLfloat* frustums, GLuint nbViews,
+					       const GLfloat* detail) const;
+    void			_setDetail(const GLfloat* detail);
 
-    void			_addDebugNode(Node* node);
-    Node*			_root;
-    std::atomic<int>		_nbThreads;
-    GLfloat			_frustum[6][4];
+    WorkerPool			_pool;
+    GLfloat			_frustums[maximumNumberOfViews][6][4];
+    GLuint			_nbViews;
+    GLfloat			_detail[4];
+    const GLfloat*		_queryDetail;
     std::list<Element*>		_elementsInFrustum;
-    std::map<Element*, bool>	_alreadyDone;
+    Material*			_debugMaterial;
     std::vector<Mesh*>		_debugNodes;
 
-    std::thread*			_threadPool[maximumNumberOfThreads];
-    std::queue<std::pair<Node*, int>>	_tasksQueue;
-    std::mutex				_tasksQueueAccess;
-    std::mutex				_listEmptyAccess;
+    GLfloat			_looseness;
+    std::vector<Node>		_nodes;
+    std::vector<GLuint>		_freeNodes;
+    GLuint			_nbAllocatedNodes;
+
+    // Slots of the elements, with the leaf and the next bucket of each bucket
+    std::vector<Element*>	_elements;
+    std::vector<Slot>		_slots;
+    BoundsArray			_bounds;
+    std::vector<GLuint>		_bucketsNodes;
+    std::vector<GLuint>		_bucketsNext;
+    std::vector<GLuint>		_freeBuckets;
+    std::unordered_map<Element*, GLuint>	_elementsSlots;
+
+    // Slots of the sorted elements, and the stamps of the slots found
+    // in the list of updateTree()
+    std::vector<GLuint>		_sortedSlots;
+    std::vector<GLuint>		_stamps;
+    GLuint			_stamp;
+
+    // Version of the elements, and version and number of frustums of the
+    // last query, whose results are still valid while they are equal
+    GLuint			_version;
+    GLuint			_queryVersion;
+    GLuint			_queryNbViews;
+
+    // Elements in the order of generateTree(), with their bounds
+    std::vector<Element*>		_unsortedElements;
+    std::vector<Vector3<GLfloat> >	_mins;
+    std::vector<Vector3<GLfloat> >	_maxs;
+    std::vector<Vector3<GLfloat> >	_centers;
+    std::vector<GLfloat>		_radiuses;
+    std::vector<GLfloat>		_drawDistances;
+
+    // Morton codes, sorted with the index of their element in
+    // _unsortedElements, and the buffers of the radix sort
+    Vector3<GLfloat>		_codesOrigin;
+    Vector3<GLfloat>		_codesScale;
+    std::vector<GLuint>		_codes;
+    std::vector<GLuint>		_indexes;
+    std::vector<GLuint>		_sortedCodes;
+    std::vector<GLuint>		_sortedIndexes;
+    std::vector<GLuint>		_histograms;
+
+    // Slots of the visible elements of the current query, with the
+    // views containing each slot when there are several views
+    std::vector<GLuint>		_visibleIndexes;
+    std::vector<GLuint>		_slotsMasks;
+    std::vector<Element*>	_visibleElements;
+    std::vector<GLuint>		_visibleMasks;
+
+    // Subtree culled by a worker, or buckets of a node when subtree is
+    // false, with the visible elements of its part of the traversal
+    struct CullTask {
+      GLuint			node;
+      GLuint			viewMask;
+      GLuint			planeMasks[maximumNumberOfViews];
+      bool			subtree;
+      GLuint			offset;
+      std::vector<GLuint>	indexes;
+      std::vector<Element*>	elements;
+      std::vector<GLuint>	masks;
+    };
 
-    std::atomic<int>			_threadIsComputing;
-    std::atomic<bool>			_hasFinished;
-    std::mutex				_generateDone;
+    std::vector<CullTask>	_cullTasks;
+    GLuint			_nbCullTasks;
   };
 }
 
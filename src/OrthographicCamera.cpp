@@ -33,6 +33,19 @@ gle::OrthographicCamera::OrthographicCamera(gle::Vector3<GLfloat> const& positio
 
 }
 
+void gle::OrthographicCamera::setClippingPlanes(GLfloat near, GLfloat far,
+						GLfloat left, GLfloat right,
+						GLfloat bottom, GLfloat top)
+{
+  _near = near;
+  _far = far;
+  _left = left;
+  _right = right;
+  _bottom = bottom;
+  _top = top;
+  updateProjectionMatrix();
+}
+
 void gle::OrthographicCamera::updateProjectionMatrix()
 {
   _projectionMatrix = gle::Matrix4<GLfloat>::orthographic(_near, _far, _left, _right, _bottom, _top);
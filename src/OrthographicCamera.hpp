@@ -58,6 +58,20 @@ namespace gle {
 
     ~OrthographicCamera(){}
 
+    //! Set the clipping planes of the camera
+    /*!
+      \param near Distance to the near clipping plane
+      \param far Distance to the far clipping plane
+      \param left Distance to the left clipping plane
+      \param right Distance to the right clipping plane
+      \param bottom Distance to the bottom clipping plane
+      \param top Distance to the top clipping plane
+     */
+
+    void setClippingPlanes(GLfloat near, GLfloat far,
+			   GLfloat left, GLfloat right,
+			   GLfloat bottom, GLfloat top);
+
     //! Update the projection matrix associated with the camera
 
     virtual void updateProjectionMatrix();
@@ -8,12 +8,29 @@
 // Last update Tue Jun  5 20:20:11 2012 loick michard
 //
 
+#include <cmath>
+#include <algorithm>
 #include <PointLight.hpp>
 
+namespace {
+  // Rows of the rotation of the view matrix of each face:
+  // right, up and back vectors, following the OpenGL cube maps conventions
+  const GLfloat	PointLightFacesAxes[gle::PointLight::NbFaces][9] = {
+    {0, 0, -1,	0, -1, 0,	-1, 0, 0},
+    {0, 0, 1,	0, -1, 0,	1, 0, 0},
+    {1, 0, 0,	0, 0, 1,	0, -1, 0},
+    {1, 0, 0,	0, 0, -1,	0, 1, 0},
+    {1, 0, 0,	0, -1, 0,	0, 0, -1},
+    {-1, 0, 0,	0, -1, 0,	0, 0, 1}
+  };
+}
+
 gle::PointLight::PointLight(Vector3<GLfloat> const& position,
 			    Color<GLfloat> const& color,
 			    Color<GLfloat> const& specularColor)
-  : gle::Light(gle::Light::POINT)
+  : gle::Light(gle::Light::POINT), _shadowMapNear(1), _shadowMapFar(1000),
+    _facesFar(1000), _shadowMapLayer(-1), _shadowMapLayerSize(0),
+    _shadowMapPosition(), _shadowMapProjection()
 {
   _color[0] = color.r;
   _color[1] = color.g;
@@ -27,7 +44,9 @@ gle::PointLight::PointLight(Vector3<GLfloat> const& position,
 
 gle::PointLight::PointLight(Vector3<GLfloat> const& position,
                             Color<GLfloat> const& color)
-  : gle::Light(gle::Light::POINT)
+  : gle::Light(gle::Light::POINT), _shadowMapNear(1), _shadowMapFar(1000),
+    _facesFar(1000), _shadowMapLayer(-1), _shadowMapLayerSize(0),
+    _shadowMapPosition(), _shadowMapProjection()
 {
   _color[0] = color.r;
   _color[1] = color.g;
@@ -84,3 +103,106 @@ void gle::PointLight::update()
 {
 
 }
+
+void gle::PointLight::getUniforms(GLfloat* uniforms)
+{
+  const gle::Vector3<GLfloat>& position = getAbsolutePosition();
+
+  gle::Light::getUniforms(uniforms);
+  uniforms[0] = position.x;
+  uniforms[1] = position.y;
+  uniforms[2] = position.z;
+  for (int i = 0; i < 3; ++i)
+    {
+      uniforms[8 + i] = _color[i];
+      uniforms[12 + i] = _specularColor[i];
+      uniforms[16 + i] = _attenuation[i];
+    }
+  if (projectShadow() && _shadowMapLayer >= 0)
+    {
+      uniforms[4] = _shadowMapNear;
+      uniforms[5] = _facesFar;
+      // Two texels of the center of a face, relative to the distance
+      uniforms[6] = 4.0 / _shadowMapLayerSize;
+      uniforms[7] = _shadowMapLayer;
+      uniforms[15] = 1;
+    }
+}
+
+void gle::PointLight::setShadowMapClippingPlanes(GLfloat near, GLfloat far)
+{
+  _shadowMapNear = near;
+  _shadowMapFar = far;
+}
+
+void gle::PointLight::setShadowMapLayer(GLint layer, GLuint size)
+{
+  _shadowMapLayer = layer;
+  _shadowMapLayerSize = size;
+}
+
+GLint gle::PointLight::getShadowMapLayer() const
+{
+  return (_shadowMapLayer);
+}
+
+void gle::PointLight::updateShadowMapFaces(GLfloat range)
+{
+  const gle::Vector3<GLfloat>& p = getAbsolutePosition();
+
+  _facesFar = _shadowMapFar;
+  if (range >= 0)
+    _facesFar = std::max(std::min(_facesFar, range), _shadowMapNear * 2);
+  _shadowMapPosition = p;
+  _shadowMapProjection = gle::Matrix4<GLfloat>::perspective(90, 1, _shadowMapNear,
+							      _facesFar);
+  for (GLuint face = 0; face < NbFaces; ++face)
+    {
+      const GLfloat* a = PointLightFacesAxes[face];
+
+      _facesViewMatrices[face] =
+	gle::Matrix4<GLfloat>(a[0], a[1], a[2], -(a[0] * p.x + a[1] * p.y + a[2] * p.z),
+			      a[3], a[4], a[5], -(a[3] * p.x + a[4] * p.y + a[5] * p.z),
+			      a[6], a[7], a[8], -(a[6] * p.x + a[7] * p.y + a[8] * p.z),
+			      0, 0, 0, 1);
+    }
+}
+
+const gle::Matrix4<GLfloat>& gle::PointLight::getShadowMapProjection() const
+{
+  return (_shadowMapProjection);
+}
+
+const gle::Matrix4<GLfloat>& gle::PointLight::getFaceViewMatrix(GLuint face) const
+{
+  return (_facesViewMatrices[face]);
+}
+
+GLuint gle::PointLight::getFacesMask(const Vector3<GLfloat>& min,
+				     const Vector3<GLfloat>& max) const
+{
+  const gle::Vector3<GLfloat>& p = _shadowMapPosition;
+  GLfloat	boxMin[3] = {min.x - p.x, min.y - p.y, min.z - p.z};
+  GLfloat	boxMax[3] = {max.x - p.x, max.y - p.y, max.z - p.z};
+  GLfloat	closest[3];
+  GLuint	mask = 0;
+
+  // Closest distance of the box to the light on each axis
+  for (int axis = 0; axis < 3; ++axis)
+    closest[axis] = (boxMin[axis] <= 0 && boxMax[axis] >= 0) ? 0
+      : std::min(fabs(boxMin[axis]), fabs(boxMax[axis]));
+  // A face along an axis sees the points farther on its axis than on the others,
+  // between its near and far planes
+  for (int axis = 0; axis < 3; ++axis)
+    for (int side = 0; side < 2; ++side)
+      {
+	GLfloat farthest = side ? -boxMin[axis] : boxMax[axis];
+	GLfloat nearest = side ? -boxMax[axis] : boxMin[axis];
+	GLfloat depth = std::min(farthest, _facesFar);
+
+	if (depth >= _shadowMapNear && nearest <= _facesFar
+	    && depth >= closest[(axis + 1) % 3] && depth >= closest[(axis + 2) % 3])
+	  mask |= 1 << (axis * 2 + side);
+      }
+  return (mask);
+}
@@ -15,17 +15,26 @@
 # include <Light.hpp>
 # include <Vector3.hpp>
 # include <Color.hpp>
+# include <Matrix4.hpp>
 
 namespace gle {
 
   //! Point light class
   /*!
     This class enables to create a point light, with a position, a color, and a specular color.
+
+    The shadows of a point light are rendered in the six faces of a cube
+    around it, each a 90 degrees perspective along one axis (+X, -X, +Y,
+    -Y, +Z, -Z). The faces are consecutive layers of the point shadow maps
+    of the scene, and are all rendered in a single pass.
   */
 
   class PointLight : public Light {
   public:
 
+    //! Number of faces of the cube shadow map
+    static const GLuint NbFaces = 6;
+
     //! Construct a point light
     /*!
       \param position Position of the light
@@ -86,10 +95,67 @@ namespace gle {
     //! Update tranformation
     virtual void update();
 
+    //! Write the parameters of the light in the lights uniform block layout
+    /*!
+      When the light has a shadow map, the direction holds the near
+      plane, the far plane and the depth bias of the faces, and the
+      layer of the first face in w.
+     */
+    void getUniforms(GLfloat* uniforms);
+
+    //! Set the near and far planes of the faces of the shadow map
+    /*!
+      The far plane is brought to the range of the light when it is shorter.
+      \param near Distance to the near plane (1 by default)
+      \param far Distance to the far plane (1000 by default)
+     */
+    void setShadowMapClippingPlanes(GLfloat near, GLfloat far);
+
+    //! Set the layers of the point shadow maps where the faces are rendered
+    /*!
+      \param layer Layer of the first face, or -1 to disable the shadows
+      \param size Width and height of the faces
+     */
+    void setShadowMapLayer(GLint layer, GLuint size);
+
+    //! Return the layer of the first face, or -1 if the light has no shadow map
+    GLint getShadowMapLayer() const;
+
+    //! Update the matrices of the faces from the position of the light
+    /*!
+      \param range Distance after which the light has no effect,
+      or a negative value for an infinite range
+     */
+    void updateShadowMapFaces(GLfloat range);
+
+    //! Return the projection matrix shared by the faces
+    const Matrix4<GLfloat>& getShadowMapProjection() const;
+
+    //! Return the view matrix of a face
+    const Matrix4<GLfloat>& getFaceViewMatrix(GLuint face) const;
+
+    //! Return the faces reached by a box, one bit per face
+    /*!
+      \param min Lowest world coordinates of the box
+      \param max Highest world coordinates of the box
+     */
+    GLuint getFacesMask(const Vector3<GLfloat>& min,
+			const Vector3<GLfloat>& max) const;
+
   private:
     GLfloat _color[3];
     GLfloat _specularColor[3];
     GLfloat _attenuation[3];
+
+    GLfloat		_shadowMapNear;
+    GLfloat		_shadowMapFar;
+    // Far plane of the faces, brought to the range of the light
+    GLfloat		_facesFar;
+    GLint		_shadowMapLayer;
+    GLuint		_shadowMapLayerSize;
+    Vector3<GLfloat>	_shadowMapPosition;
+    Matrix4<GLfloat>	_shadowMapProjection;
+    Matrix4<GLfloat>	_facesViewMatrices[NbFaces];
   };
 }
 
@@ -0,0 +1,100 @@
+//
+// PointShadowMaps.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:44:19 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <PointShadowMaps.hpp>
+#include <PointLight.hpp>
+#include <Texture.hpp>
+#include <FrameBuffer.hpp>
+
+gle::PointShadowMaps::PointShadowMaps(GLuint maxLights, GLuint size) :
+  _maxLights(maxLights), _size(size), _texture(NULL), _frameBuffer(NULL),
+  _layerFrameBuffer(NULL), _layer(-1)
+{
+}
+
+gle::PointShadowMaps::~PointShadowMaps()
+{
+  _clearTextures();
+}
+
+void gle::PointShadowMaps::setMaxLights(GLuint maxLights)
+{
+  _clearTextures();
+  _maxLights = maxLights;
+}
+
+GLuint gle::PointShadowMaps::getMaxLights() const
+{
+  return (_maxLights);
+}
+
+void gle::PointShadowMaps::setSize(GLuint size)
+{
+  _clearTextures();
+  _size = size;
+}
+
+GLuint gle::PointShadowMaps::getSize() const
+{
+  return (_size);
+}
+
+gle::Texture* gle::PointShadowMaps::getTexture()
+{
+  if (!_texture && _maxLights > 0)
+    {
+      _texture = new gle::Texture(_size, _size,
+				  _maxLights * gle::PointLight::NbFaces,
+				  gle::Texture::Texture2DArray,
+				  gle::Texture::Depth);
+      _texture->setUseMipmap(false);
+      _texture->setFilterType(gle::Texture::Nearest);
+    }
+  return (_texture);
+}
+
+gle::FrameBuffer* gle::PointShadowMaps::getFrameBuffer()
+{
+  if (!_frameBuffer && getTexture())
+    {
+      _frameBuffer = new gle::FrameBuffer();
+      _frameBuffer->attach(*_texture, gle::FrameBuffer::AttachmentDepth);
+    }
+  return (_frameBuffer);
+}
+
+gle::FrameBuffer* gle::PointShadowMaps::getLayerFrameBuffer(GLuint layer)
+{
+  if (!getTexture())
+    return (NULL);
+  if (!_layerFrameBuffer)
+    _layerFrameBuffer = new gle::FrameBuffer();
+  if (_layer != (GLint)layer)
+    {
+      _layerFrameBuffer->attach(*_texture, gle::FrameBuffer::AttachmentDepth,
+				layer);
+      _layer = layer;
+    }
+  return (_layerFrameBuffer);
+}
+
+void gle::PointShadowMaps::_clearTextures()
+{
+  if (_frameBuffer)
+    delete _frameBuffer;
+  if (_layerFrameBuffer)
+    delete _layerFrameBuffer;
+  if (_texture)
+    delete _texture;
+  _frameBuffer = NULL;
+  _layerFrameBuffer = NULL;
+  _texture = NULL;
+  _layer = -1;
+}
@@ -0,0 +1,101 @@
+//
+// PointShadowMaps.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:44:19 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_POINT_SHADOW_MAPS_HPP_
+# define _GLE_POINT_SHADOW_MAPS_HPP_
+
+# include <gle/opengl.h>
+
+namespace gle {
+
+  class Texture;
+  class FrameBuffer;
+
+  //! Depth texture array containing the cube shadow maps of point lights
+  /*!
+    Each point light with a shadow uses PointLight::NbFaces consecutive
+    layers of the array, one per face of its cube.
+    OpenGL 3.3 has no cube map arrays, so the shaders select the face
+    and its layer themselves.
+
+    The framebuffer returned by getFrameBuffer() is layered: the geometry
+    shader of the point shadow maps chooses the layer of each triangle.
+    The layers are cleared one by one through getLayerFrameBuffer().
+
+    The texture and framebuffers are created the first time they are
+    requested.
+   */
+
+  class PointShadowMaps {
+  public:
+
+    //! Create the shadow maps
+    /*!
+      \param maxLights Maximum number of point lights with a shadow
+      \param size Width and height of the faces
+     */
+
+    PointShadowMaps(GLuint maxLights = 4, GLuint size = 512);
+
+    //! Destroy the shadow maps and their texture
+
+    ~PointShadowMaps();
+
+    //! Set the maximum number of point lights with a shadow
+    /*!
+      The texture is created again.
+     */
+
+    void setMaxLights(GLuint maxLights);
+
+    //! Returns the maximum number of point lights with a shadow
+
+    GLuint getMaxLights() const;
+
+    //! Set the width and height of the faces
+    /*!
+      The texture is created again.
+     */
+
+    void setSize(GLuint size);
+
+    //! Returns the width and height of the faces
+
+    GLuint getSize() const;
+
+    //! Returns the depth texture array
+
+    gle::Texture* getTexture();
+
+    //! Returns the layered framebuffer rendering in all the layers
+
+    gle::FrameBuffer* getFrameBuffer();
+
+    //! Returns the framebuffer rendering in a single layer
+    /*!
+      \param layer Layer attached to the framebuffer
+     */
+
+    gle::FrameBuffer* getLayerFrameBuffer(GLuint layer);
+
+  private:
+    void		_clearTextures();
+
+    GLuint		_maxLights;
+    GLuint		_size;
+
+    gle::Texture*	_texture;
+    gle::FrameBuffer*	_frameBuffer;
+    gle::FrameBuffer*	_layerFrameBuffer;
+    GLint		_layer;
+  };
+}
+
+#endif /* _GLE_POINT_SHADOW_MAPS_HPP_ */
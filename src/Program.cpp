@@ -10,10 +10,50 @@
 
 #include <Program.hpp>
 #include <Exception.hpp>
+#include <Debug.hpp>
+#include <StateCache.hpp>
+#include <Extensions.hpp>
+
+const GLchar* const gle::Program::UniformNames[gle::Program::NbUniforms] = {
+  "gle_MWMatrix",
+  "gle_ViewMatrix",
+  "gle_PMatrix",
+  "gle_MVMatrix",
+  "gle_CameraPos",
+  "gle_fogColor",
+  "gle_fogDensity",
+  "gle_colorMap",
+  "gle_normalMap",
+  "gle_cubeMap",
+  "gle_bonesMatrix",
+  "gle_color",
+  "gle_shadowAtlas",
+  "gle_clusterDepth",
+  "gle_cascadesShadowMap",
+  "gle_cascadesMatrices",
+  "gle_cascadesSplits",
+  "gle_cascadesBiases",
+  "gle_pointShadowMaps",
+  "gle_cubeFacesMatrices",
+  "gle_cubeFacesMask",
+  "gle_cubeFirstLayer"
+};
+
+const GLchar* const gle::Program::UniformBlockNames[gle::Program::NbUniformBlocks] = {
+  "gle_staticMeshesBlock",
+  "gle_materialBlock",
+  "gle_lightsBlock",
+  "gle_lightClustersBlock"
+};
 
 gle::Program::Program() :
-  _id(0), _currentUniformBlockBinding(0)
+  _id(0), _currentUniformBlockBinding(0), _linking(false), _linked(false),
+  _shaders()
 {
+  for (GLuint i = 0; i < NbUniforms; ++i)
+    _uniforms[i] = -1;
+  for (GLuint i = 0; i < NbUniformBlocks; ++i)
+    _uniformBlocks[i] = 0;
   _id = glCreateProgram();
   if (_id == 0)
     throw new gle::Exception::OpenGLError("Cannot create program");
@@ -22,31 +62,124 @@ gle::Program::Program() :
 gle::Program::~Program()
 {
   glDeleteProgram(_id);
+  gle::StateCache::getInstance().forgetProgram(_id);
 }
 
 void gle::Program::attach(Shader const & shader)
 {
   glAttachShader(_id, shader.getId());
-  GLenum error = glGetError();
+  GLenum error = GLE_GET_ERROR();
   if (error == GL_INVALID_OPERATION)
     throw new gle::Exception::InvalidOperation("Trying to attach a shader already attached to a program");
   else if (error != GL_NO_ERROR)
     throw new gle::Exception::OpenGLError();
+  _shaders.push_back(shader.getId());
 }
 
 void gle::Program::link()
 {
-  GLint status;
+  linkAsync();
+  _checkLinkStatus();
+}
 
+void gle::Program::linkAsync()
+{
   glLinkProgram(_id);
-  GLenum error = glGetError();
+  GLenum error = GLE_GET_ERROR();
   if (error == GL_INVALID_OPERATION)
     throw new gle::Exception::InvalidOperation("Cannot link the program");
   else if (error != GL_NO_ERROR)
     throw new gle::Exception::OpenGLError();
+  _linking = true;
+  _linked = false;
+}
+
+bool gle::Program::isReady()
+{
+  if (!_linking)
+    return (_linked);
+  if (gle::Extensions::hasParallelShaderCompile())
+    {
+      GLint completed = GL_FALSE;
+      glGetProgramiv(_id, GL_COMPLETION_STATUS_KHR, &completed);
+      if (completed != GL_TRUE)
+	return (false);
+    }
+  _checkLinkStatus();
+  return (true);
+}
+
+void gle::Program::_checkLinkStatus()
+{
+  GLint status;
+
+  _linking = false;
+  glGetProgramiv(_id, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE)
+    {
+      // Report the errors of the shaders compiled asynchronously first
+      for (GLuint shader : _shaders)
+	{
+	  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	  if (status != GL_TRUE)
+	    {
+	      GLint length = 0;
+	      glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+	      std::string infoLog(length > 0 ? length : 1, '\0');
+	      glGetShaderInfoLog(shader, infoLog.size(), NULL, &infoLog[0]);
+	      throw new gle::Exception::CompilationError(infoLog.c_str());
+	    }
+	}
+      throw new gle::Exception::LinkageError(getInfoLog());
+    }
+  _linked = true;
+  _retreiveUniforms();
+}
+
+void gle::Program::setBinaryRetrievable(bool retrievable)
+{
+  glProgramParameteri(_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+		      retrievable ? GL_TRUE : GL_FALSE);
+}
+
+bool gle::Program::getBinary(GLenum& format, std::vector<char>& binary) const
+{
+  GLint length = 0;
+
+  glGetProgramiv(_id, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return (false);
+  binary.resize(length);
+  glGetProgramBinary(_id, length, &length, &format, &binary[0]);
+  if (GLE_GET_ERROR() != GL_NO_ERROR || length <= 0)
+    return (false);
+  binary.resize(length);
+  return (true);
+}
+
+bool gle::Program::loadBinary(GLenum format, const GLvoid* binary, GLsizei length)
+{
+  GLint status = GL_FALSE;
+
+  glProgramBinary(_id, format, binary, length);
   glGetProgramiv(_id, GL_LINK_STATUS, &status);
   if (status != GL_TRUE)
-    throw new gle::Exception::LinkageError(getInfoLog());
+    {
+      // An unsupported format raises an error that must not be
+      // reported by the next check
+      glGetError();
+      return (false);
+    }
+  _linking = false;
+  _linked = true;
+  _retreiveUniforms();
+  return (true);
+}
+
+void gle::Program::_retreiveUniforms()
+{
+  for (GLuint i = 0; i < NbUniforms; ++i)
+    _uniforms[i] = glGetUniformLocation(_id, UniformNames[i]);
 }
 
 std::string gle::Program::getInfoLog() const
@@ -65,8 +198,8 @@ std::string gle::Program::getInfoLog() const
 
 void gle::Program::use() const
 {
-  glUseProgram(_id);
-  GLenum error = glGetError();
+  gle::StateCache::getInstance().useProgram(_id);
+  GLenum error = GLE_GET_ERROR();
   if (error == GL_INVALID_OPERATION)
     throw new gle::Exception::InvalidOperation("Program cannot be used");
   else if (error != GL_NO_ERROR)
@@ -79,7 +212,7 @@ GLint gle::Program::getUniformLocation(const GLchar *name)
   _uniformLocations[name] = location;
   if (location == -1)
     throw new gle::Exception::InvalidOperation(std::string(name) + ": Uniform doesn't exists");
-  else if (glGetError() != GL_NO_ERROR)
+  else if (GLE_GET_ERROR() != GL_NO_ERROR)
     throw new gle::Exception::OpenGLError();
   return (location);
 }
@@ -158,11 +291,16 @@ void gle::Program::setUniform(const GLchar* uniform, const gle::Vector3f& value)
 
 void gle::Program::retreiveUniformBlockIndex(const std::string &name)
 {
+  if (_uniformBlockIndexes.find(name) != _uniformBlockIndexes.end())
+    return ;
   _uniformBlockIndexes[name] = glGetUniformBlockIndex(_id, name.c_str());
   _uniformBlockBindings[name] = _currentUniformBlockBinding;
   glUniformBlockBinding(_id,
                         _uniformBlockIndexes[name],
                         _uniformBlockBindings[name]);
+  for (GLuint i = 0; i < NbUniformBlocks; ++i)
+    if (name == UniformBlockNames[i])
+      _uniformBlocks[i] = _currentUniformBlockBinding;
   _currentUniformBlockBinding += 1;
 }
 
@@ -175,3 +313,63 @@ GLuint gle::Program::getUniformBlockBinding(const std::string &name)
 {
   return (_uniformBlockBindings[name]);
 }
+
+void gle::Program::setUniform(Uniform uniform, const Matrix4<GLfloat> & matrix)
+{
+  glUniformMatrix4fv(_uniforms[uniform], 1, GL_FALSE, (const GLfloat*)matrix);
+}
+
+void gle::Program::setUniform(Uniform uniform, const Matrix3<GLfloat> & matrix)
+{
+  glUniformMatrix3fv(_uniforms[uniform], 1, GL_FALSE, (const GLfloat*)matrix);
+}
+
+void gle::Program::setUniform3(Uniform uniform, const GLfloat* values,
+				GLsizeiptr size)
+{
+  glUniform3fv(_uniforms[uniform], size, values);
+}
+
+void gle::Program::setUniform1(Uniform uniform, const GLfloat* values,
+				GLsizeiptr size)
+{
+  glUniform1fv(_uniforms[uniform], size, values);
+}
+
+void gle::Program::setUniform1(Uniform uniform, const GLint* values,
+				GLsizeiptr size)
+{
+  glUniform1iv(_uniforms[uniform], size, values);
+}
+
+void gle::Program::setUniformMatrix4v(Uniform uniform, const GLfloat* values,
+				      GLsizeiptr count)
+{
+  glUniformMatrix4fv(_uniforms[uniform], count, GL_FALSE, values);
+}
+
+void gle::Program::setUniform(Uniform uniform,
+			      gle::Color<GLfloat> const & color)
+{
+  glUniform3f(_uniforms[uniform], color.r, color.g, color.b);
+}
+
+void gle::Program::setUniform(Uniform uniform, GLfloat value)
+{
+  glUniform1f(_uniforms[uniform], value);
+}
+
+void gle::Program::setUniform(Uniform uniform, TextureUnit texture)
+{
+  glUniform1i(_uniforms[uniform], texture);
+}
+
+void gle::Program::setUniform(Uniform uniform, bool value)
+{
+  glUniform1i(_uniforms[uniform], (value) ? 1 : 0);
+}
+
+void gle::Program::setUniform(Uniform uniform, const gle::Vector3f& value)
+{
+  glUniform3f(_uniforms[uniform], value.x, value.y, value.z);
+}
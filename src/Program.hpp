@@ -39,10 +39,92 @@ namespace gle {
       NormalMapTextureIndex = 1,
       CubeMapTexture = GL_TEXTURE2,
       CubeMapTextureIndex = 2,
-      ShadowMapsTextures = GL_TEXTURE3,
-      ShadowMapsTexturesIndexes = 3
+      ShadowAtlasTexture = GL_TEXTURE3,
+      ShadowAtlasTextureIndex = 3,
+      CascadesShadowMapTexture = GL_TEXTURE4,
+      CascadesShadowMapTextureIndex = 4,
+      PointShadowMapsTexture = GL_TEXTURE5,
+      PointShadowMapsTextureIndex = 5
     };
     
+    //! Uniforms used by the engine shaders
+    /*!
+      Their locations are retreived once when the program is linked,
+      so they can be set without any lookup by name.
+      Uniforms absent from the program have the location -1,
+      and setting them has no effect.
+     */
+
+    enum Uniform {
+      MWMatrix,
+      /*!< gle_MWMatrix */
+      ViewMatrix,
+      /*!< gle_ViewMatrix */
+      PMatrix,
+      /*!< gle_PMatrix */
+      MVMatrix,
+      /*!< gle_MVMatrix */
+      CameraPos,
+      /*!< gle_CameraPos */
+      FogColor,
+      /*!< gle_fogColor */
+      FogDensity,
+      /*!< gle_fogDensity */
+      ColorMap,
+      /*!< gle_colorMap */
+      NormalMap,
+      /*!< gle_normalMap */
+      CubeMap,
+      /*!< gle_cubeMap */
+      BonesMatrix,
+      /*!< gle_bonesMatrix */
+      Color,
+      /*!< gle_color */
+      ShadowAtlas,
+      /*!< gle_shadowAtlas */
+      ClusterDepth,
+      /*!< gle_clusterDepth */
+      CascadesShadowMap,
+      /*!< gle_cascadesShadowMap */
+      CascadesMatrices,
+      /*!< gle_cascadesMatrices */
+      CascadesSplits,
+      /*!< gle_cascadesSplits */
+      CascadesBiases,
+      /*!< gle_cascadesBiases */
+      PointShadowMaps,
+      /*!< gle_pointShadowMaps */
+      CubeFacesMatrices,
+      /*!< gle_cubeFacesMatrices */
+      CubeFacesMask,
+      /*!< gle_cubeFacesMask */
+      CubeFirstLayer,
+      /*!< gle_cubeFirstLayer */
+      NbUniforms
+    };
+
+    //! Uniform blocks used by the engine shaders
+
+    enum UniformBlock {
+      StaticMeshesBlock,
+      /*!< gle_staticMeshesBlock */
+      MaterialBlock,
+      /*!< gle_materialBlock */
+      LightsBlock,
+      /*!< gle_lightsBlock */
+      LightClustersBlock,
+      /*!< gle_lightClustersBlock */
+      NbUniformBlocks
+    };
+
+    //! Names of the engine uniforms in the shaders, indexed by Uniform
+
+    static const GLchar* const UniformNames[NbUniforms];
+
+    //! Names of the engine uniform blocks in the shaders, indexed by UniformBlock
+
+    static const GLchar* const UniformBlockNames[NbUniformBlocks];
+
     //! Create a new OpenGL Program
     /*!
       Throw an OpenGLError if the program cannot be created
@@ -64,11 +146,56 @@ namespace gle {
 
     //! Link the program
     /*!
-      If an error occur, throw a LinkageError with the details of the error
+      If an error occur, throw a LinkageError with the details of the error.
+      Once linked, the locations of the engine uniforms are retreived.
     */
 
     void link();
 
+    //! Start linking the program without waiting for the result
+    /*!
+      The shaders may still be compiling (see Shader::compileAsync()).
+      isReady() tells when the program can be used.
+     */
+
+    void linkAsync();
+
+    //! Returns wether the program is linked and can be used
+    /*!
+      With KHR_parallel_shader_compile, the completion is polled without
+      blocking. Otherwise, the first call waits for the driver.
+      If the compilation of a shader failed, throw a CompilationError,
+      and if the linkage failed, throw a LinkageError.
+     */
+
+    bool isReady();
+
+    //! Allow the binary of the program to be retreived once linked
+    /*!
+      Must be called before link()
+     */
+
+    void setBinaryRetrievable(bool retrievable);
+
+    //! Retreive the binary of the linked program
+    /*!
+      Returns false if the binary is not available.
+      \param format Filled with the binary format of the program
+      \param binary Filled with the binary of the program
+     */
+
+    bool getBinary(GLenum& format, std::vector<char>& binary) const;
+
+    //! Load the program from a binary retreived by getBinary()
+    /*!
+      Replaces the linkage of the program.
+      Returns false if the binary is rejected (for example after a driver
+      update), in which case the program must be linked from its shaders.
+      Once loaded, the locations of the engine uniforms are retreived.
+     */
+
+    bool loadBinary(GLenum format, const GLvoid* binary, GLsizei length);
+
     //! Return the program the info log
     /*!
       Get the shader info log and returns it as a std::string.
@@ -140,11 +267,66 @@ namespace gle {
 
     void setUniform(const GLchar* uniform, const Vector3f& value);
 
+    //! Return the location of an engine uniform
+
+    GLint getUniformLocation(Uniform uniform) const
+    {
+      return (_uniforms[uniform]);
+    }
+
+    //! Set the value of a uniform matrix
+
+    void setUniform(Uniform uniform, const Matrix4<GLfloat> & matrix);
+
+    //! Set the value of a uniform matrix3
+
+    void setUniform(Uniform uniform, const Matrix3<GLfloat> & matrix);
+
+    //! Set the value of a uniform array of vec3
+
+    void setUniform3(Uniform uniform, const GLfloat* values, GLsizeiptr size);
+
+    //! Set the value of a uniform array of float
+
+    void setUniform1(Uniform uniform, const GLfloat* values, GLsizeiptr size);
+
+    //! Set the value of a uniform array of int
+
+    void setUniform1(Uniform uniform, const GLint* values, GLsizeiptr size);
+
+    //! Set the value of a uniform array of  matrix 4x4
+
+    void setUniformMatrix4v(Uniform uniform, const GLfloat* values,
+			    GLsizeiptr count);
+
+    //! Set the value of a uniform color
+
+    void setUniform(Uniform uniform, gle::Color<GLfloat> const & color);
+
+    //! Set a value of an uniform GLfloat
+
+    void setUniform(Uniform uniform, GLfloat value);
+
+    //! Set a value of an uniform texture
+
+    void setUniform(Uniform uniform, TextureUnit texture);
+
+    //! Set a value of an uniform bool
+
+    void setUniform(Uniform uniform, bool value);
+
+    //! Set the value of a uniform vector 3 of float
+
+    void setUniform(Uniform uniform, const Vector3f& value);
+
     //! Return the OpenGL Program identifier
 
     GLuint getId() const;
 
     //! Retrieve and store a uniform block index for future accessing
+    /*!
+      Does nothing if the block index is already retreived
+     */
 
     void retreiveUniformBlockIndex(const std::string& name);
 
@@ -156,13 +338,30 @@ namespace gle {
 
     GLuint getUniformBlockBinding(const std::string& name);
 
+    //! Return a previously defined binding point of an engine uniform block
+
+    GLuint getUniformBlockBinding(UniformBlock block) const
+    {
+      return (_uniformBlocks[block]);
+    }
+
   private:
+    void	_retreiveUniforms();
+    void	_checkLinkStatus();
+
     GLuint	_id;
     GLuint	_currentUniformBlockBinding;
+    bool	_linking;
+    bool	_linked;
+
+    std::vector<GLuint> _shaders;
 
     std::map<std::string, GLint> _uniformLocations;
     std::map<std::string, GLint> _uniformBlockIndexes;
     std::map<std::string, GLint> _uniformBlockBindings;
+
+    GLint	_uniforms[NbUniforms];
+    GLuint	_uniformBlocks[NbUniformBlocks];
   };
 
 }
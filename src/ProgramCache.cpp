@@ -0,0 +1,313 @@
+//
+// ProgramCache.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:00:37 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <ProgramCache.hpp>
+#include <Extensions.hpp>
+
+namespace {
+  const char	ProgramCacheMagic[8] = {'G', 'L', 'E', 'P', 'R', 'O', 'G', '1'};
+}
+
+gle::ProgramCache::ProgramCache() :
+  _programs(), _pendingPrograms(), _directory(), _driverIdentity(),
+  _memoryHits(0), _diskHits(0), _misses(0)
+{
+}
+
+gle::ProgramCache::~ProgramCache()
+{
+  // The programs are not deleted here, the OpenGL context
+  // is already destroyed when static objects are destructed
+}
+
+void gle::ProgramCache::setDirectory(std::string const & directory)
+{
+  _directory = directory;
+  if (!_directory.empty())
+    mkdir(_directory.c_str(), 0755);
+}
+
+std::string const & gle::ProgramCache::getDirectory() const
+{
+  return (_directory);
+}
+
+gle::Program* gle::ProgramCache::get(std::string const & vertexSource,
+				     std::string const & fragmentSource,
+				     std::string const & geometrySource)
+{
+  std::string key = _getKey(vertexSource, fragmentSource, geometrySource);
+  std::map<std::string, Program*>::iterator it = _programs.find(key);
+
+  if (it != _programs.end())
+    {
+      ++_memoryHits;
+      return (it->second);
+    }
+  Program* program = _load(key);
+  if (program)
+    {
+      ++_diskHits;
+      _programs[key] = program;
+      return (program);
+    }
+  ++_misses;
+  return (NULL);
+}
+
+gle::Program* gle::ProgramCache::prepare(std::string const & vertexSource,
+					 std::string const & fragmentSource,
+					 std::string const & geometrySource)
+{
+  Program* program = get(vertexSource, fragmentSource, geometrySource);
+
+  if (program)
+    return (program);
+
+  program = new Program();
+  Shader vertexShader(Shader::Vertex);
+  Shader fragmentShader(Shader::Fragment);
+  vertexShader.setSource(vertexSource);
+  fragmentShader.setSource(fragmentSource);
+  vertexShader.compileAsync();
+  fragmentShader.compileAsync();
+  program->attach(vertexShader);
+  program->attach(fragmentShader);
+  if (!geometrySource.empty())
+    {
+      Shader geometryShader(Shader::Geometry);
+      geometryShader.setSource(geometrySource);
+      geometryShader.compileAsync();
+      program->attach(geometryShader);
+    }
+  program->setBinaryRetrievable(true);
+  program->linkAsync();
+  // The shaders are only deleted by OpenGL once detached from the program
+
+  std::string key = _getKey(vertexSource, fragmentSource, geometrySource);
+  _programs[key] = program;
+  _pendingPrograms.push_back(key);
+  return (program);
+}
+
+void gle::ProgramCache::update()
+{
+  auto it = _pendingPrograms.begin();
+
+  while (it != _pendingPrograms.end())
+    {
+      Program* program = _programs[*it];
+      if (program->isReady())
+	{
+	  _save(*it, program);
+	  it = _pendingPrograms.erase(it);
+	}
+      else
+	++it;
+    }
+}
+
+bool gle::ProgramCache::hasPendingPrograms() const
+{
+  return (!_pendingPrograms.empty());
+}
+
+void gle::ProgramCache::store(std::string const & vertexSource,
+			      std::string const & fragmentSource,
+			      Program* program,
+			      std::string const & geometrySource)
+{
+  std::string key = _getKey(vertexSource, fragmentSource, geometrySource);
+  std::map<std::string, Program*>::iterator it = _programs.find(key);
+
+  if (it != _programs.end() && it->second != program)
+    delete it->second;
+  _programs[key] = program;
+  _save(key, program);
+}
+
+void gle::ProgramCache::clear()
+{
+  for (auto it = _programs.begin(); it != _programs.end(); ++it)
+    delete it->second;
+  _programs.clear();
+  _pendingPrograms.clear();
+}
+
+GLuint gle::ProgramCache::getMemoryHits() const
+{
+  return (_memoryHits);
+}
+
+GLuint gle::ProgramCache::getDiskHits() const
+{
+  return (_diskHits);
+}
+
+GLuint gle::ProgramCache::getMisses() const
+{
+  return (_misses);
+}
+
+bool gle::ProgramCache::_isDiskCacheAvailable()
+{
+  if (_directory.empty())
+    return (false);
+  if (!gle::Extensions::hasVersion(4, 1)
+      && !gle::Extensions::isSupported("GL_ARB_get_program_binary"))
+    return (false);
+
+  GLint nbFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbFormats);
+  return (nbFormats > 0);
+}
+
+std::string gle::ProgramCache::_getDriverIdentity()
+{
+  if (_driverIdentity.empty())
+    {
+      const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION,
+			      GL_SHADING_LANGUAGE_VERSION};
+      for (GLuint i = 0; i < sizeof(names) / sizeof(*names); ++i)
+	{
+	  const GLubyte* value = glGetString(names[i]);
+	  if (value)
+	    _driverIdentity += (const char*)value;
+	  _driverIdentity += '\n';
+	}
+    }
+  return (_driverIdentity);
+}
+
+std::string gle::ProgramCache::_getPath(std::string const & key) const
+{
+  std::stringstream path;
+
+  path << _directory << "/" << std::hex << _hash(key) << ".glp";
+  return (path.str());
+}
+
+gle::Program* gle::ProgramCache::_load(std::string const & key)
+{
+  if (!_isDiskCacheAvailable())
+    return (NULL);
+
+  std::ifstream file(_getPath(key).c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+    return (NULL);
+
+  char magic[sizeof(ProgramCacheMagic)];
+  GLuint identitySize = 0;
+  file.read(magic, sizeof(magic));
+  file.read((char*)&identitySize, sizeof(identitySize));
+  if (!file || !std::equal(magic, magic + sizeof(magic), ProgramCacheMagic))
+    return (NULL);
+
+  std::string identity(identitySize, '\0');
+  unsigned long long keyHash = 0;
+  GLuint keySize = 0;
+  GLenum format = 0;
+  GLuint length = 0;
+  file.read(&identity[0], identitySize);
+  file.read((char*)&keyHash, sizeof(keyHash));
+  file.read((char*)&keySize, sizeof(keySize));
+  file.read((char*)&format, sizeof(format));
+  file.read((char*)&length, sizeof(length));
+  // The binary is only valid for the same driver and the same sources
+  if (!file || identity != _getDriverIdentity()
+      || keyHash != _hash(key) || keySize != key.size() || length == 0)
+    return (NULL);
+
+  std::vector<char> binary(length);
+  file.read(&binary[0], length);
+  if (!file)
+    return (NULL);
+
+  Program* program = new Program();
+  if (!program->loadBinary(format, &binary[0], length))
+    {
+      delete program;
+      return (NULL);
+    }
+  return (program);
+}
+
+void gle::ProgramCache::_save(std::string const & key, Program* program)
+{
+  if (!_isDiskCacheAvailable())
+    return ;
+
+  GLenum format = 0;
+  std::vector<char> binary;
+  if (!program->getBinary(format, binary))
+    return ;
+
+  std::string identity = _getDriverIdentity();
+  std::string path = _getPath(key);
+  std::string tmpPath = path + ".tmp";
+  GLuint identitySize = identity.size();
+  unsigned long long keyHash = _hash(key);
+  GLuint keySize = key.size();
+  GLuint length = binary.size();
+
+  // Written in a temporary file first, so another process never reads
+  // a partial binary
+  std::ofstream file(tmpPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file)
+    return ;
+  file.write(ProgramCacheMagic, sizeof(ProgramCacheMagic));
+  file.write((const char*)&identitySize, sizeof(identitySize));
+  file.write(identity.data(), identitySize);
+  file.write((const char*)&keyHash, sizeof(keyHash));
+  file.write((const char*)&keySize, sizeof(keySize));
+  file.write((const char*)&format, sizeof(format));
+  file.write((const char*)&length, sizeof(length));
+  file.write(&binary[0], length);
+  file.close();
+  if (!file || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    std::remove(tmpPath.c_str());
+}
+
+std::string gle::ProgramCache::_getKey(std::string const & vertexSource,
+				       std::string const & fragmentSource,
+				       std::string const & geometrySource)
+{
+  std::string key = vertexSource;
+
+  key += '\0';
+  key += fragmentSource;
+  // Programs without geometry shader keep the keys of the binaries already saved
+  if (!geometrySource.empty())
+    {
+      key += '\0';
+      key += geometrySource;
+    }
+  return (key);
+}
+
+unsigned long long gle::ProgramCache::_hash(std::string const & str)
+{
+  // 64 bits FNV-1a
+  unsigned long long hash = 14695981039346656037ULL;
+
+  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+      hash ^= (unsigned char)*it;
+      hash *= 1099511628211ULL;
+    }
+  return (hash);
+}
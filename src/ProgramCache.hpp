@@ -0,0 +1,152 @@
+//
+// ProgramCache.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:00:37 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_PROGRAM_CACHE_HPP_
+# define _GLE_PROGRAM_CACHE_HPP_
+
+# include <list>
+# include <map>
+# include <string>
+# include <gle/opengl.h>
+# include <Singleton.hpp>
+# include <Program.hpp>
+
+namespace gle {
+
+  //! Cache of the linked programs, keyed by their shader sources
+  /*!
+    Each permutation of the engine shaders (number of lights, of bones...)
+    gives different sources once the constants are replaced, so a program
+    is compiled only once per permutation, and switching back to a
+    permutation already used costs nothing.
+
+    When a directory is set, the binaries of the linked programs are also
+    saved in it with glGetProgramBinary, and reloaded with glProgramBinary
+    by the next runs. A binary is only reused with the same driver
+    (vendor, renderer and version strings) and the same sources,
+    otherwise the program is compiled again.
+
+    Programs can also be prepared ahead of their first use: their shaders
+    are submitted to the driver without waiting, so they compile in the
+    background (in parallel with KHR_parallel_shader_compile) while the
+    renderer keeps drawing with the programs that are ready.
+
+    The cache owns the programs it contains.
+   */
+
+  class ProgramCache : public Singleton<ProgramCache> {
+    friend class Singleton<ProgramCache>;
+
+  public:
+
+    //! Set the directory where program binaries are saved
+    /*!
+      An empty path disables the on-disk cache (the default).
+      The directory is created if it doesn't exist.
+     */
+
+    void	setDirectory(std::string const & directory);
+
+    //! Returns the directory where program binaries are saved
+
+    std::string const & getDirectory() const;
+
+    //! Returns the program built from the sources, or NULL
+    /*!
+      The program is searched in memory, then on disk.
+      A program loaded from disk is linked, but the state set after
+      linkage (uniform block bindings...) must be set again.
+     */
+
+    Program*	get(std::string const & vertexSource,
+		    std::string const & fragmentSource,
+		    std::string const & geometrySource = "");
+
+    //! Returns the program built from the sources, starting its build if needed
+    /*!
+      The program is taken from memory or from disk, otherwise its shaders
+      are submitted for compilation without waiting for the result.
+      Program::isReady() tells when the program can be used.
+      The geometry shader is optional.
+     */
+
+    Program*	prepare(std::string const & vertexSource,
+			std::string const & fragmentSource,
+			std::string const & geometrySource = "");
+
+    //! Save the binaries of the prepared programs whose build is finished
+    /*!
+      Should be called once per frame.
+      Throw the compilation or linkage errors of these programs.
+     */
+
+    void	update();
+
+    //! Returns wether programs are still being built
+
+    bool	hasPendingPrograms() const;
+
+    //! Store a linked program built from the sources
+    /*!
+      The binary of the program is saved on disk if a directory is set.
+      For this, Program::setBinaryRetrievable(true) should have been called
+      before linking the program.
+     */
+
+    void	store(std::string const & vertexSource,
+		      std::string const & fragmentSource,
+		      Program* program,
+		      std::string const & geometrySource = "");
+
+    //! Delete all the programs of the cache
+    /*!
+      The files on disk are kept.
+     */
+
+    void	clear();
+
+    //! Returns the number of programs found in memory
+
+    GLuint	getMemoryHits() const;
+
+    //! Returns the number of programs loaded from disk
+
+    GLuint	getDiskHits() const;
+
+    //! Returns the number of programs that were not cached
+
+    GLuint	getMisses() const;
+
+  private:
+    ProgramCache();
+    ~ProgramCache();
+
+    bool		_isDiskCacheAvailable();
+    std::string		_getDriverIdentity();
+    std::string		_getPath(std::string const & key) const;
+    Program*		_load(std::string const & key);
+    void		_save(std::string const & key, Program* program);
+
+    static std::string	_getKey(std::string const & vertexSource,
+				std::string const & fragmentSource,
+				std::string const & geometrySource);
+    static unsigned long long	_hash(std::string const & str);
+
+    std::map<std::string, Program*>	_programs;
+    std::list<std::string>		_pendingPrograms;
+    std::string				_directory;
+    std::string				_driverIdentity;
+    GLuint				_memoryHits;
+    GLuint				_diskHits;
+    GLuint				_misses;
+  };
+}
+
+#endif /* _GLE_PROGRAM_CACHE_HPP_ */
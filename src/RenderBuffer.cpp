@@ -11,6 +11,8 @@
 #include "RenderBuffer.hpp"
 
 #include "Exception.hpp"
+#include "Debug.hpp"
+#include "StateCache.hpp"
 
 gle::RenderBuffer::RenderBuffer(Type type, GLuint width, GLuint height) :
   _id(0), _type(type), _width(width), _height(height)
@@ -23,12 +25,13 @@ gle::RenderBuffer::RenderBuffer(Type type, GLuint width, GLuint height) :
 gle::RenderBuffer::~RenderBuffer()
 {
   glDeleteRenderbuffers(1, &_id);
+  gle::StateCache::getInstance().forgetRenderbuffer(_id);
 }
 
 
 void gle::RenderBuffer::bind() const
 {
-  glBindRenderbuffer(GL_RENDERBUFFER, _id);
+  gle::StateCache::getInstance().bindRenderbuffer(_id);
 }
 
 void	gle::RenderBuffer::setStorage(GLuint width, GLuint height)
@@ -37,7 +40,7 @@ void	gle::RenderBuffer::setStorage(GLuint width, GLuint height)
   _width = width;
   _height = height;
   glRenderbufferStorage(GL_RENDERBUFFER, _type, _width, _height);
-  gle::Exception::CheckOpenGLError("glRenderbufferStorage()");
+  GLE_CHECK_OPENGL_ERROR("glRenderbufferStorage()");
 }
 
 GLuint	gle::RenderBuffer::getId() const
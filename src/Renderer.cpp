@@ -12,41 +12,47 @@
 #include <gle/opengl.h>
 #include <ShaderSource.hpp>
 #include <Exception.hpp>
+#include <Debug.hpp>
 #include <EnvironmentMap.hpp>
 #include <Camera.hpp>
+#include <VertexArray.hpp>
+#include <StateCache.hpp>
+#include <ProgramCache.hpp>
+#include <Light.hpp>
+#include <DirectionalLight.hpp>
+#include <PointShadowMaps.hpp>
+#include <Geometries.hpp>
 
 gle::Renderer::Renderer() :
   _currentProgram(NULL),
-  _shadowMapProgram(NULL),
-  _indexesBuffer(gle::Bufferui::ElementArray,
-		 gle::Bufferui::StaticDraw),
-  _debugMode(0), _debugProgram(NULL)
+  _shadowMapProgram(NULL), _pointShadowMapProgram(NULL),
+  _vertexArrays(), _vertexArraysBufferId(0), _meshAttributes(0),
+  _debugMode(0), _debugProgram(NULL), _queryBox(NULL)
 {
   // Set color and depth clear value
   glClearColor(0.f, 0.f, 0.f, 1.f);
   glClearDepth(1.f);
 
   // Enable Z-buffer read and write 
-  glEnable(GL_DEPTH_TEST);
-  glDepthMask(GL_TRUE);
+  gle::StateCache::getInstance().enable(GL_DEPTH_TEST);
+  gle::StateCache::getInstance().depthMask(GL_TRUE);
 
   // Backface culling
   //glEnable(GL_CULL_FACE);
   //glCullFace(GL_BACK);
 
   // Enable antialiasing
-  glEnable(GL_LINE_SMOOTH);
-  glEnable(GL_POLYGON_SMOOTH);
-  glEnable(GL_BLEND);
+  gle::StateCache::getInstance().enable(GL_LINE_SMOOTH);
+  gle::StateCache::getInstance().enable(GL_POLYGON_SMOOTH);
+  gle::StateCache::getInstance().enable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 gle::Renderer::~Renderer()
 {
-  if (_debugProgram)
-    delete _debugProgram;
-  if (_shadowMapProgram)
-    delete _shadowMapProgram;
+  _clearVertexArrays();
+  if (_queryBox)
+    delete _queryBox;
 }
 
 void gle::Renderer::clear()
@@ -59,11 +65,12 @@ void gle::Renderer::render(Scene* scene, const Rectf& size, FrameBuffer* customF
   gle::FrameBuffer& framebuffer = customFramebuffer 
     ? *customFramebuffer : gle::FrameBuffer::getDefaultFrameBuffer();
 
+  gle::ProgramCache::getInstance().update();
   scene->update();
   scene->updateShadowMaps(this);
 
   glViewport(size.x, size.y, size.width, size.height);
-  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  gle::StateCache::getInstance().colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
   framebuffer.bind();
 
@@ -80,130 +87,108 @@ void gle::Renderer::render(Scene* scene, const Rectf& size, FrameBuffer* customF
   if (!camera)
     throw (new gle::Exception::Exception("No camera for the scene..."));
 
-  _setCurrentProgram(scene);
+  // Nothing to draw until the scene program is compiled
+  if (!_setCurrentProgram(scene))
+    {
+      framebuffer.update();
+      return ;
+    }
   _setSceneUniforms(scene, camera);
 
 
   const std::list<gle::Mesh*> & staticMeshes = scene->getStaticMeshes();
   const std::list<gle::Mesh*> & dynamicMeshes = scene->getDynamicMeshes();
 
-  // Enable vertex attributes commons to all draws
-  glEnableVertexAttribArray(gle::ShaderSource::PositionLocation);
-  glEnableVertexAttribArray(gle::ShaderSource::NormalLocation);
-  glEnableVertexAttribArray(gle::ShaderSource::TangentLocation);
-  glEnableVertexAttribArray(gle::ShaderSource::MeshIdentifierLocation);
+  // Vertex attributes commons to all draws
+  _meshAttributes = ((1 << gle::ShaderSource::PositionLocation)
+		     | (1 << gle::ShaderSource::NormalLocation)
+		     | (1 << gle::ShaderSource::TangentLocation)
+		     | (1 << gle::ShaderSource::MeshIdentifierLocation));
   if (scene->getBones().size())
-    glEnableVertexAttribArray(gle::ShaderSource::BonesLocation);
+    _meshAttributes |= (1 << gle::ShaderSource::BonesLocation);
 
-  MeshBufferManager::getInstance().bind();
   //Draw static meshes
   std::list<gle::Scene::MeshGroup> factorizedStaticMeshes =
     gle::Mesh::factorizeForDrawing(staticMeshes);
   //std::cout << "nb draw calls: " << factorizedStaticMeshes.size() << " for " << staticMeshes.size() << " meshes\n";
 
   for (gle::Scene::MeshGroup &group : factorizedStaticMeshes)
-    {
-      _buildIndexesBuffer(group.meshes);
-      _renderMeshes(scene, group);
-    }
+    _renderMeshes(scene, group);
 
   // Draw dynamic meshes
 
   for (gle::Mesh* mesh : dynamicMeshes)
     _renderMesh(mesh);
 
-  glDisableVertexAttribArray(gle::ShaderSource::PositionLocation);
-  glDisableVertexAttribArray(gle::ShaderSource::NormalLocation);
-  glDisableVertexAttribArray(gle::ShaderSource::TangentLocation);
-  glDisableVertexAttribArray(gle::ShaderSource::BonesLocation);
-  glDisableVertexAttribArray(gle::ShaderSource::MeshIdentifierLocation);
-  glDisableVertexAttribArray(gle::ShaderSource::TextureCoordLocation);
+  gle::VertexArray::unbind();
 
+  if (scene->isOcclusionQueriesEnabled())
+    _renderOcclusionQueries(scene, camera);
   if (_debugMode)
     _renderDebugMeshes(scene);
   framebuffer.update();
 }
 
-void gle::Renderer::renderShadowMap(gle::Scene* scene, const std::list<gle::Mesh*> & staticMeshes, const std::list<gle::Mesh*> & dynamicMeshes,
-				    gle::Light* light)
+bool gle::Renderer::renderShadowMap(gle::Scene* scene, const std::list<gle::Mesh*> & staticMeshes, const std::list<gle::Mesh*> & dynamicMeshes,
+				    gle::Light* light, gle::FrameBuffer* framebuffer,
+				    gle::FrameBuffer* cachedDepth, gle::Camera* camera)
 {
-  gle::FrameBuffer*	framebuffer = light->getShadowMapFrameBuffer();
-  gle::Rectf		size = light->getShadowMap()->getSize();
+  const gle::Rectui&	tile = light->getShadowMapTile();
 
-  if (!_shadowMapProgram)
-    {
-      _shadowMapProgram = new gle::Program();
-      gle::Shader* vertexShader;
-      gle::Shader* fragmentShader;
-      std::string shaderSource = gle::ShaderSource::ShadowMapVertexShader;
-      scene->setShaderSourceConstants(shaderSource);
-      vertexShader = new gle::Shader(gle::Shader::Vertex, shaderSource);
-      shaderSource = gle::ShaderSource::ShadowMapFragmentShader;
-      scene->setShaderSourceConstants(shaderSource);
-      fragmentShader = new gle::Shader(gle::Shader::Fragment, shaderSource);
-      _shadowMapProgram->attach(*vertexShader);
-      _shadowMapProgram->attach(*fragmentShader);
-      try {
-        _shadowMapProgram->link();
-      }
-      catch (std::exception *e)
-        {
-          delete vertexShader;
-          delete fragmentShader;
-          throw e;
-        }
-      _shadowMapProgram->getUniformLocation("gle_MWMatrix");
-      _shadowMapProgram->getUniformLocation("gle_ViewMatrix");
-      _shadowMapProgram->getUniformLocation("gle_PMatrix");
-      _shadowMapProgram->retreiveUniformBlockIndex("gle_staticMeshesBlock");
-    }
+  gle::Program*		program = _getShadowMapProgram(scene);
 
+  if (!framebuffer)
+    framebuffer = light->getShadowMapFrameBuffer();
+  if (!camera)
+    camera = light->getShadowMapCamera();
+  // The shadow map keeps its previous content until the program is compiled
+  if (!program->isReady())
+    return (false);
+  program->retreiveUniformBlockIndex("gle_staticMeshesBlock");
   _shadowMapProgram->use();
 
-  glViewport(size.x, size.y, size.width, size.height);
-  framebuffer->bind();
-
-  glClear(GL_DEPTH_BUFFER_BIT);
+  // Only the tile of the light is cleared, copied and rendered
+  glViewport(tile.x, tile.y, tile.width, tile.height);
+  gle::StateCache::getInstance().enable(GL_SCISSOR_TEST);
+  glScissor(tile.x, tile.y, tile.width, tile.height);
+  if (cachedDepth)
+    {
+      // Start from the depth of the meshes already rendered in cachedDepth
+      gle::StateCache::getInstance().bindFramebuffer(GL_READ_FRAMEBUFFER, cachedDepth->getId());
+      gle::StateCache::getInstance().bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer->getId());
+      // Depth only framebuffers are incomplete for reading with a color read buffer
+      glReadBuffer(GL_NONE);
+      glBlitFramebuffer(tile.x, tile.y, tile.x + tile.width, tile.y + tile.height,
+			tile.x, tile.y, tile.x + tile.width, tile.y + tile.height,
+			GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+      framebuffer->bind();
+    }
+  else
+    {
+      framebuffer->bind();
+      glClear(GL_DEPTH_BUFFER_BIT);
+    }
   glDrawBuffer(GL_NONE);
-  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-
-  glEnableVertexAttribArray(gle::ShaderSource::PositionLocation);
-  glEnableVertexAttribArray(gle::ShaderSource::MeshIdentifierLocation);
-  MeshBufferManager::getInstance().bind();
+  gle::StateCache::getInstance().colorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
   std::list<gle::Scene::MeshGroup> factorizedStaticMeshes =
     gle::Mesh::factorizeForDrawing(staticMeshes, false, true);
 
-  glVertexAttribPointer(gle::ShaderSource::PositionLocation,
-			3, GL_FLOAT, GL_FALSE,
-			gle::Mesh::VertexAttributesSize * sizeof(GLfloat),
-			(GLvoid*)(0 * sizeof(GLfloat)));
-  glVertexAttribPointer(gle::ShaderSource::MeshIdentifierLocation,
-			3, GL_FLOAT, GL_FALSE, gle::Mesh::VertexAttributesSize * sizeof(GLfloat),
-			(GLvoid*)((0
-				   + gle::Mesh::VertexAttributeSizeCoords
-				   + gle::Mesh::VertexAttributeSizeNormal
-				   + gle::Mesh::VertexAttributeSizeTangent
-				   + gle::Mesh::VertexAttributeSizeTextureCoords
-				   + gle::Mesh::VertexAttributeSizeBone)
-				  * sizeof(GLfloat)));
+  _bindVertexArray((1 << gle::ShaderSource::PositionLocation)
+		   | (1 << gle::ShaderSource::MeshIdentifierLocation));
 
-  const Matrix4<GLfloat>& viewMatrix =
-    light->getShadowMapCamera()->getTransformationMatrix();
-  const Matrix4<GLfloat>& pMatrix =
-    light->getShadowMapCamera()->getProjectionMatrix();
+  const Matrix4<GLfloat>& viewMatrix = camera->getTransformationMatrix();
+  const Matrix4<GLfloat>& pMatrix = camera->getProjectionMatrix();
   
-  _shadowMapProgram->setUniform("gle_ViewMatrix", viewMatrix);
-  _shadowMapProgram->setUniform("gle_PMatrix", pMatrix);
+  _shadowMapProgram->setUniform(gle::Program::ViewMatrix, viewMatrix);
+  _shadowMapProgram->setUniform(gle::Program::PMatrix, pMatrix);
 
   for (gle::Scene::MeshGroup &group : factorizedStaticMeshes)
     {
-      _buildIndexesBuffer(group.meshes);
       scene->getStaticMeshesUniformsBuffer(group.uniformBufferId)
-      	->bindBase(_shadowMapProgram->getUniformBlockBinding("gle_staticMeshesBlock"));
-      _indexesBuffer.bind();
-      glPolygonMode(GL_FRONT_AND_BACK, group.rasterizationMode);
-      glDrawElements(GL_TRIANGLES, _indexesBuffer.getSize(), GL_UNSIGNED_INT, 0);
+      	->bindBase(_shadowMapProgram->getUniformBlockBinding(gle::Program::StaticMeshesBlock));
+      gle::StateCache::getInstance().polygonMode(group.rasterizationMode);
+      _drawMeshes(group.meshes);
     }
 
   for (gle::Mesh* mesh : dynamicMeshes)
@@ -211,140 +196,222 @@ void gle::Renderer::renderShadowMap(gle::Scene* scene, const std::list<gle::Mesh
       GLsizeiptr nbIndexes = mesh->getNbIndexes();
       GLsizeiptr nbVertexes = mesh->getNbVertexes();
       gle::MeshBufferManager::Chunk* vertexAttributes = mesh->getAttributes();
-      gle::Buffer<GLuint>* indexesBuffer = mesh->getIndexesBuffer();
       
-      if (nbIndexes < 1 || nbVertexes < 1 || !vertexAttributes || !indexesBuffer)
+      if (nbIndexes < 1 || nbVertexes < 1 || !vertexAttributes)
 	continue ;
 
-      glVertexAttribPointer(gle::ShaderSource::PositionLocation,
-			    3, GL_FLOAT, GL_FALSE,
-			    gle::Mesh::VertexAttributesSize * sizeof(GLfloat),
-			    (GLvoid*)(vertexAttributes->getOffset() * sizeof(GLfloat)));
-      glVertexAttribPointer(gle::ShaderSource::MeshIdentifierLocation,
-			    3, GL_FLOAT, GL_FALSE, gle::Mesh::VertexAttributesSize * sizeof(GLfloat),
-			    (GLvoid*)((vertexAttributes->getOffset()
-				       + gle::Mesh::VertexAttributeSizeCoords
-				       + gle::Mesh::VertexAttributeSizeNormal
-				       + gle::Mesh::VertexAttributeSizeTangent
-				       + gle::Mesh::VertexAttributeSizeTextureCoords
-				       + gle::Mesh::VertexAttributeSizeBone)
-				      * sizeof(GLfloat)));
-
-      _shadowMapProgram->setUniform("gle_MWMatrix", mesh->getTransformationMatrix());
-
-      indexesBuffer->bind();
-      glPolygonMode(GL_FRONT_AND_BACK, mesh->getRasterizationMode());
-      glDrawElements(mesh->getPrimitiveType(), nbIndexes, GL_UNSIGNED_INT, 0);
+      _shadowMapProgram->setUniform(gle::Program::MWMatrix, mesh->getTransformationMatrix());
+
+      _bindVertexArray((1 << gle::ShaderSource::PositionLocation)
+		       | (1 << gle::ShaderSource::MeshIdentifierLocation));
+      gle::StateCache::getInstance().polygonMode(mesh->getRasterizationMode());
+      _drawMesh(mesh);
     }
 
-  glDisableVertexAttribArray(gle::ShaderSource::PositionLocation);
-  glDisableVertexAttribArray(gle::ShaderSource::MeshIdentifierLocation);
+  gle::VertexArray::unbind();
+  gle::StateCache::getInstance().disable(GL_SCISSOR_TEST);
 
   framebuffer->update();
+  return (true);
+}
+
+bool gle::Renderer::renderPointShadowMap(gle::Scene* scene,
+					 const std::map<GLuint, std::list<gle::Mesh*> > & staticMeshes,
+					 const std::list<std::pair<gle::Mesh*, GLuint> > & dynamicMeshes,
+					 gle::PointLight* light)
+{
+  gle::PointShadowMaps&	shadowMaps = scene->getPointShadowMaps();
+  gle::Program*		program = _getPointShadowMapProgram(scene);
+  GLint			firstLayer = light->getShadowMapLayer();
+  GLuint		size = shadowMaps.getSize();
+
+  if (!program->isReady() || firstLayer < 0 || !shadowMaps.getFrameBuffer())
+    return (false);
+  program->retreiveUniformBlockIndex("gle_staticMeshesBlock");
+  program->use();
+
+  glViewport(0, 0, size, size);
+  // Clearing the layered framebuffer would clear the faces of all the lights
+  for (GLuint face = 0; face < gle::PointLight::NbFaces; ++face)
+    {
+      shadowMaps.getLayerFrameBuffer(firstLayer + face)->bind();
+      glDrawBuffer(GL_NONE);
+      glClear(GL_DEPTH_BUFFER_BIT);
+    }
+  shadowMaps.getFrameBuffer()->bind();
+  glDrawBuffer(GL_NONE);
+  gle::StateCache::getInstance().colorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+  // The vertex shader outputs world coordinates,
+  // the geometry shader projects them on each face
+  GLfloat facesMatrices[gle::PointLight::NbFaces * 16];
+  for (GLuint face = 0; face < gle::PointLight::NbFaces; ++face)
+    {
+      Matrix4<GLfloat> matrix = light->getShadowMapProjection()
+	* light->getFaceViewMatrix(face);
+      const GLfloat* matrixf = (const GLfloat*)matrix;
+
+      std::copy(matrixf, matrixf + 16, facesMatrices + face * 16);
+    }
+  program->setUniform(gle::Program::ViewMatrix, Matrix4<GLfloat>());
+  program->setUniform(gle::Program::PMatrix, Matrix4<GLfloat>());
+  program->setUniformMatrix4v(gle::Program::CubeFacesMatrices, facesMatrices,
+			      gle::PointLight::NbFaces);
+  program->setUniform1(gle::Program::CubeFirstLayer, &firstLayer, 1);
+
+  _bindVertexArray((1 << gle::ShaderSource::PositionLocation)
+		   | (1 << gle::ShaderSource::MeshIdentifierLocation));
+
+  for (auto it = staticMeshes.begin(); it != staticMeshes.end(); ++it)
+    {
+      GLint mask = it->first;
+      std::list<gle::Scene::MeshGroup> factorizedStaticMeshes =
+	gle::Mesh::factorizeForDrawing(it->second, false, true);
+
+      program->setUniform1(gle::Program::CubeFacesMask, &mask, 1);
+      for (gle::Scene::MeshGroup &group : factorizedStaticMeshes)
+	{
+	  scene->getStaticMeshesUniformsBuffer(group.uniformBufferId)
+	    ->bindBase(program->getUniformBlockBinding(gle::Program::StaticMeshesBlock));
+	  gle::StateCache::getInstance().polygonMode(group.rasterizationMode);
+	  _drawMeshes(group.meshes);
+	}
+    }
+
+  for (const std::pair<gle::Mesh*, GLuint> & dynamicMesh : dynamicMeshes)
+    {
+      gle::Mesh* mesh = dynamicMesh.first;
+      GLint mask = dynamicMesh.second;
+
+      if (mesh->getNbIndexes() < 1 || mesh->getNbVertexes() < 1
+	  || !mesh->getAttributes())
+	continue ;
+      program->setUniform(gle::Program::MWMatrix, mesh->getTransformationMatrix());
+      program->setUniform1(gle::Program::CubeFacesMask, &mask, 1);
+      _bindVertexArray((1 << gle::ShaderSource::PositionLocation)
+		       | (1 << gle::ShaderSource::MeshIdentifierLocation));
+      gle::StateCache::getInstance().polygonMode(mesh->getRasterizationMode());
+      _drawMesh(mesh);
+    }
+
+  gle::VertexArray::unbind();
+  shadowMaps.getFrameBuffer()->update();
+  return (true);
 }
 
-void gle::Renderer::_buildIndexesBuffer(const std::list<gle::Mesh*> & meshes)
+void gle::Renderer::_drawMesh(gle::Mesh* mesh)
 {
-  GLuint	nbIndexes = 0;
-  for (gle::Mesh* mesh : meshes)
-    nbIndexes += mesh->getNbIndexes();
+  mesh->bindIndexes();
+  glDrawElementsBaseVertex(mesh->getPrimitiveType(), mesh->getNbIndexes(),
+			   mesh->getIndexType(), mesh->getIndexesOffset(),
+			   mesh->getBaseVertex());
+}
 
-  _indexesBuffer.resize(nbIndexes);
+void gle::Renderer::_drawMeshes(const std::list<gle::Mesh*> & meshes)
+{
+  static const GLenum indexTypes[] = {GL_UNSIGNED_SHORT, GL_UNSIGNED_INT};
 
-  GLuint	i = 0;
-  glBindBuffer(GL_COPY_WRITE_BUFFER, _indexesBuffer.getId());
-  for (gle::Mesh* mesh : meshes)
+  for (GLenum indexType : indexTypes)
     {
-      gle::Bufferui* indexesBuffer = mesh->getIndexesBuffer();
-      glBindBuffer(GL_COPY_READ_BUFFER, indexesBuffer->getId());
-      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
-			  0, i * sizeof(GLuint), mesh->getNbIndexes() * sizeof(GLuint));
-      i += mesh->getNbIndexes();
+      _drawCounts.clear();
+      _drawIndexes.clear();
+      _drawBaseVertexes.clear();
+      for (gle::Mesh* mesh : meshes)
+	if (mesh->getIndexType() == indexType && mesh->getNbIndexes() > 0)
+	  {
+	    _drawCounts.push_back(mesh->getNbIndexes());
+	    _drawIndexes.push_back(mesh->getIndexesOffset());
+	    _drawBaseVertexes.push_back(mesh->getBaseVertex());
+	  }
+      if (_drawCounts.empty())
+	continue ;
+      if (indexType == GL_UNSIGNED_INT)
+	IndexBufferManagerui::getInstance().bind();
+      else
+	IndexBufferManagerus::getInstance().bind();
+      glMultiDrawElementsBaseVertex(GL_TRIANGLES, &_drawCounts[0], indexType,
+				    &_drawIndexes[0], _drawCounts.size(),
+				    &_drawBaseVertexes[0]);
     }
 }
 
 void gle::Renderer::_renderEnvMap(gle::Scene* scene)
 {
   
+  if (!scene->getEnvMapProgram()->isReady())
+    return ;
   _currentProgram = scene->getEnvMapProgram();
   _currentProgram->use();
   GLsizeiptr nbIndexes = scene->getEnvMapMesh()->getNbIndexes();
-  gle::MeshBufferManager::Chunk* vertexAttributes = scene->getEnvMapMesh()->getAttributes();
-  gle::Buffer<GLuint> * indexesBuffer = scene->getEnvMapMesh()->getIndexesBuffer();
-  glEnableVertexAttribArray(gle::ShaderSource::PositionLocation);
-  glVertexAttribPointer(gle::ShaderSource::PositionLocation,
-                        3, GL_FLOAT, GL_FALSE,
-                        gle::Mesh::VertexAttributesSize * sizeof(GLfloat),
-                        (GLvoid*)(vertexAttributes->getOffset() * sizeof(GLfloat)));
   gle::EnvironmentMap* envMap = scene->getEnvMap();
   if (envMap->getType() == EnvironmentMap::CubeMap)
     {
-      glActiveTexture(gle::Program::CubeMapTexture);
+      gle::StateCache::getInstance().activeTexture(gle::Program::CubeMapTexture);
       envMap->bind();
-      _currentProgram->setUniform("gle_cubeMap",
+      _currentProgram->setUniform(gle::Program::CubeMap,
 				  gle::Program::CubeMapTextureIndex);
     }
   const gle::Matrix4<GLfloat>& mvMatrix = scene->getCurrentCamera()->getTransformationMatrix();
-  _currentProgram->setUniform("gle_MVMatrix", mvMatrix);
-  _currentProgram->setUniform("gle_PMatrix", scene->getCurrentCamera()->getProjectionMatrix());
-  _currentProgram->setUniform("gle_CameraPos", scene->getCurrentCamera()->getPosition());
-  indexesBuffer->bind();
-  glPolygonMode(GL_FRONT_AND_BACK, scene->getEnvMapMesh()->getRasterizationMode());
-  glDrawElements(scene->getEnvMapMesh()->getPrimitiveType(), nbIndexes, GL_UNSIGNED_INT, 0);
+  _currentProgram->setUniform(gle::Program::MVMatrix, mvMatrix);
+  _currentProgram->setUniform(gle::Program::PMatrix, scene->getCurrentCamera()->getProjectionMatrix());
+  _currentProgram->setUniform(gle::Program::CameraPos, scene->getCurrentCamera()->getPosition());
+  gle::StateCache::getInstance().polygonMode(scene->getEnvMapMesh()->getRasterizationMode());
+  if (nbIndexes > 0)
+    {
+      _bindVertexArray(1 << gle::ShaderSource::PositionLocation);
+      _drawMesh(scene->getEnvMapMesh());
+      gle::VertexArray::unbind();
+    }
   glClear(GL_DEPTH_BUFFER_BIT);
 }
 
 void gle::Renderer::_renderMeshes(gle::Scene* scene, gle::Scene::MeshGroup& group)
 {
   scene->getStaticMeshesUniformsBuffer(group.uniformBufferId)
-    ->bindBase(_currentProgram->getUniformBlockBinding("gle_staticMeshesBlock"));
+    ->bindBase(_currentProgram->getUniformBlockBinding(gle::Program::StaticMeshesBlock));
   scene->getStaticMeshesMaterialsBuffer(group.materialBufferId)
-    ->bindBase(_currentProgram->getUniformBlockBinding("gle_materialBlock"));
+    ->bindBase(_currentProgram->getUniformBlockBinding(gle::Program::MaterialBlock));
 
-  _setVertexAttributes(0);
-  
   // Set up ColorMap
   if (group.colorMap || group.normalMap)
-    glEnableVertexAttribArray(gle::ShaderSource::TextureCoordLocation);
+    _bindVertexArray(_meshAttributes | (1 << gle::ShaderSource::TextureCoordLocation));
+  else
+    _bindVertexArray(_meshAttributes);
   if (group.colorMap)
     {
       // Set texture to the shader
-      glActiveTexture(gle::Program::ColorMapTexture);
+      gle::StateCache::getInstance().activeTexture(gle::Program::ColorMapTexture);
       group.colorMap->bind();
-      _currentProgram->setUniform("gle_colorMap",
+      _currentProgram->setUniform(gle::Program::ColorMap,
       				  gle::Program::ColorMapTextureIndex);
     }
   if (group.normalMap)
     {
       // Set texture to the shader
-      glActiveTexture(gle::Program::NormalMapTexture);
+      gle::StateCache::getInstance().activeTexture(gle::Program::NormalMapTexture);
       group.normalMap->bind();
-      _currentProgram->setUniform("gle_normalMap",
+      _currentProgram->setUniform(gle::Program::NormalMap,
       				  gle::Program::NormalMapTextureIndex);
     }
-  gle::Exception::CheckOpenGLError("Set uniform Normal map");
+  GLE_CHECK_OPENGL_ERROR("Set uniform Normal map");
 
   // Set up EnvMap
   if (group.envMap)
     {
       if (group.envMap->getType() == EnvironmentMap::CubeMap)
 	{
-	  glActiveTexture(gle::Program::CubeMapTexture);
+	  gle::StateCache::getInstance().activeTexture(gle::Program::CubeMapTexture);
 	  group.envMap->bind();
-	  _currentProgram->setUniform("gle_cubeMap",
+	  _currentProgram->setUniform(gle::Program::CubeMap,
 				      gle::Program::CubeMapTextureIndex);
 	}
     }
 
-  // Draw the mesh elements
-  _indexesBuffer.bind();
-
   //! Set the rasterization mode
-  glPolygonMode(GL_FRONT_AND_BACK, group.rasterizationMode);
+  gle::StateCache::getInstance().polygonMode(group.rasterizationMode);
 
-  glDrawElements(GL_TRIANGLES, _indexesBuffer.getSize(), GL_UNSIGNED_INT, 0);
-  
-  glDisableVertexAttribArray(gle::ShaderSource::TextureCoordLocation);  
+  // Draw the mesh elements
+  _drawMeshes(group.meshes);
 }
 
 void gle::Renderer::_renderMesh(gle::Mesh* mesh)
@@ -356,44 +423,43 @@ void gle::Renderer::_renderMesh(gle::Mesh* mesh)
     return ;
 
   gle::MeshBufferManager::Chunk* vertexAttributes = mesh->getAttributes();
-  gle::Buffer<GLuint>* indexesBuffer = mesh->getIndexesBuffer();
   gle::Material* material = mesh->getMaterial();
 
-  if (indexesBuffer == NULL || material == NULL || mesh == NULL ||
+  if (vertexAttributes == NULL || material == NULL || mesh == NULL ||
       !_currentProgram)
     return ;
   
   material->getUniformsBuffer()
-    ->bindBase(_currentProgram->getUniformBlockBinding("gle_materialBlock"));
-
-  _currentProgram->setUniform("gle_MWMatrix", mesh->getTransformationMatrix());
+    ->bindBase(_currentProgram->getUniformBlockBinding(gle::Program::MaterialBlock));
 
-  _setVertexAttributes(vertexAttributes->getOffset());
+  _currentProgram->setUniform(gle::Program::MWMatrix, mesh->getTransformationMatrix());
 
   // Set up ColorMap
   if (material->isColorMapEnabled() || material->isNormalMapEnabled())
-    glEnableVertexAttribArray(gle::ShaderSource::TextureCoordLocation);
+    _bindVertexArray(_meshAttributes | (1 << gle::ShaderSource::TextureCoordLocation));
+  else
+    _bindVertexArray(_meshAttributes);
 
   if (material->isColorMapEnabled())
     {
       // Set texture to the shader
       gle::Texture* colorMap = material->getColorMap();
-      glActiveTexture(gle::Program::ColorMapTexture);
+      gle::StateCache::getInstance().activeTexture(gle::Program::ColorMapTexture);
       colorMap->bind();
-      _currentProgram->setUniform("gle_colorMap",
+      _currentProgram->setUniform(gle::Program::ColorMap,
       				  gle::Program::ColorMapTextureIndex);
     }
-  gle::Exception::CheckOpenGLError("Set uniform Color map");
+  GLE_CHECK_OPENGL_ERROR("Set uniform Color map");
   if (material->isNormalMapEnabled())
     {
       // Set texture to the shader
       gle::Texture* normalMap = material->getNormalMap();
-      glActiveTexture(gle::Program::NormalMapTexture);
+      gle::StateCache::getInstance().activeTexture(gle::Program::NormalMapTexture);
       normalMap->bind();
-      _currentProgram->setUniform("gle_normalMap",
+      _currentProgram->setUniform(gle::Program::NormalMap,
       				  gle::Program::NormalMapTextureIndex);
     }
-  gle::Exception::CheckOpenGLError("Set uniform Normal map");
+  GLE_CHECK_OPENGL_ERROR("Set uniform Normal map");
 
   // Set up EnvMap
   if (material->isEnvMapEnabled())
@@ -401,31 +467,52 @@ void gle::Renderer::_renderMesh(gle::Mesh* mesh)
       gle::EnvironmentMap* envMap = material->getEnvMap();
       if (envMap->getType() == EnvironmentMap::CubeMap)
 	{
-	  glActiveTexture(gle::Program::CubeMapTexture);
+	  gle::StateCache::getInstance().activeTexture(gle::Program::CubeMapTexture);
 	  envMap->bind();
-	  _currentProgram->setUniform("gle_cubeMap",
+	  _currentProgram->setUniform(gle::Program::CubeMap,
 				      gle::Program::CubeMapTextureIndex);
 	}
     }
 
-  // Draw the mesh elements
-  indexesBuffer->bind();
-  {
-    GLenum error = glGetError();
-    if (error != GL_NO_ERROR)
-      throw new gle::Exception::OpenGLError("_renderMesh: indexesBuffer->bind()");
-
-  }
-
   if (mesh->getPrimitiveType() == gle::Mesh::Points
       || mesh->getRasterizationMode() == gle::Mesh::Point)
-    glPointSize(mesh->getPointSize());
-  glPolygonMode(GL_FRONT_AND_BACK, mesh->getRasterizationMode());
-  gle::Exception::CheckOpenGLError("Before glDrawElements");
-  glDrawElements(mesh->getPrimitiveType(), nbIndexes, GL_UNSIGNED_INT, 0);
-  gle::Exception::CheckOpenGLError("glDrawElements");
-  if (material->isColorMapEnabled())
-    glDisableVertexAttribArray(gle::ShaderSource::TextureCoordLocation);
+    gle::StateCache::getInstance().pointSize(mesh->getPointSize());
+  gle::StateCache::getInstance().polygonMode(mesh->getRasterizationMode());
+  GLE_CHECK_OPENGL_ERROR("Before glDrawElementsBaseVertex");
+  _drawMesh(mesh);
+  GLE_CHECK_OPENGL_ERROR("glDrawElementsBaseVertex");
+}
+
+void gle::Renderer::_bindVertexArray(GLuint attributes)
+{
+  GLuint bufferId = MeshBufferManager::getInstance().getBufferId();
+
+  // Vertex arrays point to the buffer they were set up with,
+  // it is replaced each time the mesh buffer manager grows
+  if (bufferId != _vertexArraysBufferId)
+    {
+      _clearVertexArrays();
+      _vertexArraysBufferId = bufferId;
+    }
+  gle::VertexArray*& vertexArray = _vertexArrays[attributes];
+  if (vertexArray)
+    {
+      vertexArray->bind();
+      return ;
+    }
+  vertexArray = new gle::VertexArray();
+  vertexArray->bind();
+  MeshBufferManager::getInstance().bind();
+  vertexArray->enableAttributes(attributes);
+  _setVertexAttributes(0);
+}
+
+void gle::Renderer::_clearVertexArrays()
+{
+  gle::VertexArray::unbind();
+  for (auto& it : _vertexArrays)
+    delete it.second;
+  _vertexArrays.clear();
 }
 
 void gle::Renderer::_setVertexAttributes(GLuint offset)
@@ -471,109 +558,133 @@ void gle::Renderer::_setVertexAttributes(GLuint offset)
 				  * sizeof(GLfloat)));
 }
 
-void gle::Renderer::_setCurrentProgram(gle::Scene* scene)
+bool gle::Renderer::_setCurrentProgram(gle::Scene* scene)
 { 
   gle::Program* program = scene->getProgram();
 
   if (!program)
-    throw (new gle::Exception::Exception("No program for the scene..."));
-  if (program && program != _currentProgram)
+    return (false);
+  if (program != _currentProgram)
     program->use();
   _currentProgram = program;
+  return (true);
+}
+
+gle::Program* gle::Renderer::_getShadowMapProgram(gle::Scene* scene)
+{
+  if (!_shadowMapProgram)
+    {
+      std::string vertexSource = gle::ShaderSource::ShadowMapVertexShader;
+      std::string fragmentSource = gle::ShaderSource::ShadowMapFragmentShader;
+      scene->setShaderSourceConstants(vertexSource);
+      scene->setShaderSourceConstants(fragmentSource);
+      _shadowMapProgram =
+	gle::ProgramCache::getInstance().prepare(vertexSource, fragmentSource);
+    }
+  return (_shadowMapProgram);
+}
+
+gle::Program* gle::Renderer::_getPointShadowMapProgram(gle::Scene* scene)
+{
+  if (!_pointShadowMapProgram)
+    {
+      std::string vertexSource = gle::ShaderSource::ShadowMapVertexShader;
+      std::string fragmentSource = gle::ShaderSource::ShadowMapFragmentShader;
+      scene->setShaderSourceConstants(vertexSource);
+      scene->setShaderSourceConstants(fragmentSource);
+      _pointShadowMapProgram =
+	gle::ProgramCache::getInstance().prepare(vertexSource, fragmentSource,
+						 gle::ShaderSource::PointShadowMapGeometryShader);
+    }
+  return (_pointShadowMapProgram);
+}
+
+gle::Program* gle::Renderer::_getDebugProgram()
+{
+  if (!_debugProgram)
+    _debugProgram =
+      gle::ProgramCache::getInstance().prepare(gle::ShaderSource::DebugVertexShader,
+					       gle::ShaderSource::DebugFragmentShader);
+  return (_debugProgram);
+}
+
+void gle::Renderer::preparePrograms(gle::Scene* scene)
+{
+  // The permutation of the scene program depends on its nodes
+  scene->update();
+  scene->getProgram();
+  _getShadowMapProgram(scene);
+  if (scene->getPointShadowMaps().getMaxLights() > 0)
+    _getPointShadowMapProgram(scene);
+  if (_debugMode)
+    _getDebugProgram();
 }
 
 void gle::Renderer::_setSceneUniforms(gle::Scene* scene, gle::Camera* camera)
 {
   const gle::Matrix4<GLfloat> & projectionMatrix = camera->getProjectionMatrix();
 
-  _currentProgram->setUniform("gle_ViewMatrix", camera->getTransformationMatrix());
-  _currentProgram->setUniform("gle_PMatrix", projectionMatrix);
-  _currentProgram->setUniform("gle_CameraPos", camera->getAbsolutePosition());
-  _currentProgram->setUniform("gle_fogColor", scene->getFogColor());
-  _currentProgram->setUniform("gle_fogDensity", scene->getFogDensity());
+  _currentProgram->setUniform(gle::Program::ViewMatrix, camera->getTransformationMatrix());
+  _currentProgram->setUniform(gle::Program::PMatrix, projectionMatrix);
+  _currentProgram->setUniform(gle::Program::CameraPos, camera->getAbsolutePosition());
+  _currentProgram->setUniform(gle::Program::FogColor, scene->getFogColor());
+  _currentProgram->setUniform(gle::Program::FogDensity, scene->getFogDensity());
 
   std::vector<GLfloat>& bones = scene->getBones();
   if (bones.size())
-      _currentProgram->setUniformMatrix4v("gle_bonesMatrix", (GLfloat*)&bones[0], bones.size());
+      _currentProgram->setUniformMatrix4v(gle::Program::BonesMatrix, (GLfloat*)&bones[0], bones.size());
 
   // Send light infos to the shader
-  GLint currentTexture = gle::Program::ShadowMapsTextures;
-  GLint currentTextureIndex = gle::Program::ShadowMapsTexturesIndexes;
-
-  if (scene->getDirectionalLightsSize())
+  gle::Bufferf* lightsBuffer = scene->getLightsUniformsBuffer();
+  if (lightsBuffer)
+    lightsBuffer->bindBase(_currentProgram->getUniformBlockBinding(gle::Program::LightsBlock));
+
+  // Send the lights of each cluster
+  gle::Bufferui* lightClustersBuffer = scene->getLightClustersBuffer();
+  if (lightClustersBuffer)
+    lightClustersBuffer->bindBase(_currentProgram->getUniformBlockBinding(gle::Program::LightClustersBlock));
+  _currentProgram->setUniform(gle::Program::ClusterDepth,
+			      scene->getLightClusters().getDepthParameters());
+
+  // Send the shadow atlas of the spot lights
+  gle::StateCache::getInstance().activeTexture(gle::Program::ShadowAtlasTexture);
+  scene->getShadowAtlas().getSampledTexture()->bind();
+  _currentProgram->setUniform(gle::Program::ShadowAtlas,
+			      gle::Program::ShadowAtlasTextureIndex);
+
+  // Send the cascades of the directional light shadows
+  gle::DirectionalLight* cascadedLight = scene->getCascadedShadowLight();
+  if (cascadedLight && cascadedLight->getShadowMap())
     {
-      _currentProgram->setUniform3("gle_directionalLightDirection",
-				    scene->getDirectionalLightsDirection(),
-				    scene->getDirectionalLightsSize());
-      _currentProgram->setUniform3("gle_directionalLightColor",
-				    scene->getDirectionalLightsColor(),
-				    scene->getDirectionalLightsSize());
+      gle::StateCache::getInstance().activeTexture(gle::Program::CascadesShadowMapTexture);
+      cascadedLight->getShadowMap()->bind();
+      _currentProgram->setUniformMatrix4v(gle::Program::CascadesMatrices,
+					  cascadedLight->getCascadesMatrices(),
+					  gle::DirectionalLight::NbCascades);
+      _currentProgram->setUniform1(gle::Program::CascadesSplits,
+				   cascadedLight->getCascadesSplits(),
+				   gle::DirectionalLight::NbCascades);
+      _currentProgram->setUniform1(gle::Program::CascadesBiases,
+				   cascadedLight->getCascadesBiases(),
+				   gle::DirectionalLight::NbCascades);
     }
-  if (scene->getPointLightsSize())
-    {
-      _currentProgram->setUniform3("gle_pointLightPosition",
-      			    scene->getPointLightsPosition(),
-      			    scene->getPointLightsSize());
-      _currentProgram->setUniform3("gle_pointLightColor",
-      			    scene->getPointLightsColor(),
-      				    scene->getPointLightsSize());
-      _currentProgram->setUniform3("gle_pointLightSpecularColor",
-      			    scene->getPointLightsSpecularColor(),
-      			    scene->getPointLightsSize());
-      _currentProgram->setUniform3("gle_pointLightAttenuation",
-      			    scene->getPointLightsAttenuation(),
-      			    scene->getPointLightsSize());
-    }
-  if (scene->getSpotLightsSize())
+  // Always set, samplers of different types cannot share a texture unit
+  _currentProgram->setUniform(gle::Program::CascadesShadowMap,
+			      gle::Program::CascadesShadowMapTextureIndex);
+
+  // Send the cube shadow maps of the point lights
+  if (scene->hasPointShadowMaps())
     {
-      _currentProgram->setUniform3("gle_spotLightPosition",
-				    scene->getSpotLightsPosition(),
-				    scene->getSpotLightsSize());
-      _currentProgram->setUniform3("gle_spotLightColor",
-				    scene->getSpotLightsColor(),
-				    scene->getSpotLightsSize());
-      _currentProgram->setUniform3("gle_spotLightSpecularColor",
-				    scene->getSpotLightsSpecularColor(),
-				    scene->getSpotLightsSize());
-      _currentProgram->setUniform3("gle_spotLightAttenuation",
-				    scene->getSpotLightsAttenuation(),
-				    scene->getSpotLightsSize());
-      _currentProgram->setUniform3("gle_spotLightDirection",
-				    scene->getSpotLightsDirection(),
-				    scene->getSpotLightsSize());
-      _currentProgram->setUniform1("gle_spotLightCosCutOff",
-				    scene->getSpotLightsCosCutOff(),
-				    scene->getSpotLightsSize());
-      _currentProgram->setUniform1("gle_spotLightInnerCosCutOff",
-				   scene->getSpotLightsInnerCosCutOff(),
-				   scene->getSpotLightsSize());
-      _currentProgram->setUniform1("gle_spotLightHasShadowMap",
-				   scene->getSpotLightsHasShadowMap(),
-				   scene->getSpotLightsSize());
-      _currentProgram->setUniformMatrix4v("gle_spotLightShadowMapMatrix",
-					  scene->getSpotLightsShadowMapMatrix(),
-					  scene->getSpotLightsSize());
-      // Send shadow maps
-      gle::Array<GLint> spotLightsShadowMapIndexes;
-      spotLightsShadowMapIndexes.resize(scene->getSpotLightsSize());
-      const std::vector<gle::Texture*>& shadowMaps = scene->getSpotLightsShadowMap();
-      for (GLuint i = 0; i < scene->getSpotLightsSize(); ++i)
-	{
-	  if (shadowMaps[i])
-	    {
-	      glActiveTexture(currentTexture);
-	      shadowMaps[i]->bind();
-	      spotLightsShadowMapIndexes[i] = currentTextureIndex;
-	      currentTextureIndex++;
-	      currentTexture++;
-	    }
-	  else
-	    spotLightsShadowMapIndexes[i] = 0;
-	}
-      _currentProgram->setUniform1("gle_spotLightShadowMap",
-				   (GLint*)spotLightsShadowMapIndexes,
-				   scene->getSpotLightsSize());
+      gle::StateCache::getInstance().activeTexture(gle::Program::PointShadowMapsTexture);
+      scene->getPointShadowMaps().getTexture()->bind();
     }
+  _currentProgram->setUniform(gle::Program::PointShadowMaps,
+			      gle::Program::PointShadowMapsTextureIndex);
+
+  // The cube map would share the unit 0 of the color map without an
+  // environment map
+  _currentProgram->setUniform(gle::Program::CubeMap,
+			      gle::Program::CubeMapTextureIndex);
 }
 
 void gle::Renderer::setDebugMode(int mode)
@@ -584,29 +695,11 @@ void gle::Renderer::setDebugMode(int mode)
 void gle::Renderer::_renderDebugMeshes(gle::Scene* scene)
 {  
   //glClear(GL_DEPTH_BUFFER_BIT);
-  if (!_debugProgram)
-    {
-      _debugProgram = new gle::Program();
-      gle::Shader* vertexShader;
-      gle::Shader* fragmentShader;
-      vertexShader = new gle::Shader(gle::Shader::Vertex, gle::ShaderSource::DebugVertexShader);
-      fragmentShader = new gle::Shader(gle::Shader::Fragment, gle::ShaderSource::DebugFragmentShader);
-      _debugProgram->attach(*vertexShader);
-      _debugProgram->attach(*fragmentShader);
-      try {
-        _debugProgram->link();
-      }
-      catch (std::exception *e)
-        {
-          delete vertexShader;
-          delete fragmentShader;
-          throw e;
-        }
-      _debugProgram->getUniformLocation("gle_MVMatrix");
-      _debugProgram->getUniformLocation("gle_PMatrix");
-      _debugProgram->getUniformLocation("gle_color");
-    }
-  _currentProgram = _debugProgram;
+  gle::Program* program = _getDebugProgram();
+
+  if (!program->isReady())
+    return ;
+  _currentProgram = program;
   _currentProgram->use();
   const std::vector<Scene::Node*>& debugNodes = scene->getDebugNodes(_debugMode);
   for (Scene::Node* const &debugNode : debugNodes)
@@ -616,20 +709,60 @@ void gle::Renderer::_renderDebugMeshes(gle::Scene* scene)
       {
 	GLsizeiptr nbIndexes = debugMesh->getNbIndexes();
 	MeshBufferManager::Chunk* vertexAttributes = debugMesh->getAttributes();
-	Buffer<GLuint> * indexesBuffer = debugMesh->getIndexesBuffer();
-	glEnableVertexAttribArray(ShaderSource::PositionLocation);
-	glVertexAttribPointer(ShaderSource::PositionLocation,
-			      3, GL_FLOAT, GL_FALSE,
-			      Mesh::VertexAttributesSize * sizeof(GLfloat),
-			      (GLvoid*)(vertexAttributes->getOffset() * sizeof(GLfloat)));
+	if (nbIndexes < 1 || !vertexAttributes)
+	  continue ;
+	_bindVertexArray(1 << ShaderSource::PositionLocation);
 	const Matrix4<GLfloat>& mvMatrix =
 	  scene->getCurrentCamera()->getTransformationMatrix() * debugMesh->getTransformationMatrix();
-	_currentProgram->setUniform("gle_MVMatrix", mvMatrix);
-	_currentProgram->setUniform("gle_PMatrix", scene->getCurrentCamera()->getProjectionMatrix());
-	_currentProgram->setUniform("gle_color", debugMesh->getMaterial()->getAmbientColor());
-	indexesBuffer->bind();
-	glPolygonMode(GL_FRONT_AND_BACK, debugMesh->getRasterizationMode());
-	glDrawElements(debugMesh->getPrimitiveType(), nbIndexes, GL_UNSIGNED_INT, 0);
+	_currentProgram->setUniform(gle::Program::MVMatrix, mvMatrix);
+	_currentProgram->setUniform(gle::Program::PMatrix, scene->getCurrentCamera()->getProjectionMatrix());
+	_currentProgram->setUniform(gle::Program::Color, debugMesh->getMaterial()->getAmbientColor());
+	gle::StateCache::getInstance().polygonMode(debugMesh->getRasterizationMode());
+	_drawMesh(debugMesh);
       }
   }
+  gle::VertexArray::unbind();
+}
+
+void gle::Renderer::_renderOcclusionQueries(gle::Scene* scene, gle::Camera* camera)
+{
+  gle::OcclusionQueries& queries = scene->getOcclusionQueries();
+  gle::Program* program = _getDebugProgram();
+  gle::StateCache& states = gle::StateCache::getInstance();
+
+  if (queries.getQueries().empty())
+    return ;
+  if (!program->isReady())
+    {
+      queries.setQueriesIssued(false);
+      return ;
+    }
+  if (!_queryBox)
+    _queryBox = gle::Geometries::Cube(NULL, 1, true);
+  _currentProgram = program;
+  _currentProgram->use();
+  _currentProgram->setUniform(gle::Program::PMatrix, camera->getProjectionMatrix());
+
+  // The boxes are tested against the depth of the scene, without
+  // writing anything
+  states.colorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  states.depthMask(GL_FALSE);
+  states.polygonMode(gle::Mesh::Fill);
+  _bindVertexArray(1 << ShaderSource::PositionLocation);
+  for (const gle::OcclusionQueries::Query& query : queries.getQueries())
+    {
+      gle::Matrix4<GLfloat> mvMatrix = camera->getTransformationMatrix();
+      gle::Vector3<GLfloat> size = query.max - query.min;
+
+      mvMatrix.translate((query.min + query.max) * 0.5f);
+      mvMatrix *= gle::Matrix4<GLfloat>::scale(size.x, size.y, size.z);
+      _currentProgram->setUniform(gle::Program::MVMatrix, mvMatrix);
+      glBeginQuery(GL_ANY_SAMPLES_PASSED, query.id);
+      _drawMesh(_queryBox);
+      glEndQuery(GL_ANY_SAMPLES_PASSED);
+    }
+  gle::VertexArray::unbind();
+  states.depthMask(GL_TRUE);
+  states.colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  queries.setQueriesIssued(true);
 }
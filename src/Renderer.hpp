@@ -12,15 +12,20 @@
 # define _GLE_RENDERER_HPP_
 
 # include <string>
+# include <vector>
+# include <map>
 # include <Scene.hpp>
 # include <Mesh.hpp>
 # include <Camera.hpp>
 # include <FrameBuffer.hpp>
 # include <Rect.hpp>
 # include <Light.hpp>
+# include <PointLight.hpp>
 
 namespace gle {
 
+  class VertexArray;
+
   //! Rendering class
   /*!
     Controls all rendering operations.
@@ -64,10 +69,50 @@ namespace gle {
 
     void render(Scene* scene, const Rectf& size, FrameBuffer* customFramebuffer=NULL);
 
+    //! Start the compilation of the programs needed to render a scene
+    /*!
+      Should be called once the scene is loaded, so the shaders compile
+      in the background instead of stalling the first frames.
+      Until a program is ready, what it renders is skipped (or drawn with
+      the previous program of the scene).
+     */
+
+    void preparePrograms(Scene* scene);
+
     //! Render a set of static and dynamic meshes to a shadow map
+    /*!
+      \param framebuffer Framebuffer in which to render the depth,
+      NULL for the shadow map framebuffer of the light
+      \param cachedDepth Framebuffer whose depth is copied before rendering
+      the meshes, NULL to clear the depth
+      \param camera Camera from which the meshes are rendered,
+      NULL for the shadow map camera of the light
+      \return false if the shadow map program is not compiled yet,
+      in which case nothing is rendered
+     */
     
-    void renderShadowMap(gle::Scene* scene, const std::list<gle::Mesh*> & staticMeshes,
-			 const std::list<gle::Mesh*> & dynamicMeshes, gle::Light* light);
+    bool renderShadowMap(gle::Scene* scene, const std::list<gle::Mesh*> & staticMeshes,
+			 const std::list<gle::Mesh*> & dynamicMeshes, gle::Light* light,
+			 gle::FrameBuffer* framebuffer=NULL,
+			 gle::FrameBuffer* cachedDepth=NULL,
+			 gle::Camera* camera=NULL);
+
+    //! Render the six faces of the shadow map of a point light in a single pass
+    /*!
+      The faces are layers of the point shadow maps of the scene, selected
+      by a geometry shader. Each triangle is only emitted to the faces set
+      in the mask of its meshes, and whose frustum it intersects.
+      \param staticMeshes Static meshes, by mask of the faces they reach
+      \param dynamicMeshes Dynamic meshes, with the mask of the faces they reach
+      \param light Point light with a layer in the point shadow maps
+      \return false if the program is not compiled yet or the light has
+      no layer, in which case nothing is rendered
+     */
+
+    bool renderPointShadowMap(gle::Scene* scene,
+			      const std::map<GLuint, std::list<gle::Mesh*> > & staticMeshes,
+			      const std::list<std::pair<gle::Mesh*, GLuint> > & dynamicMeshes,
+			      gle::PointLight* light);
 
     //! Set the debug mode of the renderer
     /*!
@@ -77,23 +122,37 @@ namespace gle {
     void setDebugMode(int mode);
 
   private:
-    void _buildIndexesBuffer(const std::list<gle::Mesh*> & meshes);
+    void _drawMesh(gle::Mesh* mesh);
+    void _drawMeshes(const std::list<gle::Mesh*> & meshes);
     void _renderEnvMap(gle::Scene* scene);
     void _renderShadowMapMeshes(gle::Scene::MeshGroup& group);
     void _renderMeshes(gle::Scene* scene, gle::Scene::MeshGroup& group);
     void _renderMesh(gle::Mesh* mesh);
+    void _bindVertexArray(GLuint attributes);
+    void _clearVertexArrays();
     void _setVertexAttributes(GLuint offset);
-    void _setCurrentProgram(gle::Scene* scene);
+    bool _setCurrentProgram(gle::Scene* scene);
+    gle::Program* _getShadowMapProgram(gle::Scene* scene);
+    gle::Program* _getPointShadowMapProgram(gle::Scene* scene);
+    gle::Program* _getDebugProgram();
     void _setMaterialUniforms(gle::Material* material);
     void _setSceneUniforms(gle::Scene* scene, gle::Camera* camera);
     void _setMeshUniforms(gle::Scene* scene, gle::Mesh* mesh);
     void _renderDebugMeshes(gle::Scene* scene);
+    void _renderOcclusionQueries(gle::Scene* scene, gle::Camera* camera);
 
     gle::Program*	_currentProgram;
     gle::Program*	_shadowMapProgram;
-    gle::Bufferui	_indexesBuffer;
+    gle::Program*	_pointShadowMapProgram;
+    std::map<GLuint, gle::VertexArray*>	_vertexArrays;
+    GLuint		_vertexArraysBufferId;
+    GLuint		_meshAttributes;
+    std::vector<GLsizei>	_drawCounts;
+    std::vector<const GLvoid*>	_drawIndexes;
+    std::vector<GLint>		_drawBaseVertexes;
     int			_debugMode;
     gle::Program*	_debugProgram;
+    gle::Mesh*		_queryBox;
   };
 
 };
@@ -20,19 +20,36 @@
 #include <Renderer.hpp>
 #include <Bone.hpp>
 #include <Skeleton.hpp>
+#include <ProgramCache.hpp>
+#include <BoundingVolume.hpp>
+#include <Extensions.hpp>
+
+// Lights are binned in the clusters where their attenuation is above this value
+#define GLE_LIGHT_ATTENUATION_THRESHOLD (1.0 / 256.0)
+
+// Number of frames the gpu may be late before writing the light clusters waits
+#define GLE_LIGHT_CLUSTERS_BUFFERS 3
 
 gle::Scene::Scene() :
   _backgroundColor(0.0, 0.0, 0.0, 0.0), _fogColor(0.0, 0.0, 0.0, 0.0), _fogDensity(0.0),
   _cameras(), _staticMeshes(), _dynamicMeshes(),
-  _lights(), _directionalLightsDirection(),
-  _directionalLightsColor(), _directionalLightsSize(0),
-  _pointLightsPosition(),
-  _pointLightsColor(), _pointLightsSize(0),
-  _spotLightsSize(0),
+  _lights(), _directionalLightsSize(0), _pointLightsSize(0),
+  _spotLightsSize(0), _lightsUniforms(), _lightsUniformsBuffer(NULL),
+  _shadowAtlas(), _pointShadowMaps(), _nbPointShadowMaps(0),
+  _cascadedShadowLight(NULL), _lightClusters(), _lightClustersBuffers(),
+  _lightClustersBufferIndex(0),
+  _lightSelection(ClusteredLights), _meshesLightsNeedUpdate(true),
+  _changedLightsBounds(),
   _currentCamera(NULL), _program(NULL), _needProgramCompilation(true),
+  _pendingProgram(NULL), _programPermutation(),
   _staticMeshesUniformsBuffers(), _staticMeshesMaterialsBuffers(),
-  _staticMeshesMaterialsBuffersIds(),
-  _frustumCulling(false),
+  _staticMeshesMaterialsBuffersIds(), _staticMeshesVersion(0),
+  _frustumCulling(false), _viewsVersion(0), _meshesInFrustumValid(false),
+  _meshesInFrustumVersion(0), _drawDistancesVersion(0),
+  _occlusionBuffer(), _occlusionCulling(false),
+  _meshesNotOccluded(), _dynamicMeshesNotOccluded(),
+  _occlusionQueries(), _occlusionQueriesEnabled(false), _meshesNotQueried(),
+  _screenSizePixels(0), _screenHeight(1),
   _envMap(NULL), _isEnvMapEnabled(false), _envMapProgram(NULL), _envMapMesh(NULL)
 {
   _root.setName("root");
@@ -40,8 +57,10 @@ gle::Scene::Scene() :
 
 gle::Scene::~Scene()
 {
-  if (_envMapProgram)
-    delete _envMapProgram;
+  if (_lightsUniformsBuffer)
+    delete _lightsUniformsBuffer;
+  for (gle::Bufferui* buffer : _lightClustersBuffers)
+    delete buffer;
   if (_envMapMesh)
     delete _envMapMesh;
   _clearStaticMeshesBuffers();
@@ -103,6 +122,10 @@ gle::Scene::Node & gle::Scene::getRootNode()
 
 const std::list<gle::Mesh*> & gle::Scene::getStaticMeshes()
 {
+  if (_frustumCulling && _occlusionQueriesEnabled)
+    return (_meshesNotQueried);
+  if (_frustumCulling && _occlusionCulling)
+    return (_meshesNotOccluded);
   if (_frustumCulling)
     return (_meshesInFrustum);
   return (_staticMeshes);
@@ -110,15 +133,123 @@ const std::list<gle::Mesh*> & gle::Scene::getStaticMeshes()
 
 const std::list<gle::Mesh*> & gle::Scene::getDynamicMeshes()
 {
+  if (_frustumCulling && _occlusionCulling)
+    return (_dynamicMeshesNotOccluded);
+  if (_frustumCulling)
+    return (_dynamicMeshesInFrustum);
   return (_dynamicMeshes);
 }
 
 void gle::Scene::processFrustumCulling()
 {
-  if (_frustumCulling)
-    _meshesInFrustum = reinterpret_cast<const std::list<gle::Mesh*>&>
-      (_tree.getElementsInFrustum(_currentCamera->getProjectionMatrix(),
-				  _currentCamera->getTransformationMatrix()));
+  if (!_frustumCulling)
+    return ;
+
+  GLint		view = _getView(_currentCamera);
+  GLfloat	frustum[6][4];
+
+  gle::Octree::getFrustumPlanes(_currentCamera->getProjectionMatrix(),
+				_currentCamera->getTransformationMatrix(), frustum);
+  // The static meshes are still those of the last frame while the camera
+  // and the tree do not change
+  if (!_meshesInFrustumValid || _meshesInFrustumVersion != _tree.getVersion()
+      || !std::equal(&frustum[0][0], &frustum[0][0] + 6 * 4,
+		     &_meshesInFrustumPlanes[0][0]))
+    {
+      _updateMeshesInFrustum(view, frustum);
+      _meshesInFrustumValid = true;
+      _meshesInFrustumVersion = _tree.getVersion();
+      std::copy(&frustum[0][0], &frustum[0][0] + 6 * 4, &_meshesInFrustumPlanes[0][0]);
+    }
+
+  // The dynamic meshes without bounding volume are never culled
+  _dynamicMeshesInFrustum.clear();
+  for (gle::Mesh* mesh : _dynamicMeshes)
+    if (!mesh->getBoundingVolume())
+      _dynamicMeshesInFrustum.push_back(mesh);
+  if (view >= 0)
+    {
+      for (GLuint i = 0; i < _viewsDynamicMeshes.size(); ++i)
+	if (_viewsDynamicMasks[i] & (1u << view))
+	  _dynamicMeshesInFrustum.push_back(_viewsDynamicMeshes[i]);
+    }
+  else
+    {
+      GLfloat detail[4];
+
+      _getDetail(_currentCamera, detail);
+
+      const std::vector<gle::Octree::Element*>& dynamicElements =
+	_dynamicTree.getVisibleElements(frustum, detail);
+
+      for (gle::Octree::Element* element : dynamicElements)
+	_dynamicMeshesInFrustum.push_back(static_cast<gle::Mesh*>(element));
+    }
+  if (_occlusionCulling)
+    _processOcclusionCulling();
+  if (_occlusionQueriesEnabled)
+    _occlusionQueries.cull(_tree, frustum,
+			   _occlusionCulling ? _meshesNotOccluded : _meshesInFrustum,
+			   _meshesNotQueried);
+}
+
+void gle::Scene::_processOcclusionCulling()
+{
+  // The occluders are taken from the meshes in the frustum only: those
+  // outside cannot hide anything inside
+  _occlusionBuffer.clear(_currentCamera->getProjectionMatrix(),
+			 _currentCamera->getTransformationMatrix());
+  for (std::list<gle::Mesh*>* meshes : {&_meshesInFrustum, &_dynamicMeshesInFrustum})
+    for (gle::Mesh* mesh : *meshes)
+      if (mesh->isOccluder())
+	{
+	  const std::vector<GLfloat>& vertexes = mesh->getOccluderVertexes();
+	  const std::vector<GLuint>& indexes = mesh->getOccluderIndexes();
+
+	  _occlusionBuffer.addOccluder(mesh->getTransformationMatrix(),
+				       &vertexes[0], vertexes.size() / 3,
+				       &indexes[0], indexes.size());
+	}
+  _occlusionBuffer.rasterize();
+
+  // The meshes without bounding volume are never culled
+  _meshesNotOccluded.clear();
+  for (gle::Mesh* mesh : _meshesInFrustum)
+    if (!mesh->getBoundingVolume()
+	|| _occlusionBuffer.isVisible(mesh->getMinPoint(), mesh->getMaxPoint()))
+      _meshesNotOccluded.push_back(mesh);
+  _dynamicMeshesNotOccluded.clear();
+  for (gle::Mesh* mesh : _dynamicMeshesInFrustum)
+    if (!mesh->getBoundingVolume()
+	|| _occlusionBuffer.isVisible(mesh->getMinPoint(), mesh->getMaxPoint()))
+      _dynamicMeshesNotOccluded.push_back(mesh);
+}
+
+void gle::Scene::_updateMeshesInFrustum(GLint view, const GLfloat frustum[6][4])
+{
+  // The camera did not move since updateShadowMaps(): the meshes of its
+  // view were found with the shadow casters
+  if (view >= 0)
+    {
+      _meshesInFrustum.clear();
+      for (GLuint i = 0; i < _viewsStaticMeshes.size(); ++i)
+	if (_viewsStaticMasks[i] & (1u << view))
+	  _meshesInFrustum.push_back(_viewsStaticMeshes[i]);
+      return ;
+    }
+
+  GLfloat detail[4];
+
+  _getDetail(_currentCamera, detail);
+
+  const std::vector<gle::Octree::Element*>& elements =
+    _tree.getVisibleElements(frustum, detail);
+
+  // The nodes of the previous list are reused
+  _meshesInFrustum.resize(elements.size());
+  auto mesh = _meshesInFrustum.begin();
+  for (gle::Octree::Element* element : elements)
+    *mesh++ = static_cast<gle::Mesh*>(element);
 }
 
 std::vector<gle::Camera*> & gle::Scene::getCameras()
@@ -138,177 +269,665 @@ gle::Camera* gle::Scene::getCurrentCamera()
 
 void gle::Scene::updateShadowMaps(gle::Renderer* renderer)
 {
+  _cullViews();
   for (gle::Light* light : _lights)
     updateShadowMap(renderer, light);
 }
 
+void gle::Scene::_cullViews()
+{
+  std::vector<gle::Camera*>	cameras;
+  GLfloat			frustums[gle::Octree::maximumNumberOfViews][6][4];
+
+  if (!_frustumCulling || !_currentCamera)
+    {
+      _viewsCameras.clear();
+      return ;
+    }
+  // The camera, the spot lights and the cascades are culled in a single
+  // traversal of the trees
+  cameras.push_back(_currentCamera);
+  for (gle::Light* light : _lights)
+    if (light == _cascadedShadowLight && light->getShadowMap())
+      {
+	_cascadedShadowLight->updateCascades(_currentCamera->getTransformationMatrix(),
+					     _currentCamera->getProjectionMatrix());
+	for (GLuint cascade = 0; cascade < gle::DirectionalLight::NbCascades; ++cascade)
+	  cameras.push_back(_cascadedShadowLight->getCascadeCamera(cascade));
+      }
+    else if (light->getLightType() == gle::Light::SPOT && light->projectShadow()
+	     && light->hasShadowMapTile() && light->getShadowMapCamera())
+      cameras.push_back(light->getShadowMapCamera());
+  // The other cameras are culled with their own query
+  if (cameras.size() > gle::Octree::maximumNumberOfViews)
+    cameras.resize(gle::Octree::maximumNumberOfViews);
+  for (GLuint view = 0; view < cameras.size(); ++view)
+    gle::Octree::getFrustumPlanes(cameras[view]->getProjectionMatrix(),
+				  cameras[view]->getTransformationMatrix(),
+				  frustums[view]);
+
+  // The camera is the first view, the only one culled with the detail
+  GLfloat detail[4];
+
+  _getDetail(_currentCamera, detail);
+
+  // The static meshes of the views are kept while the views and the
+  // tree do not change
+  bool cached = cameras == _viewsCameras && _viewsVersion == _tree.getVersion()
+    && std::equal(&frustums[0][0][0], &frustums[0][0][0] + cameras.size() * 6 * 4,
+		  &_viewsFrustums[0][0][0]);
+
+  _viewsCameras.swap(cameras);
+  std::copy(&frustums[0][0][0], &frustums[0][0][0] + _viewsCameras.size() * 6 * 4,
+	    &_viewsFrustums[0][0][0]);
+  if (!cached)
+    {
+      const std::vector<gle::Octree::Element*>& elements =
+	_tree.getVisibleElements(_viewsFrustums, _viewsCameras.size(), detail);
+
+      _viewsStaticMeshes.clear();
+      for (gle::Octree::Element* element : elements)
+	_viewsStaticMeshes.push_back(static_cast<gle::Mesh*>(element));
+      _viewsStaticMasks = _tree.getVisibleMasks();
+      _viewsVersion = _tree.getVersion();
+    }
+
+  const std::vector<gle::Octree::Element*>& dynamicElements =
+    _dynamicTree.getVisibleElements(_viewsFrustums, _viewsCameras.size(), detail);
+
+  _viewsDynamicMeshes.clear();
+  for (gle::Octree::Element* element : dynamicElements)
+    _viewsDynamicMeshes.push_back(static_cast<gle::Mesh*>(element));
+  _viewsDynamicMasks = _dynamicTree.getVisibleMasks();
+}
+
+GLint gle::Scene::_getView(gle::Camera* camera) const
+{
+  GLfloat frustum[6][4];
+
+  for (GLuint view = 0; view < _viewsCameras.size(); ++view)
+    if (_viewsCameras[view] == camera)
+      {
+	// The camera may have moved since the views were culled
+	gle::Octree::getFrustumPlanes(camera->getProjectionMatrix(),
+				      camera->getTransformationMatrix(), frustum);
+	if (std::equal(&frustum[0][0], &frustum[0][0] + 6 * 4,
+		       &_viewsFrustums[view][0][0]))
+	  return (view);
+	return (-1);
+      }
+  return (-1);
+}
+
+void gle::Scene::_getDetail(gle::Camera* camera, GLfloat detail[4]) const
+{
+  const gle::Matrix4<GLfloat>&	projection = camera->getProjectionMatrix();
+  const gle::Vector3<GLfloat>&	position = camera->getAbsolutePosition();
+
+  // A sphere of radius r at a distance d covers r * p / d of the height
+  // of the screen, p being the scale of the projection on y
+  detail[0] = position.x;
+  detail[1] = position.y;
+  detail[2] = position.z;
+  detail[3] = 0;
+  if (projection[15] == 0 && projection[5] > 0)
+    detail[3] = _screenSizePixels / (projection[5] * _screenHeight);
+}
+
 void gle::Scene::updateShadowMap(gle::Renderer* renderer, gle::Light* light)
 {
-  gle::Texture*		shadowMap;
-  gle::FrameBuffer*	frameBuffer;
   gle::Camera*		lightCamera;
-  if (!light->projectShadow()
-      || !(lightCamera = light->getShadowMapCamera())
-      || !(shadowMap = light->getShadowMap())
-      || !(frameBuffer = light->getShadowMapFrameBuffer()))
+  if (light->getLightType() == gle::Light::DIRECTIONAL)
+    {
+      if (light == _cascadedShadowLight)
+	_updateCascades(renderer);
+      return ;
+    }
+  if (light->getLightType() == gle::Light::POINT)
+    {
+      _updatePointShadowMap(renderer, static_cast<gle::PointLight*>(light));
+      return ;
+    }
+  if (!light->projectShadow() || !light->hasShadowMapTile()
+      || !(lightCamera = light->getShadowMapCamera()))
     return ;
-  std::list<gle::Mesh*> staticMeshes;
-  if (_frustumCulling)
-    staticMeshes = reinterpret_cast<const std::list<gle::Mesh*>&>
-      (_tree.getElementsInFrustum(lightCamera->getProjectionMatrix(),
-				  lightCamera->getTransformationMatrix()));
-  else
-    staticMeshes = _staticMeshes;
-  for (auto it = staticMeshes.begin(); it != staticMeshes.end();)
+
+  gle::Light::StaticShadowCasters& casters = light->getStaticShadowCasters();
+  Matrix4<GLfloat> lightMatrix = lightCamera->getProjectionMatrix()
+    * lightCamera->getTransformationMatrix();
+
+  if (!casters.valid || casters.matrix != lightMatrix
+      || casters.staticMeshesVersion != _staticMeshesVersion)
     {
-      if (!(*it)->projectShadow())
-	it = staticMeshes.erase(it);
+      std::list<gle::Mesh*> staticMeshes = _getStaticShadowCasters(lightCamera);
+      std::vector<Matrix4<GLfloat> > matrices;
+
+      matrices.reserve(staticMeshes.size());
+      for (gle::Mesh* mesh : staticMeshes)
+	matrices.push_back(mesh->getTransformationMatrix());
+      // The static meshes were rebuilt, but none of the casters moved
+      if (casters.valid && casters.matrix == lightMatrix
+	  && casters.meshes == staticMeshes && casters.meshesMatrices == matrices)
+	casters.staticMeshesVersion = _staticMeshesVersion;
       else
-	++it;
+	{
+	  // Without static casters there is nothing to cache, and the
+	  // static atlas is not needed
+	  casters.valid = staticMeshes.empty()
+	    || renderer->renderShadowMap(this, staticMeshes,
+					 std::list<gle::Mesh*>(), light,
+					 _shadowAtlas.getStaticFrameBuffer());
+	  casters.matrix = lightMatrix;
+	  casters.staticMeshesVersion = _staticMeshesVersion;
+	  casters.meshes.swap(staticMeshes);
+	  casters.meshesMatrices.swap(matrices);
+	}
     }
-  std::list<gle::Mesh*> dynamicMeshes = getDynamicMeshes();
-  for (auto it = dynamicMeshes.begin(); it != dynamicMeshes.end();)
+  if (!casters.valid)
+    return ;
+
+  // All the lights render in their tile of the same framebuffers
+  renderer->renderShadowMap(this, std::list<gle::Mesh*>(),
+			    _getDynamicShadowCasters(lightCamera),
+			    light, _shadowAtlas.getFrameBuffer(),
+			    casters.meshes.empty() ? NULL
+			    : _shadowAtlas.getStaticFrameBuffer());
+}
+
+void gle::Scene::_updateCascades(gle::Renderer* renderer)
+{
+  gle::DirectionalLight* light = _cascadedShadowLight;
+
+  if (!_currentCamera || !light->getShadowMap())
+    return ;
+  light->updateCascades(_currentCamera->getTransformationMatrix(),
+			_currentCamera->getProjectionMatrix());
+
+  // Each cascade only renders the casters of its own frustum
+  for (GLuint cascade = 0; cascade < gle::DirectionalLight::NbCascades; ++cascade)
     {
-      if (!(*it)->projectShadow())
-	it = dynamicMeshes.erase(it);
-      else
-	++it;
+      gle::Camera* camera = light->getCascadeCamera(cascade);
+
+      if (!renderer->renderShadowMap(this, _getStaticShadowCasters(camera),
+				     _getDynamicShadowCasters(camera), light,
+				     light->getCascadeFrameBuffer(cascade),
+				     NULL, camera))
+	return ;
     }
-  renderer->renderShadowMap(this, staticMeshes, dynamicMeshes, light);
 }
 
-void gle::Scene::updateLights()
+void gle::Scene::_updatePointShadowMap(gle::Renderer* renderer,
+				      gle::PointLight* light)
 {
-  _directionalLightsDirection.resize(0);
-  _directionalLightsColor.resize(0);
-
-  _pointLightsPosition.resize(0);
-  _pointLightsColor.resize(0);
-  _pointLightsSpecularColor.resize(0);
-  _pointLightsAttenuation.resize(0);
-
-  _spotLightsPosition.resize(0);
-  _spotLightsColor.resize(0);
-  _spotLightsSpecularColor.resize(0);
-  _spotLightsAttenuation.resize(0);
-  _spotLightsDirection.resize(0);
-  _spotLightsCosCutOff.resize(0);
-  _spotLightsInnerCosCutOff.resize(0);
-  _spotLightsHasShadowMap.resize(0);
-  _spotLightsShadowMapMatrix.resize(0);
-  _spotLightsShadowMap.resize(0);
-
-  gle::Matrix4f
-    shadowMapBiasMatrix(
-			0.5, 0.0, 0.0, 0.5,
-			0.0, 0.5, 0.0, 0.5,
-			0.0, 0.0, 0.5, 0.5,
-			0.0, 0.0, 0.0, 1.0
-			);
-
-  unsigned int dSize = 0;
-  unsigned int pSize = 0;
-  unsigned int sSize = 0;
-  for (auto it = _lights.begin();
-       it != _lights.end(); ++it)
-    {
-      if ((*it)->getLightType() == gle::Light::DIRECTIONAL)
+  std::map<GLuint, std::list<gle::Mesh*> >	staticMeshes;
+  std::list<std::pair<gle::Mesh*, GLuint> >	dynamicMeshes;
+
+  if (!light->projectShadow() || light->getShadowMapLayer() < 0)
+    return ;
+  // Each mesh is only rendered in the faces whose frustum it reaches:
+  // the six faces are culled in a single traversal of the trees
+  if (_frustumCulling)
+    {
+      GLfloat	frustums[gle::PointLight::NbFaces][6][4];
+
+      for (GLuint face = 0; face < gle::PointLight::NbFaces; ++face)
+	gle::Octree::getFrustumPlanes(light->getShadowMapProjection(),
+				      light->getFaceViewMatrix(face), frustums[face]);
+
+      const std::vector<gle::Octree::Element*>& elements =
+	_tree.getVisibleElements(frustums, gle::PointLight::NbFaces);
+      const std::vector<GLuint>& masks = _tree.getVisibleMasks();
+
+      for (GLuint i = 0; i < elements.size(); ++i)
+	if (static_cast<gle::Mesh*>(elements[i])->projectShadow())
+	  staticMeshes[masks[i]].push_back(static_cast<gle::Mesh*>(elements[i]));
+
+      const std::vector<gle::Octree::Element*>& dynamicElements =
+	_dynamicTree.getVisibleElements(frustums, gle::PointLight::NbFaces);
+      const std::vector<GLuint>& dynamicMasks = _dynamicTree.getVisibleMasks();
+
+      for (GLuint i = 0; i < dynamicElements.size(); ++i)
+	if (static_cast<gle::Mesh*>(dynamicElements[i])->projectShadow())
+	  dynamicMeshes.push_back(std::make_pair(static_cast<gle::Mesh*>(dynamicElements[i]),
+						 dynamicMasks[i]));
+      for (gle::Mesh* mesh : _dynamicMeshes)
+	if (!mesh->getBoundingVolume() && mesh->projectShadow())
+	  dynamicMeshes.push_back(std::make_pair(mesh, _getFacesMask(light, mesh)));
+    }
+  else
+    {
+      for (gle::Mesh* mesh : _staticMeshes)
 	{
-	  ++dSize;
-	  gle::Vector3<GLfloat> direction = ((gle::DirectionalLight*)(*it))->getDirection();
-	  if (!_currentCamera)
-	    throw (new gle::Exception::Exception("No camera for the scene..."));
-	  GLfloat* color = ((gle::DirectionalLight*)(*it))->getColor();
-	  _directionalLightsDirection.push_back(direction.x);
-	  _directionalLightsDirection.push_back(direction.y);
-	  _directionalLightsDirection.push_back(direction.z);
-	  _directionalLightsColor.push_back(color[0]);
-	  _directionalLightsColor.push_back(color[1]);
-	  _directionalLightsColor.push_back(color[2]);
+	  GLuint mask = _getFacesMask(light, mesh);
+
+	  if (mask && mesh->projectShadow())
+	    staticMeshes[mask].push_back(mesh);
 	}
-      else if ((*it)->getLightType() == gle::Light::POINT)
+      for (gle::Mesh* mesh : _dynamicMeshes)
 	{
-	  ++pSize;
-	  gle::Vector3<GLfloat> position = ((gle::PointLight*)(*it))->getAbsolutePosition();
-	  if (!_currentCamera)
-	    throw (new gle::Exception::Exception("No camera for the scene..."));
-	  position *= _currentCamera->getTransformationMatrix();
-          GLfloat* color = ((gle::PointLight*)(*it))->getColor();
-          GLfloat* specularColor = ((gle::PointLight*)(*it))->getSpecularColor();
-          GLfloat* attenuation = ((gle::PointLight*)(*it))->getAttenuation();
-          _pointLightsPosition.push_back(position.x);
-          _pointLightsPosition.push_back(position.y);
-          _pointLightsPosition.push_back(position.z);
-          _pointLightsColor.push_back(color[0]);
-          _pointLightsColor.push_back(color[1]);
-          _pointLightsColor.push_back(color[2]);
-          _pointLightsSpecularColor.push_back(specularColor[0]);
-          _pointLightsSpecularColor.push_back(specularColor[1]);
-          _pointLightsSpecularColor.push_back(specularColor[2]);
-	  _pointLightsAttenuation.push_back(attenuation[0]);
-          _pointLightsAttenuation.push_back(attenuation[1]);
-          _pointLightsAttenuation.push_back(attenuation[2]);
+	  GLuint mask = _getFacesMask(light, mesh);
+
+	  if (mask && mesh->projectShadow())
+	    dynamicMeshes.push_back(std::make_pair(mesh, mask));
 	}
-      else if ((*it)->getLightType() == gle::Light::SPOT)
+    }
+  renderer->renderPointShadowMap(this, staticMeshes, dynamicMeshes, light);
+}
+
+GLuint gle::Scene::_getFacesMask(gle::PointLight* light, gle::Mesh* mesh)
+{
+  gle::BoundingVolume* boundingVolume = mesh->getBoundingVolume();
+
+  if (!boundingVolume)
+    return ((1 << gle::PointLight::NbFaces) - 1);
+  return (light->getFacesMask(boundingVolume->getMinPoint(),
+			      boundingVolume->getMaxPoint()));
+}
+
+std::list<gle::Mesh*> gle::Scene::_getStaticShadowCasters(gle::Camera* lightCamera)
+{
+  std::list<gle::Mesh*> staticMeshes;
+  GLint			view = _getView(lightCamera);
+
+  // The casters were found when culling the views
+  if (view >= 0)
+    {
+      for (GLuint i = 0; i < _viewsStaticMeshes.size(); ++i)
+	if ((_viewsStaticMasks[i] & (1u << view))
+	    && _viewsStaticMeshes[i]->projectShadow())
+	  staticMeshes.push_back(_viewsStaticMeshes[i]);
+      return (staticMeshes);
+    }
+  if (_frustumCulling)
+    {
+      const std::vector<gle::Octree::Element*>& elements =
+	_tree.getVisibleElements(lightCamera->getProjectionMatrix(),
+				 lightCamera->getTransformationMatrix());
+
+      for (gle::Octree::Element* element : elements)
+	if (static_cast<gle::Mesh*>(element)->projectShadow())
+	  staticMeshes.push_back(static_cast<gle::Mesh*>(element));
+      return (staticMeshes);
+    }
+  for (gle::Mesh* mesh : _staticMeshes)
+    if (mesh->projectShadow())
+      staticMeshes.push_back(mesh);
+  return (staticMeshes);
+}
+
+std::list<gle::Mesh*> gle::Scene::_getDynamicShadowCasters(gle::Camera* lightCamera)
+{
+  std::list<gle::Mesh*> dynamicMeshes;
+  if (_frustumCulling)
+    {
+      GLint view = _getView(lightCamera);
+
+      for (gle::Mesh* mesh : _dynamicMeshes)
+	if (!mesh->getBoundingVolume() && mesh->projectShadow())
+	  dynamicMeshes.push_back(mesh);
+      if (view >= 0)
 	{
-	  ++sSize;
-	  gle::SpotLight* light = dynamic_cast<gle::SpotLight*>(*it);
-
-	  gle::Vector3<GLfloat> position = light->getAbsolutePosition();
-
-	  if (!_currentCamera)
-	    throw (new gle::Exception::Exception("No camera for the scene..."));
-	  Vector3f direction = light->getTarget();
-	  direction *= _currentCamera->getTransformationMatrix();
-	  position *= _currentCamera->getTransformationMatrix();
-	  direction -= position;
-          GLfloat* color = light->getColor();
-          GLfloat* specularColor = light->getSpecularColor();
-          GLfloat* attenuation = light->getAttenuation();
-          _spotLightsPosition.push_back(position.x);
-          _spotLightsPosition.push_back(position.y);
-          _spotLightsPosition.push_back(position.z);
-          _spotLightsColor.push_back(color[0]);
-          _spotLightsColor.push_back(color[1]);
-          _spotLightsColor.push_back(color[2]);
-          _spotLightsSpecularColor.push_back(specularColor[0]);
-          _spotLightsSpecularColor.push_back(specularColor[1]);
-          _spotLightsSpecularColor.push_back(specularColor[2]);
-	  _spotLightsAttenuation.push_back(attenuation[0]);
-          _spotLightsAttenuation.push_back(attenuation[1]);
-          _spotLightsAttenuation.push_back(attenuation[2]);
-	  _spotLightsDirection.push_back(direction.x);
-          _spotLightsDirection.push_back(direction.y);
-          _spotLightsDirection.push_back(direction.z);
-          _spotLightsCosCutOff.push_back(light->getCosCutOff());
-          _spotLightsInnerCosCutOff.push_back(light->getInnerCosCutOff());
-
-	  if (light->projectShadow()
-	      && light->getShadowMapCamera()
-	      && light->getShadowMap())
-	    {
-	      _spotLightsHasShadowMap.push_back(true);
-	      gle::Matrix4f VPMatrix =
-		shadowMapBiasMatrix
-		* light->getShadowMapCamera()->getProjectionMatrix()
-		* light->getShadowMapCamera()->getTransformationMatrix();
-	      GLfloat* VPMatrixf = (GLfloat*)VPMatrix;
-	      for (int i = 0; i < 16; ++i)
-		_spotLightsShadowMapMatrix.push_back(VPMatrixf[i]);
-	      _spotLightsShadowMap.push_back(light->getShadowMap());
-	    }
-	  else
-	    {
-	      _spotLightsHasShadowMap.push_back(false);
-	      for (int i = 0; i < 16; ++i)
-		_spotLightsShadowMapMatrix.push_back(0);
-	      _spotLightsShadowMap.push_back(NULL);
-	    }
+	  for (GLuint i = 0; i < _viewsDynamicMeshes.size(); ++i)
+	    if ((_viewsDynamicMasks[i] & (1u << view))
+		&& _viewsDynamicMeshes[i]->projectShadow())
+	      dynamicMeshes.push_back(_viewsDynamicMeshes[i]);
+	  return (dynamicMeshes);
+	}
+
+      const std::vector<gle::Octree::Element*>& elements =
+	_dynamicTree.getVisibleElements(lightCamera->getProjectionMatrix(),
+					lightCamera->getTransformationMatrix());
+
+      for (gle::Octree::Element* element : elements)
+	if (static_cast<gle::Mesh*>(element)->projectShadow())
+	  dynamicMeshes.push_back(static_cast<gle::Mesh*>(element));
+      return (dynamicMeshes);
+    }
+  for (gle::Mesh* mesh : _dynamicMeshes)
+    if (mesh->projectShadow())
+      dynamicMeshes.push_back(mesh);
+  return (dynamicMeshes);
+}
+
+void gle::Scene::updateLights()
+{
+  GLsizeiptr	maxLights = getMaxLights();
+  GLsizeiptr	size = LightsHeaderSize + maxLights * gle::Light::UniformSize;
+  GLsizeiptr	sizes[3] = {0, 0, 0};
+  GLsizeiptr	offset = LightsHeaderSize;
+  GLsizeiptr	dirtyStart = size;
+  GLsizeiptr	dirtyEnd = 0;
+  GLfloat	uniforms[gle::Light::UniformSize];
+
+  if (!_lightsUniformsBuffer)
+    {
+      _lightsUniforms.assign(size, 0);
+      _lightsUniformsBuffer = new gle::Bufferf(gle::Bufferf::UniformArray,
+					       gle::Bufferf::DynamicDraw,
+					       size, &_lightsUniforms[0]);
+    }
+  _cascadedShadowLight = NULL;
+  if (_currentCamera)
+    {
+      _allocateShadowMapTiles();
+      _allocatePointShadowMaps();
+    }
+  _lightClusters.clear();
+  // Lights are sorted by type, so the shaders only need their counts
+  for (int type = gle::Light::DIRECTIONAL; type <= gle::Light::SPOT; ++type)
+    for (gle::Light* light : _lights)
+      {
+	if (light->getLightType() != type
+	    || offset - LightsHeaderSize >= maxLights * gle::Light::UniformSize)
+	  continue ;
+	if (!_currentCamera)
+	  throw (new gle::Exception::Exception("No camera for the scene..."));
+	light->getUniforms(uniforms);
+	if (uniforms[15] > 0 && type == gle::Light::DIRECTIONAL)
+	  {
+	    if (!_cascadedShadowLight)
+	      _cascadedShadowLight = static_cast<gle::DirectionalLight*>(light);
+	    else
+	      uniforms[15] = 0;
+	  }
+	if (!std::equal(uniforms, uniforms + gle::Light::UniformSize,
+			&_lightsUniforms[offset]))
+	  {
+	    // The meshes near the previous and new positions select their lights again
+	    if (type != gle::Light::DIRECTIONAL)
+	      {
+		_addChangedLightBounds(&_lightsUniforms[offset]);
+		_addChangedLightBounds(uniforms);
+	      }
+	    std::copy(uniforms, uniforms + gle::Light::UniformSize,
+		      &_lightsUniforms[offset]);
+	    dirtyStart = std::min(dirtyStart, offset);
+	    dirtyEnd = offset + gle::Light::UniformSize;
+	  }
+	if (type != gle::Light::DIRECTIONAL)
+	  _lightClusters.addLight(gle::Vector3<GLfloat>(uniforms[0], uniforms[1],
+							uniforms[2]),
+				  gle::LightClusters::getLightRange(uniforms[16], uniforms[17], uniforms[18],
+								    GLE_LIGHT_ATTENUATION_THRESHOLD),
+				  (offset - LightsHeaderSize) / gle::Light::UniformSize);
+	++sizes[type];
+	offset += gle::Light::UniformSize;
+      }
+  for (int type = gle::Light::DIRECTIONAL; type <= gle::Light::SPOT; ++type)
+    if (_lightsUniforms[type] != sizes[type])
+      {
+	_lightsUniforms[type] = sizes[type];
+	_meshesLightsNeedUpdate = true;
+	dirtyStart = 0;
+	dirtyEnd = std::max(dirtyEnd, (GLsizeiptr)LightsHeaderSize);
+      }
+  // Only the range of the lights which changed is uploaded. Its previous
+  // content is invalidated, so the driver does not need to keep it
+  if (dirtyStart < dirtyEnd)
+    {
+      GLfloat* data = _lightsUniformsBuffer->map(dirtyStart,
+						 dirtyEnd - dirtyStart,
+						 gle::Bufferf::WriteOnly,
+						 gle::Bufferf::InvalidateRange);
+      std::copy(_lightsUniforms.begin() + dirtyStart,
+		_lightsUniforms.begin() + dirtyEnd, data);
+      _lightsUniformsBuffer->unmap();
+    }
+  _directionalLightsSize = sizes[gle::Light::DIRECTIONAL];
+  _pointLightsSize = sizes[gle::Light::POINT];
+  _spotLightsSize = sizes[gle::Light::SPOT];
+}
+
+void gle::Scene::_allocateShadowMapTiles()
+{
+  std::vector<std::pair<GLuint, gle::Light*> >	tiles;
+  const Matrix4<GLfloat>&	view = _currentCamera->getTransformationMatrix();
+  const Matrix4<GLfloat>&	projection = _currentCamera->getProjectionMatrix();
+
+  // Lights covering a larger part of the screen get larger tiles
+  for (gle::Light* light : _lights)
+    if (light->getLightType() == gle::Light::SPOT)
+      {
+	if (light->projectShadow())
+	  tiles.push_back(std::make_pair(_shadowAtlas.getTileSize(_getShadowMapImportance(light, view, projection),
+								  light->getShadowMapSize()),
+					 light));
+	else
+	  light->setShadowMapTile(gle::Rectui(0, 0, 0, 0), 0);
+      }
+  // The atlas packs the tiles without holes from the largest to the smallest
+  std::stable_sort(tiles.begin(), tiles.end(),
+		   [](const std::pair<GLuint, gle::Light*>& a,
+		      const std::pair<GLuint, gle::Light*>& b)
+		   { return (a.first > b.first); });
+  _shadowAtlas.clear();
+  for (std::pair<GLuint, gle::Light*>& tile : tiles)
+    {
+      gle::Rectui rect(0, 0, 0, 0);
+
+      // The last lights get smaller tiles when the atlas is full
+      for (GLuint size = tile.first; size >= _shadowAtlas.getMinTileSize(); size /= 2)
+	if (_shadowAtlas.allocate(size, rect))
+	  break ;
+      tile.second->setShadowMapTile(rect, _shadowAtlas.getSize());
+    }
+}
+
+void gle::Scene::_allocatePointShadowMaps()
+{
+  std::vector<std::pair<GLfloat, gle::PointLight*> >	importances;
+  const Matrix4<GLfloat>&	view = _currentCamera->getTransformationMatrix();
+  const Matrix4<GLfloat>&	projection = _currentCamera->getProjectionMatrix();
+
+  for (gle::Light* light : _lights)
+    if (light->getLightType() == gle::Light::POINT)
+      {
+	gle::PointLight* pointLight = static_cast<gle::PointLight*>(light);
+
+	pointLight->setShadowMapLayer(-1, 0);
+	if (light->projectShadow())
+	  importances.push_back(std::make_pair(_getShadowMapImportance(light, view, projection),
+					       pointLight));
+      }
+  // Only the lights covering the largest part of the screen get shadows
+  std::stable_sort(importances.begin(), importances.end(),
+		   [](const std::pair<GLfloat, gle::PointLight*>& a,
+		      const std::pair<GLfloat, gle::PointLight*>& b)
+		   { return (a.first > b.first); });
+  _nbPointShadowMaps = std::min((GLuint)importances.size(),
+				_pointShadowMaps.getMaxLights());
+  for (GLuint i = 0; i < _nbPointShadowMaps; ++i)
+    {
+      gle::PointLight* light = importances[i].second;
+
+      light->setShadowMapLayer(i * gle::PointLight::NbFaces,
+			       _pointShadowMaps.getSize());
+      light->updateShadowMapFaces(_getLightRange(light));
+    }
+}
+
+GLfloat gle::Scene::_getLightRange(gle::Light* light)
+{
+  const GLfloat* attenuation;
+
+  if (light->getLightType() == gle::Light::POINT)
+    attenuation = static_cast<gle::PointLight*>(light)->getAttenuation();
+  else if (light->getLightType() == gle::Light::SPOT)
+    attenuation = static_cast<gle::SpotLight*>(light)->getAttenuation();
+  else
+    return (-1);
+  return (gle::LightClusters::getLightRange(attenuation[0], attenuation[1],
+					    attenuation[2],
+					    GLE_LIGHT_ATTENUATION_THRESHOLD));
+}
+
+GLfloat gle::Scene::_getShadowMapImportance(gle::Light* light,
+					    const Matrix4<GLfloat>& view,
+					    const Matrix4<GLfloat>& projection)
+{
+  GLfloat		range = _getLightRange(light);
+  gle::Vector3<GLfloat>	position = light->getAbsolutePosition();
+
+  position *= view;
+  GLfloat distance = sqrt(position * position);
+  if (range < 0 || distance <= range)
+    return (1);
+  // Half the height of the projection of the sphere of the light on the screen
+  if (projection[11] != 0)
+    return (range * projection[5] / sqrt(distance * distance - range * range));
+  return (range * projection[5]);
+}
+
+void gle::Scene::updateLightClusters()
+{
+  if (!_currentCamera)
+    return ;
+  if (!_lightClusters.getMaxIndexes())
+    _lightClusters.setMaxIndexes(getMaxLightClustersIndexes());
+  if (_lightClustersBuffers.empty())
+    for (GLuint i = 0; i < GLE_LIGHT_CLUSTERS_BUFFERS; ++i)
+      {
+	gle::Bufferui* buffer = new gle::Bufferui(gle::Bufferui::UniformArray,
+						  gle::Bufferui::StreamDraw,
+						  _lightClusters.getData().size(),
+						  &_lightClusters.getData()[0]);
+	buffer->setPersistent();
+	_lightClustersBuffers.push_back(buffer);
+      }
+  _lightClusters.build(_currentCamera->getTransformationMatrix(),
+		       _currentCamera->getProjectionMatrix());
+  // All the commands using the previous buffer are sent: fence them, and
+  // write the clusters in the next buffer once the gpu is done with it.
+  // Without persistent mapping, the range is mapped unsynchronized
+  _lightClustersBuffers[_lightClustersBufferIndex]->lock();
+  _lightClustersBufferIndex = (_lightClustersBufferIndex + 1)
+    % _lightClustersBuffers.size();
+
+  gle::Bufferui*	buffer = _lightClustersBuffers[_lightClustersBufferIndex];
+  GLsizeiptr		size = _lightClusters.getDataSize();
+
+  buffer->wait();
+  GLuint* data = buffer->map(0, size, gle::Bufferui::WriteOnly,
+			     gle::Bufferui::InvalidateRange
+			     | gle::Bufferui::Unsynchronized);
+  std::copy(_lightClusters.getData().begin(),
+	    _lightClusters.getData().begin() + size, data);
+  buffer->unmap();
+}
+
+void gle::Scene::updateMeshesLights()
+{
+  if (!_meshesLightsNeedUpdate && _changedLightsBounds.empty())
+    return ;
+  for (gle::Mesh* mesh : _staticMeshes)
+    {
+      if (!_meshesLightsNeedUpdate && !_isNearChangedLights(mesh))
+	continue ;
+      GLint bufferId = mesh->getUniformBufferId();
+      if (_selectMeshLights(mesh) && bufferId >= 0
+	  && bufferId < (GLint)_staticMeshesUniformsBuffers.size())
+	_staticMeshesUniformsBuffers[bufferId]
+	  ->setData(mesh->getUniforms() + Mesh::UniformLightsOffset,
+		    mesh->getUniformIndex() * Mesh::UniformSize + Mesh::UniformLightsOffset,
+		    Mesh::UniformSize - Mesh::UniformLightsOffset);
+    }
+  _meshesLightsNeedUpdate = false;
+  _changedLightsBounds.clear();
+}
+
+bool gle::Scene::_selectMeshLights(gle::Mesh* mesh)
+{
+  GLuint	lights[Mesh::MaxLights];
+  GLfloat	influences[Mesh::MaxLights];
+  GLint		nbLights = 0;
+  GLsizeiptr	nbPointAndSpotLights = _pointLightsSize + _spotLightsSize;
+
+  if (_lightSelection != MeshLights)
+    return (mesh->setLights(NULL, -1));
+  // Keep the most influential lights, sorted by decreasing influence
+  for (GLsizeiptr i = 0; i < nbPointAndSpotLights; ++i)
+    {
+      GLuint	index = _directionalLightsSize + i;
+      GLfloat	influence = _getLightInfluence(&_lightsUniforms[LightsHeaderSize
+								 + index * gle::Light::UniformSize],
+						   mesh);
+      GLint	position = nbLights;
+
+      if (influence <= 0)
+	continue ;
+      while (position > 0 && influences[position - 1] < influence)
+	--position;
+      if (position >= Mesh::MaxLights)
+	continue ;
+      if (nbLights < Mesh::MaxLights)
+	++nbLights;
+      for (GLint j = nbLights - 1; j > position; --j)
+	{
+	  lights[j] = lights[j - 1];
+	  influences[j] = influences[j - 1];
 	}
+      lights[position] = index;
+      influences[position] = influence;
     }
-  _directionalLightsSize = dSize;
-  _pointLightsSize = pSize;
-  _spotLightsSize = sSize;
+  return (mesh->setLights(lights, nbLights));
+}
+
+GLfloat gle::Scene::_getLightInfluence(const GLfloat* light, gle::Mesh* mesh) const
+{
+  const gle::Vector3<GLfloat>& min = mesh->getBoundingVolume()->getMinPoint();
+  const gle::Vector3<GLfloat>& max = mesh->getBoundingVolume()->getMaxPoint();
+  GLfloat	range = gle::LightClusters::getLightRange(light[16], light[17], light[18],
+							  GLE_LIGHT_ATTENUATION_THRESHOLD);
+  GLfloat	attenuation = 1;
+  GLfloat	dx = std::max(std::max(min.x - light[0], light[0] - max.x), 0.0f);
+  GLfloat	dy = std::max(std::max(min.y - light[1], light[1] - max.y), 0.0f);
+  GLfloat	dz = std::max(std::max(min.z - light[2], light[2] - max.z), 0.0f);
+  GLfloat	distance = sqrt(dx * dx + dy * dy + dz * dz);
+
+  if (range >= 0 && distance > range)
+    return (0);
+  if (light[16] != 0 || light[17] != 0 || light[18] != 0)
+    attenuation = std::min(1 / (light[16] + light[17] * distance
+				+ light[18] * distance * distance), 1.0f);
+  // Attenuation at the nearest point of the bounding box, times the luminance
+  return (attenuation * (0.2126 * light[8] + 0.7152 * light[9] + 0.0722 * light[10]));
+}
+
+void gle::Scene::_addChangedLightBounds(const GLfloat* light)
+{
+  _changedLightsBounds.insert(_changedLightsBounds.end(), light, light + 3);
+  _changedLightsBounds.push_back(gle::LightClusters::getLightRange(light[16], light[17], light[18],
+								   GLE_LIGHT_ATTENUATION_THRESHOLD));
+}
+
+bool gle::Scene::_isNearChangedLights(gle::Mesh* mesh) const
+{
+  const gle::Vector3<GLfloat>& min = mesh->getBoundingVolume()->getMinPoint();
+  const gle::Vector3<GLfloat>& max = mesh->getBoundingVolume()->getMaxPoint();
+
+  for (GLsizeiptr i = 0; i < (GLsizeiptr)_changedLightsBounds.size(); i += 4)
+    {
+      const GLfloat* bounds = &_changedLightsBounds[i];
+      GLfloat dx = std::max(std::max(min.x - bounds[0], bounds[0] - max.x), 0.0f);
+      GLfloat dy = std::max(std::max(min.y - bounds[1], bounds[1] - max.y), 0.0f);
+      GLfloat dz = std::max(std::max(min.z - bounds[2], bounds[2] - max.z), 0.0f);
+
+      if (bounds[3] < 0 || dx * dx + dy * dy + dz * dz <= bounds[3] * bounds[3])
+	return (true);
+    }
+  return (false);
+}
+
+void gle::Scene::setLightSelection(LightSelection selection)
+{
+  if (selection != _lightSelection)
+    _meshesLightsNeedUpdate = true;
+  _lightSelection = selection;
+}
+
+gle::Scene::LightSelection gle::Scene::getLightSelection() const
+{
+  return (_lightSelection);
 }
 
 void gle::Scene::updateSkeletons()
@@ -338,94 +957,68 @@ void gle::Scene::updateSkeleton(Scene::Node* node)
 }
 
 
-GLfloat* gle::Scene::getDirectionalLightsDirection() const
-{
-  return ((GLfloat*)&_directionalLightsDirection[0]);
-}
-
-GLfloat* gle::Scene::getDirectionalLightsColor() const
-{
-  return ((GLfloat*)&_directionalLightsColor[0]);
-}
-
 GLsizeiptr gle::Scene::getDirectionalLightsSize() const
 {
   return (_directionalLightsSize);
 }
 
-GLfloat* gle::Scene::getPointLightsPosition() const
-{
-  return ((GLfloat*)&_pointLightsPosition[0]);
-}
-
-GLfloat* gle::Scene::getPointLightsColor() const
-{
-  return ((GLfloat*)&_pointLightsColor[0]);
-}
-
-GLfloat* gle::Scene::getPointLightsSpecularColor() const
-{
-  return ((GLfloat*)&_pointLightsSpecularColor[0]);
-}
-
-GLfloat* gle::Scene::getPointLightsAttenuation() const
-{
-  return ((GLfloat*)&_pointLightsAttenuation[0]);
-}
-
 GLsizeiptr gle::Scene::getPointLightsSize() const
 {
   return (_pointLightsSize);
 }
 
-GLfloat* gle::Scene::getSpotLightsPosition() const
+gle::Bufferf* gle::Scene::getLightsUniformsBuffer() const
 {
-  return ((GLfloat*)&_spotLightsPosition[0]);
+  return (_lightsUniformsBuffer);
 }
 
-GLfloat* gle::Scene::getSpotLightsColor() const
+gle::ShadowAtlas& gle::Scene::getShadowAtlas()
 {
-  return ((GLfloat*)&_spotLightsColor[0]);
+  return (_shadowAtlas);
 }
 
-GLfloat* gle::Scene::getSpotLightsSpecularColor() const
+gle::PointShadowMaps& gle::Scene::getPointShadowMaps()
 {
-  return ((GLfloat*)&_spotLightsSpecularColor[0]);
+  return (_pointShadowMaps);
 }
 
-GLfloat* gle::Scene::getSpotLightsAttenuation() const
+bool gle::Scene::hasPointShadowMaps() const
 {
-  return ((GLfloat*)&_spotLightsAttenuation[0]);
+  return (_nbPointShadowMaps > 0);
 }
 
-GLfloat* gle::Scene::getSpotLightsDirection() const
+gle::DirectionalLight* gle::Scene::getCascadedShadowLight() const
 {
-  return ((GLfloat*)&_spotLightsDirection[0]);
+  return (_cascadedShadowLight);
 }
 
-GLfloat* gle::Scene::getSpotLightsCosCutOff() const
+GLsizeiptr gle::Scene::getMaxLights()
 {
-  return ((GLfloat*)&_spotLightsCosCutOff[0]);
-}
+  GLint	maxUniformBlockSize = gle::Extensions::getMaxUniformBlockSize();
 
-GLfloat* gle::Scene::getSpotLightsInnerCosCutOff() const
-{
-  return ((GLfloat*)&_spotLightsInnerCosCutOff[0]);
+  return ((maxUniformBlockSize / sizeof(GLfloat) - LightsHeaderSize)
+	  / gle::Light::UniformSize);
 }
 
-GLint*	gle::Scene::getSpotLightsHasShadowMap() const
+gle::Bufferui* gle::Scene::getLightClustersBuffer() const
 {
-  return ((GLint*)&_spotLightsHasShadowMap[0]);
+  if (_lightClustersBuffers.empty())
+    return (NULL);
+  return (_lightClustersBuffers[_lightClustersBufferIndex]);
 }
 
-GLfloat* gle::Scene::getSpotLightsShadowMapMatrix() const
+const gle::LightClusters& gle::Scene::getLightClusters() const
 {
-  return ((GLfloat*)&_spotLightsShadowMapMatrix[0]);
+  return (_lightClusters);
 }
 
-const std::vector<gle::Texture*>& gle::Scene::getSpotLightsShadowMap() const
+GLsizeiptr gle::Scene::getMaxLightClustersIndexes()
 {
-  return (_spotLightsShadowMap);
+  GLint	maxUniformBlockSize = gle::Extensions::getMaxUniformBlockSize();
+
+  // Two indexes are packed in each uint
+  return ((maxUniformBlockSize / sizeof(GLuint)
+	   - gle::LightClusters::NbClusters) * 2);
 }
 
 GLsizeiptr gle::Scene::getSpotLightsSize() const
@@ -441,70 +1034,45 @@ bool gle::Scene::hasLights() const
 void		gle::Scene::buildProgram()
 {
   _needProgramCompilation = false;
-  if (_program)
-    delete(_program);
-  _program = new gle::Program();
-
-  gle::Shader* vertexShader = _createVertexShader();
-  gle::Shader* fragmentShader = _createFragmentShader();
-
-  _program->attach(*vertexShader);
-  _program->attach(*fragmentShader);
+  _programPermutation = _getProgramPermutation();
+
+  std::string vertexSource = gle::ShaderSource::VertexShader;
+  std::string fragmentSource = gle::ShaderSource::FragmentShader;
+  setShaderSourceConstants(vertexSource);
+  setShaderSourceConstants(fragmentSource);
+
+  // Permutations already built are reused without any compilation,
+  // the other ones are compiled in the background
+  gle::Program* program = gle::ProgramCache::getInstance().prepare(vertexSource,
+								   fragmentSource);
+  _pendingProgram = (program != _program) ? program : NULL;
+}
+
+void		gle::Scene::_setupProgram(gle::Program* program)
+{
+  program->getUniformLocation("gle_MWMatrix");
+  program->getUniformLocation("gle_ViewMatrix");
+  program->getUniformLocation("gle_PMatrix");
+  program->getUniformLocation("gle_CameraPos");
+  program->getUniformLocation("gle_fogDensity");
+  program->getUniformLocation("gle_fogColor");
+  program->getUniformLocation("gle_colorMap");
+  program->getUniformLocation("gle_normalMap");
+  program->getUniformLocation("gle_cubeMap");
+  if (_bonesMatrices.size())
+    program->getUniformLocation("gle_bonesMatrix");
+  program->retreiveUniformBlockIndex("gle_materialBlock");
+  program->retreiveUniformBlockIndex("gle_staticMeshesBlock");
+  program->retreiveUniformBlockIndex("gle_lightsBlock");
+  program->retreiveUniformBlockIndex("gle_lightClustersBlock");
+}
 
-  try
-    {
-      _program->link();
-    }
-  catch (std::exception *e)
-    {
-      delete vertexShader;
-      delete fragmentShader;
-      throw e;
-    }
+std::vector<GLsizeiptr>	gle::Scene::_getProgramPermutation() const
+{
+  std::vector<GLsizeiptr> permutation;
 
-  _program->getUniformLocation("gle_MWMatrix");
-  _program->getUniformLocation("gle_ViewMatrix");
-  _program->getUniformLocation("gle_PMatrix");
-  _program->getUniformLocation("gle_CameraPos");
-  _program->getUniformLocation("gle_fogDensity");
-  _program->getUniformLocation("gle_fogColor");
-  _program->getUniformLocation("gle_colorMap");
-  if (getDirectionalLightsSize() || getPointLightsSize() || getSpotLightsSize())
-    _program->getUniformLocation("gle_normalMap");
-  _program->getUniformLocation("gle_cubeMap");
-  //if (getDirectionalLightsSize() || getPointLightsSize() || getSpotLightsSize())
-  //_program->getUniformLocation(gle::Program::NMatrix);
-  if (_bonesMatrices.size())
-    _program->getUniformLocation("gle_bonesMatrix");
-  if (getDirectionalLightsSize())
-    {
-      _program->getUniformLocation("gle_directionalLightDirection");
-      _program->getUniformLocation("gle_directionalLightColor");
-    }
-  if (getPointLightsSize())
-    {
-      _program->getUniformLocation("gle_pointLightPosition");
-      _program->getUniformLocation("gle_pointLightColor");
-      _program->getUniformLocation("gle_pointLightSpecularColor");
-      _program->getUniformLocation("gle_pointLightAttenuation");
-    }
-  if (getSpotLightsSize())
-    {
-      _program->getUniformLocation("gle_spotLightPosition");
-      _program->getUniformLocation("gle_spotLightColor");
-      _program->getUniformLocation("gle_spotLightSpecularColor");
-      _program->getUniformLocation("gle_spotLightAttenuation");
-      _program->getUniformLocation("gle_spotLightDirection");
-      _program->getUniformLocation("gle_spotLightCosCutOff");
-      _program->getUniformLocation("gle_spotLightInnerCosCutOff");
-      _program->getUniformLocation("gle_spotLightHasShadowMap");
-      _program->getUniformLocation("gle_spotLightShadowMapMatrix");
-      _program->getUniformLocation("gle_spotLightShadowMap");
-    }
-  _program->retreiveUniformBlockIndex("gle_materialBlock");
-  _program->retreiveUniformBlockIndex("gle_staticMeshesBlock");
-  delete vertexShader;
-  delete fragmentShader;
+  permutation.push_back(_bonesMatrices.size() / 16);
+  return (permutation);
 }
 
 void	gle::Scene::setShaderSourceConstants(std::string& shaderSource)
@@ -516,56 +1084,21 @@ void	gle::Scene::setShaderSourceConstants(std::string& shaderSource)
   maxMeshByBuffer = maxUniformBlockSize / (Mesh::UniformSize * sizeof(GLfloat));
   maxMaterialByBuffer = maxUniformBlockSize / (gle::Material::UniformSize * sizeof(GLfloat));
 
-  shaderSource = _replace("%nb_directional_lights", getDirectionalLightsSize(), shaderSource);
-  shaderSource = _replace("%nb_point_lights", getPointLightsSize(), shaderSource);
-  shaderSource = _replace("%nb_spot_lights", getSpotLightsSize(), shaderSource);
+  shaderSource = _replace("%max_lights", getMaxLights(), shaderSource);
+  shaderSource = _replace("%nb_cascades", gle::DirectionalLight::NbCascades, shaderSource);
+  shaderSource = _replace("%mesh_max_lights", Mesh::MaxLights, shaderSource);
+  shaderSource = _replace("%clusters_x", gle::LightClusters::GridX, shaderSource);
+  shaderSource = _replace("%clusters_y", gle::LightClusters::GridY, shaderSource);
+  shaderSource = _replace("%clusters_z", gle::LightClusters::GridZ, shaderSource);
+  if (!_lightClusters.getMaxIndexes())
+    _lightClusters.setMaxIndexes(getMaxLightClustersIndexes());
+  shaderSource = _replace("%max_cluster_indexes", _lightClusters.getMaxIndexes(),
+			  shaderSource);
   shaderSource = _replace("%nb_static_meshes", maxMeshByBuffer, shaderSource);
   shaderSource = _replace("%nb_materials", maxMaterialByBuffer, shaderSource);
   shaderSource = _replace("%nb_bones", _bonesMatrices.size() / 16, shaderSource);
 }
 
-gle::Shader* gle::Scene::_createVertexShader()
-{
-  std::string shaderSource;
-
-  shaderSource += gle::ShaderSource::VertexShader;
-  setShaderSourceConstants(shaderSource);
-
-  gle::Shader *shader;
-  try
-    {
-      shader = new gle::Shader(gle::Shader::Vertex, shaderSource);
-    }
-  catch (gle::Exception::CompilationError* e)
-    {
-      e->setFilename("Vertex.glsl");
-      throw e;
-    }
-
-  return (shader);
-}
-
-gle::Shader* gle::Scene::_createFragmentShader()
-{
-  std::string shaderSource;
-
-  shaderSource += gle::ShaderSource::FragmentShader;
-  setShaderSourceConstants(shaderSource);
-
-  gle::Shader *shader;
-  try
-    {
-      shader = new gle::Shader(gle::Shader::Fragment, shaderSource);
-    }
-  catch (gle::Exception::CompilationError* e)
-    {
-      e->setFilename("Fragment.glsl");
-      throw e;
-    }
-
-  return (shader);
-}
-
 std::string gle::Scene::_replace(std::string const& search,
 				int to,
 				std::string const& str)
@@ -582,8 +1115,16 @@ std::string gle::Scene::_replace(std::string const& search,
 
 gle::Program*	gle::Scene::getProgram()
 {
-  if (_needProgramCompilation)
+  if (_needProgramCompilation
+      || _getProgramPermutation() != _programPermutation)
     this->buildProgram();
+  // The previous program is used until the new one is ready
+  if (_pendingProgram && _pendingProgram->isReady())
+    {
+      _setupProgram(_pendingProgram);
+      _program = _pendingProgram;
+      _pendingProgram = NULL;
+    }
   return (_program);
 }
 
@@ -591,14 +1132,97 @@ void		gle::Scene::generateTree()
 {
   std::cout << "Starting octree generation..." << std::endl;
   _tree.generateTree(reinterpret_cast<std::list<gle::Octree::Element*>&>(_staticMeshes));
+  _occlusionQueries.clear();
   std::cout << "End of octree generation" << std::endl;
 }
 
+void		gle::Scene::updateTree()
+{
+  std::list<gle::Octree::Element*> meshes(_staticMeshes.begin(),
+					  _staticMeshes.end());
+
+  _tree.updateTree(meshes);
+}
+
+void		gle::Scene::_updateDynamicTree()
+{
+  // The dynamic meshes move at each frame: only the list changes rarely
+  if (_root.getAddedNodes() & gle::Scene::Node::DynamicMesh)
+    {
+      std::list<gle::Octree::Element*> meshes;
+
+      for (gle::Mesh* mesh : _dynamicMeshes)
+	if (mesh->getBoundingVolume())
+	  meshes.push_back(mesh);
+      _dynamicTree.updateTree(meshes);
+      return ;
+    }
+  for (gle::Mesh* mesh : _dynamicMeshes)
+    if (mesh->getBoundingVolume())
+      _dynamicTree.update(mesh);
+}
+
+void		gle::Scene::_updateDrawDistances()
+{
+  // The octree keeps the draw distances of the static meshes: only those
+  // which changed increment its version, and the visible meshes kept
+  // for its previous version are culled again
+  if (_drawDistancesVersion == gle::Mesh::getDrawDistancesVersion())
+    return ;
+  _drawDistancesVersion = gle::Mesh::getDrawDistancesVersion();
+  for (gle::Mesh* mesh : _staticMeshes)
+    if (_tree.contains(mesh))
+      _tree.update(mesh);
+}
+
 void		gle::Scene::enableFrustumCulling(bool enable)
 {
   _frustumCulling = enable;
 }
 
+void		gle::Scene::setNumberOfCullingThreads(unsigned int nbThreads)
+{
+  _tree.setNumberOfThreads(nbThreads);
+  _dynamicTree.setNumberOfThreads(nbThreads);
+  _lightClusters.setNumberOfThreads(nbThreads);
+  _occlusionBuffer.setNumberOfThreads(nbThreads);
+}
+
+void		gle::Scene::enableOcclusionCulling(bool enable)
+{
+  _occlusionCulling = enable;
+}
+
+gle::OcclusionBuffer&	gle::Scene::getOcclusionBuffer()
+{
+  return (_occlusionBuffer);
+}
+
+void		gle::Scene::enableOcclusionQueries(bool enable)
+{
+  _occlusionQueriesEnabled = enable;
+  _occlusionQueries.clear();
+}
+
+bool		gle::Scene::isOcclusionQueriesEnabled() const
+{
+  return (_occlusionQueriesEnabled);
+}
+
+gle::OcclusionQueries&	gle::Scene::getOcclusionQueries()
+{
+  return (_occlusionQueries);
+}
+
+void		gle::Scene::setScreenSizeCulling(GLfloat pixels, GLfloat screenHeight)
+{
+  _screenSizePixels = std::max(pixels, 0.0f);
+  _screenHeight = std::max(screenHeight, 1.0f);
+  // The meshes kept for the views of the last frame are culled again
+  _meshesInFrustumValid = false;
+  _viewsCameras.clear();
+}
+
 void		gle::Scene::setCurrentCamera(gle::Camera* camera)
 {
   _currentCamera = camera;
@@ -646,13 +1270,20 @@ void		gle::Scene::update(gle::Scene::Node* node, int depth)
   for (Node* const &child : children)
     update(child, depth + 1);
   if ((_root.getAddedNodes() & gle::Scene::Node::StaticMesh) && generate && _frustumCulling)
-    generateTree();
+    updateTree();
+  if (generate && _frustumCulling)
+    {
+      _updateDrawDistances();
+      _updateDynamicTree();
+    }
   if (generate)
     {
       updateLights();
+      updateLightClusters();
       updateSkeletons();
       if (_root.getAddedNodes() & gle::Scene::Node::StaticMesh)
 	updateStaticMeshes();
+      updateMeshesLights();
       if ((_root.getAddedNodes() & gle::Scene::Node::Light) && (_root.getAddedNodes() & gle::Scene::Node::Skeleton))
       	_needProgramCompilation = true;
       _root.setAddedNodesRecursive(0);
@@ -693,6 +1324,7 @@ void gle::Scene::updateStaticMeshes()
 	      mesh->setUniformBufferId(bufferId);
 	      mesh->setMaterialBufferId(_staticMeshesMaterialsBuffersIds[mesh->getMaterial()].first);
 	      mesh->setIdentifiers(i, _staticMeshesMaterialsBuffersIds[mesh->getMaterial()].second);
+	      _selectMeshLights(mesh);
 	      const GLfloat* buffer = mesh->getUniforms();
 
 	      for (int j = 0; j < Mesh::UniformSize; ++j)
@@ -706,6 +1338,11 @@ void gle::Scene::updateStaticMeshes()
     }
 
   delete[] staticMeshesUniforms;
+  // The static shadow maps check if their casters changed
+  ++_staticMeshesVersion;
+  // All the static meshes have just selected their lights
+  _meshesLightsNeedUpdate = false;
+  _changedLightsBounds.clear();
 }
 
 void	gle::Scene::_buildMaterialBuffers(std::list<MeshGroup>& factorizedMeshes, GLint maxUniformBlockSize)
@@ -778,47 +1415,9 @@ void gle::Scene::setEnvMap(EnvironmentMap* envMap)
   _envMap = envMap;
   _isEnvMapEnabled = true;
   if (!_envMapProgram)
-    {
-      _envMapProgram = new gle::Program();
-      
-      gle::Shader* vertexShader;
-      gle::Shader* fragmentShader;
-      try
-	{
-	  vertexShader = new gle::Shader(gle::Shader::Vertex, gle::ShaderSource::CubeMapVertexShader);
-	}
-      catch (gle::Exception::CompilationError* e)
-	{
-	  e->setFilename("EnvMap Vertex Shader");
-	  throw e;
-	}
-      try
-	{
-	  fragmentShader = new gle::Shader(gle::Shader::Fragment, gle::ShaderSource::CubeMapFragmentShader);
-	}
-      catch (gle::Exception::CompilationError* e)
-	{
-	  e->setFilename("EnvMap Fragment Shader");
-	  throw e;
-	}
-      
-      _envMapProgram->attach(*vertexShader);
-      _envMapProgram->attach(*fragmentShader);
-      
-      try {
-	_envMapProgram->link();
-      }
-      catch (std::exception *e)
-	{
-	  delete vertexShader;
-	  delete fragmentShader;
-	  throw e;
-	}
-      _envMapProgram->getUniformLocation("gle_CameraPos");
-      _envMapProgram->getUniformLocation("gle_MVMatrix");
-      _envMapProgram->getUniformLocation("gle_PMatrix");
-      _envMapProgram->getUniformLocation("gle_cubeMap");
-    }
+    _envMapProgram =
+      gle::ProgramCache::getInstance().prepare(gle::ShaderSource::CubeMapVertexShader,
+					       gle::ShaderSource::CubeMapFragmentShader);
   if (!_envMapMesh)
     _envMapMesh = Geometries::Cube(NULL, 100, true);
 }
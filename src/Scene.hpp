@@ -20,11 +20,19 @@
 # include <EnvironmentMap.hpp>
 # include <Buffer.hpp>
 # include <Octree.hpp>
+# include <DynamicTree.hpp>
+# include <LightClusters.hpp>
+# include <ShadowAtlas.hpp>
+# include <PointShadowMaps.hpp>
+# include <OcclusionBuffer.hpp>
+# include <OcclusionQueries.hpp>
 
 namespace gle {
 
   class Camera;
   class Light;
+  class DirectionalLight;
+  class PointLight;
   class Mesh;
   class Texture;
   class Material;
@@ -417,6 +425,21 @@ namespace gle {
       gle::EnvironmentMap*      envMap;
     };
 
+    //! Ways of selecting the point and spot lights that shade a fragment
+    /*!
+      Directional lights always shade all the meshes.
+     */
+
+    enum LightSelection {
+      ClusteredLights,
+      /*!< Lights are those of the cluster of the fragment (see LightClusters) */
+      MeshLights
+      /*!< Each static mesh is shaded by its Mesh::MaxLights most influential
+	lights, computed from their range and attenuation against its bounding
+	box. Dynamic meshes still use the clusters.
+	Suited to mostly static scenes with many lights spread in a large world */
+    };
+
     //! Constructs a scene
     /*!
       Constructs an empty scene, ready to contain all types of scene nodes
@@ -500,12 +523,18 @@ namespace gle {
     //! Get a vector of all static meshes
     /*
       If frustum culling is enabled, the vector only contains meshes
-      that are in the frustum of the current camera.
+      that are in the frustum of the current camera, and if occlusion
+      culling or occlusion queries are enabled, those not hidden.
      */
 
     const std::list<Mesh*> & getStaticMeshes();
 
     //! Get a vector of all dynamic meshes
+    /*
+      If frustum culling is enabled, the vector only contains meshes
+      that are in the frustum of the current camera and not hidden by
+      the occluders, and the meshes without bounding volume.
+     */
 
     const std::list<Mesh*> & getDynamicMeshes();
 
@@ -525,77 +554,89 @@ namespace gle {
 
     gle::Camera* getCurrentCamera();
 
-    //! Get a GLfloat tab of all directional lights direction
-
-    GLfloat* getDirectionalLightsDirection() const;
-
-    //! Get a GLfloat tab of all directional lights color
-
-    GLfloat* getDirectionalLightsColor() const;
-
     //! Get number of directional lights in the scene
 
     GLsizeiptr getDirectionalLightsSize() const;
 
-    //! Get a GLfloat tab of all point lights direction
-
-    GLfloat* getPointLightsPosition() const;
-
-    //! Get a GLfloat tab of all point lights color
-
-    GLfloat* getPointLightsColor() const;
-
-    //! Get a GLfloat tab of all point lights specular color
+    //! Get number of point lights in the scene
 
-    GLfloat* getPointLightsSpecularColor() const;
+    GLsizeiptr getPointLightsSize() const;
 
-    //! Get a GLfloat tab of all point lights attenuation
+    //! Get the uniform buffer containing the parameters of the lights
+    /*!
+      The buffer follows the std140 layout of the gle_lightsBlock uniform
+      block: the number of directional, point and spot lights, then the
+      lights sorted by type (see Light::UniformSize).
+     */
 
-    GLfloat* getPointLightsAttenuation() const;
+    gle::Bufferf* getLightsUniformsBuffer() const;
 
-    //! Get number of point lights in the scene
+    //! Get the shadow atlas containing the shadow maps of the spot lights
+    /*!
+      Each spot light projecting shadows renders in a tile of the atlas,
+      with a resolution depending on the part of the screen it covers.
+      Lights that do not fit in the atlas project no shadow.
+     */
 
-    GLsizeiptr getPointLightsSize() const;
+    gle::ShadowAtlas& getShadowAtlas();
 
-    //! Get a GLfloat tab of all point lights direction
+    //! Get the cube shadow maps of the point lights
+    /*!
+      The point lights projecting shadows covering the largest part of the
+      screen get a cube in the shadow maps, up to
+      PointShadowMaps::getMaxLights(). The others project no shadow.
+     */
 
-    GLfloat* getSpotLightsPosition() const;
+    gle::PointShadowMaps& getPointShadowMaps();
 
-    //! Get a GLfloat tab of all spot lights color
+    //! Return wether a point light renders in the point shadow maps
 
-    GLfloat* getSpotLightsColor() const;
+    bool hasPointShadowMaps() const;
 
-    //! Get a GLfloat tab of all spot lights specular color
+    //! Get the directional light whose shadows are rendered in cascades
+    /*!
+      Only the first directional light projecting shadows has cascades,
+      NULL if there is none.
+     */
 
-    GLfloat* getSpotLightsSpecularColor() const;
+    gle::DirectionalLight* getCascadedShadowLight() const;
 
-    //! Get a GLfloat tab of all spot lights attenuation
+    //! Number of floats before the lights in the lights uniform buffer
 
-    GLfloat* getSpotLightsAttenuation() const;
+    static const GLsizeiptr LightsHeaderSize = 4;
 
-    //! Get a GLfloat tab of all spot lights directions
+    //! Returns the maximum number of lights in the lights uniform buffer
 
-    GLfloat* getSpotLightsDirection() const;
+    static GLsizeiptr getMaxLights();
 
-    //! Get a GLfloat tab of all spot lights cos cut off
+    //! Get the uniform buffer containing the lights of each cluster
+    /*!
+      The buffer follows the std140 layout of the gle_lightClustersBlock
+      uniform block (see LightClusters).
+      It is the buffer of the last update among the ring of buffers
+      written in turn by updateLightClusters().
+     */
 
-    GLfloat* getSpotLightsCosCutOff() const;
+    gle::Bufferui* getLightClustersBuffer() const;
 
-    //! Get a GLfloat tab of all spot lights inner cos cut off
+    //! Get the assignment of the point and spot lights to the clusters
 
-    GLfloat* getSpotLightsInnerCosCutOff() const;
+    const LightClusters& getLightClusters() const;
 
-    //! Get a GLint tab indicated for each point light whether or not it has a shadow map
+    //! Set the way the lights shading a fragment are selected
+    /*!
+      Default is ClusteredLights
+     */
 
-    GLint* getSpotLightsHasShadowMap() const;
+    void setLightSelection(LightSelection selection);
 
-    //! Get a GLfloat tab of all spot lights shadow map matrices
+    //! Returns the way the lights shading a fragment are selected
 
-    GLfloat* getSpotLightsShadowMapMatrix() const;
+    LightSelection getLightSelection() const;
 
-    //! Get a texture tab of all spot lights shadow maps
+    //! Returns the maximum number of light indexes in the clusters uniform buffer
 
-    const std::vector<gle::Texture*>& getSpotLightsShadowMap() const;
+    static GLsizeiptr getMaxLightClustersIndexes();
 
     //! Get number of spot lights in the scene
 
@@ -606,20 +647,65 @@ namespace gle {
     bool hasLights() const;
 
     //! Update the shadow maps for all the lights with shadows enabled
+    /*!
+      The camera, the cascades and the spot lights are culled first in a
+      single traversal of the trees. Their shadow casters, and the meshes
+      of the next processFrustumCulling(), are taken from its results
+      while they do not move.
+     */
 
     void updateShadowMaps(gle::Renderer* renderer);
 
     //! Render the shadow map for the given light
+    /*!
+      The static shadow casters are rendered in the tile of the light in
+      the static shadow atlas only when the light or its tile change,
+      or when the static meshes were updated and the casters in its
+      frustum changed.
+      The dynamic casters are then rendered on a copy of the tile in the
+      shadow atlas.
+      The cascades of a directional light follow the camera, so all their
+      casters are rendered each frame.
+      The six faces of a point light are rendered in a single pass, with
+      the casters of each face culled against the octree.
+     */
 
     void updateShadowMap(gle::Renderer* renderer, gle::Light* light);
 
     //! Update lights
     /*!
-      You have to call this function when you change any light color or position
+      Called at each update of the scene.
+      Only the lights whose parameters changed since the last update are
+      uploaded to the lights uniform buffer, so adding, removing or moving
+      lights never needs a rebuild of the scene program.
     */
 
     void updateLights();
 
+    //! Assign the point and spot lights to the clusters of the current camera
+    /*!
+      Called at each update of the scene, after updateLights().
+      The lights of each cluster are uploaded in the light clusters
+      uniform buffer, so the shaders only iterate the lights that can
+      reach a fragment.
+      The clusters are written each frame in the next buffer of a ring,
+      persistently mapped when possible. A fence is placed after the
+      commands using a buffer, so it is only written again once the gpu
+      is done with it, without waiting for the last frame.
+     */
+
+    void updateLightClusters();
+
+    //! Update the lights selected for each static mesh
+    /*!
+      Called at each update of the scene, with the MeshLights selection.
+      Only the meshes near the lights that moved since the last update
+      have their lights selected again, and only the meshes whose lights
+      changed are uploaded.
+     */
+
+    void updateMeshesLights();
+
     //! Update the skeletons
 
     void updateSkeletons();
@@ -639,6 +725,12 @@ namespace gle {
     void updateStaticMeshes();
 
     //! Builds the shader program for the scene
+    /*!
+      The program is taken from the ProgramCache when the current
+      permutation (number of bones) was already built,
+      otherwise its compilation is started in the background.
+      It is rebuilt automatically by getProgram() when the permutation changes.
+     */
 
     void buildProgram();
 
@@ -646,7 +738,11 @@ namespace gle {
 
     void setShaderSourceConstants(std::string& shaderSource);
 
-    //! Returns the shader program for the
+    //! Returns the shader program for the scene
+    /*!
+      While a new permutation is compiling, the previous program is
+      returned, or NULL if there is none yet.
+     */
 
     gle::Program* getProgram();
 
@@ -658,10 +754,73 @@ namespace gle {
 
     void generateTree();
 
+    //! Updates the spatial partitionning tree with the static meshes
+    //! added, removed or moved since the last update
+
+    void updateTree();
+
     //! Enable or disable the frustum culling in the scene
 
     void enableFrustumCulling(bool enable = true);
 
+    //! Set the number of threads building and culling the trees
+    /*!
+      The octree, the tree of the dynamic meshes, the binning of the
+      lights in the clusters and the rasterization of the occluders use
+      a single thread by default: the work of a frame is often too short
+      to pay for the synchronization of the threads. The result does not
+      depend on the number of threads.
+     */
+
+    void setNumberOfCullingThreads(unsigned int nbThreads);
+
+    //! Enable or disable the occlusion culling in the scene
+    /*!
+      After the frustum culling, the occluders of the meshes in the
+      frustum (see Mesh::setOccluder()) are rasterized in a small depth
+      buffer on the CPU, and the meshes whose box is behind them are not
+      rendered. It requires the frustum culling.
+     */
+
+    void enableOcclusionCulling(bool enable = true);
+
+    //! Returns the buffer in which the occluders are rasterized
+
+    OcclusionBuffer& getOcclusionBuffer();
+
+    //! Enable or disable the occlusion queries in the scene
+    /*!
+      The static meshes of the octree leaves found hidden by the queries
+      of the previous frames are not rendered (see OcclusionQueries).
+      It requires the frustum culling, and can be used with the occlusion
+      culling, for the scenes without occluders.
+     */
+
+    void enableOcclusionQueries(bool enable = true);
+
+    //! Returns whether the occlusion queries are enabled
+
+    bool isOcclusionQueriesEnabled() const;
+
+    //! Returns the occlusion queries of the octree leaves
+
+    OcclusionQueries& getOcclusionQueries();
+
+    //! Set the smallest size on the screen of the meshes rendered
+    /*!
+      With the frustum culling, the meshes whose bounding sphere is
+      smaller on the screen, or whose nearest point is farther from the
+      camera than their draw distance (see Mesh::setMaxDrawDistance()),
+      are culled in the same traversal as the frustum of the camera. They
+      still cast their shadows. Only the draw distances are used with
+      the orthographic cameras.
+      \param pixels Smallest height of the meshes on the screen, in
+      pixels, 0 by default
+      \param screenHeight Height of the screen, in pixels
+     */
+
+    void setScreenSizeCulling(GLfloat pixels, GLfloat screenHeight);
+
     //! Set the camera used to render the scene. By default, use the last camera added.
 
     void setCurrentCamera(Camera* camera);
@@ -690,6 +849,9 @@ namespace gle {
     bool isEnvMapEnabled() const;
 
     //! Returns the rendering program used to render the environment map
+    /*!
+      The program may still be compiling, see Program::isReady()
+     */
 
     Program* getEnvMapProgram() const;
 
@@ -714,12 +876,35 @@ namespace gle {
     std::vector<GLfloat>& getBones();
 
   private:
-    gle::Shader*	_createVertexShader();
-    gle::Shader*	_createFragmentShader();
+    void		_setupProgram(gle::Program* program);
+    bool		_selectMeshLights(Mesh* mesh);
+    GLfloat		_getLightInfluence(const GLfloat* light, Mesh* mesh) const;
+    void		_addChangedLightBounds(const GLfloat* light);
+    bool		_isNearChangedLights(Mesh* mesh) const;
+    std::vector<GLsizeiptr>	_getProgramPermutation() const;
     std::string		_replace(std::string const& search, int number,
 				 std::string const& str);
 
     void		_buildMaterialBuffers(std::list<MeshGroup>&, GLint);
+    std::list<Mesh*>	_getStaticShadowCasters(gle::Camera* lightCamera);
+    std::list<Mesh*>	_getDynamicShadowCasters(gle::Camera* lightCamera);
+    void		_cullViews();
+    void		_updateMeshesInFrustum(GLint view, const GLfloat frustum[6][4]);
+    void		_processOcclusionCulling();
+    GLint		_getView(gle::Camera* camera) const;
+    void		_getDetail(gle::Camera* camera, GLfloat detail[4]) const;
+    void		_updateDynamicTree();
+    void		_updateDrawDistances();
+    void		_updateCascades(gle::Renderer* renderer);
+    void		_updatePointShadowMap(gle::Renderer* renderer,
+					      gle::PointLight* light);
+    GLuint		_getFacesMask(gle::PointLight* light, gle::Mesh* mesh);
+    void		_allocateShadowMapTiles();
+    void		_allocatePointShadowMaps();
+    GLfloat		_getLightRange(gle::Light* light);
+    GLfloat		_getShadowMapImportance(gle::Light* light,
+						const Matrix4<GLfloat>& view,
+						const Matrix4<GLfloat>& projection);
     void		_clearStaticMeshesBuffers();
 
     gle::Color<GLfloat>	_backgroundColor;
@@ -730,44 +915,74 @@ namespace gle {
     std::list<Mesh*>		_staticMeshes;
     std::list<Mesh*>		_dynamicMeshes;
     std::list<Mesh*>		_meshesInFrustum;
+    std::list<Mesh*>		_dynamicMeshesInFrustum;
 
     std::vector<Light*>	_lights;
     gle::Scene::Node	_root;
 
-    std::vector<GLfloat>	_directionalLightsDirection;
-    std::vector<GLfloat>	_directionalLightsColor;
     GLsizeiptr			_directionalLightsSize;
-
-    std::vector<GLfloat>	_pointLightsPosition;
-    std::vector<GLfloat>	_pointLightsColor;
-    std::vector<GLfloat>	_pointLightsSpecularColor;
-    std::vector<GLfloat>	_pointLightsAttenuation;
     GLsizeiptr			_pointLightsSize;
-
-    std::vector<GLfloat>	_spotLightsPosition;
-    std::vector<GLfloat>	_spotLightsColor;
-    std::vector<GLfloat>	_spotLightsSpecularColor;
-    std::vector<GLfloat>	_spotLightsAttenuation;
-    std::vector<GLfloat>	_spotLightsDirection;
-    std::vector<GLfloat>	_spotLightsCosCutOff;
-    std::vector<GLfloat>	_spotLightsInnerCosCutOff;
-    std::vector<GLint>		_spotLightsHasShadowMap;
-    std::vector<GLfloat>	_spotLightsShadowMapMatrix;
-    std::vector<gle::Texture*>	_spotLightsShadowMap;
     GLsizeiptr			_spotLightsSize;
+    std::vector<GLfloat>	_lightsUniforms;
+    gle::Bufferf*		_lightsUniformsBuffer;
+    ShadowAtlas			_shadowAtlas;
+    PointShadowMaps		_pointShadowMaps;
+    GLuint			_nbPointShadowMaps;
+    gle::DirectionalLight*	_cascadedShadowLight;
+    LightClusters		_lightClusters;
+    std::vector<gle::Bufferui*>	_lightClustersBuffers;
+    GLuint			_lightClustersBufferIndex;
+    LightSelection		_lightSelection;
+    bool			_meshesLightsNeedUpdate;
+    std::vector<GLfloat>	_changedLightsBounds;
 
     gle::Camera*	_currentCamera;
 
     gle::Program*	_program;
     bool		_needProgramCompilation;
+    gle::Program*	_pendingProgram;
+    std::vector<GLsizeiptr>	_programPermutation;
 
     std::vector<gle::Bufferf*>				_staticMeshesUniformsBuffers;
     std::vector<gle::Bufferf*>				_staticMeshesMaterialsBuffers;
     std::map<gle::Material*, std::pair<GLuint, GLuint>>	_staticMeshesMaterialsBuffersIds;
+    GLuint						_staticMeshesVersion;
 
     Octree	_tree;
+    DynamicTree	_dynamicTree;
     bool	_frustumCulling;
 
+    // Views culled together by updateShadowMaps(), with the views
+    // containing each of the meshes found
+    std::vector<Camera*>	_viewsCameras;
+    GLfloat			_viewsFrustums[Octree::maximumNumberOfViews][6][4];
+    std::vector<Mesh*>		_viewsStaticMeshes;
+    std::vector<GLuint>		_viewsStaticMasks;
+    std::vector<Mesh*>		_viewsDynamicMeshes;
+    std::vector<GLuint>		_viewsDynamicMasks;
+    GLuint			_viewsVersion;
+
+    // Frustum of the camera and version of the tree when the static
+    // meshes in the frustum were found
+    bool			_meshesInFrustumValid;
+    GLuint			_meshesInFrustumVersion;
+    GLfloat			_meshesInFrustumPlanes[6][4];
+    // Version of the draw distances stored in the octree
+    GLuint			_drawDistancesVersion;
+
+    OcclusionBuffer		_occlusionBuffer;
+    bool			_occlusionCulling;
+    std::list<Mesh*>		_meshesNotOccluded;
+    std::list<Mesh*>		_dynamicMeshesNotOccluded;
+
+    OcclusionQueries		_occlusionQueries;
+    bool			_occlusionQueriesEnabled;
+    std::list<Mesh*>		_meshesNotQueried;
+
+    // Size of the smallest meshes of the camera view, in pixels
+    GLfloat			_screenSizePixels;
+    GLfloat			_screenHeight;
+
     EnvironmentMap*	_envMap;
     bool		_isEnvMapEnabled;
     Program*		_envMapProgram;
@@ -58,6 +58,11 @@ void gle::Shader::compile()
     }
 }
 
+void gle::Shader::compileAsync()
+{
+  glCompileShader(_id);
+}
+
 std::string gle::Shader::getInfoLog() const
 {
   GLint length;
@@ -76,6 +76,14 @@ namespace gle {
 
     void compile();
 
+    //! Start the compilation of the shader without waiting for its result
+    /*!
+      The driver can compile the shader in the background.
+      Errors are reported when linking the program, see Program::isReady().
+     */
+
+    void compileAsync();
+
     //! Return the shader info log
     /*!
       Get the shader info log and returns it as a std::string.
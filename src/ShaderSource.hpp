@@ -41,6 +41,9 @@ namespace gle {
     //! Source of the shadow map fragment shader
     extern const char *ShadowMapFragmentShader;
 
+    //! Source of the geometry shader rendering the six faces of point light shadow maps
+    extern const char *PointShadowMapGeometryShader;
+
     //! Attribute location of the vertex position
     extern GLuint PositionLocation;
 
@@ -1,9 +1,13 @@
 #version 330 core 
   
 #define GLE_OUT_FRAGMENT_COLOR_LOCATION 0 
-#define GLE_NB_DIRECTIONAL_LIGHTS %nb_directional_lights 
-#define GLE_NB_POINT_LIGHTS %nb_point_lights  
-#define GLE_NB_SPOT_LIGHTS %nb_spot_lights 
+#define GLE_MAX_LIGHTS %max_lights
+#define GLE_NB_CASCADES %nb_cascades
+#define GLE_CLUSTERS_X %clusters_x
+#define GLE_CLUSTERS_Y %clusters_y
+#define GLE_CLUSTERS_Z %clusters_z
+#define GLE_MAX_CLUSTER_INDEXES %max_cluster_indexes
+#define GLE_MESH_MAX_LIGHTS %mesh_max_lights
 #define GLE_NB_MATERIALS %nb_materials
 
 #define GLE_CUBE_MAP 1
@@ -37,22 +41,60 @@ uniform sampler2D gle_colorMap;
 uniform sampler2D gle_normalMap;
 uniform samplerCube gle_cubeMap;
 
-#if GLE_NB_DIRECTIONAL_LIGHTS > 0
-	uniform vec3 gle_directionalLightColor[GLE_NB_DIRECTIONAL_LIGHTS];
-#endif
-#if GLE_NB_POINT_LIGHTS > 0
-	uniform vec3 gle_pointLightColor[GLE_NB_POINT_LIGHTS];
-	uniform vec3 gle_pointLightSpecularColor[GLE_NB_POINT_LIGHTS];
-#endif
-#if GLE_NB_SPOT_LIGHTS > 0
-	uniform vec3 gle_spotLightColor[GLE_NB_SPOT_LIGHTS];
-	uniform vec3 gle_spotLightSpecularColor[GLE_NB_SPOT_LIGHTS];
-	uniform vec3 gle_spotLightDirection[GLE_NB_SPOT_LIGHTS];
-	uniform float gle_spotLightCosCutOff[GLE_NB_SPOT_LIGHTS];
-	uniform float gle_spotLightInnerCosCutOff[GLE_NB_SPOT_LIGHTS];
-	uniform bool gle_spotLightHasShadowMap[GLE_NB_SPOT_LIGHTS];
-	uniform sampler2D/*Shadow*/ gle_spotLightShadowMap[GLE_NB_SPOT_LIGHTS];
-#endif
+// Lights are packed by type: directional, then point, then spot lights
+// (see gle::Light::getUniforms)
+struct gle_Light
+{
+	vec4 position;
+	vec4 direction;
+	vec4 color;
+	vec4 specularColor;
+	vec4 attenuation;
+	mat4 shadowMapMatrix;
+};
+
+layout(std140) uniform gle_lightsBlock
+{
+	vec4 count;
+	gle_Light lights[GLE_MAX_LIGHTS];
+} gle_lights;
+
+// Point and spot lights reaching each cluster of the view frustum
+// (see gle::LightClusters)
+layout(std140) uniform gle_lightClustersBlock
+{
+	uvec4 clusters[GLE_CLUSTERS_X * GLE_CLUSTERS_Y * GLE_CLUSTERS_Z / 4];
+	uvec4 indexes[GLE_MAX_CLUSTER_INDEXES / 8];
+} gle_lightClusters;
+
+// Near plane, far plane and scale of the depth slices of the clusters
+uniform vec3 gle_clusterDepth;
+
+uniform mat4 gle_ViewMatrix;
+uniform mat4 gle_PMatrix;
+
+// Shadow maps of the spot lights, each in its own tile
+// (see gle::ShadowAtlas)
+uniform sampler2D gle_shadowAtlas;
+
+// Cascaded shadow map of the directional light
+// (see gle::DirectionalLight::updateCascades)
+uniform sampler2DArray gle_cascadesShadowMap;
+uniform mat4 gle_cascadesMatrices[GLE_NB_CASCADES];
+uniform float gle_cascadesSplits[GLE_NB_CASCADES];
+uniform float gle_cascadesBiases[GLE_NB_CASCADES];
+
+// Cube shadow maps of the point lights, six layers per light
+// (see gle::PointLight)
+uniform sampler2DArray gle_pointShadowMaps;
+
+// Right, up and back vectors of the view of each face: +X, -X, +Y, -Y, +Z, -Z
+const mat3 gle_cubeFaces[6] = mat3[6](mat3(0.0, 0.0, -1.0, 0.0, -1.0, 0.0, -1.0, 0.0, 0.0),
+				      mat3(0.0, 0.0, 1.0, 0.0, -1.0, 0.0, 1.0, 0.0, 0.0),
+				      mat3(1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, -1.0, 0.0),
+				      mat3(1.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0, 1.0, 0.0),
+				      mat3(1.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, -1.0),
+				      mat3(-1.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, 1.0));
 
 in vec3 gle_varying_vPosition;
 in float gle_varying_fogFactor; 
@@ -63,23 +105,125 @@ in vec3 gle_varying_envMapVector;
 
 flat in vec3 gle_varying_vMeshIdentifier;
 
-#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0
-	in vec3 gle_varying_normal;
-	in vec3 gle_varying_eyeDirection;
-#endif
-#if GLE_NB_DIRECTIONAL_LIGHTS > 0
-	in vec3 gle_varying_directionalLightDirection[GLE_NB_DIRECTIONAL_LIGHTS];
-#endif
-#if GLE_NB_POINT_LIGHTS > 0
-	in vec3 gle_varying_pointLightDirection[GLE_NB_POINT_LIGHTS];
-	in float gle_varying_pointLightAttenuation[GLE_NB_POINT_LIGHTS];
-#endif
-#if GLE_NB_SPOT_LIGHTS > 0
-	in vec3 gle_varying_spotLightDirection[GLE_NB_SPOT_LIGHTS];
-	in vec3 gle_varying_spotLightRealDirection[GLE_NB_SPOT_LIGHTS];
-	in float gle_varying_spotLightAttenuation[GLE_NB_SPOT_LIGHTS];
-	in vec4 gle_varying_spotLightShadowMapCoord[GLE_NB_SPOT_LIGHTS];
-#endif
+flat in float gle_varying_nbMeshLights;
+flat in vec4 gle_varying_meshLights[GLE_MESH_MAX_LIGHTS / 4];
+
+in vec3 gle_varying_mvPosition;
+in vec4 gle_varying_worldPosition;
+in vec3 gle_varying_normal;
+in vec3 gle_varying_tangent;
+
+float gle_lightAttenuation(vec3 attenuation, float distance)
+{
+	if (attenuation.x == 0.0 && attenuation.y == 0.0 && attenuation.z == 0.0)
+		return (1.0);
+	return (min(1.0 / (attenuation.x + attenuation.y * distance
+			   + attenuation.z * distance * distance), 1.0));
+}
+
+float gle_shadowAttenuation(gle_Light light)
+{
+	if (light.specularColor.w <= 0.0)
+		return (0.0);
+	vec4 shadowCoord = light.shadowMapMatrix * gle_varying_worldPosition;
+	float depth = texture(gle_shadowAtlas, shadowCoord.xy / shadowCoord.w).r;
+	if (depth < (shadowCoord.z / shadowCoord.w) - 0.005)
+		return (1.0);
+	return (0.0);
+}
+
+// The direction of a point light holds the near and far planes of
+// its faces, the depth bias, and the layer of its first face
+float gle_pointShadowAttenuation(gle_Light light)
+{
+	if (light.specularColor.w <= 0.0)
+		return (0.0);
+	vec3 v = gle_varying_worldPosition.xyz / gle_varying_worldPosition.w
+		- light.position.xyz;
+	vec3 a = abs(v);
+	int face;
+	if (a.x >= a.y && a.x >= a.z)
+		face = v.x > 0.0 ? 0 : 1;
+	else if (a.y >= a.z)
+		face = v.y > 0.0 ? 2 : 3;
+	else
+		face = v.z > 0.0 ? 4 : 5;
+
+	// Coordinates in the view of the face, whose field of view is 90 degrees
+	vec3 position = v * gle_cubeFaces[face];
+	float depth = -position.z;
+	vec2 coord = position.xy / depth * 0.5 + 0.5;
+	float shadowDepth = texture(gle_pointShadowMaps,
+				    vec3(coord, light.direction.w + float(face))).r;
+
+	// Compare the distances along the axis of the face
+	float near = light.direction.x;
+	float far = light.direction.y;
+	shadowDepth = 2.0 * near * far
+		/ (far + near - (shadowDepth * 2.0 - 1.0) * (far - near));
+	if (shadowDepth < depth * (1.0 - light.direction.z))
+		return (1.0);
+	return (0.0);
+}
+
+float gle_cascadesShadowAttenuation()
+{
+	float depth = -gle_varying_mvPosition.z;
+
+	for (int i = 0; i < GLE_NB_CASCADES; ++i)
+		if (depth < gle_cascadesSplits[i])
+		{
+			vec4 shadowCoord = gle_cascadesMatrices[i] * gle_varying_worldPosition;
+			float shadowDepth = texture(gle_cascadesShadowMap,
+						    vec3(shadowCoord.xy, float(i))).r;
+			if (shadowDepth < shadowCoord.z - gle_cascadesBiases[i])
+				return (1.0);
+			return (0.0);
+		}
+	return (0.0);
+}
+
+vec3 gle_lightContribution(int i, int nbDirectionalLights, int nbPointLights,
+			   vec3 N, vec3 E, vec3 diffuse, vec3 specular, float shininess)
+{
+	gle_Light light = gle_lights.lights[i];
+	vec3 L;
+	float weight = 1.0;
+	vec3 lightSpecularColor = light.specularColor.rgb;
+
+	if (i < nbDirectionalLights)
+	{
+		L = normalize(mat3(gle_ViewMatrix) * light.direction.xyz);
+		lightSpecularColor = light.color.rgb;
+		if (light.specularColor.w > 0.0)
+			weight = 1.0 - gle_cascadesShadowAttenuation();
+	}
+	else
+	{
+		vec3 lightPosition = (gle_ViewMatrix * vec4(light.position.xyz, 1.0)).xyz;
+		L = lightPosition - gle_varying_mvPosition;
+		weight = gle_lightAttenuation(light.attenuation.xyz, length(L));
+		L = normalize(L);
+		if (i >= nbDirectionalLights + nbPointLights)
+		{
+			vec3 D = normalize(mat3(gle_ViewMatrix) * light.direction.xyz);
+			float cosCurAngle = dot(D, -L);
+			weight *= clamp((cosCurAngle - light.direction.w)
+					/ (light.color.w - light.direction.w), 0.0, 1.0);
+			weight *= 1.0 - gle_shadowAttenuation(light);
+		}
+		else
+			weight *= 1.0 - gle_pointShadowAttenuation(light);
+	}
+	vec3 contribution = vec3(0.0, 0.0, 0.0);
+	if (weight <= 0.0)
+		return (contribution);
+	contribution += light.color.rgb * diffuse * max(dot(N, L), 0.0);
+	if (dot(specular, specular) > 0.0)
+		contribution += lightSpecularColor * specular
+			* pow(max(dot(reflect(-L, N), E), 0.0), shininess);
+	return (contribution * weight);
+}
 
 void main(void) {
 
@@ -95,119 +239,60 @@ void main(void) {
 	float hasNormalMap = gle_material.materials[int(gle_varying_vMeshIdentifier.z)].hasNormalMap;
 	
 	vec3 lightWeighting = gle_varying_vLightWeighting;
-	vec3 bump = vec3(0.0, 1.0, 0.0);
-	#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0
-		vec3 N = normalize(gle_varying_normal);
-		vec3 E = normalize(gle_varying_eyeDirection);
-		if (hasNormalMap > 0.0)
-		{
-			vec2 tmp = vec2(gle_varying_vTextureCoord.x, -gle_varying_vTextureCoord.y);
-			bump = normalize(texture2D(gle_normalMap, tmp).xyz * 2.0 - 1.0);
-		}
-	#endif
-	#if GLE_NB_DIRECTIONAL_LIGHTS > 0
-		for (int i = 0; i < GLE_NB_DIRECTIONAL_LIGHTS; ++i)
-		{
-			if (diffuseIntensity > 0)
-			{
-				float directionalLightWeighting = 0.0;
-				if (hasNormalMap > 0.0)
-					directionalLightWeighting = max(dot(bump,
-													gle_varying_directionalLightDirection[i]), 0.0);
-				else
-					directionalLightWeighting = max(dot(N,
-													gle_varying_directionalLightDirection[i]), 0.0);
-				lightWeighting += gle_directionalLightColor[i] * diffuseColor.rgb * directionalLightWeighting * diffuseIntensity;
-			}
-			if (specularIntensity > 0)
-			{
-				float directionalLightWeighting = 0.0;
-				if (hasNormalMap > 0.0)
-					directionalLightWeighting = pow(max(dot(reflect(-gle_varying_directionalLightDirection[i], bump), E), 0.0), shininess);
-				else
-					directionalLightWeighting = pow(max(dot(reflect(-gle_varying_directionalLightDirection[i], N), E), 0.0), shininess);
-				lightWeighting += gle_directionalLightColor[i] * specularColor.rgb
-							* directionalLightWeighting * specularIntensity;
-			}
-		}
-	#endif
-	#if GLE_NB_POINT_LIGHTS > 0
-		for (int i = 0; i < GLE_NB_POINT_LIGHTS; ++i)
-		{
-			vec3 L = normalize(gle_varying_pointLightDirection[i]);
-
-			if (diffuseIntensity > 0)
-			{
-				float pointLightWeighting = 0.0;
-				if (hasNormalMap > 0.0)
-					pointLightWeighting = max(dot(L, bump), 0.0);
-				else
-					pointLightWeighting = max(dot(L, N), 0.0);
-				lightWeighting += gle_pointLightColor[i] * diffuseColor.rgb * pointLightWeighting * diffuseIntensity * 
-				gle_varying_pointLightAttenuation[i];
-			}
-			if (specularIntensity > 0)
-			{
-				float pointLightSpecularWeighting = 0.0;
-				if (hasNormalMap > 0.0)
-					pointLightSpecularWeighting = pow(clamp(dot(reflect(-L, bump), E), 0.0, 1.0), shininess);
-				else
-					pointLightSpecularWeighting = pow(max(dot(reflect(-L, N), E), 0.0), shininess);
-				lightWeighting += gle_pointLightSpecularColor[i] * specularColor.rgb
-							* pointLightSpecularWeighting * specularIntensity * gle_varying_pointLightAttenuation[i];
-			}
-		}
-	#endif
-	
-	#if GLE_NB_SPOT_LIGHTS > 0
-		for (int i = 0; i < GLE_NB_SPOT_LIGHTS; ++i)
+	vec3 N = normalize(gle_varying_normal);
+	vec3 E = normalize(-gle_varying_mvPosition);
+	if (hasNormalMap > 0.0)
+	{
+		vec2 tmp = vec2(gle_varying_vTextureCoord.x, -gle_varying_vTextureCoord.y);
+		vec3 bump = normalize(texture(gle_normalMap, tmp).xyz * 2.0 - 1.0);
+		vec3 t = normalize(gle_varying_tangent);
+		N = normalize(mat3(t, cross(N, t), N) * bump);
+	}
+
+	int nbDirectionalLights = int(gle_lights.count.x);
+	int nbPointLights = int(gle_lights.count.y);
+
+	for (int i = 0; i < nbDirectionalLights; ++i)
+		lightWeighting += gle_lightContribution(i, nbDirectionalLights, nbPointLights,
+							N, E, diffuseColor.rgb * diffuseIntensity,
+							specularColor.rgb * specularIntensity, shininess);
+
+	// Point and spot lights are those selected for the mesh,
+	// or those of the cluster of the fragment
+	int nbMeshLights = int(gle_varying_nbMeshLights);
+	for (int j = 0; j < nbMeshLights; ++j)
+		lightWeighting += gle_lightContribution(int(gle_varying_meshLights[j / 4][j % 4]),
+							nbDirectionalLights, nbPointLights,
+							N, E, diffuseColor.rgb * diffuseIntensity,
+							specularColor.rgb * specularIntensity, shininess);
+	if (nbMeshLights < 0)
+	{
+		vec4 clipPosition = gle_PMatrix * vec4(gle_varying_mvPosition, 1.0);
+		ivec2 tile = ivec2((clipPosition.xy / clipPosition.w * 0.5 + 0.5)
+				   * vec2(GLE_CLUSTERS_X, GLE_CLUSTERS_Y));
+		int slice = 0;
+		if (-gle_varying_mvPosition.z > gle_clusterDepth.x)
+			slice = int(log(-gle_varying_mvPosition.z / gle_clusterDepth.x) * gle_clusterDepth.z);
+		int cluster = (clamp(slice, 0, GLE_CLUSTERS_Z - 1) * GLE_CLUSTERS_Y
+			       + clamp(tile.y, 0, GLE_CLUSTERS_Y - 1)) * GLE_CLUSTERS_X
+			+ clamp(tile.x, 0, GLE_CLUSTERS_X - 1);
+		uint clusterData = gle_lightClusters.clusters[cluster / 4][cluster % 4];
+		int offset = int(clusterData & 0xFFFFu);
+		int nbClusterLights = int(clusterData >> 16u);
+
+		for (int j = offset; j < offset + nbClusterLights; ++j)
 		{
-			float shadowAttenuation = 0.0;
-			if (gle_spotLightHasShadowMap[i])
-			{
-				vec4 shadowCoord = gle_varying_spotLightShadowMapCoord[i];
-				if (texture2D(gle_spotLightShadowMap[i], (shadowCoord.xy/shadowCoord.w)).z < (shadowCoord.z/shadowCoord.w) - 0.005){
-					shadowAttenuation = 1.0;
-				}
-				//shadowAttenuation = 1.0 - textureProj(gle_spotLightShadowMap[i], shadowCoord);
-			}
-			
-			vec3 L = normalize(gle_varying_spotLightDirection[i]);
-			vec3 D = normalize(gle_spotLightDirection[i]);
-
-			// COMPUTE SPOT ANGLE
-			float cos_cur_angle = dot(D, normalize(-gle_varying_spotLightRealDirection[i]));
-			float spot = clamp((cos_cur_angle - gle_spotLightCosCutOff[i]) / (gle_spotLightInnerCosCutOff[i] - gle_spotLightCosCutOff[i]), 0.0, 1.0);
-
-			diffuseIntensity *= (1.0 - shadowAttenuation);
-			specularIntensity *= (1.0 - shadowAttenuation);
-
-			if (diffuseIntensity > 0)
-			{
-				float spotLightWeighting = 0.0;
-				if (hasNormalMap > 0.0)
-					spotLightWeighting = max(dot(bump, L), 0.0);
-				else
-					spotLightWeighting = max(dot(N, L), 0.0);
-				lightWeighting += gle_spotLightColor[i] * diffuseColor.rgb * spotLightWeighting * diffuseIntensity * 
-				gle_varying_spotLightAttenuation[i] * (spot);
-			}
-			if (specularIntensity > 0)
-			{
-				vec3 reflectionDirection = vec3(0.0, 0.0, 0.0);
-				if (hasNormalMap > 0.0)
-					reflectionDirection = reflect(-L, bump);
-				else
-					reflectionDirection = reflect(-L, N);
-				float spotLightSpecularWeighting = pow(max(dot(reflectionDirection, E), 0.0), shininess);
-				lightWeighting += gle_spotLightSpecularColor[i] * specularColor.rgb
-							* spotLightSpecularWeighting * specularIntensity * gle_varying_spotLightAttenuation[i] * spot;
-			}
+			uint indexes = gle_lightClusters.indexes[j / 8][(j / 2) % 4];
+			int i = int((indexes >> uint((j % 2) * 16)) & 0xFFFFu);
+			lightWeighting += gle_lightContribution(i, nbDirectionalLights, nbPointLights,
+								N, E, diffuseColor.rgb * diffuseIntensity,
+								specularColor.rgb * specularIntensity, shininess);
 		}
-	#endif
+	}
+
 	vec2 tmp = vec2(gle_varying_vTextureCoord.x, -gle_varying_vTextureCoord.y);
 	if (hasColorMap > 0.0)
-		gle_FragColor = texture2D(gle_colorMap, tmp) * vec4(lightWeighting, 1.0);
+		gle_FragColor = texture(gle_colorMap, tmp) * vec4(lightWeighting, 1.0);
 	else
 		gle_FragColor = vec4(lightWeighting, 1.0);
 	if (reflectionIntensity > 0 && envMapType == GLE_CUBE_MAP)
@@ -16,32 +16,15 @@ const char* gle::ShaderSource::VertexShader =
 "#define GLE_IN_VERTEX_BONES_LOCATION 4\n"
 "#define GLE_IN_VERTEX_MESH_ID_LOCATION 5\n"
 "\n"
-"#define GLE_LIGHT_ENABLED 1\n"
-"\n"
-"#define GLE_NB_DIRECTIONAL_LIGHTS %nb_directional_lights \n"
-"#define GLE_NB_POINT_LIGHTS %nb_point_lights\n"
-"#define GLE_NB_SPOT_LIGHTS %nb_spot_lights\n"
 "#define GLE_NB_STATIC_MESHES %nb_static_meshes\n"
 "#define GLE_NB_MATERIALS %nb_materials\n"
 "#define GLE_NB_BONES %nb_bones\n"
+"#define GLE_MESH_MAX_LIGHTS %mesh_max_lights\n"
 "\n"
 "#define GLE_CUBE_MAP 1\n"
 "\n"
 "uniform float gle_fogDensity;\n"
 "\n"
-"#if GLE_NB_DIRECTIONAL_LIGHTS > 0\n"
-"	uniform vec3 gle_directionalLightDirection[GLE_NB_DIRECTIONAL_LIGHTS];\n"
-"#endif\n"
-"#if GLE_NB_POINT_LIGHTS > 0\n"
-"	uniform vec3 gle_pointLightPosition[GLE_NB_POINT_LIGHTS];\n"
-"	uniform vec3 gle_pointLightAttenuation[GLE_NB_POINT_LIGHTS];\n"
-"#endif\n"
-"#if GLE_NB_SPOT_LIGHTS > 0\n"
-"	uniform vec3 gle_spotLightPosition[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform vec3 gle_spotLightAttenuation[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform bool gle_spotLightHasShadowMap[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform mat4 gle_spotLightShadowMapMatrix[GLE_NB_SPOT_LIGHTS];\n"
-"#endif\n"
 "#if GLE_NB_BONES > 0\n"
 "	uniform mat4 gle_bonesMatrix[GLE_NB_BONES];\n"
 "#endif\n"
@@ -51,14 +34,13 @@ const char* gle::ShaderSource::VertexShader =
 "uniform mat4 gle_ViewMatrix;\n"
 "uniform mat4 gle_PMatrix;\n"
 "\n"
-"#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0\n"
-"	uniform mat3 gle_NMatrix;\n"
-"\n"
 "#if GLE_NB_STATIC_MESHES > 0\n"
 "\n"
 "struct gle_StaticMesh {\n"
 "	mat4	MWMatrix;\n"
 "	float	skeletonIndex;\n"
+"	float	nbLights;\n"
+"	vec4	lights[GLE_MESH_MAX_LIGHTS / 4];\n"
 "};\n"
 "\n"
 "layout(std140) uniform gle_staticMeshesBlock\n"
@@ -105,23 +87,15 @@ const char* gle::ShaderSource::VertexShader =
 "\n"
 "flat out vec3 gle_varying_vMeshIdentifier;\n"
 "\n"
-"#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0\n"
-"	out vec3 gle_varying_normal;\n"
-"	out vec3 gle_varying_eyeDirection;\n"
-"#endif\n"
-"#if GLE_NB_DIRECTIONAL_LIGHTS > 0\n"
-"	out vec3 gle_varying_directionalLightDirection[GLE_NB_DIRECTIONAL_LIGHTS];\n"
-"#endif\n"
-"#if GLE_NB_POINT_LIGHTS > 0\n"
-"	out vec3 gle_varying_pointLightDirection[GLE_NB_POINT_LIGHTS];\n"
-"	out float gle_varying_pointLightAttenuation[GLE_NB_POINT_LIGHTS];\n"
-"#endif\n"
-"#if GLE_NB_SPOT_LIGHTS > 0\n"
-"	out vec3 gle_varying_spotLightDirection[GLE_NB_SPOT_LIGHTS];\n"
-"	out vec3 gle_varying_spotLightRealDirection[GLE_NB_SPOT_LIGHTS];\n"
-"	out float gle_varying_spotLightAttenuation[GLE_NB_SPOT_LIGHTS];\n"
-"	out vec4 gle_varying_spotLightShadowMapCoord[GLE_NB_SPOT_LIGHTS];\n"
-"#endif\n"
+"// Lights selected for the mesh, or -1 to use the lights of the clusters\n"
+"flat out float gle_varying_nbMeshLights;\n"
+"flat out vec4 gle_varying_meshLights[GLE_MESH_MAX_LIGHTS / 4];\n"
+"\n"
+"// Lighting is computed per fragment, in view space\n"
+"out vec3 gle_varying_mvPosition;\n"
+"out vec4 gle_varying_worldPosition;\n"
+"out vec3 gle_varying_normal;\n"
+"out vec3 gle_varying_tangent;\n"
 "\n"
 "void main(void) {\n"
 "\n"
@@ -145,12 +119,15 @@ const char* gle::ShaderSource::VertexShader =
 "		{\n"
 "			mwMatrix = gle_staticMeshes.meshes[int(gle_vMeshIdentifier.y)].MWMatrix;\n"
 "			skeletonIndex = gle_staticMeshes.meshes[int(gle_vMeshIdentifier.y)].skeletonIndex;\n"
+"			gle_varying_nbMeshLights = gle_staticMeshes.meshes[int(gle_vMeshIdentifier.y)].nbLights;\n"
+"			gle_varying_meshLights = gle_staticMeshes.meshes[int(gle_vMeshIdentifier.y)].lights;\n"
 "		}\n"
 "		else\n"
 "	#endif\n"
 "	{\n"
 "			mwMatrix = gle_MWMatrix;\n"
 "			skeletonIndex = 0;\n"
+"			gle_varying_nbMeshLights = -1.0;\n"
 "	}\n"
 "			\n"
 "	gle_varying_vPosition = gle_vPosition;\n"
@@ -178,112 +155,30 @@ const char* gle::ShaderSource::VertexShader =
 "	const float LOG2 = 1.442695;\n"
 "	gle_varying_fogFactor = exp2(-gle_fogDensity * gle_fogDensity * fogDistance * fogDistance * LOG2); \n"
 "	gle_varying_fogFactor = clamp(gle_varying_fogFactor, 0.0, 1.0); \n"
-"	#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0\n"
-"		vec3 transformedNormal = normalize(nMatrix * gle_BoneNormal);\n"
-"	#endif\n"
+"	vec3 transformedNormal = normalize(nMatrix * gle_BoneNormal);\n"
 "	gle_varying_vTextureCoord = gle_vTextureCoord;\n"
 "\n"
 "	gle_varying_vLightWeighting = vec3(0.0, 0.0, 0.0);\n"
 "\n"
-"	vec3 n, t, b;\n"
-"	#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0\n"
-"		gle_varying_normal = nMatrix * gle_BoneNormal;\n"
-"		if (hasNormalMap > 0.0)\n"
-"		{\n"
-"			n = transformedNormal;\n"
-"			if (gle_vTangent.x != 0.0 && gle_vTangent.y != 0.0 && gle_vTangent.z != 0.0)\n"
-"				t = normalize(nMatrix * gle_vTangent);\n"
-"			else\n"
-"				{\n"
-"					vec3 c1 = cross(gle_BoneNormal, vec3(0.0, 0.0, 1.0)); \n"
-"					vec3 c2 = cross(gle_BoneNormal, vec3(0.0, 1.0, 0.0)); \n"
-"					if(length(c1) > length(c2))\n"
-"						t = normalize(nMatrix * c1);\n"
-"					else\n"
-"						t = normalize(nMatrix * c2);\n"
-"				}\n"
-"			b = cross(n, t);\n"
-"			vec3 tmp = -gle_mvPosition.xyz;\n"
-"			gle_varying_eyeDirection.x = dot(tmp, t);\n"
-"			gle_varying_eyeDirection.y = dot(tmp, b);\n"
-"			gle_varying_eyeDirection.z = dot(tmp, n);\n"
-"		}	\n"
-"		else\n"
-"			gle_varying_eyeDirection = -gle_mvPosition.xyz;\n"
-"\n"
-"	#endif\n"
-"	#if GLE_NB_DIRECTIONAL_LIGHTS > 0\n"
-"	for (int i = 0; i < GLE_NB_DIRECTIONAL_LIGHTS; ++i)\n"
+"	gle_varying_mvPosition = gle_mvPosition.xyz;\n"
+"	gle_varying_worldPosition = mwMatrix * gle_BonevPosition;\n"
+"	gle_varying_normal = transformedNormal;\n"
+"	gle_varying_tangent = vec3(0.0, 0.0, 0.0);\n"
+"	if (hasNormalMap > 0.0)\n"
 "	{\n"
-"		vec3 directionalLightDirection = normalize(mat3(mvMatrix) * gle_directionalLightDirection[i]);\n"
-"		if (hasNormalMap > 0.0)\n"
-"			{\n"
-"				vec3 tmp = directionalLightDirection;\n"
-"				gle_varying_directionalLightDirection[i].x = dot(tmp, t);\n"
-"				gle_varying_directionalLightDirection[i].y = dot(tmp, b);\n"
-"				gle_varying_directionalLightDirection[i].z = dot(tmp, n);	\n"
-"			}\n"
+"		if (gle_vTangent.x != 0.0 && gle_vTangent.y != 0.0 && gle_vTangent.z != 0.0)\n"
+"			gle_varying_tangent = normalize(nMatrix * gle_vTangent);\n"
 "		else\n"
-"			gle_varying_directionalLightDirection[i] = directionalLightDirection;\n"
-"	}\n"
-"	#endif\n"
-"	#if GLE_NB_POINT_LIGHTS > 0\n"
-"		for (int i = 0; i < GLE_NB_POINT_LIGHTS; ++i)\n"
-"		{\n"
-"			vec3 pointLightDirection = gle_pointLightPosition[i] - gle_mvPosition.xyz;\n"
-"			float d = length(pointLightDirection);\n"
-"			if (gle_pointLightAttenuation[i].x == 0.0 && gle_pointLightAttenuation[i].y == 0.0 && gle_pointLightAttenuation[i].z == 0.0)\n"
-"			   gle_varying_pointLightAttenuation[i] = 1.0;\n"
-"			else\n"
-"			   gle_varying_pointLightAttenuation[i] = 1.0 / (gle_pointLightAttenuation[i].x +\n"
-"			   			      	 (gle_pointLightAttenuation[i].y * d) + \n"
-"			     				 (gle_pointLightAttenuation[i].z * d * d));\n"
-"			if (gle_varying_pointLightAttenuation[i] > 1.0)\n"
-"				gle_varying_pointLightAttenuation[i] = 1.0;\n"
-"			if (hasNormalMap > 0.0)\n"
-"			{\n"
-"				vec3 tmp = pointLightDirection;\n"
-"				gle_varying_pointLightDirection[i].x = dot(tmp, t);\n"
-"				gle_varying_pointLightDirection[i].y = dot(tmp, b);\n"
-"				gle_varying_pointLightDirection[i].z = dot(tmp, n);\n"
-"			}\n"
-"			else\n"
-"				gle_varying_pointLightDirection[i] = pointLightDirection;\n"
-"		}\n"
-"	#endif\n"
-"	#if GLE_NB_SPOT_LIGHTS > 0\n"
-"		for (int i = 0; i < GLE_NB_SPOT_LIGHTS; ++i)\n"
 "		{\n"
-"			// Compute shadow map coords\n"
-"			if (gle_spotLightHasShadowMap[i])\n"
-"			{\n"
-"				gle_varying_spotLightShadowMapCoord[i] =\n"
-"					gle_spotLightShadowMapMatrix[i] * mwMatrix * vec4(gle_vPosition, 1.0);\n"
-"			}\n"
-"		\n"
-"			vec3 spotLightDirection = gle_spotLightPosition[i] - gle_mvPosition.xyz;\n"
-"			float d = length(spotLightDirection);\n"
-"			if (gle_spotLightAttenuation[i].x == 0.0 && gle_spotLightAttenuation[i].y == 0.0 && gle_spotLightAttenuation[i].z == 0.0)\n"
-"			   gle_varying_spotLightAttenuation[i] = 1.0;\n"
+"			vec3 c1 = cross(gle_BoneNormal, vec3(0.0, 0.0, 1.0)); \n"
+"			vec3 c2 = cross(gle_BoneNormal, vec3(0.0, 1.0, 0.0)); \n"
+"			if(length(c1) > length(c2))\n"
+"				gle_varying_tangent = normalize(nMatrix * c1);\n"
 "			else\n"
-"			   gle_varying_spotLightAttenuation[i] = 1.0 / (gle_spotLightAttenuation[i].x +\n"
-"			   			      	 					(gle_spotLightAttenuation[i].y * d) + \n"
-"							 						(gle_spotLightAttenuation[i].z * d * d));\n"
-"			if (gle_varying_spotLightAttenuation[i] > 1.0)\n"
-"				gle_varying_spotLightAttenuation[i] = 1.0;\n"
-"			if (hasNormalMap > 0.0)\n"
-"			{\n"
-"				vec3 tmp = spotLightDirection;\n"
-"				gle_varying_spotLightDirection[i].x = dot(tmp, t);\n"
-"				gle_varying_spotLightDirection[i].y = dot(tmp, b);\n"
-"				gle_varying_spotLightDirection[i].z = dot(tmp, n);\n"
-"			}\n"
-"			else\n"
-"				gle_varying_spotLightDirection[i] = spotLightDirection;\n"
-"			gle_varying_spotLightRealDirection[i] = spotLightDirection;\n"
+"				gle_varying_tangent = normalize(nMatrix * c2);\n"
 "		}\n"
-"	#endif\n"
-"	\n"
+"	}\n"
+"\n"
 "	gle_varying_vLightWeighting += ambientColor.rgb;\n"
 "\n"
 "	if (reflectionIntensity > 0 && envMapType == GLE_CUBE_MAP)\n"
@@ -301,9 +196,13 @@ const char* gle::ShaderSource::FragmentShader =
 "#version 330 core \n"
 "  \n"
 "#define GLE_OUT_FRAGMENT_COLOR_LOCATION 0 \n"
-"#define GLE_NB_DIRECTIONAL_LIGHTS %nb_directional_lights \n"
-"#define GLE_NB_POINT_LIGHTS %nb_point_lights  \n"
-"#define GLE_NB_SPOT_LIGHTS %nb_spot_lights \n"
+"#define GLE_MAX_LIGHTS %max_lights\n"
+"#define GLE_NB_CASCADES %nb_cascades\n"
+"#define GLE_CLUSTERS_X %clusters_x\n"
+"#define GLE_CLUSTERS_Y %clusters_y\n"
+"#define GLE_CLUSTERS_Z %clusters_z\n"
+"#define GLE_MAX_CLUSTER_INDEXES %max_cluster_indexes\n"
+"#define GLE_MESH_MAX_LIGHTS %mesh_max_lights\n"
 "#define GLE_NB_MATERIALS %nb_materials\n"
 "\n"
 "#define GLE_CUBE_MAP 1\n"
@@ -337,22 +236,60 @@ const char* gle::ShaderSource::FragmentShader =
 "uniform sampler2D gle_normalMap;\n"
 "uniform samplerCube gle_cubeMap;\n"
 "\n"
-"#if GLE_NB_DIRECTIONAL_LIGHTS > 0\n"
-"	uniform vec3 gle_directionalLightColor[GLE_NB_DIRECTIONAL_LIGHTS];\n"
-"#endif\n"
-"#if GLE_NB_POINT_LIGHTS > 0\n"
-"	uniform vec3 gle_pointLightColor[GLE_NB_POINT_LIGHTS];\n"
-"	uniform vec3 gle_pointLightSpecularColor[GLE_NB_POINT_LIGHTS];\n"
-"#endif\n"
-"#if GLE_NB_SPOT_LIGHTS > 0\n"
-"	uniform vec3 gle_spotLightColor[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform vec3 gle_spotLightSpecularColor[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform vec3 gle_spotLightDirection[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform float gle_spotLightCosCutOff[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform float gle_spotLightInnerCosCutOff[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform bool gle_spotLightHasShadowMap[GLE_NB_SPOT_LIGHTS];\n"
-"	uniform sampler2D/*Shadow*/ gle_spotLightShadowMap[GLE_NB_SPOT_LIGHTS];\n"
-"#endif\n"
+"// Lights are packed by type: directional, then point, then spot lights\n"
+"// (see gle::Light::getUniforms)\n"
+"struct gle_Light\n"
+"{\n"
+"	vec4 position;\n"
+"	vec4 direction;\n"
+"	vec4 color;\n"
+"	vec4 specularColor;\n"
+"	vec4 attenuation;\n"
+"	mat4 shadowMapMatrix;\n"
+"};\n"
+"\n"
+"layout(std140) uniform gle_lightsBlock\n"
+"{\n"
+"	vec4 count;\n"
+"	gle_Light lights[GLE_MAX_LIGHTS];\n"
+"} gle_lights;\n"
+"\n"
+"// Point and spot lights reaching each cluster of the view frustum\n"
+"// (see gle::LightClusters)\n"
+"layout(std140) uniform gle_lightClustersBlock\n"
+"{\n"
+"	uvec4 clusters[GLE_CLUSTERS_X * GLE_CLUSTERS_Y * GLE_CLUSTERS_Z / 4];\n"
+"	uvec4 indexes[GLE_MAX_CLUSTER_INDEXES / 8];\n"
+"} gle_lightClusters;\n"
+"\n"
+"// Near plane, far plane and scale of the depth slices of the clusters\n"
+"uniform vec3 gle_clusterDepth;\n"
+"\n"
+"uniform mat4 gle_ViewMatrix;\n"
+"uniform mat4 gle_PMatrix;\n"
+"\n"
+"// Shadow maps of the spot lights, each in its own tile\n"
+"// (see gle::ShadowAtlas)\n"
+"uniform sampler2D gle_shadowAtlas;\n"
+"\n"
+"// Cascaded shadow map of the directional light\n"
+"// (see gle::DirectionalLight::updateCascades)\n"
+"uniform sampler2DArray gle_cascadesShadowMap;\n"
+"uniform mat4 gle_cascadesMatrices[GLE_NB_CASCADES];\n"
+"uniform float gle_cascadesSplits[GLE_NB_CASCADES];\n"
+"uniform float gle_cascadesBiases[GLE_NB_CASCADES];\n"
+"\n"
+"// Cube shadow maps of the point lights, six layers per light\n"
+"// (see gle::PointLight)\n"
+"uniform sampler2DArray gle_pointShadowMaps;\n"
+"\n"
+"// Right, up and back vectors of the view of each face: +X, -X, +Y, -Y, +Z, -Z\n"
+"const mat3 gle_cubeFaces[6] = mat3[6](mat3(0.0, 0.0, -1.0, 0.0, -1.0, 0.0, -1.0, 0.0, 0.0),\n"
+"				      mat3(0.0, 0.0, 1.0, 0.0, -1.0, 0.0, 1.0, 0.0, 0.0),\n"
+"				      mat3(1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, -1.0, 0.0),\n"
+"				      mat3(1.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0, 1.0, 0.0),\n"
+"				      mat3(1.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, -1.0),\n"
+"				      mat3(-1.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, 1.0));\n"
 "\n"
 "in vec3 gle_varying_vPosition;\n"
 "in float gle_varying_fogFactor; \n"
@@ -363,23 +300,125 @@ const char* gle::ShaderSource::FragmentShader =
 "\n"
 "flat in vec3 gle_varying_vMeshIdentifier;\n"
 "\n"
-"#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0\n"
-"	in vec3 gle_varying_normal;\n"
-"	in vec3 gle_varying_eyeDirection;\n"
-"#endif\n"
-"#if GLE_NB_DIRECTIONAL_LIGHTS > 0\n"
-"	in vec3 gle_varying_directionalLightDirection[GLE_NB_DIRECTIONAL_LIGHTS];\n"
-"#endif\n"
-"#if GLE_NB_POINT_LIGHTS > 0\n"
-"	in vec3 gle_varying_pointLightDirection[GLE_NB_POINT_LIGHTS];\n"
-"	in float gle_varying_pointLightAttenuation[GLE_NB_POINT_LIGHTS];\n"
-"#endif\n"
-"#if GLE_NB_SPOT_LIGHTS > 0\n"
-"	in vec3 gle_varying_spotLightDirection[GLE_NB_SPOT_LIGHTS];\n"
-"	in vec3 gle_varying_spotLightRealDirection[GLE_NB_SPOT_LIGHTS];\n"
-"	in float gle_varying_spotLightAttenuation[GLE_NB_SPOT_LIGHTS];\n"
-"	in vec4 gle_varying_spotLightShadowMapCoord[GLE_NB_SPOT_LIGHTS];\n"
-"#endif\n"
+"flat in float gle_varying_nbMeshLights;\n"
+"flat in vec4 gle_varying_meshLights[GLE_MESH_MAX_LIGHTS / 4];\n"
+"\n"
+"in vec3 gle_varying_mvPosition;\n"
+"in vec4 gle_varying_worldPosition;\n"
+"in vec3 gle_varying_normal;\n"
+"in vec3 gle_varying_tangent;\n"
+"\n"
+"float gle_lightAttenuation(vec3 attenuation, float distance)\n"
+"{\n"
+"	if (attenuation.x == 0.0 && attenuation.y == 0.0 && attenuation.z == 0.0)\n"
+"		return (1.0);\n"
+"	return (min(1.0 / (attenuation.x + attenuation.y * distance\n"
+"			   + attenuation.z * distance * distance), 1.0));\n"
+"}\n"
+"\n"
+"float gle_shadowAttenuation(gle_Light light)\n"
+"{\n"
+"	if (light.specularColor.w <= 0.0)\n"
+"		return (0.0);\n"
+"	vec4 shadowCoord = light.shadowMapMatrix * gle_varying_worldPosition;\n"
+"	float depth = texture(gle_shadowAtlas, shadowCoord.xy / shadowCoord.w).r;\n"
+"	if (depth < (shadowCoord.z / shadowCoord.w) - 0.005)\n"
+"		return (1.0);\n"
+"	return (0.0);\n"
+"}\n"
+"\n"
+"// The direction of a point light holds the near and far planes of\n"
+"// its faces, the depth bias, and the layer of its first face\n"
+"float gle_pointShadowAttenuation(gle_Light light)\n"
+"{\n"
+"	if (light.specularColor.w <= 0.0)\n"
+"		return (0.0);\n"
+"	vec3 v = gle_varying_worldPosition.xyz / gle_varying_worldPosition.w\n"
+"		- light.position.xyz;\n"
+"	vec3 a = abs(v);\n"
+"	int face;\n"
+"	if (a.x >= a.y && a.x >= a.z)\n"
+"		face = v.x > 0.0 ? 0 : 1;\n"
+"	else if (a.y >= a.z)\n"
+"		face = v.y > 0.0 ? 2 : 3;\n"
+"	else\n"
+"		face = v.z > 0.0 ? 4 : 5;\n"
+"\n"
+"	// Coordinates in the view of the face, whose field of view is 90 degrees\n"
+"	vec3 position = v * gle_cubeFaces[face];\n"
+"	float depth = -position.z;\n"
+"	vec2 coord = position.xy / depth * 0.5 + 0.5;\n"
+"	float shadowDepth = texture(gle_pointShadowMaps,\n"
+"				    vec3(coord, light.direction.w + float(face))).r;\n"
+"\n"
+"	// Compare the distances along the axis of the face\n"
+"	float near = light.direction.x;\n"
+"	float far = light.direction.y;\n"
+"	shadowDepth = 2.0 * near * far\n"
+"		/ (far + near - (shadowDepth * 2.0 - 1.0) * (far - near));\n"
+"	if (shadowDepth < depth * (1.0 - light.direction.z))\n"
+"		return (1.0);\n"
+"	return (0.0);\n"
+"}\n"
+"\n"
+"float gle_cascadesShadowAttenuation()\n"
+"{\n"
+"	float depth = -gle_varying_mvPosition.z;\n"
+"\n"
+"	for (int i = 0; i < GLE_NB_CASCADES; ++i)\n"
+"		if (depth < gle_cascadesSplits[i])\n"
+"		{\n"
+"			vec4 shadowCoord = gle_cascadesMatrices[i] * gle_varying_worldPosition;\n"
+"			float shadowDepth = texture(gle_cascadesShadowMap,\n"
+"						    vec3(shadowCoord.xy, float(i))).r;\n"
+"			if (shadowDepth < shadowCoord.z - gle_cascadesBiases[i])\n"
+"				return (1.0);\n"
+"			return (0.0);\n"
+"		}\n"
+"	return (0.0);\n"
+"}\n"
+"\n"
+"vec3 gle_lightContribution(int i, int nbDirectionalLights, int nbPointLights,\n"
+"			   vec3 N, vec3 E, vec3 diffuse, vec3 specular, float shininess)\n"
+"{\n"
+"	gle_Light light = gle_lights.lights[i];\n"
+"	vec3 L;\n"
+"	float weight = 1.0;\n"
+"	vec3 lightSpecularColor = light.specularColor.rgb;\n"
+"\n"
+"	if (i < nbDirectionalLights)\n"
+"	{\n"
+"		L = normalize(mat3(gle_ViewMatrix) * light.direction.xyz);\n"
+"		lightSpecularColor = light.color.rgb;\n"
+"		if (light.specularColor.w > 0.0)\n"
+"			weight = 1.0 - gle_cascadesShadowAttenuation();\n"
+"	}\n"
+"	else\n"
+"	{\n"
+"		vec3 lightPosition = (gle_ViewMatrix * vec4(light.position.xyz, 1.0)).xyz;\n"
+"		L = lightPosition - gle_varying_mvPosition;\n"
+"		weight = gle_lightAttenuation(light.attenuation.xyz, length(L));\n"
+"		L = normalize(L);\n"
+"		if (i >= nbDirectionalLights + nbPointLights)\n"
+"		{\n"
+"			vec3 D = normalize(mat3(gle_ViewMatrix) * light.direction.xyz);\n"
+"			float cosCurAngle = dot(D, -L);\n"
+"			weight *= clamp((cosCurAngle - light.direction.w)\n"
+"					/ (light.color.w - light.direction.w), 0.0, 1.0);\n"
+"			weight *= 1.0 - gle_shadowAttenuation(light);\n"
+"		}\n"
+"		else\n"
+"			weight *= 1.0 - gle_pointShadowAttenuation(light);\n"
+"	}\n"
+"	vec3 contribution = vec3(0.0, 0.0, 0.0);\n"
+"	if (weight <= 0.0)\n"
+"		return (contribution);\n"
+"	contribution += light.color.rgb * diffuse * max(dot(N, L), 0.0);\n"
+"	if (dot(specular, specular) > 0.0)\n"
+"		contribution += lightSpecularColor * specular\n"
+"			* pow(max(dot(reflect(-L, N), E), 0.0), shininess);\n"
+"	return (contribution * weight);\n"
+"}\n"
 "\n"
 "void main(void) {\n"
 "\n"
@@ -395,119 +434,60 @@ const char* gle::ShaderSource::FragmentShader =
 "	float hasNormalMap = gle_material.materials[int(gle_varying_vMeshIdentifier.z)].hasNormalMap;\n"
 "	\n"
 "	vec3 lightWeighting = gle_varying_vLightWeighting;\n"
-"	vec3 bump = vec3(0.0, 1.0, 0.0);\n"
-"	#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0\n"
-"		vec3 N = normalize(gle_varying_normal);\n"
-"		vec3 E = normalize(gle_varying_eyeDirection);\n"
-"		if (hasNormalMap > 0.0)\n"
-"		{\n"
-"			vec2 tmp = vec2(gle_varying_vTextureCoord.x, -gle_varying_vTextureCoord.y);\n"
-"			bump = normalize(texture2D(gle_normalMap, tmp).xyz * 2.0 - 1.0);\n"
-"		}\n"
-"	#endif\n"
-"	#if GLE_NB_DIRECTIONAL_LIGHTS > 0\n"
-"		for (int i = 0; i < GLE_NB_DIRECTIONAL_LIGHTS; ++i)\n"
-"		{\n"
-"			if (diffuseIntensity > 0)\n"
-"			{\n"
-"				float directionalLightWeighting = 0.0;\n"
-"				if (hasNormalMap > 0.0)\n"
-"					directionalLightWeighting = max(dot(bump,\n"
-"													gle_varying_directionalLightDirection[i]), 0.0);\n"
-"				else\n"
-"					directionalLightWeighting = max(dot(N,\n"
-"													gle_varying_directionalLightDirection[i]), 0.0);\n"
-"				lightWeighting += gle_directionalLightColor[i] * diffuseColor.rgb * directionalLightWeighting * diffuseIntensity;\n"
-"			}\n"
-"			if (specularIntensity > 0)\n"
-"			{\n"
-"				float directionalLightWeighting = 0.0;\n"
-"				if (hasNormalMap > 0.0)\n"
-"					directionalLightWeighting = pow(max(dot(reflect(-gle_varying_directionalLightDirection[i], bump), E), 0.0), shininess);\n"
-"				else\n"
-"					directionalLightWeighting = pow(max(dot(reflect(-gle_varying_directionalLightDirection[i], N), E), 0.0), shininess);\n"
-"				lightWeighting += gle_directionalLightColor[i] * specularColor.rgb\n"
-"							* directionalLightWeighting * specularIntensity;\n"
-"			}\n"
-"		}\n"
-"	#endif\n"
-"	#if GLE_NB_POINT_LIGHTS > 0\n"
-"		for (int i = 0; i < GLE_NB_POINT_LIGHTS; ++i)\n"
-"		{\n"
-"			vec3 L = normalize(gle_varying_pointLightDirection[i]);\n"
-"\n"
-"			if (diffuseIntensity > 0)\n"
-"			{\n"
-"				float pointLightWeighting = 0.0;\n"
-"				if (hasNormalMap > 0.0)\n"
-"					pointLightWeighting = max(dot(L, bump), 0.0);\n"
-"				else\n"
-"					pointLightWeighting = max(dot(L, N), 0.0);\n"
-"				lightWeighting += gle_pointLightColor[i] * diffuseColor.rgb * pointLightWeighting * diffuseIntensity * \n"
-"				gle_varying_pointLightAttenuation[i];\n"
-"			}\n"
-"			if (specularIntensity > 0)\n"
-"			{\n"
-"				float pointLightSpecularWeighting = 0.0;\n"
-"				if (hasNormalMap > 0.0)\n"
-"					pointLightSpecularWeighting = pow(clamp(dot(reflect(-L, bump), E), 0.0, 1.0), shininess);\n"
-"				else\n"
-"					pointLightSpecularWeighting = pow(max(dot(reflect(-L, N), E), 0.0), shininess);\n"
-"				lightWeighting += gle_pointLightSpecularColor[i] * specularColor.rgb\n"
-"							* pointLightSpecularWeighting * specularIntensity * gle_varying_pointLightAttenuation[i];\n"
-"			}\n"
-"		}\n"
-"	#endif\n"
-"	\n"
-"	#if GLE_NB_SPOT_LIGHTS > 0\n"
-"		for (int i = 0; i < GLE_NB_SPOT_LIGHTS; ++i)\n"
+"	vec3 N = normalize(gle_varying_normal);\n"
+"	vec3 E = normalize(-gle_varying_mvPosition);\n"
+"	if (hasNormalMap > 0.0)\n"
+"	{\n"
+"		vec2 tmp = vec2(gle_varying_vTextureCoord.x, -gle_varying_vTextureCoord.y);\n"
+"		vec3 bump = normalize(texture(gle_normalMap, tmp).xyz * 2.0 - 1.0);\n"
+"		vec3 t = normalize(gle_varying_tangent);\n"
+"		N = normalize(mat3(t, cross(N, t), N) * bump);\n"
+"	}\n"
+"\n"
+"	int nbDirectionalLights = int(gle_lights.count.x);\n"
+"	int nbPointLights = int(gle_lights.count.y);\n"
+"\n"
+"	for (int i = 0; i < nbDirectionalLights; ++i)\n"
+"		lightWeighting += gle_lightContribution(i, nbDirectionalLights, nbPointLights,\n"
+"							N, E, diffuseColor.rgb * diffuseIntensity,\n"
+"							specularColor.rgb * specularIntensity, shininess);\n"
+"\n"
+"	// Point and spot lights are those selected for the mesh,\n"
+"	// or those of the cluster of the fragment\n"
+"	int nbMeshLights = int(gle_varying_nbMeshLights);\n"
+"	for (int j = 0; j < nbMeshLights; ++j)\n"
+"		lightWeighting += gle_lightContribution(int(gle_varying_meshLights[j / 4][j % 4]),\n"
+"							nbDirectionalLights, nbPointLights,\n"
+"							N, E, diffuseColor.rgb * diffuseIntensity,\n"
+"							specularColor.rgb * specularIntensity, shininess);\n"
+"	if (nbMeshLights < 0)\n"
+"	{\n"
+"		vec4 clipPosition = gle_PMatrix * vec4(gle_varying_mvPosition, 1.0);\n"
+"		ivec2 tile = ivec2((clipPosition.xy / clipPosition.w * 0.5 + 0.5)\n"
+"				   * vec2(GLE_CLUSTERS_X, GLE_CLUSTERS_Y));\n"
+"		int slice = 0;\n"
+"		if (-gle_varying_mvPosition.z > gle_clusterDepth.x)\n"
+"			slice = int(log(-gle_varying_mvPosition.z / gle_clusterDepth.x) * gle_clusterDepth.z);\n"
+"		int cluster = (clamp(slice, 0, GLE_CLUSTERS_Z - 1) * GLE_CLUSTERS_Y\n"
+"			       + clamp(tile.y, 0, GLE_CLUSTERS_Y - 1)) * GLE_CLUSTERS_X\n"
+"			+ clamp(tile.x, 0, GLE_CLUSTERS_X - 1);\n"
+"		uint clusterData = gle_lightClusters.clusters[cluster / 4][cluster % 4];\n"
+"		int offset = int(clusterData & 0xFFFFu);\n"
+"		int nbClusterLights = int(clusterData >> 16u);\n"
+"\n"
+"		for (int j = offset; j < offset + nbClusterLights; ++j)\n"
 "		{\n"
-"			float shadowAttenuation = 0.0;\n"
-"			if (gle_spotLightHasShadowMap[i])\n"
-"			{\n"
-"				vec4 shadowCoord = gle_varying_spotLightShadowMapCoord[i];\n"
-"				if (texture2D(gle_spotLightShadowMap[i], (shadowCoord.xy/shadowCoord.w)).z < (shadowCoord.z/shadowCoord.w) - 0.005){\n"
-"					shadowAttenuation = 1.0;\n"
-"				}\n"
-"				//shadowAttenuation = 1.0 - textureProj(gle_spotLightShadowMap[i], shadowCoord);\n"
-"			}\n"
-"			\n"
-"			vec3 L = normalize(gle_varying_spotLightDirection[i]);\n"
-"			vec3 D = normalize(gle_spotLightDirection[i]);\n"
-"\n"
-"			// COMPUTE SPOT ANGLE\n"
-"			float cos_cur_angle = dot(D, normalize(-gle_varying_spotLightRealDirection[i]));\n"
-"			float spot = clamp((cos_cur_angle - gle_spotLightCosCutOff[i]) / (gle_spotLightInnerCosCutOff[i] - gle_spotLightCosCutOff[i]), 0.0, 1.0);\n"
-"\n"
-"			diffuseIntensity *= (1.0 - shadowAttenuation);\n"
-"			specularIntensity *= (1.0 - shadowAttenuation);\n"
-"\n"
-"			if (diffuseIntensity > 0)\n"
-"			{\n"
-"				float spotLightWeighting = 0.0;\n"
-"				if (hasNormalMap > 0.0)\n"
-"					spotLightWeighting = max(dot(bump, L), 0.0);\n"
-"				else\n"
-"					spotLightWeighting = max(dot(N, L), 0.0);\n"
-"				lightWeighting += gle_spotLightColor[i] * diffuseColor.rgb * spotLightWeighting * diffuseIntensity * \n"
-"				gle_varying_spotLightAttenuation[i] * (spot);\n"
-"			}\n"
-"			if (specularIntensity > 0)\n"
-"			{\n"
-"				vec3 reflectionDirection = vec3(0.0, 0.0, 0.0);\n"
-"				if (hasNormalMap > 0.0)\n"
-"					reflectionDirection = reflect(-L, bump);\n"
-"				else\n"
-"					reflectionDirection = reflect(-L, N);\n"
-"				float spotLightSpecularWeighting = pow(max(dot(reflectionDirection, E), 0.0), shininess);\n"
-"				lightWeighting += gle_spotLightSpecularColor[i] * specularColor.rgb\n"
-"							* spotLightSpecularWeighting * specularIntensity * gle_varying_spotLightAttenuation[i] * spot;\n"
-"			}\n"
+"			uint indexes = gle_lightClusters.indexes[j / 8][(j / 2) % 4];\n"
+"			int i = int((indexes >> uint((j % 2) * 16)) & 0xFFFFu);\n"
+"			lightWeighting += gle_lightContribution(i, nbDirectionalLights, nbPointLights,\n"
+"								N, E, diffuseColor.rgb * diffuseIntensity,\n"
+"								specularColor.rgb * specularIntensity, shininess);\n"
 "		}\n"
-"	#endif\n"
+"	}\n"
+"\n"
 "	vec2 tmp = vec2(gle_varying_vTextureCoord.x, -gle_varying_vTextureCoord.y);\n"
 "	if (hasColorMap > 0.0)\n"
-"		gle_FragColor = texture2D(gle_colorMap, tmp) * vec4(lightWeighting, 1.0);\n"
+"		gle_FragColor = texture(gle_colorMap, tmp) * vec4(lightWeighting, 1.0);\n"
 "	else\n"
 "		gle_FragColor = vec4(lightWeighting, 1.0);\n"
 "	if (reflectionIntensity > 0 && envMapType == GLE_CUBE_MAP)\n"
@@ -603,6 +583,7 @@ const char* gle::ShaderSource::ShadowMapVertexShader =
 "#version 330 core\n"
 "\n"
 "#define GLE_NB_STATIC_MESHES %nb_static_meshes\n"
+"#define GLE_MESH_MAX_LIGHTS %mesh_max_lights\n"
 "\n"
 "#define GLE_IN_VERTEX_POSITION_LOCATION 0\n"
 "#define GLE_IN_VERTEX_MESH_ID_LOCATION 5\n"
@@ -615,6 +596,8 @@ const char* gle::ShaderSource::ShadowMapVertexShader =
 "struct gle_StaticMesh {\n"
 "	mat4	MWMatrix;\n"
 "	float	skeletonIndex;\n"
+"	float	nbLights;\n"
+"	vec4	lights[GLE_MESH_MAX_LIGHTS / 4];\n"
 "};\n"
 "\n"
 "layout(std140) uniform gle_staticMeshesBlock\n"
@@ -656,3 +639,57 @@ const char* gle::ShaderSource::ShadowMapFragmentShader =
 "\n"
 ;
 
+const char* gle::ShaderSource::PointShadowMapGeometryShader = 
+"#version 330 core\n"
+"\n"
+"// Renders each triangle in the faces of the cube shadow map it covers,\n"
+"// so the six faces of a point light are drawn in a single pass\n"
+"// (see gle::Renderer::renderPointShadowMap)\n"
+"\n"
+"#define GLE_CUBE_NB_FACES 6\n"
+"\n"
+"layout (triangles) in;\n"
+"layout (triangle_strip, max_vertices = 18) out;\n"
+"\n"
+"// Projection * view matrix of each face, from world coordinates\n"
+"uniform mat4 gle_cubeFacesMatrices[GLE_CUBE_NB_FACES];\n"
+"\n"
+"// Faces reached by the meshes of the draw call, one bit per face\n"
+"uniform int gle_cubeFacesMask;\n"
+"\n"
+"// Layer of the first face in the shadow maps array\n"
+"uniform int gle_cubeFirstLayer;\n"
+"\n"
+"void main(void) {\n"
+"\n"
+"	for (int face = 0; face < GLE_CUBE_NB_FACES; ++face)\n"
+"	{\n"
+"		if ((gle_cubeFacesMask & (1 << face)) == 0)\n"
+"			continue;\n"
+"\n"
+"		vec4 positions[3];\n"
+"		for (int i = 0; i < 3; ++i)\n"
+"			positions[i] = gle_cubeFacesMatrices[face] * gl_in[i].gl_Position;\n"
+"\n"
+"		// Skip the triangles entirely outside one of the planes of the face\n"
+"		vec3 lower = max(max(positions[0].xyz + positions[0].w,\n"
+"				     positions[1].xyz + positions[1].w),\n"
+"				 positions[2].xyz + positions[2].w);\n"
+"		vec3 upper = max(max(positions[0].w - positions[0].xyz,\n"
+"				     positions[1].w - positions[1].xyz),\n"
+"				 positions[2].w - positions[2].xyz);\n"
+"		if (any(lessThan(lower, vec3(0.0))) || any(lessThan(upper, vec3(0.0))))\n"
+"			continue;\n"
+"\n"
+"		for (int i = 0; i < 3; ++i)\n"
+"		{\n"
+"			gl_Layer = gle_cubeFirstLayer + face;\n"
+"			gl_Position = positions[i];\n"
+"			EmitVertex();\n"
+"		}\n"
+"		EndPrimitive();\n"
+"	}\n"
+"}\n"
+"\n"
+;
+
@@ -0,0 +1,50 @@
+#version 330 core
+
+// Renders each triangle in the faces of the cube shadow map it covers,
+// so the six faces of a point light are drawn in a single pass
+// (see gle::Renderer::renderPointShadowMap)
+
+#define GLE_CUBE_NB_FACES 6
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+// Projection * view matrix of each face, from world coordinates
+uniform mat4 gle_cubeFacesMatrices[GLE_CUBE_NB_FACES];
+
+// Faces reached by the meshes of the draw call, one bit per face
+uniform int gle_cubeFacesMask;
+
+// Layer of the first face in the shadow maps array
+uniform int gle_cubeFirstLayer;
+
+void main(void) {
+
+	for (int face = 0; face < GLE_CUBE_NB_FACES; ++face)
+	{
+		if ((gle_cubeFacesMask & (1 << face)) == 0)
+			continue;
+
+		vec4 positions[3];
+		for (int i = 0; i < 3; ++i)
+			positions[i] = gle_cubeFacesMatrices[face] * gl_in[i].gl_Position;
+
+		// Skip the triangles entirely outside one of the planes of the face
+		vec3 lower = max(max(positions[0].xyz + positions[0].w,
+				     positions[1].xyz + positions[1].w),
+				 positions[2].xyz + positions[2].w);
+		vec3 upper = max(max(positions[0].w - positions[0].xyz,
+				     positions[1].w - positions[1].xyz),
+				 positions[2].w - positions[2].xyz);
+		if (any(lessThan(lower, vec3(0.0))) || any(lessThan(upper, vec3(0.0))))
+			continue;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			gl_Layer = gle_cubeFirstLayer + face;
+			gl_Position = positions[i];
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+}
@@ -1,6 +1,7 @@
 #version 330 core
 
 #define GLE_NB_STATIC_MESHES %nb_static_meshes
+#define GLE_MESH_MAX_LIGHTS %mesh_max_lights
 
 #define GLE_IN_VERTEX_POSITION_LOCATION 0
 #define GLE_IN_VERTEX_MESH_ID_LOCATION 5
@@ -13,6 +14,8 @@ layout (location = GLE_IN_VERTEX_MESH_ID_LOCATION) in vec3 gle_vMeshIdentifier;
 struct gle_StaticMesh {
 	mat4	MWMatrix;
 	float	skeletonIndex;
+	float	nbLights;
+	vec4	lights[GLE_MESH_MAX_LIGHTS / 4];
 };
 
 layout(std140) uniform gle_staticMeshesBlock
@@ -7,32 +7,15 @@
 #define GLE_IN_VERTEX_BONES_LOCATION 4
 #define GLE_IN_VERTEX_MESH_ID_LOCATION 5
 
-#define GLE_LIGHT_ENABLED 1
-
-#define GLE_NB_DIRECTIONAL_LIGHTS %nb_directional_lights 
-#define GLE_NB_POINT_LIGHTS %nb_point_lights
-#define GLE_NB_SPOT_LIGHTS %nb_spot_lights
 #define GLE_NB_STATIC_MESHES %nb_static_meshes
 #define GLE_NB_MATERIALS %nb_materials
 #define GLE_NB_BONES %nb_bones
+#define GLE_MESH_MAX_LIGHTS %mesh_max_lights
 
 #define GLE_CUBE_MAP 1
 
 uniform float gle_fogDensity;
 
-#if GLE_NB_DIRECTIONAL_LIGHTS > 0
-	uniform vec3 gle_directionalLightDirection[GLE_NB_DIRECTIONAL_LIGHTS];
-#endif
-#if GLE_NB_POINT_LIGHTS > 0
-	uniform vec3 gle_pointLightPosition[GLE_NB_POINT_LIGHTS];
-	uniform vec3 gle_pointLightAttenuation[GLE_NB_POINT_LIGHTS];
-#endif
-#if GLE_NB_SPOT_LIGHTS > 0
-	uniform vec3 gle_spotLightPosition[GLE_NB_SPOT_LIGHTS];
-	uniform vec3 gle_spotLightAttenuation[GLE_NB_SPOT_LIGHTS];
-	uniform bool gle_spotLightHasShadowMap[GLE_NB_SPOT_LIGHTS];
-	uniform mat4 gle_spotLightShadowMapMatrix[GLE_NB_SPOT_LIGHTS];
-#endif
 #if GLE_NB_BONES > 0
 	uniform mat4 gle_bonesMatrix[GLE_NB_BONES];
 #endif
@@ -42,14 +25,13 @@ uniform mat4 gle_MWMatrix;
 uniform mat4 gle_ViewMatrix;
 uniform mat4 gle_PMatrix;
 
-#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0
-	uniform mat3 gle_NMatrix;
-
 #if GLE_NB_STATIC_MESHES > 0
 
 struct gle_StaticMesh {
 	mat4	MWMatrix;
 	float	skeletonIndex;
+	float	nbLights;
+	vec4	lights[GLE_MESH_MAX_LIGHTS / 4];
 };
 
 layout(std140) uniform gle_staticMeshesBlock
@@ -96,23 +78,15 @@ out vec3 gle_varying_envMapVector;
 
 flat out vec3 gle_varying_vMeshIdentifier;
 
-#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0
-	out vec3 gle_varying_normal;
-	out vec3 gle_varying_eyeDirection;
-#endif
-#if GLE_NB_DIRECTIONAL_LIGHTS > 0
-	out vec3 gle_varying_directionalLightDirection[GLE_NB_DIRECTIONAL_LIGHTS];
-#endif
-#if GLE_NB_POINT_LIGHTS > 0
-	out vec3 gle_varying_pointLightDirection[GLE_NB_POINT_LIGHTS];
-	out float gle_varying_pointLightAttenuation[GLE_NB_POINT_LIGHTS];
-#endif
-#if GLE_NB_SPOT_LIGHTS > 0
-	out vec3 gle_varying_spotLightDirection[GLE_NB_SPOT_LIGHTS];
-	out vec3 gle_varying_spotLightRealDirection[GLE_NB_SPOT_LIGHTS];
-	out float gle_varying_spotLightAttenuation[GLE_NB_SPOT_LIGHTS];
-	out vec4 gle_varying_spotLightShadowMapCoord[GLE_NB_SPOT_LIGHTS];
-#endif
+// Lights selected for the mesh, or -1 to use the lights of the clusters
+flat out float gle_varying_nbMeshLights;
+flat out vec4 gle_varying_meshLights[GLE_MESH_MAX_LIGHTS / 4];
+
+// Lighting is computed per fragment, in view space
+out vec3 gle_varying_mvPosition;
+out vec4 gle_varying_worldPosition;
+out vec3 gle_varying_normal;
+out vec3 gle_varying_tangent;
 
 void main(void) {
 
@@ -136,12 +110,15 @@ void main(void) {
 		{
 			mwMatrix = gle_staticMeshes.meshes[int(gle_vMeshIdentifier.y)].MWMatrix;
 			skeletonIndex = gle_staticMeshes.meshes[int(gle_vMeshIdentifier.y)].skeletonIndex;
+			gle_varying_nbMeshLights = gle_staticMeshes.meshes[int(gle_vMeshIdentifier.y)].nbLights;
+			gle_varying_meshLights = gle_staticMeshes.meshes[int(gle_vMeshIdentifier.y)].lights;
 		}
 		else
 	#endif
 	{
 			mwMatrix = gle_MWMatrix;
 			skeletonIndex = 0;
+			gle_varying_nbMeshLights = -1.0;
 	}
 			
 	gle_varying_vPosition = gle_vPosition;
@@ -169,112 +146,30 @@ void main(void) {
 	const float LOG2 = 1.442695;
 	gle_varying_fogFactor = exp2(-gle_fogDensity * gle_fogDensity * fogDistance * fogDistance * LOG2); 
 	gle_varying_fogFactor = clamp(gle_varying_fogFactor, 0.0, 1.0); 
-	#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0
-		vec3 transformedNormal = normalize(nMatrix * gle_BoneNormal);
-	#endif
+	vec3 transformedNormal = normalize(nMatrix * gle_BoneNormal);
 	gle_varying_vTextureCoord = gle_vTextureCoord;
 
 	gle_varying_vLightWeighting = vec3(0.0, 0.0, 0.0);
 
-	vec3 n, t, b;
-	#if GLE_NB_DIRECTIONAL_LIGHTS > 0 || GLE_NB_POINT_LIGHTS > 0 || GLE_NB_SPOT_LIGHTS > 0
-		gle_varying_normal = nMatrix * gle_BoneNormal;
-		if (hasNormalMap > 0.0)
-		{
-			n = transformedNormal;
-			if (gle_vTangent.x != 0.0 && gle_vTangent.y != 0.0 && gle_vTangent.z != 0.0)
-				t = normalize(nMatrix * gle_vTangent);
-			else
-				{
-					vec3 c1 = cross(gle_BoneNormal, vec3(0.0, 0.0, 1.0)); 
-					vec3 c2 = cross(gle_BoneNormal, vec3(0.0, 1.0, 0.0)); 
-					if(length(c1) > length(c2))
-						t = normalize(nMatrix * c1);
-					else
-						t = normalize(nMatrix * c2);
-				}
-			b = cross(n, t);
-			vec3 tmp = -gle_mvPosition.xyz;
-			gle_varying_eyeDirection.x = dot(tmp, t);
-			gle_varying_eyeDirection.y = dot(tmp, b);
-			gle_varying_eyeDirection.z = dot(tmp, n);
-		}	
-		else
-			gle_varying_eyeDirection = -gle_mvPosition.xyz;
-
-	#endif
-	#if GLE_NB_DIRECTIONAL_LIGHTS > 0
-	for (int i = 0; i < GLE_NB_DIRECTIONAL_LIGHTS; ++i)
+	gle_varying_mvPosition = gle_mvPosition.xyz;
+	gle_varying_worldPosition = mwMatrix * gle_BonevPosition;
+	gle_varying_normal = transformedNormal;
+	gle_varying_tangent = vec3(0.0, 0.0, 0.0);
+	if (hasNormalMap > 0.0)
 	{
-		vec3 directionalLightDirection = normalize(mat3(mvMatrix) * gle_directionalLightDirection[i]);
-		if (hasNormalMap > 0.0)
-			{
-				vec3 tmp = directionalLightDirection;
-				gle_varying_directionalLightDirection[i].x = dot(tmp, t);
-				gle_varying_directionalLightDirection[i].y = dot(tmp, b);
-				gle_varying_directionalLightDirection[i].z = dot(tmp, n);	
-			}
+		if (gle_vTangent.x != 0.0 && gle_vTangent.y != 0.0 && gle_vTangent.z != 0.0)
+			gle_varying_tangent = normalize(nMatrix * gle_vTangent);
 		else
-			gle_varying_directionalLightDirection[i] = directionalLightDirection;
-	}
-	#endif
-	#if GLE_NB_POINT_LIGHTS > 0
-		for (int i = 0; i < GLE_NB_POINT_LIGHTS; ++i)
-		{
-			vec3 pointLightDirection = gle_pointLightPosition[i] - gle_mvPosition.xyz;
-			float d = length(pointLightDirection);
-			if (gle_pointLightAttenuation[i].x == 0.0 && gle_pointLightAttenuation[i].y == 0.0 && gle_pointLightAttenuation[i].z == 0.0)
-			   gle_varying_pointLightAttenuation[i] = 1.0;
-			else
-			   gle_varying_pointLightAttenuation[i] = 1.0 / (gle_pointLightAttenuation[i].x +
-			   			      	 (gle_pointLightAttenuation[i].y * d) + 
-			     				 (gle_pointLightAttenuation[i].z * d * d));
-			if (gle_varying_pointLightAttenuation[i] > 1.0)
-				gle_varying_pointLightAttenuation[i] = 1.0;
-			if (hasNormalMap > 0.0)
-			{
-				vec3 tmp = pointLightDirection;
-				gle_varying_pointLightDirection[i].x = dot(tmp, t);
-				gle_varying_pointLightDirection[i].y = dot(tmp, b);
-				gle_varying_pointLightDirection[i].z = dot(tmp, n);
-			}
-			else
-				gle_varying_pointLightDirection[i] = pointLightDirection;
-		}
-	#endif
-	#if GLE_NB_SPOT_LIGHTS > 0
-		for (int i = 0; i < GLE_NB_SPOT_LIGHTS; ++i)
 		{
-			// Compute shadow map coords
-			if (gle_spotLightHasShadowMap[i])
-			{
-				gle_varying_spotLightShadowMapCoord[i] =
-					gle_spotLightShadowMapMatrix[i] * mwMatrix * vec4(gle_vPosition, 1.0);
-			}
-		
-			vec3 spotLightDirection = gle_spotLightPosition[i] - gle_mvPosition.xyz;
-			float d = length(spotLightDirection);
-			if (gle_spotLightAttenuation[i].x == 0.0 && gle_spotLightAttenuation[i].y == 0.0 && gle_spotLightAttenuation[i].z == 0.0)
-			   gle_varying_spotLightAttenuation[i] = 1.0;
+			vec3 c1 = cross(gle_BoneNormal, vec3(0.0, 0.0, 1.0)); 
+			vec3 c2 = cross(gle_BoneNormal, vec3(0.0, 1.0, 0.0)); 
+			if(length(c1) > length(c2))
+				gle_varying_tangent = normalize(nMatrix * c1);
 			else
-			   gle_varying_spotLightAttenuation[i] = 1.0 / (gle_spotLightAttenuation[i].x +
-			   			      	 					(gle_spotLightAttenuation[i].y * d) + 
-							 						(gle_spotLightAttenuation[i].z * d * d));
-			if (gle_varying_spotLightAttenuation[i] > 1.0)
-				gle_varying_spotLightAttenuation[i] = 1.0;
-			if (hasNormalMap > 0.0)
-			{
-				vec3 tmp = spotLightDirection;
-				gle_varying_spotLightDirection[i].x = dot(tmp, t);
-				gle_varying_spotLightDirection[i].y = dot(tmp, b);
-				gle_varying_spotLightDirection[i].z = dot(tmp, n);
-			}
-			else
-				gle_varying_spotLightDirection[i] = spotLightDirection;
-			gle_varying_spotLightRealDirection[i] = spotLightDirection;
+				gle_varying_tangent = normalize(nMatrix * c2);
 		}
-	#endif
-	
+	}
+
 	gle_varying_vLightWeighting += ambientColor.rgb;
 
 	if (reflectionIntensity > 0 && envMapType == GLE_CUBE_MAP)
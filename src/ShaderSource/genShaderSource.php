@@ -8,7 +8,8 @@ $shaders = array(
 		 'gle::ShaderSource::DebugVertexShader' => 'DebugVertex.glsl',
 		 'gle::ShaderSource::DebugFragmentShader' => 'DebugFragment.glsl',
 		 'gle::ShaderSource::ShadowMapVertexShader' => 'ShadowMapVertex.glsl',
-		 'gle::ShaderSource::ShadowMapFragmentShader' => 'ShadowMapFragment.glsl'
+		 'gle::ShaderSource::ShadowMapFragmentShader' => 'ShadowMapFragment.glsl',
+		 'gle::ShaderSource::PointShadowMapGeometryShader' => 'PointShadowMapGeometry.glsl'
 		 );
 
 $path = realpath(dirname(__FILE__));
@@ -0,0 +1,161 @@
+//
+// ShadowAtlas.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:34:07 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <algorithm>
+#include <ShadowAtlas.hpp>
+#include <Texture.hpp>
+#include <FrameBuffer.hpp>
+
+gle::ShadowAtlas::ShadowAtlas(GLuint size, GLuint minTileSize) :
+  _size(size), _minTileSize(std::min(minTileSize, size)), _nextTile(0),
+  _texture(NULL), _frameBuffer(NULL), _staticTexture(NULL),
+  _staticFrameBuffer(NULL), _emptyTexture(NULL)
+{
+}
+
+gle::ShadowAtlas::~ShadowAtlas()
+{
+  _clearTextures();
+  if (_emptyTexture)
+    delete _emptyTexture;
+}
+
+void gle::ShadowAtlas::setSize(GLuint size)
+{
+  _clearTextures();
+  _size = size;
+  _minTileSize = std::min(_minTileSize, size);
+  clear();
+}
+
+GLuint gle::ShadowAtlas::getSize() const
+{
+  return (_size);
+}
+
+GLuint gle::ShadowAtlas::getMinTileSize() const
+{
+  return (_minTileSize);
+}
+
+void gle::ShadowAtlas::clear()
+{
+  _nextTile = 0;
+}
+
+bool gle::ShadowAtlas::allocate(GLuint tileSize, Rectui& tile)
+{
+  GLuint side = _size / _minTileSize;
+  GLuint tileSide = std::max(tileSize / _minTileSize, (GLuint)1);
+  GLuint nbTiles = tileSide * tileSide;
+  // A tile starts at a multiple of its number of minimum tiles
+  GLuint first = (_nextTile + nbTiles - 1) / nbTiles * nbTiles;
+
+  if (tileSide > side || first + nbTiles > side * side)
+    return (false);
+  _nextTile = first + nbTiles;
+
+  // Deinterleave the bits of the index to get the tile coordinates
+  GLuint x = 0, y = 0;
+  for (GLuint bit = 0; (first >> (2 * bit)) != 0; ++bit)
+    {
+      x |= ((first >> (2 * bit)) & 1) << bit;
+      y |= ((first >> (2 * bit + 1)) & 1) << bit;
+    }
+  tile = Rectui(x * _minTileSize, y * _minTileSize,
+		tileSide * _minTileSize, tileSide * _minTileSize);
+  return (true);
+}
+
+GLuint gle::ShadowAtlas::getTileSize(GLfloat importance,
+				     GLuint maxTileSize) const
+{
+  GLfloat size = std::min(std::max(importance, 0.0f), 1.0f) * maxTileSize;
+  GLuint tileSize = _minTileSize;
+
+  while (tileSize < size && tileSize < _size)
+    tileSize *= 2;
+  return (tileSize);
+}
+
+bool gle::ShadowAtlas::hasTiles() const
+{
+  return (_nextTile != 0);
+}
+
+gle::Texture* gle::ShadowAtlas::getTexture()
+{
+  if (!_texture)
+    _texture = _createTexture(_size);
+  return (_texture);
+}
+
+gle::Texture* gle::ShadowAtlas::getSampledTexture()
+{
+  if (hasTiles())
+    return (getTexture());
+  if (!_emptyTexture)
+    _emptyTexture = _createTexture(1);
+  return (_emptyTexture);
+}
+
+gle::FrameBuffer* gle::ShadowAtlas::getFrameBuffer()
+{
+  if (!_frameBuffer)
+    {
+      _frameBuffer = new gle::FrameBuffer();
+      _frameBuffer->attach(*getTexture(), gle::FrameBuffer::AttachmentDepth);
+    }
+  return (_frameBuffer);
+}
+
+gle::Texture* gle::ShadowAtlas::getStaticTexture()
+{
+  if (!_staticTexture)
+    _staticTexture = _createTexture(_size);
+  return (_staticTexture);
+}
+
+gle::FrameBuffer* gle::ShadowAtlas::getStaticFrameBuffer()
+{
+  if (!_staticFrameBuffer)
+    {
+      _staticFrameBuffer = new gle::FrameBuffer();
+      _staticFrameBuffer->attach(*getStaticTexture(),
+				 gle::FrameBuffer::AttachmentDepth);
+    }
+  return (_staticFrameBuffer);
+}
+
+void gle::ShadowAtlas::_clearTextures()
+{
+  if (_frameBuffer)
+    delete _frameBuffer;
+  if (_texture)
+    delete _texture;
+  if (_staticFrameBuffer)
+    delete _staticFrameBuffer;
+  if (_staticTexture)
+    delete _staticTexture;
+  _frameBuffer = NULL;
+  _texture = NULL;
+  _staticFrameBuffer = NULL;
+  _staticTexture = NULL;
+}
+
+gle::Texture* gle::ShadowAtlas::_createTexture(GLuint size)
+{
+  gle::Texture* texture = new gle::Texture(size, size, gle::Texture::Texture2D,
+					   gle::Texture::Depth);
+
+  texture->setUseMipmap(false);
+  texture->setFilterType(gle::Texture::Nearest);
+  return (texture);
+}
@@ -0,0 +1,137 @@
+//
+// ShadowAtlas.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 08:34:07 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_SHADOW_ATLAS_HPP_
+# define _GLE_SHADOW_ATLAS_HPP_
+
+# include <gle/opengl.h>
+# include <Rect.hpp>
+
+namespace gle {
+
+  class Texture;
+  class FrameBuffer;
+
+  //! Single depth texture containing the shadow maps of several lights
+  /*!
+    Each light renders its shadow map in a square tile of the atlas, with
+    a size that is a power of two between getMinTileSize() and getSize().
+    Tiles are placed along a Z-order curve: when they are allocated from
+    the largest to the smallest, they are packed without any hole.
+
+    The allocation only works on the CPU, the textures and framebuffers
+    are created the first time they are requested. Until a tile is
+    allocated, the shaders sample a 1x1 depth texture instead of the atlas.
+
+    A second texture with the same layout, the static atlas, keeps the
+    depth of the static shadow casters of each tile. It is only created
+    when a light has static casters to cache.
+   */
+
+  class ShadowAtlas {
+  public:
+
+    //! Create an empty atlas
+    /*!
+      \param size Width and height of the atlas texture, a power of two
+      \param minTileSize Size of the smallest tiles, a power of two
+     */
+
+    ShadowAtlas(GLuint size = 4096, GLuint minTileSize = 128);
+
+    //! Destroy the atlas and its textures
+
+    ~ShadowAtlas();
+
+    //! Set the width and height of the atlas texture
+    /*!
+      The textures are created again, and all the tiles are released.
+     */
+
+    void setSize(GLuint size);
+
+    //! Returns the width and height of the atlas texture
+
+    GLuint getSize() const;
+
+    //! Returns the size of the smallest tiles
+
+    GLuint getMinTileSize() const;
+
+    //! Release all the tiles
+
+    void clear();
+
+    //! Allocate a tile
+    /*!
+      \param tileSize Size of the tile, a power of two
+      \param tile Filled with the position and size of the tile in texels
+      \return false if there is no room left for the tile
+     */
+
+    bool allocate(GLuint tileSize, Rectui& tile);
+
+    //! Returns the size of the tile of a shadow map
+    /*!
+      \param importance Part of the screen covered by the light, from 0 to 1
+      \param maxTileSize Size of the tile when the light covers the screen
+      \return The smallest power of two above importance * maxTileSize,
+      between getMinTileSize() and getSize()
+     */
+
+    GLuint getTileSize(GLfloat importance, GLuint maxTileSize) const;
+
+    //! Returns true if at least one tile is allocated
+
+    bool hasTiles() const;
+
+    //! Returns the depth texture of the atlas
+
+    gle::Texture* getTexture();
+
+    //! Returns the depth texture sampled by the shaders
+    /*!
+      The atlas texture if a tile is allocated, a 1x1 depth texture
+      otherwise, so that a scene without spot light shadows never creates
+      the atlas.
+     */
+
+    gle::Texture* getSampledTexture();
+
+    //! Returns the framebuffer rendering in the atlas
+
+    gle::FrameBuffer* getFrameBuffer();
+
+    //! Returns the depth texture of the static shadow casters
+
+    gle::Texture* getStaticTexture();
+
+    //! Returns the framebuffer rendering in the static atlas
+
+    gle::FrameBuffer* getStaticFrameBuffer();
+
+  private:
+    void		_clearTextures();
+    gle::Texture*	_createTexture(GLuint size);
+
+    GLuint		_size;
+    GLuint		_minTileSize;
+    // Index of the next free tile of minimum size, along the Z-order curve
+    GLuint		_nextTile;
+
+    gle::Texture*	_texture;
+    gle::FrameBuffer*	_frameBuffer;
+    gle::Texture*	_staticTexture;
+    gle::FrameBuffer*	_staticFrameBuffer;
+    gle::Texture*	_emptyTexture;
+  };
+}
+
+#endif /* _GLE_SHADOW_ATLAS_HPP_ */
@@ -149,3 +149,54 @@ void gle::SpotLight::update()
       _shadowMapCamera->setTarget(_target);
     }
 }
+
+void gle::SpotLight::getUniforms(GLfloat* uniforms)
+{
+  const gle::Vector3<GLfloat>& position = getAbsolutePosition();
+  gle::Vector3<GLfloat> direction = getTarget();
+
+  gle::Light::getUniforms(uniforms);
+  direction -= position;
+  uniforms[0] = position.x;
+  uniforms[1] = position.y;
+  uniforms[2] = position.z;
+  uniforms[4] = direction.x;
+  uniforms[5] = direction.y;
+  uniforms[6] = direction.z;
+  uniforms[7] = _cosCutOff;
+  uniforms[11] = _innerCosCutOff;
+  for (int i = 0; i < 3; ++i)
+    {
+      uniforms[8 + i] = _color[i];
+      uniforms[12 + i] = _specularColor[i];
+      uniforms[16 + i] = _attenuation[i];
+    }
+  if (projectShadow() && getShadowMapCamera() && hasShadowMapTile())
+    {
+      gle::Matrix4f
+	shadowMapBiasMatrix(
+			    0.5, 0.0, 0.0, 0.5,
+			    0.0, 0.5, 0.0, 0.5,
+			    0.0, 0.0, 0.5, 0.5,
+			    0.0, 0.0, 0.0, 1.0
+			    );
+      // From the coordinates of the shadow map to those of its tile in the atlas
+      GLfloat scale = (GLfloat)_shadowMapTile.width / _shadowAtlasSize;
+      gle::Matrix4f
+	tileMatrix(
+		   scale, 0.0, 0.0, (GLfloat)_shadowMapTile.x / _shadowAtlasSize,
+		   0.0, scale, 0.0, (GLfloat)_shadowMapTile.y / _shadowAtlasSize,
+		   0.0, 0.0, 1.0, 0.0,
+		   0.0, 0.0, 0.0, 1.0
+		   );
+      gle::Matrix4f VPMatrix =
+	tileMatrix
+	* shadowMapBiasMatrix
+	* _shadowMapCamera->getProjectionMatrix()
+	* _shadowMapCamera->getTransformationMatrix();
+      const GLfloat* VPMatrixf = (const GLfloat*)VPMatrix;
+      uniforms[15] = 1;
+      for (int i = 0; i < 16; ++i)
+	uniforms[20 + i] = VPMatrixf[i];
+    }
+}
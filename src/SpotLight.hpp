@@ -117,6 +117,12 @@ namespace gle {
     //! Update transformation
     void update();
 
+    //! Write the parameters of the light in the lights uniform block layout
+    /*!
+      The shadow map index is left to -1, it's set by the scene
+     */
+    void getUniforms(GLfloat* uniforms);
+
   private:
     GLfloat	_color[3];
     GLfloat	_specularColor[3];
@@ -0,0 +1,312 @@
+//
+// StateCache.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 07:52:50 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <StateCache.hpp>
+
+gle::StateCache::StateCache() :
+  _hasProgram(false), _program(0),
+  _hasVertexArray(false), _vertexArray(0),
+  _buffers(), _indexedBuffers(), _framebuffers(),
+  _hasRenderbuffer(false), _renderbuffer(0),
+  _hasActiveTexture(false), _activeTexture(GL_TEXTURE0),
+  _activeTexturePending(false), _pendingActiveTexture(GL_TEXTURE0),
+  _textures(),
+  _hasPolygonMode(false), _polygonMode(GL_FILL),
+  _hasPointSize(false), _pointSize(1.0),
+  _capabilities(),
+  _hasColorMask(false),
+  _hasDepthMask(false), _depthMask(GL_TRUE),
+  _issuedCalls(0), _skippedCalls(0)
+{
+}
+
+gle::StateCache::~StateCache()
+{
+}
+
+bool gle::StateCache::_skip(bool unchanged)
+{
+  if (unchanged)
+    _skippedCalls++;
+  else
+    _issuedCalls++;
+  return (unchanged);
+}
+
+void gle::StateCache::useProgram(GLuint id)
+{
+  if (_skip(_hasProgram && _program == id))
+    return ;
+  glUseProgram(id);
+  _hasProgram = true;
+  _program = id;
+}
+
+void gle::StateCache::bindBuffer(GLenum target, GLuint id)
+{
+  auto it = _buffers.find(target);
+
+  if (_skip(it != _buffers.end() && it->second == id))
+    return ;
+  glBindBuffer(target, id);
+  _buffers[target] = id;
+}
+
+void gle::StateCache::bindBufferBase(GLenum target, GLuint index, GLuint id)
+{
+  auto it = _indexedBuffers.find(IndexedTarget(target, index));
+
+  if (_skip(it != _indexedBuffers.end() && it->second == id))
+    return ;
+  glBindBufferBase(target, index, id);
+  _indexedBuffers[IndexedTarget(target, index)] = id;
+  // glBindBufferBase also binds the buffer to the generic target
+  _buffers[target] = id;
+}
+
+void gle::StateCache::bindVertexArray(GLuint id)
+{
+  if (_skip(_hasVertexArray && _vertexArray == id))
+    return ;
+  glBindVertexArray(id);
+  _hasVertexArray = true;
+  _vertexArray = id;
+  // The element array buffer binding is part of the vertex array state
+  _buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+}
+
+void gle::StateCache::bindFramebuffer(GLenum target, GLuint id)
+{
+  auto draw = _framebuffers.find(GL_DRAW_FRAMEBUFFER);
+  auto read = _framebuffers.find(GL_READ_FRAMEBUFFER);
+  bool unchanged;
+
+  if (target == GL_FRAMEBUFFER)
+    unchanged = (draw != _framebuffers.end() && draw->second == id
+		 && read != _framebuffers.end() && read->second == id);
+  else
+    unchanged = (target == GL_DRAW_FRAMEBUFFER)
+      ? (draw != _framebuffers.end() && draw->second == id)
+      : (read != _framebuffers.end() && read->second == id);
+  if (_skip(unchanged))
+    return ;
+  glBindFramebuffer(target, id);
+  if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+    _framebuffers[GL_DRAW_FRAMEBUFFER] = id;
+  if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+    _framebuffers[GL_READ_FRAMEBUFFER] = id;
+}
+
+void gle::StateCache::bindRenderbuffer(GLuint id)
+{
+  if (_skip(_hasRenderbuffer && _renderbuffer == id))
+    return ;
+  glBindRenderbuffer(GL_RENDERBUFFER, id);
+  _hasRenderbuffer = true;
+  _renderbuffer = id;
+}
+
+void gle::StateCache::activeTexture(GLenum unit)
+{
+  // The unit is changed only when a texture needs to be bound to it
+  if (_activeTexturePending)
+    _skippedCalls++;
+  _activeTexturePending = !(_hasActiveTexture && _activeTexture == unit);
+  _pendingActiveTexture = unit;
+  if (!_activeTexturePending)
+    _skippedCalls++;
+}
+
+void gle::StateCache::_flushActiveTexture()
+{
+  if (!_activeTexturePending)
+    return ;
+  glActiveTexture(_pendingActiveTexture);
+  _issuedCalls++;
+  _hasActiveTexture = true;
+  _activeTexture = _pendingActiveTexture;
+  _activeTexturePending = false;
+}
+
+void gle::StateCache::bindTexture(GLenum target, GLuint id)
+{
+  if (!_hasActiveTexture && !_activeTexturePending)
+    {
+      // Unknown unit: the binding cannot be cached
+      _issuedCalls++;
+      glBindTexture(target, id);
+      return ;
+    }
+  GLenum unit = _activeTexturePending ? _pendingActiveTexture : _activeTexture;
+  auto it = _textures.find(TextureTarget(unit, target));
+
+  if (_skip(it != _textures.end() && it->second == id))
+    return ;
+  _flushActiveTexture();
+  glBindTexture(target, id);
+  _textures[TextureTarget(unit, target)] = id;
+}
+
+void gle::StateCache::bindTexture(GLenum unit, GLenum target, GLuint id)
+{
+  activeTexture(unit);
+  bindTexture(target, id);
+}
+
+void gle::StateCache::polygonMode(GLenum mode)
+{
+  if (_skip(_hasPolygonMode && _polygonMode == mode))
+    return ;
+  glPolygonMode(GL_FRONT_AND_BACK, mode);
+  _hasPolygonMode = true;
+  _polygonMode = mode;
+}
+
+void gle::StateCache::pointSize(GLfloat size)
+{
+  if (_skip(_hasPointSize && _pointSize == size))
+    return ;
+  glPointSize(size);
+  _hasPointSize = true;
+  _pointSize = size;
+}
+
+void gle::StateCache::setEnabled(GLenum capability, bool enabled)
+{
+  auto it = _capabilities.find(capability);
+
+  if (_skip(it != _capabilities.end() && it->second == enabled))
+    return ;
+  if (enabled)
+    glEnable(capability);
+  else
+    glDisable(capability);
+  _capabilities[capability] = enabled;
+}
+
+void gle::StateCache::enable(GLenum capability)
+{
+  setEnabled(capability, true);
+}
+
+void gle::StateCache::disable(GLenum capability)
+{
+  setEnabled(capability, false);
+}
+
+void gle::StateCache::colorMask(GLboolean red, GLboolean green, GLboolean blue,
+				GLboolean alpha)
+{
+  if (_skip(_hasColorMask && _colorMask[0] == red && _colorMask[1] == green
+	    && _colorMask[2] == blue && _colorMask[3] == alpha))
+    return ;
+  glColorMask(red, green, blue, alpha);
+  _hasColorMask = true;
+  _colorMask[0] = red;
+  _colorMask[1] = green;
+  _colorMask[2] = blue;
+  _colorMask[3] = alpha;
+}
+
+void gle::StateCache::depthMask(GLboolean flag)
+{
+  if (_skip(_hasDepthMask && _depthMask == flag))
+    return ;
+  glDepthMask(flag);
+  _hasDepthMask = true;
+  _depthMask = flag;
+}
+
+void gle::StateCache::forgetBuffer(GLuint id)
+{
+  for (auto it = _buffers.begin(); it != _buffers.end();)
+    if (it->second == id)
+      _buffers.erase(it++);
+    else
+      ++it;
+  for (auto it = _indexedBuffers.begin(); it != _indexedBuffers.end();)
+    if (it->second == id)
+      _indexedBuffers.erase(it++);
+    else
+      ++it;
+}
+
+void gle::StateCache::forgetProgram(GLuint id)
+{
+  if (_program == id)
+    _hasProgram = false;
+}
+
+void gle::StateCache::forgetVertexArray(GLuint id)
+{
+  if (_vertexArray == id)
+    {
+      _hasVertexArray = false;
+      _buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+    }
+}
+
+void gle::StateCache::forgetFramebuffer(GLuint id)
+{
+  for (auto it = _framebuffers.begin(); it != _framebuffers.end();)
+    if (it->second == id)
+      _framebuffers.erase(it++);
+    else
+      ++it;
+}
+
+void gle::StateCache::forgetRenderbuffer(GLuint id)
+{
+  if (_renderbuffer == id)
+    _hasRenderbuffer = false;
+}
+
+void gle::StateCache::forgetTexture(GLuint id)
+{
+  for (auto it = _textures.begin(); it != _textures.end();)
+    if (it->second == id)
+      _textures.erase(it++);
+    else
+      ++it;
+}
+
+void gle::StateCache::reset()
+{
+  _hasProgram = false;
+  _hasVertexArray = false;
+  _buffers.clear();
+  _indexedBuffers.clear();
+  _framebuffers.clear();
+  _hasRenderbuffer = false;
+  _hasActiveTexture = false;
+  _activeTexturePending = false;
+  _textures.clear();
+  _hasPolygonMode = false;
+  _hasPointSize = false;
+  _capabilities.clear();
+  _hasColorMask = false;
+  _hasDepthMask = false;
+}
+
+GLuint gle::StateCache::getIssuedCalls() const
+{
+  return (_issuedCalls);
+}
+
+GLuint gle::StateCache::getSkippedCalls() const
+{
+  return (_skippedCalls);
+}
+
+void gle::StateCache::resetStatistics()
+{
+  _issuedCalls = 0;
+  _skippedCalls = 0;
+}
@@ -0,0 +1,189 @@
+//
+// StateCache.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 07:52:50 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_STATE_CACHE_HPP_
+# define _GLE_STATE_CACHE_HPP_
+
+# include <map>
+# include <utility>
+# include <gle/opengl.h>
+# include <Singleton.hpp>
+
+namespace gle {
+
+  //! Cache of the OpenGL state
+  /*!
+    All the engine binds its objects and sets its raster state through
+    this class, which remembers the current state of the context and skips
+    the calls that would not change it.
+    If OpenGL is used outside of the engine, reset() must be called
+    before rendering again so the cache does not rely on a stale state.
+
+    The number of issued and skipped calls can be retreived to measure
+    the savings.
+   */
+
+  class StateCache : public Singleton<StateCache> {
+    friend class Singleton<StateCache>;
+
+  public:
+
+    //! Use a program
+
+    void	useProgram(GLuint id);
+
+    //! Bind a buffer to a target
+
+    void	bindBuffer(GLenum target, GLuint id);
+
+    //! Bind a buffer to an indexed binding point of a target
+
+    void	bindBufferBase(GLenum target, GLuint index, GLuint id);
+
+    //! Bind a vertex array
+
+    void	bindVertexArray(GLuint id);
+
+    //! Bind a framebuffer
+
+    void	bindFramebuffer(GLenum target, GLuint id);
+
+    //! Bind a renderbuffer
+
+    void	bindRenderbuffer(GLuint id);
+
+    //! Set the active texture unit
+
+    void	activeTexture(GLenum unit);
+
+    //! Bind a texture to the active texture unit
+
+    void	bindTexture(GLenum target, GLuint id);
+
+    //! Bind a texture to a texture unit
+
+    void	bindTexture(GLenum unit, GLenum target, GLuint id);
+
+    //! Set the rasterization mode of the polygons (front and back)
+
+    void	polygonMode(GLenum mode);
+
+    //! Set the size of rasterized points
+
+    void	pointSize(GLfloat size);
+
+    //! Enable or disable a capability
+
+    void	setEnabled(GLenum capability, bool enabled);
+
+    //! Enable a capability
+
+    void	enable(GLenum capability);
+
+    //! Disable a capability
+
+    void	disable(GLenum capability);
+
+    //! Set the color write mask
+
+    void	colorMask(GLboolean red, GLboolean green, GLboolean blue,
+			  GLboolean alpha);
+
+    //! Set the depth write mask
+
+    void	depthMask(GLboolean flag);
+
+    //! Forget a deleted buffer
+    /*!
+      Must be called when a buffer is deleted, as OpenGL
+      can reuse its name for a new buffer.
+     */
+
+    void	forgetBuffer(GLuint id);
+
+    //! Forget a deleted program
+
+    void	forgetProgram(GLuint id);
+
+    //! Forget a deleted vertex array
+
+    void	forgetVertexArray(GLuint id);
+
+    //! Forget a deleted framebuffer
+
+    void	forgetFramebuffer(GLuint id);
+
+    //! Forget a deleted renderbuffer
+
+    void	forgetRenderbuffer(GLuint id);
+
+    //! Forget a deleted texture
+
+    void	forgetTexture(GLuint id);
+
+    //! Forget all the cached state
+    /*!
+      The next calls will all be issued.
+     */
+
+    void	reset();
+
+    //! Returns the number of calls sent to OpenGL
+
+    GLuint	getIssuedCalls() const;
+
+    //! Returns the number of calls skipped because they would not change the state
+
+    GLuint	getSkippedCalls() const;
+
+    //! Reset the issued and skipped calls counters
+
+    void	resetStatistics();
+
+  private:
+    StateCache();
+    ~StateCache();
+
+    bool	_skip(bool unchanged);
+    void	_flushActiveTexture();
+
+    typedef std::pair<GLenum, GLuint>	IndexedTarget;
+    typedef std::pair<GLenum, GLenum>	TextureTarget;
+
+    bool			_hasProgram;
+    GLuint			_program;
+    bool			_hasVertexArray;
+    GLuint			_vertexArray;
+    std::map<GLenum, GLuint>	_buffers;
+    std::map<IndexedTarget, GLuint>	_indexedBuffers;
+    std::map<GLenum, GLuint>	_framebuffers;
+    bool			_hasRenderbuffer;
+    GLuint			_renderbuffer;
+    bool			_hasActiveTexture;
+    GLenum			_activeTexture;
+    bool			_activeTexturePending;
+    GLenum			_pendingActiveTexture;
+    std::map<TextureTarget, GLuint>	_textures;
+    bool			_hasPolygonMode;
+    GLenum			_polygonMode;
+    bool			_hasPointSize;
+    GLfloat			_pointSize;
+    std::map<GLenum, bool>	_capabilities;
+    bool			_hasColorMask;
+    GLboolean			_colorMask[4];
+    bool			_hasDepthMask;
+    GLboolean			_depthMask;
+
+    GLuint			_issuedCalls;
+    GLuint			_skippedCalls;
+  };
+}
+
+#endif /* _GLE_STATE_CACHE_HPP_ */
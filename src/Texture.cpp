@@ -10,11 +10,13 @@
 
 #include <Texture.hpp>
 #include <Exception.hpp>
+#include <Debug.hpp>
+#include <StateCache.hpp>
 #include <iostream>
 
 gle::Texture::Texture(const Image& image, Type type, InternalFormat internalFormat) :
   _id(0), _type(type), _internalFormat(internalFormat), _width(0), _height(0),
-  _useMipmap(true)
+  _nbLayers(1), _useMipmap(true)
 {
   glGenTextures(1, &_id);
   setData(image);
@@ -23,7 +25,18 @@ gle::Texture::Texture(const Image& image, Type type, InternalFormat internalForm
 
 gle::Texture::Texture(GLuint width, GLuint height, Type type, InternalFormat internalFormat) :
   _id(0), _type(type), _internalFormat(internalFormat), _width(width), _height(height),
-  _useMipmap(true)
+  _nbLayers(1), _useMipmap(true)
+{
+  glGenTextures(1, &_id);
+  if (width != 0 && height != 0)
+    setData((const char*)NULL, (GLuint)width, (GLuint)height);
+  setUseMipmap(_useMipmap);
+}
+
+gle::Texture::Texture(GLuint width, GLuint height, GLuint nbLayers, Type type,
+		      InternalFormat internalFormat) :
+  _id(0), _type(type), _internalFormat(internalFormat), _width(width), _height(height),
+  _nbLayers(nbLayers), _useMipmap(true)
 {
   glGenTextures(1, &_id);
   if (width != 0 && height != 0)
@@ -34,16 +47,17 @@ gle::Texture::Texture(GLuint width, GLuint height, Type type, InternalFormat int
 gle::Texture::~Texture()
 {
   glDeleteTextures(1, &_id);
+  gle::StateCache::getInstance().forgetTexture(_id);
 }
 
 void gle::Texture::bind()
 {
-  glBindTexture(_type, _id);
+  gle::StateCache::getInstance().bindTexture(_type, _id);
 }
 
 void gle::Texture::unbind()
 {
-  glBindTexture(_type, 0);
+  gle::StateCache::getInstance().bindTexture(_type, 0);
 }
 
 void gle::Texture::setData(const Image& image, Target target, bool bindTexture)
@@ -60,16 +74,22 @@ void gle::Texture::setData(const char* data, GLuint width, GLuint height, Target
       _width = width;
       _height = height;   
     }
-  glTexImage2D(target, // Texture type
-	       0, // Level of detail (0 = max)
-	       _internalFormat, // Internal format
-	       _width, // Width
-	       _height, // Height
-	       0, // This value must be 0
-	       _internalFormat == Depth ? GL_DEPTH_COMPONENT : GL_RGBA, // Format of the pixel datas
-	       GL_UNSIGNED_BYTE, // Data type of the pixel datas
-	       data);
-  gle::Exception::CheckOpenGLError("Texture::setData");
+  // Array textures allocate all their layers at once
+  if (_type == Texture2DArray)
+    glTexImage3D(_type, 0, _internalFormat, _width, _height, _nbLayers, 0,
+		 _internalFormat == Depth ? GL_DEPTH_COMPONENT : GL_RGBA,
+		 GL_UNSIGNED_BYTE, data);
+  else
+    glTexImage2D(target, // Texture type
+	         0, // Level of detail (0 = max)
+	         _internalFormat, // Internal format
+	         _width, // Width
+	         _height, // Height
+	         0, // This value must be 0
+	         _internalFormat == Depth ? GL_DEPTH_COMPONENT : GL_RGBA, // Format of the pixel datas
+	         GL_UNSIGNED_BYTE, // Data type of the pixel datas
+	         data);
+  GLE_CHECK_OPENGL_ERROR("Texture::setData");
   generateMipmap();
   if (bindTexture)
     unbind();
@@ -112,6 +132,11 @@ gle::Rectf	gle::Texture::getSize() const
   return (Rectf(0, 0, _width, _height));
 }
 
+GLuint	gle::Texture::getNbLayers() const
+{
+  return (_nbLayers);
+}
+
 void	gle::Texture::setFilterType(FilterType filterType)
 {
   glTexParameteri(_type, GL_TEXTURE_MIN_FILTER, filterType);
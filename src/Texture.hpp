@@ -25,8 +25,9 @@ namespace gle {
 
     //! Type of the store openGL texture
     enum Type {
-      Texture2D	= GL_TEXTURE_2D,
-      CubeMap	= GL_TEXTURE_CUBE_MAP
+      Texture2D		= GL_TEXTURE_2D,
+      CubeMap		= GL_TEXTURE_CUBE_MAP,
+      Texture2DArray	= GL_TEXTURE_2D_ARRAY
     };
     
     //! Target for bind an openGL texture
@@ -77,6 +78,18 @@ namespace gle {
      */
     Texture(GLuint width=0, GLuint height=0, Type type=Texture2D, InternalFormat internalFormat=CompressedRGBA);
 
+    //! Create an empty texture with several layers
+    /*!
+      \param width Texture width
+      \param height Texture height
+      \param nbLayers Number of layers of the texture
+      \param type Type of the openGL texture to create (ex: Texture2DArray)
+      \param internalFormat Internal format of the openGL texture to create
+     */
+
+    Texture(GLuint width, GLuint height, GLuint nbLayers, Type type,
+	    InternalFormat internalFormat=CompressedRGBA);
+
     //! Destroy texture
     ~Texture();
 
@@ -125,6 +138,10 @@ namespace gle {
     //! Return texture size
     Rectf	getSize() const;
 
+    //! Return the number of layers of the texture
+
+    GLuint	getNbLayers() const;
+
     //! Set openGL texture filter type
     /*!
       \param filterType Filter type
@@ -143,6 +160,7 @@ namespace gle {
     InternalFormat	_internalFormat;
     GLuint		_width;
     GLuint		_height;
+    GLuint		_nbLayers;
     bool		_useMipmap;
   };
 
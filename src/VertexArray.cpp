@@ -0,0 +1,56 @@
+//
+// VertexArray.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 07:50:25 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include "VertexArray.hpp"
+
+#include "Exception.hpp"
+#include "Debug.hpp"
+#include "StateCache.hpp"
+
+gle::VertexArray::VertexArray() :
+  _id(0), _attributes(0)
+{
+  glGenVertexArrays(1, &_id);
+  GLE_CHECK_OPENGL_ERROR("glGenVertexArrays()");
+}
+
+gle::VertexArray::~VertexArray()
+{
+  glDeleteVertexArrays(1, &_id);
+  gle::StateCache::getInstance().forgetVertexArray(_id);
+}
+
+void gle::VertexArray::bind() const
+{
+  gle::StateCache::getInstance().bindVertexArray(_id);
+}
+
+void gle::VertexArray::unbind()
+{
+  gle::StateCache::getInstance().bindVertexArray(0);
+}
+
+void gle::VertexArray::enableAttributes(GLuint attributes)
+{
+  for (GLuint location = 0; attributes >> location; ++location)
+    if ((attributes & (1 << location)) && !(_attributes & (1 << location)))
+      glEnableVertexAttribArray(location);
+  _attributes |= attributes;
+}
+
+GLuint	gle::VertexArray::getAttributes() const
+{
+  return (_attributes);
+}
+
+GLuint	gle::VertexArray::getId() const
+{
+  return (_id);
+}
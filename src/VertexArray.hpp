@@ -0,0 +1,70 @@
+//
+// VertexArray.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 07:50:25 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_VERTEX_ARRAY_HPP_
+# define _GLE_VERTEX_ARRAY_HPP_
+
+# include <gle/opengl.h>
+
+namespace gle {
+
+  //! Vertex array object
+  /*!
+    A vertex array stores the enabled vertex attributes and their
+    pointers in the buffers, so that they can be restored with
+    a single call to bind().
+    Attribute pointers are set with glVertexAttribPointer while
+    the vertex array is bound.
+   */
+
+  class VertexArray {
+  public:
+
+    //! Construct a vertex array
+
+    VertexArray();
+
+    //! Destruct a vertex array
+
+    ~VertexArray();
+
+    //! Bind the vertex array for current operations
+
+    void	bind() const;
+
+    //! Unbind the current vertex array
+
+    static void	unbind();
+
+    //! Enable the vertex attributes specified by a mask
+    /*!
+      The vertex array must be bound.
+      \param attributes Bitfield where the bit (1 << location) is set
+      for each attribute location to enable
+     */
+
+    void	enableAttributes(GLuint attributes);
+
+    //! Returns the mask of the enabled vertex attributes
+
+    GLuint	getAttributes() const;
+
+    //! Returns the OpenGL ID of the vertex array
+
+    GLuint	getId() const;
+
+  private:
+    GLuint	_id;
+    GLuint	_attributes;
+  };
+
+}
+
+#endif /* _GLE_VERTEX_ARRAY_HPP_ */
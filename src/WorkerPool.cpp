@@ -0,0 +1,112 @@
+//
+// WorkerPool.cpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 09:02:05 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#include <WorkerPool.hpp>
+
+gle::WorkerPool::WorkerPool(unsigned int nbThreads) :
+  _nbThreads(nbThreads ? nbThreads : 1), _job(0), _nbWorking(0),
+  _stop(false), _task(NULL), _nbTasks(0), _nextTask(0)
+{
+}
+
+gle::WorkerPool::~WorkerPool()
+{
+  _stopThreads();
+}
+
+void gle::WorkerPool::setNumberOfThreads(unsigned int nbThreads)
+{
+  _stopThreads();
+  _nbThreads = nbThreads ? nbThreads : 1;
+}
+
+unsigned int gle::WorkerPool::getNumberOfThreads() const
+{
+  return (_nbThreads);
+}
+
+void gle::WorkerPool::run(const std::function<void (GLuint)>& task,
+			  GLuint nbTasks)
+{
+  if (nbTasks <= 1 || _nbThreads <= 1)
+    {
+      for (GLuint i = 0; i < nbTasks; ++i)
+	task(i);
+      return ;
+    }
+  if (_threads.empty())
+    _startThreads();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _task = &task;
+    _nbTasks = nbTasks;
+    _nextTask = 0;
+    _nbWorking = _threads.size();
+    ++_job;
+  }
+  _jobReady.notify_all();
+  _runTasks();
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_nbWorking > 0)
+    _jobDone.wait(lock);
+  _task = NULL;
+}
+
+void gle::WorkerPool::_startThreads()
+{
+  _stop = false;
+  // The calling thread is the last worker
+  for (unsigned int i = 1; i < _nbThreads; ++i)
+    _threads.push_back(new std::thread(&gle::WorkerPool::_work, this, _job));
+}
+
+void gle::WorkerPool::_stopThreads()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _stop = true;
+  }
+  _jobReady.notify_all();
+  for (std::thread* thread : _threads)
+    {
+      thread->join();
+      delete thread;
+    }
+  _threads.clear();
+}
+
+void gle::WorkerPool::_work(GLuint job)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  while (1)
+    {
+      while (!_stop && _job == job)
+	_jobReady.wait(lock);
+      if (_stop)
+	return ;
+      job = _job;
+      lock.unlock();
+      _runTasks();
+      lock.lock();
+      if (--_nbWorking == 0)
+	_jobDone.notify_one();
+    }
+}
+
+void gle::WorkerPool::_runTasks()
+{
+  GLuint task;
+
+  while ((task = _nextTask++) < _nbTasks)
+    (*_task)(task);
+}
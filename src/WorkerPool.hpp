@@ -0,0 +1,88 @@
+//
+// WorkerPool.hpp for  in /root/repo/src
+// 
+// Made by agent
+// Login   <agent@local>
+// 
+// Started on  Sun Oct 18 09:02:05 2026 agent
+// Last update Sun Oct 18 10:52:49 2026 agent
+//
+
+#ifndef _GLE_WORKER_POOL_HPP_
+# define _GLE_WORKER_POOL_HPP_
+
+# include <vector>
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+# include <functional>
+# include <gle/opengl.h>
+
+namespace gle {
+
+  //! Threads kept alive to run the parallel parts of the engine
+  /*!
+    run() splits a job in tasks numbered from 0, which are taken by the
+    workers and the calling thread until they are all done.
+    The threads are started by the first run() needing them, and wait for
+    the next job between two runs instead of being created again.
+
+    A task only knows its index: when each task writes its own part of
+    the result, the result does not depend on the number of threads.
+   */
+
+  class WorkerPool {
+  public:
+
+    //! Create a pool
+    /*!
+      \param nbThreads Number of threads running the tasks, including
+      the thread calling run()
+     */
+    WorkerPool(unsigned int nbThreads = std::thread::hardware_concurrency());
+
+    //! Stop and join the threads
+    ~WorkerPool();
+
+    //! Set the number of threads running the tasks
+    /*!
+      The current threads are stopped, the new ones are started by the
+      next run()
+     */
+    void setNumberOfThreads(unsigned int nbThreads);
+
+    //! Returns the number of threads running the tasks
+    unsigned int getNumberOfThreads() const;
+
+    //! Run tasks and wait for them
+    /*!
+      \param task Function called once with each task index
+      \param nbTasks Number of tasks
+     */
+    void run(const std::function<void (GLuint)>& task, GLuint nbTasks);
+
+  private:
+    void	_startThreads();
+    void	_stopThreads();
+    void	_work(GLuint job);
+    void	_runTasks();
+
+    unsigned int			_nbThreads;
+    std::vector<std::thread*>		_threads;
+
+    std::mutex				_mutex;
+    std::condition_variable		_jobReady;
+    std::condition_variable		_jobDone;
+    // Incremented for each job, so a worker runs it only once
+    GLuint				_job;
+    GLuint				_nbWorking;
+    bool				_stop;
+
+    const std::function<void (GLuint)>*	_task;
+    GLuint				_nbTasks;
+    std::atomic<GLuint>			_nextTask;
+  };
+}
+
+#endif /* _GLE_WORKER_POOL_HPP_ */
@@ -16,6 +16,9 @@
 #include "SpotLight.hpp"
 
 #include "Exception.hpp"
+#include "StateCache.hpp"
+#include "Debug.hpp"
+#include "ProgramCache.hpp"
 
 //! Main namespace of the engine
 /*!
@@ -0,0 +1,282 @@
+//
+// TestElement.hpp for  in /root/repo/tests
+//
+// Made by agent
+// Login   <agent@local>
+//
+// Started on  Sun Oct 18 14:40:26 2026 agent
+// Last update Sun Oct 18 14:40:26 2026 agent
+//
+
+#ifndef _GLE_TEST_ELEMENT_HPP_
+# define _GLE_TEST_ELEMENT_HPP_
+
+# include <cmath>
+# include <cstdlib>
+# include <iostream>
+# include <limits>
+# include <set>
+# include <vector>
+# include <Octree.hpp>
+
+// Results closer to a plane or a threshold than this are not compared
+# define GLE_TEST_EPSILON 1e-2
+
+namespace gle {
+  namespace Test {
+
+    //! Expected result of the culling of an element
+    enum Result {
+      Outside,
+      Inside,
+      Unknown
+      /*!< Too close to a plane or a threshold to be compared */
+    };
+
+    //! Returns a coordinate of a vector: x, y or z
+    inline GLfloat component(const Vector3<GLfloat>& v, GLuint axis)
+    {
+      return (axis == 0 ? v.x : (axis == 1 ? v.y : v.z));
+    }
+
+    //! Returns a random number in [min, max]
+    inline GLfloat randomValue(GLfloat min, GLfloat max)
+    {
+      return (min + (max - min) * rand() / RAND_MAX);
+    }
+
+    //! Element of the trees, a box or a sphere
+    /*!
+      test() culls the element in double precision, the reference of
+      the queries of Octree and DynamicTree.
+     */
+
+    class Element : public gle::Octree::Element {
+    public:
+      Element() :
+	_min(), _max(), _center(), _radius(-1),
+	_drawDistance(std::numeric_limits<GLfloat>::infinity())
+      {
+      }
+
+      //! Set the element to a box
+      void setBox(const Vector3<GLfloat>& min, const Vector3<GLfloat>& max)
+      {
+	_min = min;
+	_max = max;
+	_center = min + max;
+	_center /= 2;
+	_radius = -1;
+      }
+
+      //! Set the element to a sphere
+      void setSphere(const Vector3<GLfloat>& center, GLfloat radius)
+      {
+	_center = center;
+	_min = center;
+	_min -= radius;
+	_max = center;
+	_max += radius;
+	_radius = radius;
+      }
+
+      //! Move the element by an offset
+      void move(const Vector3<GLfloat>& offset)
+      {
+	_min += offset;
+	_max += offset;
+	_center += offset;
+      }
+
+      void setDrawDistance(GLfloat distance)
+      {
+	_drawDistance = distance;
+      }
+
+      const Vector3<GLfloat>& getMaxPoint()
+      {
+	return (_max);
+      }
+
+      const Vector3<GLfloat>& getMinPoint()
+      {
+	return (_min);
+      }
+
+      const Vector3<GLfloat>& getCenter()
+      {
+	return (_center);
+      }
+
+      GLfloat getRadius()
+      {
+	return (_radius);
+      }
+
+      GLfloat getDrawDistance()
+      {
+	return (_drawDistance);
+      }
+
+      bool isInFrustum(const GLfloat frustum[6][4]) const
+      {
+	for (GLuint p = 0; p < 6; ++p)
+	  {
+	    GLfloat distance = frustum[p][3];
+
+	    for (GLuint axis = 0; axis < 3; ++axis)
+	      distance += frustum[p][axis] * component(_center, axis)
+		+ (_radius >= 0 ? 0 : fabs(frustum[p][axis])
+		   * (component(_max, axis) - component(_min, axis)) / 2);
+	    if (distance + std::max(_radius, 0.0f) < 0)
+	      return (false);
+	  }
+	return (true);
+      }
+
+      //! Cull the element in double precision
+      /*!
+	\param frustum Six planes of frustum
+	\param detail Point of view and size ratio, see BoundsArray, or NULL
+       */
+      Result test(const GLfloat frustum[6][4], const GLfloat* detail) const
+      {
+	Result	result = Inside;
+	double	radius = std::max(_radius, 0.0f);
+	double	extents[3];
+
+	for (GLuint axis = 0; axis < 3; ++axis)
+	  extents[axis] = _radius >= 0 ? 0
+	    : (component(_max, axis) - component(_min, axis)) / 2.0;
+	for (GLuint p = 0; p < 6; ++p)
+	  {
+	    double distance = frustum[p][3] + radius;
+
+	    for (GLuint axis = 0; axis < 3; ++axis)
+	      distance += frustum[p][axis] * (double)component(_center, axis)
+		+ fabs(frustum[p][axis]) * extents[axis];
+	    if (distance < -GLE_TEST_EPSILON)
+	      return (Outside);
+	    if (distance < GLE_TEST_EPSILON)
+	      result = Unknown;
+	  }
+	if (!detail)
+	  return (result);
+
+	double	squares = 0;
+	double	size = 0;
+
+	for (GLuint axis = 0; axis < 3; ++axis)
+	  {
+	    double outside = std::max(fabs(component(_center, axis)
+					   - (double)detail[axis])
+				      - extents[axis], 0.0);
+
+	    squares += outside * outside;
+	    size += extents[axis] * extents[axis];
+	  }
+	double distance = std::max(sqrt(squares) - radius, 0.0);
+	size = radius + sqrt(size);
+	if (fabs(distance - _drawDistance) < GLE_TEST_EPSILON
+	    || fabs(size - distance * detail[3]) < GLE_TEST_EPSILON)
+	  return (Unknown);
+	if (distance > _drawDistance || size < distance * detail[3])
+	  return (Outside);
+	return (result);
+      }
+
+    private:
+      Vector3<GLfloat>	_min;
+      Vector3<GLfloat>	_max;
+      Vector3<GLfloat>	_center;
+      GLfloat		_radius;
+      GLfloat		_drawDistance;
+    };
+
+    //! Check the elements found by a query
+    /*!
+      Each element must be found once at most. The elements of the tree
+      inside the frustum must be found, and the others must not.
+      \param visible Elements found by the query
+      \param elements All the elements
+      \param inTree Whether each element is in the tree
+      \param frustum Six planes of the frustum of the query
+      \param detail Detail of the query, or NULL
+      \param exactDetail Whether the elements culled by the detail only
+      must not be found
+      \param name Name of the query, for the errors
+      \return Number of errors
+     */
+    inline GLuint compare(const std::vector<gle::Octree::Element*>& visible,
+			  std::vector<Element>& elements,
+			  const std::vector<bool>& inTree,
+			  const GLfloat frustum[6][4], const GLfloat* detail,
+			  bool exactDetail, const char* name)
+    {
+      std::set<gle::Octree::Element*>	found(visible.begin(), visible.end());
+      GLuint				errors = 0;
+
+      if (found.size() != visible.size())
+	{
+	  std::cerr << name << ": elements found twice" << std::endl;
+	  ++errors;
+	}
+      for (Element& element : elements)
+	{
+	  Result expected = element.test(frustum, detail);
+
+	  if (!inTree[&element - &elements[0]])
+	    expected = Outside;
+	  else if (expected == Outside && detail && !exactDetail
+		   && element.test(frustum, NULL) != Outside)
+	    expected = Unknown;
+	  if ((expected == Inside && !found.count(&element))
+	      || (expected == Outside && found.count(&element)))
+	    {
+	      if (errors++ < 10)
+		std::cerr << name << ": element " << &element - &elements[0]
+			  << (found.count(&element) ? " found" : " missed")
+			  << std::endl;
+	    }
+	  found.erase(&element);
+	}
+      if (!found.empty())
+	{
+	  std::cerr << name << ": unknown elements found" << std::endl;
+	  ++errors;
+	}
+      return (errors);
+    }
+
+    //! Get the frustum of a camera turning around the origin
+    /*!
+      \param frame Frame of the camera, in [0, nbFrames[
+      \param view Index of the camera: each one has its own path
+      \param frustum Filled with the planes of the frustum
+      \param detail Filled with the position of the camera and a size
+      ratio, see BoundsArray
+     */
+    inline void getFrustum(GLuint frame, GLuint nbFrames, GLuint view,
+			   GLfloat frustum[6][4], GLfloat* detail)
+    {
+      GLfloat			angle = frame * 2 * M_PI / nbFrames + view;
+      Vector3<GLfloat>		position(cos(angle) * 150, 20 + 10 * view,
+					 sin(angle) * 150);
+      Vector3<GLfloat>		target(30 * view, 0, 0);
+      Matrix4<GLfloat>		projection =
+	Matrix4<GLfloat>::perspective(60 + 10 * view, 16.0 / 9, 1, 400);
+      Matrix4<GLfloat>		modelview =
+	Matrix4<GLfloat>::cameraLookAt(position, target,
+				       Vector3<GLfloat>(0, 1, 0));
+
+      modelview.translate(-position.x, -position.y, -position.z);
+      gle::Octree::getFrustumPlanes(projection, modelview, frustum);
+      detail[0] = position.x;
+      detail[1] = position.y;
+      detail[2] = position.z;
+      detail[3] = 0.01;
+    }
+  }
+}
+
+#endif /* _GLE_TEST_ELEMENT_HPP_ */
@@ -0,0 +1,266 @@
+//
+// boundsArray.cpp for  in /root/repo/tests
+//
+// Made by agent
+// Login   <agent@local>
+//
+// Started on  Sun Oct 18 14:02:11 2026 agent
+// Last update Sun Oct 18 14:02:11 2026 agent
+//
+
+// Compares BoundsArray::cull with a test of each bound in double
+// precision. Built once with the SSE kernel and once with the scalar
+// one (tests/boundsArrayScalar), so both give the same results.
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <BoundsArray.hpp>
+#include <Matrix4.hpp>
+
+#define NB_BOUNDS 20000
+#define NB_FRAMES 50
+
+// Results closer to a plane or a threshold than this are not compared
+#define EPSILON 1e-2
+
+namespace {
+  enum Result {Outside, Inside, Unknown};
+
+  struct Bound {
+    double	center[3];
+    double	extent[3];
+    double	radius;
+    double	drawDistance;
+    bool	empty;
+  };
+
+  double randomValue(double min, double max)
+  {
+    return (min + (max - min) * rand() / RAND_MAX);
+  }
+
+  Result testPlanes(const Bound& bound, const GLfloat frustum[6][4],
+		    GLuint planeMask)
+  {
+    Result	result = Inside;
+
+    if (bound.empty)
+      return (Outside);
+    for (GLuint p = 0; p < 6; ++p)
+      if (planeMask & (1 << p))
+	{
+	  double distance = bound.radius + frustum[p][3];
+
+	  for (GLuint axis = 0; axis < 3; ++axis)
+	    distance += frustum[p][axis] * bound.center[axis]
+	      + fabs(frustum[p][axis]) * bound.extent[axis];
+	  if (distance < -EPSILON)
+	    return (Outside);
+	  if (distance < EPSILON)
+	    result = Unknown;
+	}
+    return (result);
+  }
+
+  Result testDetail(const Bound& bound, const GLfloat* detail)
+  {
+    double	squares = 0;
+    double	size = 0;
+
+    for (GLuint axis = 0; axis < 3; ++axis)
+      {
+	double outside = std::max(fabs(bound.center[axis] - detail[axis])
+				  - bound.extent[axis], 0.0);
+
+	squares += outside * outside;
+	size += bound.extent[axis] * bound.extent[axis];
+      }
+    double distance = std::max(sqrt(squares) - bound.radius, 0.0);
+    size = bound.radius + sqrt(size);
+    if (fabs(distance - bound.drawDistance) < EPSILON
+	|| fabs(size - distance * detail[3]) < EPSILON)
+      return (Unknown);
+    return (distance <= bound.drawDistance && size >= distance * detail[3]
+	    ? Inside : Outside);
+  }
+
+  Result test(const Bound& bound, const GLfloat frustum[6][4],
+	      GLuint planeMask, const GLfloat* detail)
+  {
+    Result	result = testPlanes(bound, frustum, planeMask);
+
+    if (result == Outside || !detail)
+      return (result);
+    Result	detailResult = testDetail(bound, detail);
+    if (detailResult == Outside)
+      return (Outside);
+    return (result == Unknown || detailResult == Unknown ? Unknown : Inside);
+  }
+
+  void getFrustum(GLuint frame, GLuint view, GLfloat frustum[6][4],
+		  GLfloat* detail)
+  {
+    GLfloat		angle = frame * 2 * M_PI / NB_FRAMES + view;
+    gle::Vector3<GLfloat>	position(cos(angle) * 150, 20 + 10 * view,
+					 sin(angle) * 150);
+    gle::Vector3<GLfloat>	target(30 * view, 0, 0);
+    gle::Matrix4<GLfloat>	projection =
+      gle::Matrix4<GLfloat>::perspective(60 + 10 * view, 16.0 / 9, 1, 400);
+    gle::Matrix4<GLfloat>	modelview =
+      gle::Matrix4<GLfloat>::cameraLookAt(position, target,
+					  gle::Vector3<GLfloat>(0, 1, 0));
+
+    modelview.translate(-position.x, -position.y, -position.z);
+
+    // Planes of Octree::getFrustumPlanes(), without linking the octree:
+    // the last row of the clip matrix plus or minus another row
+    gle::Matrix4<GLfloat>	clip = projection * modelview;
+
+    for (GLuint i = 0; i < 6; ++i)
+      {
+	GLfloat	sign = i % 2 ? 1 : -1;
+	GLfloat	length = 0;
+
+	for (GLuint j = 0; j < 4; ++j)
+	  frustum[i][j] = clip[j * 4 + 3] + sign * clip[j * 4 + i / 2];
+	for (GLuint j = 0; j < 3; ++j)
+	  length += frustum[i][j] * frustum[i][j];
+	for (GLuint j = 0; j < 4; ++j)
+	  frustum[i][j] /= sqrt(length);
+      }
+    detail[0] = position.x;
+    detail[1] = position.y;
+    detail[2] = position.z;
+    detail[3] = 0.01;
+  }
+}
+
+int main()
+{
+  gle::BoundsArray	bounds;
+  std::vector<Bound>	references(NB_BOUNDS);
+  GLuint		errors = 0;
+  GLuint		compared = 0;
+
+  srand(42);
+  for (GLuint i = 0; i < NB_BOUNDS; ++i)
+    {
+      Bound&	bound = references[i];
+      gle::Vector3<GLfloat>	center(randomValue(-300, 300), randomValue(-50, 50),
+				       randomValue(-300, 300));
+      gle::Vector3<GLfloat>	extent(randomValue(0, 10), randomValue(0, 10),
+				       randomValue(0, 10));
+      GLfloat			radius = 0;
+
+      bound.empty = i % 97 == 0;
+      if (bound.empty)
+	{
+	  bounds.addBox(center, center);
+	  bounds.setEmpty(i);
+	}
+      else if (i % 2)
+	bounds.addBox(center - extent, center + extent);
+      else
+	{
+	  extent = gle::Vector3<GLfloat>(0, 0, 0);
+	  radius = randomValue(0, 10);
+	  bounds.addSphere(center, radius);
+	}
+      bound.drawDistance = std::numeric_limits<double>::infinity();
+      if (i % 3 == 0)
+	{
+	  bound.drawDistance = randomValue(50, 300);
+	  bounds.setDrawDistance(i, bound.drawDistance);
+	}
+      bound.center[0] = center.x;
+      bound.center[1] = center.y;
+      bound.center[2] = center.z;
+      bound.extent[0] = extent.x;
+      bound.extent[1] = extent.y;
+      bound.extent[2] = extent.z;
+      bound.radius = radius;
+    }
+
+  for (GLuint frame = 0; frame < NB_FRAMES; ++frame)
+    {
+      GLfloat		frustums[2][6][4];
+      GLfloat		detail[4];
+      GLfloat		otherDetail[4];
+      GLuint		planeMasks[2] = {gle::BoundsArray::AllPlanes,
+					 frame % 2 ? gle::BoundsArray::AllPlanes : 0xF};
+      // Ranges which are not aligned on BoundsArray::Width
+      GLuint		first = frame % 7;
+      GLuint		last = NB_BOUNDS - frame % 5;
+
+      getFrustum(frame, 0, frustums[0], detail);
+      getFrustum(frame, 1, frustums[1], otherDetail);
+
+      // Single frustum, with and without the detail
+      for (GLuint withDetail = 0; withDetail < 2; ++withDetail)
+	{
+	  const GLfloat*	queryDetail = withDetail ? detail : NULL;
+	  std::vector<GLuint>	visible;
+	  std::vector<bool>	isVisible(NB_BOUNDS, false);
+
+	  bounds.cull(frustums[0], planeMasks[0], queryDetail, first, last,
+		      visible);
+	  for (GLuint index : visible)
+	    isVisible[index] = true;
+	  for (GLuint i = 0; i < NB_BOUNDS; ++i)
+	    {
+	      Result expected = test(references[i], frustums[0], planeMasks[0],
+				     queryDetail);
+
+	      if (i < first || i >= last)
+		expected = Outside;
+	      if (expected == Unknown)
+		continue ;
+	      ++compared;
+	      if (isVisible[i] != (expected == Inside))
+		{
+		  if (errors++ < 10)
+		    std::cerr << "frame " << frame << ": bound " << i
+			      << (isVisible[i] ? " visible" : " culled")
+			      << (withDetail ? " with detail" : "") << std::endl;
+		}
+	    }
+	}
+
+      // Two frustums, the detail only culling in the first one
+      std::vector<GLuint>	masks(NB_BOUNDS, 0);
+      std::vector<GLuint>	visible;
+      std::vector<bool>		isVisible(NB_BOUNDS, false);
+
+      bounds.cull(frustums, planeMasks, 3, detail, first, last, &masks[0],
+		  visible);
+      for (GLuint index : visible)
+	isVisible[index] = true;
+      for (GLuint i = 0; i < NB_BOUNDS; ++i)
+	{
+	  Result	expected[2] = {test(references[i], frustums[0],
+					    planeMasks[0], detail),
+				       test(references[i], frustums[1],
+					    planeMasks[1], NULL)};
+
+	  if (i < first || i >= last)
+	    expected[0] = expected[1] = Outside;
+	  if (expected[0] == Unknown || expected[1] == Unknown)
+	    continue ;
+	  ++compared;
+	  if (((masks[i] & 1) != 0) != (expected[0] == Inside)
+	      || ((masks[i] & 2) != 0) != (expected[1] == Inside)
+	      || isVisible[i] != (masks[i] != 0))
+	    {
+	      if (errors++ < 10)
+		std::cerr << "frame " << frame << ": bound " << i
+			  << " has the mask " << masks[i] << std::endl;
+	    }
+	}
+    }
+  std::cout << compared << " bounds compared, " << errors << " errors"
+	    << std::endl;
+  return (errors != 0 || compared == 0);
+}
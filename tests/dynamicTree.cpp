@@ -0,0 +1,167 @@
+//
+// dynamicTree.cpp for  in /root/repo/tests
+//
+// Made by agent
+// Login   <agent@local>
+//
+// Started on  Sun Oct 18 15:31:05 2026 agent
+// Last update Sun Oct 18 15:31:05 2026 agent
+//
+
+// Compares the queries of DynamicTree on moving elements with a brute
+// force culling of all the elements in double precision, and the
+// queries of a single thread with those of several threads.
+
+#include <iostream>
+#include <list>
+#include <vector>
+#include <DynamicTree.hpp>
+#include "TestElement.hpp"
+
+#define NB_ELEMENTS 8000
+#define NB_FRAMES 20
+
+namespace {
+  void createElements(std::vector<gle::Test::Element>& elements)
+  {
+    for (GLuint i = 0; i < elements.size(); ++i)
+      {
+	gle::Vector3<GLfloat>	center(gle::Test::randomValue(-300, 300),
+				       gle::Test::randomValue(-20, 60),
+				       gle::Test::randomValue(-300, 300));
+	GLfloat			size = gle::Test::randomValue(0.1, 5);
+
+	if (i % 2)
+	  {
+	    gle::Vector3<GLfloat>	extent(size, size / 2, size);
+
+	    elements[i].setBox(center - extent, center + extent);
+	  }
+	else
+	  elements[i].setSphere(center, size);
+	if (i % 3 == 0)
+	  elements[i].setDrawDistance(gle::Test::randomValue(50, 300));
+      }
+  }
+
+  // Moves some elements, by small steps or far away, and removes and
+  // inserts others, in both trees
+  GLuint updateElements(gle::DynamicTree& tree, gle::DynamicTree& threadedTree,
+			std::vector<gle::Test::Element>& elements,
+			std::vector<bool>& inTree)
+  {
+    GLuint	errors = 0;
+
+    for (GLuint i = 0; i < elements.size(); ++i)
+      {
+	GLuint	action = rand() % 10;
+
+	if (action < 3 && inTree[i])
+	  {
+	    GLfloat	step = action ? 2 : 100;
+
+	    elements[i].move(gle::Vector3<GLfloat>(gle::Test::randomValue(-step, step),
+						   gle::Test::randomValue(-step, step) / 10,
+						   gle::Test::randomValue(-step, step)));
+	    tree.update(&elements[i]);
+	    threadedTree.update(&elements[i]);
+	  }
+	else if (action == 3 && rand() % 5 == 0)
+	  {
+	    bool removed = tree.remove(&elements[i]);
+
+	    if (removed != inTree[i] || threadedTree.remove(&elements[i]) != removed)
+	      ++errors;
+	    inTree[i] = false;
+	  }
+	else if (action == 4 && rand() % 5 == 0)
+	  {
+	    bool inserted = tree.insert(&elements[i]);
+
+	    if (inserted == inTree[i] || threadedTree.insert(&elements[i]) != inserted)
+	      ++errors;
+	    inTree[i] = true;
+	  }
+      }
+    for (GLuint i = 0; i < elements.size(); ++i)
+      if (tree.contains(&elements[i]) != inTree[i])
+	++errors;
+    if (errors)
+      std::cerr << "update: " << errors << " elements not updated" << std::endl;
+    return (errors);
+  }
+}
+
+int main()
+{
+  std::vector<gle::Test::Element>	elements(NB_ELEMENTS);
+  std::vector<bool>			inTree(NB_ELEMENTS, true);
+  std::list<gle::Octree::Element*>	list;
+  gle::DynamicTree			tree;
+  gle::DynamicTree			threadedTree;
+  GLuint				errors = 0;
+  GLuint				nbVisible = 0;
+
+  srand(42);
+  createElements(elements);
+  for (gle::Test::Element& element : elements)
+    list.push_back(&element);
+  threadedTree.setNumberOfThreads(4);
+  tree.updateTree(list);
+  threadedTree.updateTree(list);
+
+  for (GLuint frame = 0; frame < NB_FRAMES; ++frame)
+    {
+      GLfloat	frustums[2][6][4];
+      GLfloat	detail[4];
+      GLfloat	otherDetail[4];
+
+      errors += updateElements(tree, threadedTree, elements, inTree);
+      gle::Test::getFrustum(frame, NB_FRAMES, 0, frustums[0], detail);
+      gle::Test::getFrustum(frame, NB_FRAMES, 1, frustums[1], otherDetail);
+
+      // A single frustum, then with the detail: the fat boxes keep some
+      // of the elements culled by the detail
+      std::vector<gle::Octree::Element*> visible = tree.getVisibleElements(frustums[0]);
+      errors += gle::Test::compare(visible, elements, inTree, frustums[0],
+				   NULL, true, "frustum");
+      nbVisible += visible.size();
+      if (threadedTree.getVisibleElements(frustums[0]) != visible)
+	{
+	  std::cerr << "frustum: the threads find other elements" << std::endl;
+	  ++errors;
+	}
+      visible = tree.getVisibleElements(frustums[0], detail);
+      errors += gle::Test::compare(visible, elements, inTree, frustums[0],
+				   detail, false, "detail");
+      if (threadedTree.getVisibleElements(frustums[0], detail) != visible)
+	{
+	  std::cerr << "detail: the threads find other elements" << std::endl;
+	  ++errors;
+	}
+
+      // Two frustums: the masks give the elements of each one
+      visible = tree.getVisibleElements(frustums, 2);
+      std::vector<GLuint> masks = tree.getVisibleMasks();
+      for (GLuint view = 0; view < 2; ++view)
+	{
+	  std::vector<gle::Octree::Element*> viewVisible;
+
+	  for (GLuint i = 0; i < visible.size(); ++i)
+	    if (masks[i] & (1 << view))
+	      viewVisible.push_back(visible[i]);
+	  errors += gle::Test::compare(viewVisible, elements, inTree,
+				       frustums[view], NULL, true, "views");
+	}
+      if (threadedTree.getVisibleElements(frustums, 2) != visible
+	  || threadedTree.getVisibleMasks() != masks)
+	{
+	  std::cerr << "views: the threads find other elements" << std::endl;
+	  ++errors;
+	}
+    }
+
+  std::cout << "dynamic tree: " << nbVisible << " elements found, " << errors
+	    << " errors" << std::endl;
+  return (errors != 0 || nbVisible == 0);
+}
@@ -0,0 +1,230 @@
+//
+// lightClusters.cpp for  in /root/repo/tests
+//
+// Made by agent
+// Login   <agent@local>
+//
+// Started on  Sun Oct 18 15:52:20 2026 agent
+// Last update Sun Oct 18 15:52:20 2026 agent
+//
+
+// Checks that the points lit by each light are in a cluster listing the
+// light, computing the cluster of the points in double precision, and
+// that the clusters do not depend on the number of threads.
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <LightClusters.hpp>
+
+#define NB_LIGHTS 600
+#define NB_FRAMES 10
+#define NB_SAMPLES 200
+
+// Points closer to the border of a cluster than this are not checked
+#define EPSILON 1e-3
+
+namespace {
+  struct Light {
+    gle::Vector3<GLfloat>	position;
+    GLfloat			range;
+  };
+
+  double randomValue(double min, double max)
+  {
+    return (min + (max - min) * rand() / RAND_MAX);
+  }
+
+  // Returns the cell of a coordinate in a grid, or -1 when the coordinate
+  // is too close to the border of a cell
+  int getCell(double position, GLuint gridSize)
+  {
+    double	cell = std::min(std::max(position, 0.0), gridSize - 1e-9);
+
+    if (cell - floor(cell) < EPSILON || ceil(cell) - cell < EPSILON)
+      return (-1);
+    return ((int)cell);
+  }
+
+  // Returns the cluster of a point in world space, or -1 when it is not
+  // in the frustum or too close to the border of a cluster
+  int getCluster(const gle::LightClusters& clusters,
+		 const gle::Matrix4<GLfloat>& view,
+		 const gle::Matrix4<GLfloat>& projection,
+		 const double point[3])
+  {
+    const gle::Vector3<GLfloat>&	depth = clusters.getDepthParameters();
+    double				eye[4];
+    double				clip[4];
+
+    for (GLuint i = 0; i < 4; ++i)
+      eye[i] = view[i] * point[0] + view[4 + i] * point[1]
+	+ view[8 + i] * point[2] + view[12 + i];
+    for (GLuint i = 0; i < 4; ++i)
+      clip[i] = projection[i] * eye[0] + projection[4 + i] * eye[1]
+	+ projection[8 + i] * eye[2] + projection[12 + i] * eye[3];
+    if (-eye[2] <= depth.x || -eye[2] >= depth.y
+	|| fabs(clip[0]) >= clip[3] || fabs(clip[1]) >= clip[3])
+      return (-1);
+
+    int	x = getCell((clip[0] / clip[3] + 1) * 0.5 * gle::LightClusters::GridX,
+		    gle::LightClusters::GridX);
+    int	y = getCell((clip[1] / clip[3] + 1) * 0.5 * gle::LightClusters::GridY,
+		    gle::LightClusters::GridY);
+    int	z = getCell(log(-eye[2] / depth.x) * depth.z, gle::LightClusters::GridZ);
+
+    if (x < 0 || y < 0 || z < 0)
+      return (-1);
+    return (clusters.getClusterIndex(x, y, z));
+  }
+
+  bool isInCluster(const gle::LightClusters& clusters, GLuint cluster,
+		   GLuint light)
+  {
+    GLuint	offset = clusters.getClusterOffset(cluster);
+
+    for (GLuint i = 0; i < clusters.getClusterSize(cluster); ++i)
+      if (clusters.getIndex(offset + i) == light)
+	return (true);
+    return (false);
+  }
+
+  void getCamera(GLuint frame, gle::Matrix4<GLfloat>& view,
+		 gle::Matrix4<GLfloat>& projection)
+  {
+    GLfloat			angle = frame * 2 * M_PI / NB_FRAMES;
+    gle::Vector3<GLfloat>	position(cos(angle) * 80, 10 + frame, sin(angle) * 80);
+
+    projection = gle::Matrix4<GLfloat>::perspective(50 + 5 * frame, 16.0 / 9,
+						    1, 200);
+    view = gle::Matrix4<GLfloat>::cameraLookAt(position, gle::Vector3<GLfloat>(0, 0, 0),
+					       gle::Vector3<GLfloat>(0, 1, 0));
+    view.translate(-position.x, -position.y, -position.z);
+  }
+}
+
+int main()
+{
+  std::vector<Light>	lights(NB_LIGHTS);
+  gle::LightClusters	clusters(0xFFFF);
+  gle::LightClusters	threadedClusters(0xFFFF);
+  gle::LightClusters	smallClusters(1000);
+  GLuint		errors = 0;
+  GLuint		checked = 0;
+
+  srand(42);
+  // The first lights have an infinite range, and are in all the clusters
+  for (GLuint i = 0; i < NB_LIGHTS; ++i)
+    {
+      lights[i].position = gle::Vector3<GLfloat>(randomValue(-100, 100),
+						 randomValue(-5, 20),
+						 randomValue(-100, 100));
+      lights[i].range = i < 2 ? -1 : randomValue(0.5, 10);
+      clusters.addLight(lights[i].position, lights[i].range, i);
+      threadedClusters.addLight(lights[i].position, lights[i].range, i);
+      smallClusters.addLight(lights[i].position, lights[i].range, i);
+    }
+  threadedClusters.setNumberOfThreads(gle::LightClusters::maximumNumberOfThreads);
+
+  for (GLuint frame = 0; frame < NB_FRAMES; ++frame)
+    {
+      gle::Matrix4<GLfloat>	view;
+      gle::Matrix4<GLfloat>	projection;
+
+      getCamera(frame, view, projection);
+      clusters.build(view, projection);
+      threadedClusters.build(view, projection);
+      smallClusters.build(view, projection);
+
+      if (threadedClusters.getData() != clusters.getData()
+	  || threadedClusters.getNbIndexes() != clusters.getNbIndexes())
+	{
+	  std::cerr << "frame " << frame << ": the threads give other clusters"
+		    << std::endl;
+	  ++errors;
+	}
+
+      // The points of the spheres of the lights must be in clusters
+      // listing the light
+      for (GLuint i = 0; i < NB_LIGHTS; ++i)
+	for (GLuint sample = 0; sample < NB_SAMPLES; ++sample)
+	  {
+	    double	range = lights[i].range < 0 ? 100 : lights[i].range;
+	    double	offset[3];
+	    double	point[3];
+
+	    do
+	      for (GLuint axis = 0; axis < 3; ++axis)
+		offset[axis] = randomValue(-range, range);
+	    while (offset[0] * offset[0] + offset[1] * offset[1]
+		   + offset[2] * offset[2] > range * range);
+	    point[0] = lights[i].position.x + offset[0];
+	    point[1] = lights[i].position.y + offset[1];
+	    point[2] = lights[i].position.z + offset[2];
+
+	    int cluster = getCluster(clusters, view, projection, point);
+
+	    if (cluster < 0)
+	      continue ;
+	    ++checked;
+	    if (!isInCluster(clusters, cluster, i) && errors++ < 10)
+	      std::cerr << "frame " << frame << ": light " << i
+			<< " missing from the cluster " << cluster << std::endl;
+	  }
+
+      // The lights of a cluster are in the order they were added
+      for (GLuint c = 0; c < gle::LightClusters::NbClusters; ++c)
+	for (GLuint i = 1; i < clusters.getClusterSize(c); ++i)
+	  if (clusters.getIndex(clusters.getClusterOffset(c) + i)
+	      <= clusters.getIndex(clusters.getClusterOffset(c) + i - 1))
+	    {
+	      if (errors++ < 10)
+		std::cerr << "frame " << frame << ": cluster " << c
+			  << " is not sorted" << std::endl;
+	      break ;
+	    }
+
+      // The clusters of the small list are filled in order, until the
+      // index list is full: the same indexes as the full list, truncated
+      if (smallClusters.getNbIndexes() > smallClusters.getMaxIndexes()
+	  || smallClusters.getNbIndexes()
+	  != std::min(clusters.getNbIndexes(), smallClusters.getMaxIndexes()))
+	{
+	  std::cerr << "frame " << frame << ": " << smallClusters.getNbIndexes()
+		    << " indexes in the small list" << std::endl;
+	  ++errors;
+	}
+      for (GLuint c = 0; c < gle::LightClusters::NbClusters; ++c)
+	if (smallClusters.getClusterOffset(c) != clusters.getClusterOffset(c)
+	    && smallClusters.getClusterSize(c) != 0)
+	  {
+	    std::cerr << "frame " << frame << ": cluster " << c
+		      << " moved in the small list" << std::endl;
+	    ++errors;
+	    break ;
+	  }
+      for (GLsizeiptr i = 0; i < smallClusters.getNbIndexes(); ++i)
+	if (smallClusters.getIndex(i) != clusters.getIndex(i))
+	  {
+	    std::cerr << "frame " << frame << ": index " << i
+		      << " differs in the small list" << std::endl;
+	    ++errors;
+	    break ;
+	  }
+    }
+
+  // The attenuation reaches the threshold at the range of the light
+  GLfloat	range = gle::LightClusters::getLightRange(1, 0.1, 0.01, 1 / 256.0);
+
+  if (fabs(1 / (1 + 0.1 * range + 0.01 * range * range) - 1 / 256.0) > 1e-6
+      || gle::LightClusters::getLightRange(1, 0, 0, 1 / 256.0) >= 0)
+    {
+      std::cerr << "getLightRange: wrong range " << range << std::endl;
+      ++errors;
+    }
+
+  std::cout << "light clusters: " << checked << " points checked, " << errors
+	    << " errors" << std::endl;
+  return (errors != 0 || checked == 0);
+}
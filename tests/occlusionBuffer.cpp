@@ -0,0 +1,317 @@
+//
+// occlusionBuffer.cpp for  in /root/repo/tests
+//
+// Made by agent
+// Login   <agent@local>
+//
+// Started on  Sun Oct 18 16:10:37 2026 agent
+// Last update Sun Oct 18 16:10:37 2026 agent
+//
+
+// Compares the depths of OcclusionBuffer with the occluders rasterized in
+// double precision, and checks that the hidden boxes are behind them.
+// Built once with the SSE kernel and once with the scalar one
+// (tests/occlusionBufferScalar).
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <OcclusionBuffer.hpp>
+
+#define WIDTH 256
+#define HEIGHT 128
+#define NB_QUADS 20
+#define NB_BOXES 20000
+#define NB_SAMPLES 20
+
+// Pixel centers closer to an edge than this, in pixels, are not compared
+#define EPSILON 1e-2
+
+namespace {
+  struct Triangle {
+    double	x[3];
+    double	y[3];
+    double	z[3];
+  };
+
+  double randomValue(double min, double max)
+  {
+    return (min + (max - min) * rand() / RAND_MAX);
+  }
+
+  void project(const gle::Matrix4<GLfloat>& m, const double point[3],
+	       double screen[3])
+  {
+    double	clip[4];
+
+    for (GLuint i = 0; i < 4; ++i)
+      clip[i] = m[i] * point[0] + m[4 + i] * point[1] + m[8 + i] * point[2]
+	+ m[12 + i];
+    screen[0] = (clip[0] / clip[3] * 0.5 + 0.5) * WIDTH;
+    screen[1] = (clip[1] / clip[3] * 0.5 + 0.5) * HEIGHT;
+    screen[2] = clip[2] / clip[3];
+  }
+
+  // Depth of a triangle on a point of the screen, infinite when the point
+  // is outside, or NaN when it is too close to an edge
+  double getDepth(const Triangle& t, double x, double y)
+  {
+    double	area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0])
+      - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+    double	weights[3];
+    bool	border = false;
+
+    if (area == 0)
+      return (std::numeric_limits<double>::infinity());
+    for (GLuint i = 0; i < 3; ++i)
+      {
+	GLuint	j = (i + 1) % 3;
+	GLuint	k = (i + 2) % 3;
+	double	edge = (t.x[k] - t.x[j]) * (y - t.y[j])
+	  - (t.y[k] - t.y[j]) * (x - t.x[j]);
+	double	length = sqrt((t.x[k] - t.x[j]) * (t.x[k] - t.x[j])
+			      + (t.y[k] - t.y[j]) * (t.y[k] - t.y[j]));
+
+	weights[i] = edge / area;
+	if (fabs(edge) < EPSILON * length)
+	  border = true;
+	else if (weights[i] < 0)
+	  return (std::numeric_limits<double>::infinity());
+      }
+    if (border)
+      return (NAN);
+    return (weights[0] * t.z[0] + weights[1] * t.z[1] + weights[2] * t.z[2]);
+  }
+
+  // Nearest depth of the occluders on the center of a pixel, or NaN when
+  // the center is too close to an edge
+  double getPixelDepth(const std::vector<Triangle>& triangles, GLuint x,
+		       GLuint y)
+  {
+    double	depth = std::numeric_limits<double>::infinity();
+
+    for (const Triangle& triangle : triangles)
+      {
+	double	triangleDepth = getDepth(triangle, x + 0.5, y + 0.5);
+
+	if (std::isnan(triangleDepth))
+	  return (NAN);
+	depth = std::min(depth, triangleDepth);
+      }
+    return (depth);
+  }
+
+  // Quad of an occluder, with the transformation of the occluder
+  struct Quad {
+    GLfloat			vertexes[4][3];
+    gle::Matrix4<GLfloat>	transformation;
+  };
+
+  void setQuad(Quad& quad, const GLfloat vertexes[4][3])
+  {
+    for (GLuint i = 0; i < 4; ++i)
+      for (GLuint axis = 0; axis < 3; ++axis)
+	quad.vertexes[i][axis] = vertexes[i][axis];
+  }
+
+  // A wall in front of the camera, a tilted one moved by its
+  // transformation, one crossing the near plane, and random quads
+  // behind the wall
+  void createQuads(std::vector<Quad>& quads)
+  {
+    static const GLfloat	wall[4][3] = {{-6, -4, -20}, {6, -4, -20},
+					      {6, 4, -20}, {-6, 4, -20}};
+    static const GLfloat	tilted[4][3] = {{0, -5, 0}, {12, -5, -10},
+						{12, 5, -10}, {0, 5, 0}};
+    static const GLfloat	crossing[4][3] = {{-20, -8, 5}, {-10, -8, 5},
+						  {-10, -8, -30}, {-20, -8, -30}};
+
+    quads.resize(NB_QUADS);
+    setQuad(quads[0], wall);
+    setQuad(quads[1], tilted);
+    quads[1].transformation.translate(8, 0, -30);
+    setQuad(quads[2], crossing);
+    for (GLuint i = 3; i < NB_QUADS; ++i)
+      {
+	GLfloat	z = randomValue(-80, -50);
+
+	for (GLuint j = 0; j < 4; ++j)
+	  {
+	    quads[i].vertexes[j][0] = randomValue(-0.6, 0.6) * -z;
+	    quads[i].vertexes[j][1] = randomValue(-0.3, 0.3) * -z;
+	    quads[i].vertexes[j][2] = z + randomValue(-5, 5);
+	  }
+      }
+  }
+
+  void addQuads(gle::OcclusionBuffer& buffer, const std::vector<Quad>& quads)
+  {
+    static const GLuint	indexes[6] = {0, 1, 2, 0, 2, 3};
+
+    for (const Quad& quad : quads)
+      buffer.addOccluder(quad.transformation, &quad.vertexes[0][0], 4,
+			 indexes, 6);
+  }
+
+  // The triangles of the quads in front of the near plane, on the screen
+  void getTriangles(const gle::Matrix4<GLfloat>& matrix,
+		    const std::vector<Quad>& quads,
+		    std::vector<Triangle>& triangles)
+  {
+    static const GLuint	indexes[6] = {0, 1, 2, 0, 2, 3};
+
+    for (const Quad& quad : quads)
+      for (GLuint i = 0; i < 6; i += 3)
+	{
+	  Triangle	triangle;
+	  bool		projected = true;
+
+	  for (GLuint j = 0; j < 3; ++j)
+	    {
+	      const GLfloat*	vertex = quad.vertexes[indexes[i + j]];
+	      double		point[3];
+	      double		screen[3];
+
+	      for (GLuint axis = 0; axis < 3; ++axis)
+		point[axis] = vertex[axis] + quad.transformation[12 + axis];
+	      if (point[2] > -1)
+		projected = false;
+	      project(matrix, point, screen);
+	      triangle.x[j] = screen[0];
+	      triangle.y[j] = screen[1];
+	      triangle.z[j] = screen[2];
+	    }
+	  if (projected)
+	    triangles.push_back(triangle);
+	}
+  }
+
+  // Checks that the points of a hidden box are behind the occluders
+  GLuint checkHidden(const gle::Matrix4<GLfloat>& matrix,
+		     const std::vector<Triangle>& triangles,
+		     const double min[3], const double max[3])
+  {
+    for (GLuint sample = 0; sample < 8 + NB_SAMPLES; ++sample)
+      {
+	double	point[3];
+	double	screen[3];
+
+	for (GLuint axis = 0; axis < 3; ++axis)
+	  point[axis] = sample < 8 ? (sample & (1 << axis) ? max[axis] : min[axis])
+	    : randomValue(min[axis], max[axis]);
+	project(matrix, point, screen);
+	if (screen[0] < 0 || screen[0] >= WIDTH
+	    || screen[1] < 0 || screen[1] >= HEIGHT)
+	  continue ;
+
+	double	depth = getPixelDepth(triangles, screen[0], screen[1]);
+
+	if (!std::isnan(depth) && depth > screen[2] + 1e-5)
+	  return (1);
+      }
+    return (0);
+  }
+}
+
+int main()
+{
+  gle::OcclusionBuffer		buffer(WIDTH, HEIGHT);
+  gle::OcclusionBuffer		threadedBuffer(WIDTH, HEIGHT);
+  gle::Matrix4<GLfloat>		projection =
+    gle::Matrix4<GLfloat>::perspective(60, 2, 1, 100);
+  gle::Matrix4<GLfloat>		modelview;
+  gle::Matrix4<GLfloat>		matrix = projection * modelview;
+  std::vector<Quad>		quads;
+  std::vector<Triangle>		triangles;
+  GLuint			errors = 0;
+  GLuint			compared = 0;
+  GLuint			hidden = 0;
+
+  srand(42);
+  createQuads(quads);
+  getTriangles(matrix, quads, triangles);
+  threadedBuffer.setNumberOfThreads(4);
+  buffer.clear(projection, modelview);
+  threadedBuffer.clear(projection, modelview);
+  addQuads(buffer, quads);
+  addQuads(threadedBuffer, quads);
+  buffer.rasterize();
+  threadedBuffer.rasterize();
+
+  if (buffer.getNbTriangles() != triangles.size())
+    {
+      std::cerr << buffer.getNbTriangles() << " triangles rasterized instead of "
+		<< triangles.size() << std::endl;
+      ++errors;
+    }
+  if (threadedBuffer.getDepths() != buffer.getDepths())
+    {
+      std::cerr << "the threads give other depths" << std::endl;
+      ++errors;
+    }
+
+  // The depth of a pixel is the depth of the nearest occluder on its
+  // center, raised to its farthest depth on the pixel
+  for (GLuint y = 0; y < HEIGHT; ++y)
+    for (GLuint x = 0; x < WIDTH; ++x)
+      {
+	double	expected = getPixelDepth(triangles, x, y);
+	double	depth = buffer.getDepths()[y * WIDTH + x];
+
+	if (std::isnan(expected))
+	  continue ;
+	++compared;
+	if (std::isinf(expected) ? !std::isinf(depth)
+	    : depth < expected - 1e-5 || depth > expected + 1e-2)
+	  {
+	    if (errors++ < 10)
+	      std::cerr << "pixel " << x << " " << y << ": depth " << depth
+			<< " instead of " << expected << std::endl;
+	  }
+      }
+
+  // Boxes behind the wall, in front of it, beside it, partly hidden, and
+  // crossing the near plane
+  static const GLfloat	boxes[5][2][3] = {{{-1, -1, -30}, {1, 1, -25}},
+					  {{-1, -1, -15}, {1, 1, -12}},
+					  {{-12, -1, -26}, {-10, 1, -25}},
+					  {{4, -1, -25}, {9, 1, -24}},
+					  {{-1, -1, -3}, {1, 1, 0.5}}};
+
+  for (GLuint i = 0; i < 5; ++i)
+    if (buffer.isVisible(gle::Vector3<GLfloat>(boxes[i][0][0], boxes[i][0][1],
+					       boxes[i][0][2]),
+			 gle::Vector3<GLfloat>(boxes[i][1][0], boxes[i][1][1],
+					       boxes[i][1][2])) != (i != 0))
+      {
+	std::cerr << "box " << i << (i ? " hidden" : " visible") << std::endl;
+	++errors;
+      }
+
+  // The points of the random boxes found hidden are behind the occluders
+  for (GLuint i = 0; i < NB_BOXES; ++i)
+    {
+      double	min[3];
+      double	max[3];
+      double	depth = randomValue(-90, -2);
+
+      min[0] = randomValue(-0.7, 0.7) * -depth;
+      min[1] = randomValue(-0.4, 0.4) * -depth;
+      min[2] = depth;
+      for (GLuint axis = 0; axis < 3; ++axis)
+	max[axis] = min[axis] + randomValue(0.1, 3);
+      if (buffer.isVisible(gle::Vector3<GLfloat>(min[0], min[1], min[2]),
+			   gle::Vector3<GLfloat>(max[0], max[1], max[2])))
+	continue ;
+      ++hidden;
+      if (checkHidden(matrix, triangles, min, max) && errors++ < 10)
+	std::cerr << "box " << i << " hidden in front of the occluders"
+		  << std::endl;
+    }
+
+  std::cout << "occlusion buffer: " << compared << " pixels compared, "
+	    << hidden << " boxes hidden, " << errors << " errors" << std::endl;
+  return (errors != 0 || compared == 0 || hidden == 0);
+}
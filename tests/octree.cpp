@@ -0,0 +1,240 @@
+//
+// octree.cpp for  in /root/repo/tests
+//
+// Made by agent
+// Login   <agent@local>
+//
+// Started on  Sun Oct 18 14:58:40 2026 agent
+// Last update Sun Oct 18 14:58:40 2026 agent
+//
+
+// Compares the queries of Octree with a brute force culling of all the
+// elements in double precision, with and without the detail and the
+// draw distances.
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+#include <set>
+#include <vector>
+#include "TestElement.hpp"
+
+#define NB_ELEMENTS 30000
+#define NB_FRAMES 20
+#define NB_UPDATES 10
+
+namespace {
+  // Elements gathered around a few centers, like the buildings of a city,
+  // and spread over the whole scene
+  void createElements(std::vector<gle::Test::Element>& elements)
+  {
+    gle::Vector3<GLfloat>	centers[16];
+
+    for (GLuint i = 0; i < 16; ++i)
+      centers[i] = gle::Vector3<GLfloat>(gle::Test::randomValue(-300, 300), 0,
+					 gle::Test::randomValue(-300, 300));
+    for (GLuint i = 0; i < elements.size(); ++i)
+      {
+	gle::Vector3<GLfloat>	center(gle::Test::randomValue(-400, 400),
+				       gle::Test::randomValue(-20, 60),
+				       gle::Test::randomValue(-400, 400));
+	GLfloat			size = i % 100 ? gle::Test::randomValue(0.1, 5)
+	  : gle::Test::randomValue(20, 60);
+
+	if (i % 3)
+	  center = centers[i % 16]
+	    + gle::Vector3<GLfloat>(gle::Test::randomValue(-30, 30),
+				    gle::Test::randomValue(0, 40),
+				    gle::Test::randomValue(-30, 30));
+	if (i % 2)
+	  {
+	    gle::Vector3<GLfloat>	extent(size, size * 2, size / 2);
+
+	    elements[i].setBox(center - extent, center + extent);
+	  }
+	else
+	  elements[i].setSphere(center, size);
+	if (i % 3 == 0)
+	  elements[i].setDrawDistance(gle::Test::randomValue(50, 300));
+      }
+  }
+
+  // Changes the draw distance of some elements of the tree
+  void setDrawDistances(gle::Octree& tree,
+			std::vector<gle::Test::Element>& elements,
+			const std::vector<bool>& inTree)
+  {
+    for (GLuint i = 0; i < elements.size(); ++i)
+      if (inTree[i] && rand() % 10 == 0)
+	{
+	  elements[i].setDrawDistance(gle::Test::randomValue(20, 200));
+	  tree.update(&elements[i]);
+	}
+  }
+
+  // Moves, removes and inserts elements of the tree one by one, then
+  // through updateTree()
+  GLuint updateElements(gle::Octree& tree,
+			std::vector<gle::Test::Element>& elements,
+			std::vector<bool>& inTree, GLuint step)
+  {
+    std::list<gle::Octree::Element*>	list;
+    GLuint				errors = 0;
+
+    for (GLuint i = 0; i < elements.size(); ++i)
+      {
+	GLuint	action = rand() % 20;
+
+	// Small moves stay in the loose cell of the leaf, others leave it,
+	// and some leave the grid of the tree
+	if (action == 0 && inTree[i])
+	  {
+	    elements[i].move(gle::Vector3<GLfloat>(gle::Test::randomValue(-1, 1), 0,
+						   gle::Test::randomValue(-1, 1)));
+	    tree.update(&elements[i]);
+	  }
+	else if (action == 1 && inTree[i])
+	  {
+	    elements[i].move(gle::Vector3<GLfloat>(gle::Test::randomValue(-200, 200),
+						   gle::Test::randomValue(-10, 10),
+						   gle::Test::randomValue(-200, 200)));
+	    tree.update(&elements[i]);
+	  }
+	else if (action == 2 && inTree[i] && i % 50 == 0)
+	  {
+	    elements[i].move(gle::Vector3<GLfloat>(1000, 0, 0));
+	    tree.update(&elements[i]);
+	  }
+	else if (action == 3)
+	  {
+	    if (tree.remove(&elements[i]) != inTree[i])
+	      ++errors;
+	    inTree[i] = false;
+	  }
+	else if (action == 4)
+	  {
+	    if (tree.insert(&elements[i]) == inTree[i])
+	      ++errors;
+	    inTree[i] = true;
+	  }
+      }
+    // Every other step, the list given to updateTree() has other elements
+    for (GLuint i = 0; i < elements.size(); ++i)
+      {
+	if (step % 2 && rand() % 20 == 0)
+	  {
+	    inTree[i] = !inTree[i];
+	    if (inTree[i])
+	      elements[i].move(gle::Vector3<GLfloat>(gle::Test::randomValue(-20, 20), 0,
+						     gle::Test::randomValue(-20, 20)));
+	  }
+	if (inTree[i])
+	  list.push_back(&elements[i]);
+      }
+    tree.updateTree(list);
+    for (GLuint i = 0; i < elements.size(); ++i)
+      if (tree.contains(&elements[i]) != inTree[i])
+	++errors;
+    if (tree.getNbElements() != list.size())
+      ++errors;
+    if (errors)
+      std::cerr << "update " << step << ": " << errors
+		<< " elements not updated" << std::endl;
+    return (errors);
+  }
+
+  std::set<gle::Octree::Element*> getSet(const std::vector<gle::Octree::Element*>& v)
+  {
+    return (std::set<gle::Octree::Element*>(v.begin(), v.end()));
+  }
+}
+
+int main()
+{
+  std::vector<gle::Test::Element>	elements(NB_ELEMENTS);
+  std::vector<bool>			inTree(NB_ELEMENTS, true);
+  std::list<gle::Octree::Element*>	list;
+  gle::Octree				tree;
+  gle::Octree				threadedTree;
+  GLuint				errors = 0;
+  GLuint				nbVisible = 0;
+
+  srand(42);
+  createElements(elements);
+  for (gle::Test::Element& element : elements)
+    list.push_back(&element);
+
+  // The tree built by several threads finds the same elements
+  threadedTree.setNumberOfThreads(4);
+  tree.generateTree(list);
+  threadedTree.generateTree(list);
+  if (tree.getNbElements() != NB_ELEMENTS
+      || threadedTree.getNbElements() != NB_ELEMENTS)
+    {
+      std::cerr << "generateTree: " << tree.getNbElements() << " and "
+		<< threadedTree.getNbElements() << " elements" << std::endl;
+      ++errors;
+    }
+  for (GLuint frame = 0; frame < NB_FRAMES; ++frame)
+    {
+      GLfloat	frustums[2][6][4];
+      GLfloat	detail[4];
+      GLfloat	otherDetail[4];
+
+      gle::Test::getFrustum(frame, NB_FRAMES, 0, frustums[0], detail);
+      gle::Test::getFrustum(frame, NB_FRAMES, 1, frustums[1], otherDetail);
+      errors += compare(tree.getVisibleElements(frustums[0]), elements, inTree,
+			frustums[0], NULL, true, "generateTree");
+      nbVisible += tree.getVisibleElements(frustums[0]).size();
+      if (getSet(tree.getVisibleElements(frustums[0]))
+	  != getSet(threadedTree.getVisibleElements(frustums[0])))
+	{
+	  std::cerr << "generateTree: the threads find other elements"
+		    << std::endl;
+	  ++errors;
+	}
+
+      // The leaves cull the small and distant elements exactly
+      errors += compare(tree.getVisibleElements(frustums[0], detail), elements,
+			inTree, frustums[0], detail, true, "detail");
+
+      // Two frustums, the detail only culling in the first one
+      std::vector<gle::Octree::Element*> visible =
+	tree.getVisibleElements(frustums, 2, detail);
+      std::vector<GLuint> masks = tree.getVisibleMasks();
+      for (GLuint view = 0; view < 2; ++view)
+	{
+	  std::vector<gle::Octree::Element*> viewVisible;
+
+	  for (GLuint i = 0; i < visible.size(); ++i)
+	    if (masks[i] & (1 << view))
+	      viewVisible.push_back(visible[i]);
+	  errors += compare(viewVisible, elements, inTree, frustums[view],
+			    view == 0 ? detail : NULL, true, "views");
+	}
+    }
+
+  // The elements inserted, removed and moved are found where they are
+  for (GLuint step = 0; step < NB_UPDATES; ++step)
+    {
+      GLfloat	frustum[6][4];
+      GLfloat	detail[4];
+
+      errors += updateElements(tree, elements, inTree, step);
+      gle::Test::getFrustum(step, NB_UPDATES, 0, frustum, detail);
+      errors += compare(tree.getVisibleElements(frustum), elements, inTree,
+			frustum, NULL, true, "update");
+      nbVisible += tree.getVisibleElements(frustum).size();
+
+      // The same query after changing draw distances is not taken from
+      // the results of the last one
+      tree.getVisibleElements(frustum, detail);
+      setDrawDistances(tree, elements, inTree);
+      errors += compare(tree.getVisibleElements(frustum, detail), elements,
+			inTree, frustum, detail, true, "draw distances");
+    }
+
+  std::cout << "octree: " << nbVisible << " elements found, " << errors
+	    << " errors" << std::endl;
+  return (errors != 0 || nbVisible == 0);
+}